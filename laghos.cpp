@@ -60,127 +60,96 @@
 // -m data/cube_12_hex.mesh  -pt 322 for 12 / 96 / 768 / 6144 ... tasks.
 
 #include <fstream>
+#include <vector>
 #include <sys/time.h>
 #include <sys/resource.h>
-#include "laghos_solver.hpp"
+#include "laghos_api.hpp"
+#include "laghos_vis.hpp"
 
 using std::cout;
 using std::endl;
 using namespace mfem;
-
-// Choice for the problem setup.
-static int problem, dim;
-
-// Forward declarations.
-double e0(const Vector &);
-double rho0(const Vector &);
-double gamma_func(const Vector &);
-void v0(const Vector &, Vector &);
+using namespace mfem::hydrodynamics;
 
 static long GetMaxRssMB();
+static void SerialMeshSize(const LaghosOptions &opt, int &dim, double &zones);
 static void display_banner(std::ostream&);
-static void Checks(const int dim, const int ti, const double norm, int &checks);
+static void Checks(const int problem, const int dim, const int ti,
+                   const double norm, int &checks, const double eps);
+
+// MPI initialization and finalization, as MPI_Session, with the funneled
+// thread level: the GLVis sender threads (-vislb) and the OpenMP threads make
+// no MPI calls.
+class ThreadedMPISession
+{
+private:
+   int provided, world_rank, world_size;
+
+public:
+   ThreadedMPISession(int &argc, char **&argv)
+   {
+      MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+      MPI_Comm_rank(MPI_COMM_WORLD, &world_rank);
+      MPI_Comm_size(MPI_COMM_WORLD, &world_size);
+   }
+   ~ThreadedMPISession() { MPI_Finalize(); }
+   bool Funneled() const { return provided >= MPI_THREAD_FUNNELED; }
+   bool Root() const { return world_rank == 0; }
+   int WorldSize() const { return world_size; }
+};
 
 int main(int argc, char *argv[])
 {
    // Initialize MPI.
-   MPI_Session mpi(argc, argv);
-   const int myid = mpi.WorldRank();
+   ThreadedMPISession mpi(argc, argv);
 
    // Print the banner.
    if (mpi.Root()) { display_banner(cout); }
 
    // Parse command-line options.
-   problem = 1;
-   dim = 3;
-   const char *mesh_file = "default";
-   int rs_levels = 2;
-   int rp_levels = 0;
-   Array<int> cxyz;
-   int order_v = 2;
-   int order_e = 1;
-   int order_q = -1;
-   int ode_solver_type = 4;
-   double t_final = 0.6;
-   double cfl = 0.5;
-   double cg_tol = 1e-8;
-   double ftz_tol = 0.0;
-   int cg_max_iter = 300;
-   int max_tsteps = -1;
-   bool p_assembly = true;
-   bool impose_visc = false;
+   LaghosOptions opt;
    bool visualization = false;
    int vis_steps = 5;
+   bool vis_low_bandwidth = false;
+   int vis_aggregators = 1;
    bool visit = false;
    bool gfprint = false;
    const char *basename = "results/Laghos";
-   int partition_type = 0;
    const char *device = "cpu";
    bool check = false;
    bool mem_usage = false;
    bool fom = false;
    bool gpu_aware_mpi = false;
    int dev = 0;
-   double blast_energy = 0.25;
-   double blast_position[] = {0.0, 0.0, 0.0};
+   int capture_step = -1;
+   const char *capture_file = "capture";
+   const char *replay_file = "";
+   int replay_reps = 10;
+   bool tlb_misses = false;
+   const char *perf_calibrate = "";
+   const char *perf_predict = "";
+   int perf_ranks = 0;
+   bool perf_only = false;
 
    OptionsParser args(argc, argv);
-   args.AddOption(&dim, "-dim", "--dimension", "Dimension of the problem.");
-   args.AddOption(&mesh_file, "-m", "--mesh", "Mesh file to use.");
-   args.AddOption(&rs_levels, "-rs", "--refine-serial",
-                  "Number of times to refine the mesh uniformly in serial.");
-   args.AddOption(&rp_levels, "-rp", "--refine-parallel",
-                  "Number of times to refine the mesh uniformly in parallel.");
-   args.AddOption(&cxyz, "-c", "--cartesian-partitioning",
-                  "Use Cartesian partitioning.");
-   args.AddOption(&problem, "-p", "--problem", "Problem setup to use.");
-   args.AddOption(&order_v, "-ok", "--order-kinematic",
-                  "Order (degree) of the kinematic finite element space.");
-   args.AddOption(&order_e, "-ot", "--order-thermo",
-                  "Order (degree) of the thermodynamic finite element space.");
-   args.AddOption(&order_q, "-oq", "--order-intrule",
-                  "Order  of the integration rule.");
-   args.AddOption(&ode_solver_type, "-s", "--ode-solver",
-                  "ODE solver: 1 - Forward Euler,\n\t"
-                  "            2 - RK2 SSP, 3 - RK3 SSP, 4 - RK4, 6 - RK6,\n\t"
-                  "            7 - RK2Avg.");
-   args.AddOption(&t_final, "-tf", "--t-final",
-                  "Final time; start time is 0.");
-   args.AddOption(&cfl, "-cfl", "--cfl", "CFL-condition number.");
-   args.AddOption(&cg_tol, "-cgt", "--cg-tol",
-                  "Relative CG tolerance (velocity linear solve).");
-   args.AddOption(&ftz_tol, "-ftz", "--ftz-tol",
-                  "Absolute flush-to-zero tolerance.");
-   args.AddOption(&cg_max_iter, "-cgm", "--cg-max-steps",
-                  "Maximum number of CG iterations (velocity linear solve).");
-   args.AddOption(&max_tsteps, "-ms", "--max-steps",
-                  "Maximum number of steps (negative means no restriction).");
-   args.AddOption(&p_assembly, "-pa", "--partial-assembly", "-fa",
-                  "--full-assembly",
-                  "Activate 1D tensor-based assembly (partial assembly).");
-   args.AddOption(&impose_visc, "-iv", "--impose-viscosity", "-niv",
-                  "--no-impose-viscosity",
-                  "Use active viscosity terms even for smooth problems.");
+   opt.AddOptions(args);
    args.AddOption(&visualization, "-vis", "--visualization", "-no-vis",
                   "--no-visualization",
                   "Enable or disable GLVis visualization.");
    args.AddOption(&vis_steps, "-vs", "--visualization-steps",
                   "Visualize every n-th timestep.");
+   args.AddOption(&vis_low_bandwidth, "-vislb", "--vis-low-bandwidth",
+                  "-no-vislb", "--no-vis-low-bandwidth",
+                  "Stream zone averages to GLVis asynchronously, dropping\n\t"
+                  "the frames that GLVis cannot keep up with.");
+   args.AddOption(&vis_aggregators, "-vag", "--vis-aggregators",
+                  "Number of ranks sending the -vislb frames to GLVis.");
    args.AddOption(&visit, "-visit", "--visit", "-no-visit", "--no-visit",
                   "Enable or disable VisIt visualization.");
    args.AddOption(&gfprint, "-print", "--print", "-no-print", "--no-print",
                   "Enable or disable result output (files in mfem format).");
    args.AddOption(&basename, "-k", "--outputfilename",
                   "Name of the visit dump files");
-   args.AddOption(&partition_type, "-pt", "--partition",
-                  "Customized x/y/z Cartesian MPI partitioning of the serial mesh.\n\t"
-                  "Here x,y,z are relative task ratios in each direction.\n\t"
-                  "Example: with 48 mpi tasks and -pt 321, one would get a Cartesian\n\t"
-                  "partition of the serial mesh by (6,4,2) MPI tasks in (x,y,z).\n\t"
-                  "NOTE: the serially refined mesh must have the appropriate number\n\t"
-                  "of zones in each direction, e.g., the number of zones in direction x\n\t"
-                  "must be divisible by the number of MPI tasks in direction x.\n\t"
-                  "Available options: 11, 21, 111, 211, 221, 311, 321, 322, 432.");
    args.AddOption(&device, "-d", "--device",
                   "Device configuration string, see Device::Configure().");
    args.AddOption(&check, "-chk", "--checks", "-no-chk", "--no-checks",
@@ -192,6 +161,27 @@ int main(int argc, char *argv[])
    args.AddOption(&gpu_aware_mpi, "-gam", "--gpu-aware-mpi", "-no-gam",
                   "--no-gpu-aware-mpi", "Enable GPU aware MPI communications.");
    args.AddOption(&dev, "-dev", "--dev", "GPU device to use.");
+   args.AddOption(&capture_step, "-cap", "--capture-step",
+                  "Record the kernel inputs and outputs of this step.");
+   args.AddOption(&capture_file, "-capf", "--capture-file",
+                  "Basename of the per-rank kernel capture files.");
+   args.AddOption(&replay_file, "-replay", "--replay",
+                  "Replay the kernels of a capture (basename) and exit.");
+   args.AddOption(&replay_reps, "-rr", "--replay-repetitions",
+                  "Number of timed repetitions of each replayed kernel.");
+   args.AddOption(&tlb_misses, "-tlb", "--tlb-misses", "-no-tlb",
+                  "--no-tlb-misses",
+                  "Count the data TLB load misses of the time loop.");
+   args.AddOption(&perf_calibrate, "-pmc", "--perf-calibrate",
+                  "Write the performance model calibration of this run.");
+   args.AddOption(&perf_predict, "-pmp", "--perf-predict",
+                  "Predict this run from a performance model calibration,\n\t"
+                  "and report the error of the prediction at the end.");
+   args.AddOption(&perf_ranks, "-pmn", "--perf-ranks",
+                  "Number of ranks of the prediction (0: of this run).");
+   args.AddOption(&perf_only, "-pmx", "--perf-predict-only", "-no-pmx",
+                  "--no-perf-predict-only",
+                  "Exit after the prediction, without running.");
    args.Parse();
    if (!args.Good())
    {
@@ -206,369 +196,97 @@ int main(int argc, char *argv[])
    if (mpi.Root()) { backend.Print(); }
    backend.SetGPUAwareMPI(gpu_aware_mpi);
 
-   // On all processors, use the default builtin 1D/2D/3D mesh or read the
-   // serial one given on the command line.
-   Mesh *mesh;
-   if (strncmp(mesh_file, "default", 7) != 0)
-   {
-      mesh = new Mesh(mesh_file, true, true);
-   }
-   else
-   {
-      if (dim == 1)
-      {
-         mesh = new Mesh(Mesh::MakeCartesian1D(2));
-         mesh->GetBdrElement(0)->SetAttribute(1);
-         mesh->GetBdrElement(1)->SetAttribute(1);
-      }
-      if (dim == 2)
-      {
-         mesh = new Mesh(Mesh::MakeCartesian2D(2, 2, Element::QUADRILATERAL,
-                                               true));
-         const int NBE = mesh->GetNBE();
-         for (int b = 0; b < NBE; b++)
-         {
-            Element *bel = mesh->GetBdrElement(b);
-            const int attr = (b < NBE/2) ? 2 : 1;
-            bel->SetAttribute(attr);
-         }
-      }
-      if (dim == 3)
-      {
-         mesh = new Mesh(Mesh::MakeCartesian3D(2, 2, 2, Element::HEXAHEDRON,
-                                               true));
-         const int NBE = mesh->GetNBE();
-         for (int b = 0; b < NBE; b++)
-         {
-            Element *bel = mesh->GetBdrElement(b);
-            const int attr = (b < NBE/3) ? 3 : (b < 2*NBE/3) ? 1 : 2;
-            bel->SetAttribute(attr);
-         }
-      }
-   }
-   dim = mesh->Dimension();
-
-   // 1D vs partial assembly sanity check.
-   if (p_assembly && dim == 1)
+   // Offline replay of captured kernels, instead of a simulation.
+   if (replay_file[0] != '\0')
    {
-      p_assembly = false;
+      // With -i64 (-cbt), the replay times only the 64-bit quadrature update
+      // kernel (the kernels with the compile-time tables).
+      SetKernelIndex64(opt.index64);
+      SetConstBasisTables(opt.const_basis);
+      int my_errors = ReplayKernels(MPI_COMM_WORLD, replay_file, replay_reps),
+          errors;
+      MPI_Allreduce(&my_errors, &errors, 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
       if (mpi.Root())
       {
-         cout << "Laghos does not support PA in 1D. Switching to FA." << endl;
+         cout << "Replay mismatches on all ranks: " << errors << endl;
       }
+      return errors ? 1 : 0;
    }
 
-   // Refine the mesh in serial to increase the resolution.
-   for (int lev = 0; lev < rs_levels; lev++) { mesh->UniformRefinement(); }
-   const int mesh_NE = mesh->GetNE();
-   if (mpi.Root())
-   {
-      cout << "Number of zones in the serial mesh: " << mesh_NE << endl;
-   }
-
-   // Parallel partitioning of the mesh.
-   ParMesh *pmesh = nullptr;
-   const int num_tasks = mpi.WorldSize(); int unit = 1;
-   int *nxyz = new int[dim];
-   switch (partition_type)
+   // Predicted time per step, total time and memory per rank, from the
+   // serial mesh, refinements and orders of the options.
+   PerfModel perf_model;
+   PerfCounts perf_pred = PerfCounts();
+   const bool perf = perf_predict[0] != '\0';
+   if (perf)
    {
-      case 0:
-         for (int d = 0; d < dim; d++) { nxyz[d] = unit; }
-         break;
-      case 11:
-      case 111:
-         unit = static_cast<int>(floor(pow(num_tasks, 1.0 / dim) + 1e-2));
-         for (int d = 0; d < dim; d++) { nxyz[d] = unit; }
-         break;
-      case 21: // 2D
-         unit = static_cast<int>(floor(pow(num_tasks / 2, 1.0 / 2) + 1e-2));
-         nxyz[0] = 2 * unit; nxyz[1] = unit;
-         break;
-      case 31: // 2D
-         unit = static_cast<int>(floor(pow(num_tasks / 3, 1.0 / 2) + 1e-2));
-         nxyz[0] = 3 * unit; nxyz[1] = unit;
-         break;
-      case 32: // 2D
-         unit = static_cast<int>(floor(pow(2 * num_tasks / 3, 1.0 / 2) + 1e-2));
-         nxyz[0] = 3 * unit / 2; nxyz[1] = unit;
-         break;
-      case 49: // 2D
-         unit = static_cast<int>(floor(pow(9 * num_tasks / 4, 1.0 / 2) + 1e-2));
-         nxyz[0] = 4 * unit / 9; nxyz[1] = unit;
-         break;
-      case 51: // 2D
-         unit = static_cast<int>(floor(pow(num_tasks / 5, 1.0 / 2) + 1e-2));
-         nxyz[0] = 5 * unit; nxyz[1] = unit;
-         break;
-      case 211: // 3D.
-         unit = static_cast<int>(floor(pow(num_tasks / 2, 1.0 / 3) + 1e-2));
-         nxyz[0] = 2 * unit; nxyz[1] = unit; nxyz[2] = unit;
-         break;
-      case 221: // 3D.
-         unit = static_cast<int>(floor(pow(num_tasks / 4, 1.0 / 3) + 1e-2));
-         nxyz[0] = 2 * unit; nxyz[1] = 2 * unit; nxyz[2] = unit;
-         break;
-      case 311: // 3D.
-         unit = static_cast<int>(floor(pow(num_tasks / 3, 1.0 / 3) + 1e-2));
-         nxyz[0] = 3 * unit; nxyz[1] = unit; nxyz[2] = unit;
-         break;
-      case 321: // 3D.
-         unit = static_cast<int>(floor(pow(num_tasks / 6, 1.0 / 3) + 1e-2));
-         nxyz[0] = 3 * unit; nxyz[1] = 2 * unit; nxyz[2] = unit;
-         break;
-      case 322: // 3D.
-         unit = static_cast<int>(floor(pow(2 * num_tasks / 3, 1.0 / 3) + 1e-2));
-         nxyz[0] = 3 * unit / 2; nxyz[1] = unit; nxyz[2] = unit;
-         break;
-      case 432: // 3D.
-         unit = static_cast<int>(floor(pow(num_tasks / 3, 1.0 / 3) + 1e-2));
-         nxyz[0] = 2 * unit; nxyz[1] = 3 * unit / 2; nxyz[2] = unit;
-         break;
-      case 511: // 3D.
-         unit = static_cast<int>(floor(pow(num_tasks / 5, 1.0 / 3) + 1e-2));
-         nxyz[0] = 5 * unit; nxyz[1] = unit; nxyz[2] = unit;
-         break;
-      case 521: // 3D.
-         unit = static_cast<int>(floor(pow(num_tasks / 10, 1.0 / 3) + 1e-2));
-         nxyz[0] = 5 * unit; nxyz[1] = 2 * unit; nxyz[2] = unit;
-         break;
-      case 522: // 3D.
-         unit = static_cast<int>(floor(pow(num_tasks / 20, 1.0 / 3) + 1e-2));
-         nxyz[0] = 5 * unit; nxyz[1] = 2 * unit; nxyz[2] = 2 * unit;
-         break;
-      case 911: // 3D.
-         unit = static_cast<int>(floor(pow(num_tasks / 9, 1.0 / 3) + 1e-2));
-         nxyz[0] = 9 * unit; nxyz[1] = unit; nxyz[2] = unit;
-         break;
-      case 921: // 3D.
-         unit = static_cast<int>(floor(pow(num_tasks / 18, 1.0 / 3) + 1e-2));
-         nxyz[0] = 9 * unit; nxyz[1] = 2 * unit; nxyz[2] = unit;
-         break;
-      case 922: // 3D.
-         unit = static_cast<int>(floor(pow(num_tasks / 36, 1.0 / 3) + 1e-2));
-         nxyz[0] = 9 * unit; nxyz[1] = 2 * unit; nxyz[2] = 2 * unit;
-         break;
-      default:
-         if (myid == 0)
-         {
-            cout << "Unknown partition type: " << partition_type << '\n';
-         }
-         delete mesh;
-         MPI_Finalize();
-         return 3;
-   }
-   int product = 1;
-   for (int d = 0; d < dim; d++) { product *= nxyz[d]; }
-   const bool cartesian_partitioning = (cxyz.Size()>0)?true:false;
-   if (product == num_tasks || cartesian_partitioning)
-   {
-      if (cartesian_partitioning)
-      {
-         int cproduct = 1;
-         for (int d = 0; d < dim; d++) { cproduct *= cxyz[d]; }
-         MFEM_VERIFY(!cartesian_partitioning || cxyz.Size() == dim,
-                     "Expected " << mesh->SpaceDimension() << " integers with the "
-                     "option --cartesian-partitioning.");
-         MFEM_VERIFY(!cartesian_partitioning || num_tasks == cproduct,
-                     "Expected cartesian partitioning product to match number of ranks.");
-      }
-      int *partitioning = cartesian_partitioning ?
-                          mesh->CartesianPartitioning(cxyz):
-                          mesh->CartesianPartitioning(nxyz);
-      pmesh = new ParMesh(MPI_COMM_WORLD, *mesh, partitioning);
-      delete [] partitioning;
-   }
-   else
-   {
-      if (myid == 0)
+      MFEM_VERIFY(opt.par_mesh_in[0] == '\0',
+                  "The performance model needs the serial mesh.");
+      perf_model.Load(perf_predict);
+      int pdim;
+      double serial_zones;
+      SerialMeshSize(opt, pdim, serial_zones);
+      perf_pred = PerfModel::Sizes(pdim, serial_zones,
+                                   opt.rs_levels + opt.rp_levels,
+                                   opt.order_v, opt.order_e, opt.order_q,
+                                   perf_ranks > 0 ? perf_ranks :
+                                   mpi.WorldSize());
+      perf_pred.problem = opt.problem;
+      perf_model.Predict(perf_pred, opt.t_final, opt.max_tsteps);
+      if (mpi.Root())
       {
-         cout << "Non-Cartesian partitioning through METIS will be used.\n";
-#ifndef MFEM_USE_METIS
-         cout << "MFEM was built without METIS. "
-              << "Adjust the number of tasks to use a Cartesian split." << endl;
-#endif
+         perf_model.Compare(cout, perf_pred);
+         PerfModel::Print(cout, perf_pred);
       }
-#ifndef MFEM_USE_METIS
-      return 1;
-#endif
-      pmesh = new ParMesh(MPI_COMM_WORLD, *mesh);
+      if (perf_only) { return 0; }
    }
-   delete [] nxyz;
-   delete mesh;
 
-   // Refine the mesh further in parallel to increase the resolution.
-   for (int lev = 0; lev < rp_levels; lev++) { pmesh->UniformRefinement(); }
+   // Fixed memory of a rank, for the performance model.
+   const double mem0 = (double) GetMaxRssMB();
 
-   int NE = pmesh->GetNE(), ne_min, ne_max;
-   MPI_Reduce(&NE, &ne_min, 1, MPI_INT, MPI_MIN, 0, pmesh->GetComm());
-   MPI_Reduce(&NE, &ne_max, 1, MPI_INT, MPI_MAX, 0, pmesh->GetComm());
-   if (myid == 0)
-   { cout << "Zones min/max: " << ne_min << " " << ne_max << endl; }
-
-   // Define the parallel finite element spaces. We use:
-   // - H1 (Gauss-Lobatto, continuous) for position and velocity.
-   // - L2 (Bernstein, discontinuous) for specific internal energy.
-   L2_FECollection L2FEC(order_e, dim, BasisType::Positive);
-   H1_FECollection H1FEC(order_v, dim);
-   ParFiniteElementSpace L2FESpace(pmesh, &L2FEC);
-   ParFiniteElementSpace H1FESpace(pmesh, &H1FEC, pmesh->Dimension());
-
-   // Boundary conditions: all tests use v.n = 0 on the boundary, and we assume
-   // that the boundaries are straight.
-   Array<int> ess_tdofs, ess_vdofs;
+   // Build the mesh, the spaces, the initial state and the operators.
+   LaghosSimulation sim(MPI_COMM_WORLD, opt);
+   const int setup_error = sim.Setup();
+   if (setup_error) { return setup_error; }
+   const LaghosOptions &sopt = sim.GetOptions();
+   if (sopt.par_mesh_out[0] != '\0')
    {
-      Array<int> ess_bdr(pmesh->bdr_attributes.Max()), dofs_marker, dofs_list;
-      for (int d = 0; d < pmesh->Dimension(); d++)
+      if (mpi.Root())
       {
-         // Attributes 1/2/3 correspond to fixed-x/y/z boundaries,
-         // i.e., we must enforce v_x/y/z = 0 for the velocity components.
-         ess_bdr = 0; ess_bdr[d] = 1;
-         H1FESpace.GetEssentialTrueDofs(ess_bdr, dofs_list, d);
-         ess_tdofs.Append(dofs_list);
-         H1FESpace.GetEssentialVDofs(ess_bdr, dofs_marker, d);
-         FiniteElementSpace::MarkerToList(dofs_marker, dofs_list);
-         ess_vdofs.Append(dofs_list);
+         cout << "Partitioned mesh written to " << sopt.par_mesh_out
+              << ".*" << endl;
       }
+      return 0;
    }
-
-   // Define the explicit ODE solver used for time integration.
-   ODESolver *ode_solver = NULL;
-   switch (ode_solver_type)
-   {
-      case 1: ode_solver = new ForwardEulerSolver; break;
-      case 2: ode_solver = new RK2Solver(0.5); break;
-      case 3: ode_solver = new RK3SSPSolver; break;
-      case 4: ode_solver = new RK4Solver; break;
-      case 6: ode_solver = new RK6Solver; break;
-      case 7: ode_solver = new RK2AvgSolver; break;
-      default:
-         if (myid == 0)
-         {
-            cout << "Unknown ODE solver type: " << ode_solver_type << '\n';
-         }
-         delete pmesh;
-         MPI_Finalize();
-         return 3;
-   }
-
-   const HYPRE_Int glob_size_l2 = L2FESpace.GlobalTrueVSize();
-   const HYPRE_Int glob_size_h1 = H1FESpace.GlobalTrueVSize();
-   if (mpi.Root())
-   {
-      cout << "Number of kinematic (position, velocity) dofs: "
-           << glob_size_h1 << endl;
-      cout << "Number of specific internal energy dofs: "
-           << glob_size_l2 << endl;
-   }
-
-   // The monolithic BlockVector stores unknown fields as:
-   // - 0 -> position
-   // - 1 -> velocity
-   // - 2 -> specific internal energy
-   const int Vsize_l2 = L2FESpace.GetVSize();
-   const int Vsize_h1 = H1FESpace.GetVSize();
-   Array<int> offset(4);
-   offset[0] = 0;
-   offset[1] = offset[0] + Vsize_h1;
-   offset[2] = offset[1] + Vsize_h1;
-   offset[3] = offset[2] + Vsize_l2;
-   BlockVector S(offset, Device::GetMemoryType());
-
-   // Define GridFunction objects for the position, velocity and specific
-   // internal energy. There is no function for the density, as we can always
-   // compute the density values given the current mesh position, using the
-   // property of pointwise mass conservation.
-   ParGridFunction x_gf, v_gf, e_gf;
-   x_gf.MakeRef(&H1FESpace, S, offset[0]);
-   v_gf.MakeRef(&H1FESpace, S, offset[1]);
-   e_gf.MakeRef(&L2FESpace, S, offset[2]);
-
-   // Initialize x_gf using the starting mesh coordinates.
-   pmesh->SetNodalGridFunction(&x_gf);
-   // Sync the data location of x_gf with its base, S
-   x_gf.SyncAliasMemory(S);
-
-   // Initialize the velocity.
-   VectorFunctionCoefficient v_coeff(pmesh->Dimension(), v0);
-   v_gf.ProjectCoefficient(v_coeff);
-   for (int i = 0; i < ess_vdofs.Size(); i++)
-   {
-      v_gf(ess_vdofs[i]) = 0.0;
-   }
-   // Sync the data location of v_gf with its base, S
-   v_gf.SyncAliasMemory(S);
-
-   // Initialize density and specific internal energy values. We interpolate in
-   // a non-positive basis to get the correct values at the dofs. Then we do an
-   // L2 projection to the positive basis in which we actually compute. The goal
-   // is to get a high-order representation of the initial condition. Note that
-   // this density is a temporary function and it will not be updated during the
-   // time evolution.
-   ParGridFunction rho0_gf(&L2FESpace);
-   FunctionCoefficient rho0_coeff(rho0);
-   L2_FECollection l2_fec(order_e, pmesh->Dimension());
-   ParFiniteElementSpace l2_fes(pmesh, &l2_fec);
-   ParGridFunction l2_rho0_gf(&l2_fes), l2_e(&l2_fes);
-   l2_rho0_gf.ProjectCoefficient(rho0_coeff);
-   rho0_gf.ProjectGridFunction(l2_rho0_gf);
-   if (problem == 1)
-   {
-      // For the Sedov test, we use a delta function at the origin.
-      DeltaCoefficient e_coeff(blast_position[0], blast_position[1],
-                               blast_position[2], blast_energy);
-      l2_e.ProjectCoefficient(e_coeff);
-   }
-   else
-   {
-      FunctionCoefficient e_coeff(e0);
-      l2_e.ProjectCoefficient(e_coeff);
-   }
-   e_gf.ProjectGridFunction(l2_e);
-   // Sync the data location of e_gf with its base, S
-   e_gf.SyncAliasMemory(S);
-
-   // Piecewise constant ideal gas coefficient over the Lagrangian mesh. The
-   // gamma values are projected on function that's constant on the moving mesh.
-   L2_FECollection mat_fec(0, pmesh->Dimension());
-   ParFiniteElementSpace mat_fes(pmesh, &mat_fec);
-   ParGridFunction mat_gf(&mat_fes);
-   FunctionCoefficient mat_coeff(gamma_func);
-   mat_gf.ProjectCoefficient(mat_coeff);
-
-   // Additional details, depending on the problem.
-   int source = 0; bool visc = true, vorticity = false;
-   switch (problem)
-   {
-      case 0: if (pmesh->Dimension() == 2) { source = 1; } visc = false; break;
-      case 1: visc = true; break;
-      case 2: visc = true; break;
-      case 3: visc = true; S.HostRead(); break;
-      case 4: visc = false; break;
-      case 5: visc = true; break;
-      case 6: visc = true; break;
-      case 7: source = 2; visc = true; vorticity = true;  break;
-      default: MFEM_ABORT("Wrong problem specification!");
-   }
-   if (impose_visc) { visc = true; }
-
-   hydrodynamics::LagrangianHydroOperator hydro(S.Size(),
-                                                H1FESpace, L2FESpace, ess_tdofs,
-                                                rho0_coeff, rho0_gf,
-                                                mat_gf, source, cfl,
-                                                visc, vorticity, p_assembly,
-                                                cg_tol, cg_max_iter, ftz_tol,
-                                                order_q);
+   const int problem = sopt.problem, dim = sopt.dim;
+   ParMesh *pmesh = &sim.GetParMesh();
+   // The operator is replaced when the mesh is rebalanced.
+   LagrangianHydroOperator *hydro = &sim.GetHydroOperator();
+   ParGridFunction &v_gf = sim.GetVelocity(), &e_gf = sim.GetEnergy();
 
    socketstream vis_rho, vis_v, vis_e;
    char vishost[] = "localhost";
    int  visport   = 19916;
 
+   // The low-bandwidth mode computes its own zone densities.
+   const bool vis_lb = visualization && vis_low_bandwidth;
+   const bool vis_full = visualization && !vis_low_bandwidth;
    ParGridFunction rho_gf;
-   if (visualization || visit) { hydro.ComputeDensity(rho_gf); }
-   const double energy_init = hydro.InternalEnergy(e_gf) +
-                              hydro.KineticEnergy(v_gf);
+   if (vis_full || visit) { hydro->ComputeDensity(rho_gf); }
+   const double energy_init = hydro->InternalEnergy(e_gf) +
+                              hydro->KineticEnergy(v_gf);
 
-   if (visualization)
+   LowBandwidthVis *lb_vis = nullptr;
+   if (vis_lb)
+   {
+      MFEM_VERIFY(mpi.Funneled(), "The low-bandwidth GLVis streaming needs "
+                  "MPI_THREAD_FUNNELED, which this MPI does not provide.");
+      lb_vis = new LowBandwidthVis(*pmesh, vis_aggregators, vishost, visport,
+                                   problem != 0 && problem != 4);
+      lb_vis->Send(v_gf, e_gf, hydro->GetQuadratureData(),
+                   hydro->GetIntRule());
+   }
+   if (vis_full)
    {
       // Make sure all MPI ranks have sent their 'v' solution before initiating
       // another set of GLVis connections (one from each rank):
@@ -605,18 +323,17 @@ int main(int argc, char *argv[])
    }
 
    // Perform time-integration (looping over the time iterations, ti, with a
-   // time-step dt). The object oper is of type LagrangianHydroOperator that
-   // defines the Mult() method that used by the time integrators.
-   ode_solver->Init(hydro);
-   hydro.ResetTimeStepEstimate();
-   double t = 0.0, dt = hydro.GetTimeStepEstimate(S), t_old;
-   bool last_step = false;
-   int steps = 0;
-   BlockVector S_old(S);
+   // time-step dt). Each call of Step() advances the state by one accepted
+   // time step.
    long mem=0, mmax=0, msum=0;
    int checks = 0;
-   //   const double internal_energy = hydro.InternalEnergy(e_gf);
-   //   const double kinetic_energy = hydro.KineticEnergy(v_gf);
+   KernelCapture *capture = nullptr;
+   if (capture_step > 0)
+   {
+      capture = new KernelCapture(MPI_COMM_WORLD, capture_file);
+   }
+   //   const double internal_energy = hydro->InternalEnergy(e_gf);
+   //   const double kinetic_energy = hydro->KineticEnergy(v_gf);
    //   if (mpi.Root())
    //   {
    //      cout << std::fixed;
@@ -636,65 +353,50 @@ int main(int argc, char *argv[])
    //      }
    //      cout << endl;
    //   }
-   for (int ti = 1; !last_step; ti++)
+   // Simulated time after each step, for the step rate of the performance
+   // model.
+   std::vector<double> step_times;
+   TLBMissCounter tlb_counter;
+   if (tlb_misses) { tlb_counter.Start(); }
+   const double loop_start = MPI_Wtime();
+   while (!sim.Done())
    {
-      if (t + dt >= t_final)
+      const bool capturing = capture && sim.GetCycle() + 1 == capture_step;
+      if (capturing) { hydro->SetKernelCapture(capture); }
+      sim.Step();
+      const int ti = sim.GetCycle();
+      if (sopt.balance_steps > 0 && ti == sopt.balance_steps)
       {
-         dt = t_final - t;
-         last_step = true;
+         hydro = &sim.GetHydroOperator();
+         if (lb_vis) { lb_vis->UpdateLayout(); }
       }
-      if (steps == max_tsteps) { last_step = true; }
-      S_old = S;
-      t_old = t;
-      hydro.ResetTimeStepEstimate();
-
-      // S is the vector of dofs, t is the current time, and dt is the time step
-      // to advance.
-      ode_solver->Step(S, t, dt);
-      steps++;
-
-      // Adaptive time step control.
-      const double dt_est = hydro.GetTimeStepEstimate(S);
-      if (dt_est < dt)
+      if (capturing)
       {
-         // Repeat (solve again) with a decreased time step - decrease of the
-         // time estimate suggests appearance of oscillations.
-         dt *= 0.85;
-         if (dt < std::numeric_limits<double>::epsilon())
-         { MFEM_ABORT("The time step crashed!"); }
-         t = t_old;
-         S = S_old;
-         hydro.ResetQuadratureData();
-         if (mpi.Root()) { cout << "Repeating step " << ti << endl; }
-         if (steps < max_tsteps) { last_step = false; }
-         ti--; continue;
+         hydro->SetKernelCapture(nullptr);
+         if (mpi.Root())
+         {
+            cout << "Captured " << capture->GetRecords() << " kernel calls of "
+                 << "step " << ti << " in " << capture_file << ".*" << endl;
+         }
       }
-      else if (dt_est > 1.25 * dt) { dt *= 1.02; }
-
-      // Ensure the sub-vectors x_gf, v_gf, and e_gf know the location of the
-      // data in S. This operation simply updates the Memory validity flags of
-      // the sub-vectors to match those of S.
-      x_gf.SyncAliasMemory(S);
-      v_gf.SyncAliasMemory(S);
-      e_gf.SyncAliasMemory(S);
+      const double t = sim.GetTime(), dt = sim.GetTimeStep();
+      if (perf_calibrate[0] != '\0') { step_times.push_back(t); }
+      CommProfile::Scope output_scope(CommProfile::OUTPUT);
 
-      // Make sure that the mesh corresponds to the new solution state. This is
-      // needed, because some time integrators use different S-type vectors
-      // and the oper object might have redirected the mesh positions to those.
-      pmesh->NewNodes(x_gf, false);
+      const bool output_step = sim.Done() || (ti % vis_steps) == 0;
+      double norm = 0.0;
+      if (output_step || check) { norm = sim.EnergyNorm2(); }
 
-      if (last_step || (ti % vis_steps) == 0)
+      if (output_step)
       {
-         double lnorm = e_gf * e_gf, norm;
-         MPI_Allreduce(&lnorm, &norm, 1, MPI_DOUBLE, MPI_SUM, pmesh->GetComm());
          if (mem_usage)
          {
             mem = GetMaxRssMB();
             MPI_Reduce(&mem, &mmax, 1, MPI_LONG, MPI_MAX, 0, pmesh->GetComm());
             MPI_Reduce(&mem, &msum, 1, MPI_LONG, MPI_SUM, 0, pmesh->GetComm());
          }
-         // const double internal_energy = hydro.InternalEnergy(e_gf);
-         // const double kinetic_energy = hydro.KineticEnergy(v_gf);
+         // const double internal_energy = hydro->InternalEnergy(e_gf);
+         // const double kinetic_energy = hydro->KineticEnergy(v_gf);
          if (mpi.Root())
          {
             const double sqrt_norm = sqrt(norm);
@@ -719,13 +421,18 @@ int main(int argc, char *argv[])
             cout << endl;
          }
 
-         // Make sure all ranks have sent their 'v' solution before initiating
-         // another set of GLVis connections (one from each rank):
-         MPI_Barrier(pmesh->GetComm());
-
-         if (visualization || visit || gfprint) { hydro.ComputeDensity(rho_gf); }
-         if (visualization)
+         if (vis_lb)
+         {
+            lb_vis->Send(v_gf, e_gf, hydro->GetQuadratureData(),
+                         hydro->GetIntRule());
+         }
+         if (vis_full || visit || gfprint) { hydro->ComputeDensity(rho_gf); }
+         if (vis_full)
          {
+            // Make sure all ranks have sent their 'v' solution before
+            // initiating another set of GLVis connections (one from each rank):
+            MPI_Barrier(pmesh->GetComm());
+
             int Wx = 0, Wy = 0; // window position
             int Ww = 350, Wh = 350; // window size
             int offx = Ww+10; // window offsets
@@ -784,32 +491,142 @@ int main(int argc, char *argv[])
       // Problems checks
       if (check)
       {
-         double lnorm = e_gf * e_gf, norm;
-         MPI_Allreduce(&lnorm, &norm, 1, MPI_DOUBLE, MPI_SUM, pmesh->GetComm());
          const double e_norm = sqrt(norm);
-         MFEM_VERIFY(rs_levels==0 && rp_levels==0, "check: rs, rp");
-         MFEM_VERIFY(order_v==2, "check: order_v");
-         MFEM_VERIFY(order_e==1, "check: order_e");
-         MFEM_VERIFY(ode_solver_type==4, "check: ode_solver_type");
-         MFEM_VERIFY(t_final == 0.6, "check: t_final");
-         MFEM_VERIFY(cfl==0.5, "check: cfl");
-         MFEM_VERIFY(strncmp(mesh_file, "default", 7) == 0, "check: mesh_file");
+         MFEM_VERIFY(sopt.rs_levels==0 && sopt.rp_levels==0, "check: rs, rp");
+         MFEM_VERIFY(sopt.order_v==2, "check: order_v");
+         MFEM_VERIFY(sopt.order_e==1, "check: order_e");
+         MFEM_VERIFY(sopt.ode_solver_type==4, "check: ode_solver_type");
+         MFEM_VERIFY(sopt.t_final == 0.6, "check: t_final");
+         MFEM_VERIFY(sopt.cfl==0.5, "check: cfl");
+         MFEM_VERIFY(strncmp(sopt.mesh_file, "default", 7) == 0,
+                     "check: mesh_file");
          MFEM_VERIFY(dim==2 || dim==3, "check: dimension");
-         Checks(dim, ti, e_norm, checks);
+         // The reference norms come from runs with the fixed tolerance. With
+         // the adaptive solves, the norms may move away from them by the
+         // accumulated estimate of the extra solve error, up to a safety
+         // factor of 10.
+         const double cg_err = sopt.cg_adaptive ?
+                               10.0 * hydro->GetCGExtraError() / e_norm : 0.0;
+         Checks(problem, dim, ti, e_norm, checks, 1e-13 + cg_err);
       }
    }
    MFEM_VERIFY(!check || checks == 2, "Check error!");
+   if (tlb_misses) { tlb_counter.Stop(); }
+   const double loop_time = MPI_Wtime() - loop_start;
 
-   switch (ode_solver_type)
+   const double t = sim.GetTime();
+   const long long time_steps = sim.GetSteps();
+   long long steps = time_steps;
+   switch (sopt.ode_solver_type)
    {
       case 2: steps *= 2; break;
       case 3: steps *= 3; break;
       case 4: steps *= 4; break;
       case 6: steps *= 6; break;
-      case 7: steps *= 2;
+      case 7: steps *= 2; break;
+      // The number of stages varies for the multistep methods.
+      case 12:
+      case 13: steps = hydro->GetForceEvaluations(); break;
+   }
+
+   hydro->PrintTimingData(mpi.Root(), steps, fom);
+   CommProfile::Print(pmesh->GetComm(), time_steps);
+
+   if (perf_calibrate[0] != '\0' || perf)
+   {
+      PerfCounts run = PerfCounts();
+      hydro->GetPerfCounts(steps, run);
+      run.problem = problem;
+      run.order_v = sopt.order_v;
+      run.order_e = sopt.order_e;
+      run.steps = time_steps;
+      run.time = t;
+      const int half = (int) step_times.size() / 2;
+      if (half > 0)
+      {
+         run.rate_steps = step_times.size() - half;
+         run.rate_time = step_times.back() - step_times[half - 1];
+      }
+      double my_lm[3] = { loop_time, (double) GetMaxRssMB(), mem0 }, lm[3];
+      MPI_Allreduce(my_lm, lm, 3, MPI_DOUBLE, MPI_MAX, pmesh->GetComm());
+      run.t_loop = lm[0];
+      run.mem = lm[1];
+      run.mem0 = lm[2];
+      if (perf_calibrate[0] != '\0' && mpi.Root())
+      {
+         PerfModel(run).Save(perf_calibrate);
+         cout << endl << "Performance model calibration written to "
+              << perf_calibrate << endl;
+      }
+      // The prediction is compared with the run when it was made for this
+      // rank count, which may differ from the one of the calibration.
+      if (perf && perf_pred.ranks == run.ranks && mpi.Root())
+      {
+         PerfModel::Print(cout, perf_pred, &run);
+      }
+   }
+
+   if (tlb_misses)
+   {
+      int available = tlb_counter.Available(), all_available;
+      long long misses = tlb_counter.Count(), total_misses;
+      long hp_bytes[2], total_hp_bytes[2];
+      GetHugePageBytes(hp_bytes[0], hp_bytes[1]);
+      MPI_Reduce(&available, &all_available, 1, MPI_INT, MPI_MIN, 0,
+                 pmesh->GetComm());
+      MPI_Reduce(&misses, &total_misses, 1, MPI_LONG_LONG, MPI_SUM, 0,
+                 pmesh->GetComm());
+      MPI_Reduce(hp_bytes, total_hp_bytes, 2, MPI_LONG, MPI_SUM, 0,
+                 pmesh->GetComm());
+      if (mpi.Root())
+      {
+         cout << endl;
+         if (all_available)
+         {
+            cout << "dTLB load misses of the time loop: " << total_misses
+                 << ", per step: "
+                 << total_misses / std::max(sim.GetSteps(), 1) << endl;
+         }
+         else { cout << "The dTLB miss counter is not available." << endl; }
+         cout << "Huge page arrays (MB), hugetlbfs: "
+              << total_hp_bytes[0] / (1 << 20) << ", transparent: "
+              << total_hp_bytes[1] / (1 << 20) << endl;
+      }
    }
 
-   hydro.PrintTimingData(mpi.Root(), steps, fom);
+   RK2AvgSolver *rk2avg =
+      dynamic_cast<RK2AvgSolver *>(&sim.GetODESolver());
+   if (rk2avg)
+   {
+      double my_traffic[2], traffic[2];
+      rk2avg->VectorUpdateTraffic(my_traffic[0], my_traffic[1]);
+      MPI_Reduce(my_traffic, traffic, 2, MPI_DOUBLE, MPI_SUM, 0,
+                 pmesh->GetComm());
+      if (mpi.Root())
+      {
+         cout << endl;
+         cout << "Vector updates traffic per step (MB), separate passes: "
+              << 1e-6 * traffic[0] << ", fused: " << 1e-6 * traffic[1] << endl;
+      }
+   }
+
+   // Work per unit of simulated time, to compare the time integrators.
+   if (mpi.Root())
+   {
+      const long long force_evals = hydro->GetForceEvaluations();
+      cout << endl;
+      cout << "Force evaluations: " << force_evals
+           << ", per unit of simulated time: " << force_evals / t << endl;
+      AdamsBashforthSolver *ab =
+         dynamic_cast<AdamsBashforthSolver *>(&sim.GetODESolver());
+      if (ab) { cout << "RK4 steps: " << ab->GetRKSteps() << endl; }
+      if (sim.GetRemap())
+      {
+         cout << "ALE remaps: " << sim.GetRemap()->GetRemaps()
+              << ", advection substeps: " << sim.GetRemap()->GetSubsteps()
+              << endl;
+      }
+   }
 
    if (mem_usage)
    {
@@ -818,13 +635,18 @@ int main(int argc, char *argv[])
       MPI_Reduce(&mem, &msum, 1, MPI_LONG, MPI_SUM, 0, pmesh->GetComm());
    }
 
-   const double energy_final = hydro.InternalEnergy(e_gf) +
-                               hydro.KineticEnergy(v_gf);
+   const double energy_final = hydro->InternalEnergy(e_gf) +
+                               hydro->KineticEnergy(v_gf);
    if (mpi.Root())
    {
       cout << endl;
       cout << "Energy  diff: " << std::scientific << std::setprecision(2)
            << fabs(energy_init - energy_final) << endl;
+      if (sopt.cg_adaptive)
+      {
+         cout << "Adaptive CG extra error estimate: "
+              << hydro->GetCGExtraError() << endl;
+      }
       if (mem_usage)
       {
          cout << "Maximum memory resident set size: "
@@ -836,6 +658,7 @@ int main(int argc, char *argv[])
    // For problems 0 and 4 the exact velocity is constant in time.
    if (problem == 0 || problem == 4)
    {
+      VectorCoefficient &v_coeff = sim.GetInitialVelocity();
       const double error_max = v_gf.ComputeMaxError(v_coeff),
                    error_l1  = v_gf.ComputeL1Error(v_coeff),
                    error_l2  = v_gf.ComputeL2Error(v_coeff);
@@ -847,197 +670,25 @@ int main(int argc, char *argv[])
       }
    }
 
-   if (visualization)
+   if (vis_full)
    {
       vis_v.close();
       vis_e.close();
    }
-
-   // Free the used memory.
-   delete ode_solver;
-   delete pmesh;
-
-   return 0;
-}
-
-double rho0(const Vector &x)
-{
-   switch (problem)
+   if (lb_vis)
    {
-      case 0: return 1.0;
-      case 1: return 1.0;
-      case 2: return (x(0) < 0.5) ? 1.0 : 0.1;
-      case 3: return (dim == 2) ? (x(0) > 1.0 && x(1) > 1.5) ? 0.125 : 1.0
-                        : x(0) > 1.0 && ((x(1) < 1.5 && x(2) < 1.5) ||
-                                         (x(1) > 1.5 && x(2) > 1.5)) ? 0.125 : 1.0;
-      case 4: return 1.0;
-      case 5:
-      {
-         if (x(0) >= 0.5 && x(1) >= 0.5) { return 0.5313; }
-         if (x(0) <  0.5 && x(1) <  0.5) { return 0.8; }
-         return 1.0;
-      }
-      case 6:
+      if (mpi.Root())
       {
-         if (x(0) <  0.5 && x(1) >= 0.5) { return 2.0; }
-         if (x(0) >= 0.5 && x(1) <  0.5) { return 3.0; }
-         return 1.0;
+         cout << "GLVis frames: " << lb_vis->GetFrames() << " sent, "
+              << lb_vis->GetDropped() << " dropped" << endl;
       }
-      case 7: return x(1) >= 0.0 ? 2.0 : 1.0;
-      default: MFEM_ABORT("Bad number given for problem id!"); return 0.0;
-   }
-}
-
-double gamma_func(const Vector &x)
-{
-   switch (problem)
-   {
-      case 0: return 5.0 / 3.0;
-      case 1: return 1.4;
-      case 2: return 1.4;
-      case 3: return (x(0) > 1.0 && x(1) <= 1.5) ? 1.4 : 1.5;
-      case 4: return 5.0 / 3.0;
-      case 5: return 1.4;
-      case 6: return 1.4;
-      case 7: return 5.0 / 3.0;
-      default: MFEM_ABORT("Bad number given for problem id!"); return 0.0;
+      delete lb_vis;
    }
-}
 
-static double rad(double x, double y) { return sqrt(x*x + y*y); }
+   delete capture;
 
-void v0(const Vector &x, Vector &v)
-{
-   const double atn = pow((x(0)*(1.0-x(0))*4*x(1)*(1.0-x(1))*4.0),0.4);
-   switch (problem)
-   {
-      case 0:
-         v(0) =  sin(M_PI*x(0)) * cos(M_PI*x(1));
-         v(1) = -cos(M_PI*x(0)) * sin(M_PI*x(1));
-         if (x.Size() == 3)
-         {
-            v(0) *= cos(M_PI*x(2));
-            v(1) *= cos(M_PI*x(2));
-            v(2) = 0.0;
-         }
-         break;
-      case 1: v = 0.0; break;
-      case 2: v = 0.0; break;
-      case 3: v = 0.0; break;
-      case 4:
-      {
-         v = 0.0;
-         const double r = rad(x(0), x(1));
-         if (r < 0.2)
-         {
-            v(0) =  5.0 * x(1);
-            v(1) = -5.0 * x(0);
-         }
-         else if (r < 0.4)
-         {
-            v(0) =  2.0 * x(1) / r - 5.0 * x(1);
-            v(1) = -2.0 * x(0) / r + 5.0 * x(0);
-         }
-         else { }
-         break;
-      }
-      case 5:
-      {
-         v = 0.0;
-         if (x(0) >= 0.5 && x(1) >= 0.5) { v(0)=0.0*atn, v(1)=0.0*atn; return;}
-         if (x(0) <  0.5 && x(1) >= 0.5) { v(0)=0.7276*atn, v(1)=0.0*atn; return;}
-         if (x(0) <  0.5 && x(1) <  0.5) { v(0)=0.0*atn, v(1)=0.0*atn; return;}
-         if (x(0) >= 0.5 && x(1) <  0.5) { v(0)=0.0*atn, v(1)=0.7276*atn; return; }
-         MFEM_ABORT("Error in problem 5!");
-         return;
-      }
-      case 6:
-      {
-         v = 0.0;
-         if (x(0) >= 0.5 && x(1) >= 0.5) { v(0)=+0.75*atn, v(1)=-0.5*atn; return;}
-         if (x(0) <  0.5 && x(1) >= 0.5) { v(0)=+0.75*atn, v(1)=+0.5*atn; return;}
-         if (x(0) <  0.5 && x(1) <  0.5) { v(0)=-0.75*atn, v(1)=+0.5*atn; return;}
-         if (x(0) >= 0.5 && x(1) <  0.5) { v(0)=-0.75*atn, v(1)=-0.5*atn; return;}
-         MFEM_ABORT("Error in problem 6!");
-         return;
-      }
-      case 7:
-      {
-         v = 0.0;
-         v(1) = 0.02 * exp(-2*M_PI*x(1)*x(1)) * cos(2*M_PI*x(0));
-         break;
-      }
-      default: MFEM_ABORT("Bad number given for problem id!");
-   }
-}
 
-double e0(const Vector &x)
-{
-   switch (problem)
-   {
-      case 0:
-      {
-         const double denom = 2.0 / 3.0;  // (5/3 - 1) * density.
-         double val;
-         if (x.Size() == 2)
-         {
-            val = 1.0 + (cos(2*M_PI*x(0)) + cos(2*M_PI*x(1))) / 4.0;
-         }
-         else
-         {
-            val = 100.0 + ((cos(2*M_PI*x(2)) + 2) *
-                           (cos(2*M_PI*x(0)) + cos(2*M_PI*x(1))) - 2) / 16.0;
-         }
-         return val/denom;
-      }
-      case 1: return 0.0; // This case in initialized in main().
-      case 2: return (x(0) < 0.5) ? 1.0 / rho0(x) / (gamma_func(x) - 1.0)
-                        : 0.1 / rho0(x) / (gamma_func(x) - 1.0);
-      case 3: return (x(0) > 1.0) ? 0.1 / rho0(x) / (gamma_func(x) - 1.0)
-                        : 1.0 / rho0(x) / (gamma_func(x) - 1.0);
-      case 4:
-      {
-         const double r = rad(x(0), x(1)), rsq = x(0) * x(0) + x(1) * x(1);
-         const double gamma = 5.0 / 3.0;
-         if (r < 0.2)
-         {
-            return (5.0 + 25.0 / 2.0 * rsq) / (gamma - 1.0);
-         }
-         else if (r < 0.4)
-         {
-            const double t1 = 9.0 - 4.0 * log(0.2) + 25.0 / 2.0 * rsq;
-            const double t2 = 20.0 * r - 4.0 * log(r);
-            return (t1 - t2) / (gamma - 1.0);
-         }
-         else { return (3.0 + 4.0 * log(2.0)) / (gamma - 1.0); }
-      }
-      case 5:
-      {
-         const double irg = 1.0 / rho0(x) / (gamma_func(x) - 1.0);
-         if (x(0) >= 0.5 && x(1) >= 0.5) { return 0.4 * irg; }
-         if (x(0) <  0.5 && x(1) >= 0.5) { return 1.0 * irg; }
-         if (x(0) <  0.5 && x(1) <  0.5) { return 1.0 * irg; }
-         if (x(0) >= 0.5 && x(1) <  0.5) { return 1.0 * irg; }
-         MFEM_ABORT("Error in problem 5!");
-         return 0.0;
-      }
-      case 6:
-      {
-         const double irg = 1.0 / rho0(x) / (gamma_func(x) - 1.0);
-         if (x(0) >= 0.5 && x(1) >= 0.5) { return 1.0 * irg; }
-         if (x(0) <  0.5 && x(1) >= 0.5) { return 1.0 * irg; }
-         if (x(0) <  0.5 && x(1) <  0.5) { return 1.0 * irg; }
-         if (x(0) >= 0.5 && x(1) <  0.5) { return 1.0 * irg; }
-         MFEM_ABORT("Error in problem 5!");
-         return 0.0;
-      }
-      case 7:
-      {
-         const double rho = rho0(x), gamma = gamma_func(x);
-         return (6.0 - rho * x(1)) / (gamma - 1.0) / rho;
-      }
-      default: MFEM_ABORT("Bad number given for problem id!"); return 0.0;
-   }
+   return 0;
 }
 
 static void display_banner(std::ostream &os)
@@ -1063,6 +714,20 @@ static long GetMaxRssMB()
    return usage.ru_maxrss/unit; // mega bytes
 }
 
+static void SerialMeshSize(const LaghosOptions &opt, int &dim, double &zones)
+{
+   // The default meshes have 2 zones per direction.
+   if (strncmp(opt.mesh_file, "default", 7) == 0)
+   {
+      dim = opt.dim;
+      zones = 1 << dim;
+      return;
+   }
+   Mesh mesh(opt.mesh_file, true, true);
+   dim = mesh.Dimension();
+   zones = mesh.GetNE();
+}
+
 static bool rerr(const double a, const double v, const double eps)
 {
    MFEM_VERIFY(fabs(a) > eps && fabs(v) > eps, "One value is near zero!");
@@ -1071,10 +736,9 @@ static bool rerr(const double a, const double v, const double eps)
    return fmax(err_a, err_v) < eps;
 }
 
-static void Checks(const int dim, const int ti, const double nrm, int &chk)
+static void Checks(const int pb, const int dim, const int ti, const double nrm,
+                   int &chk, const double eps)
 {
-   const int pb = problem;
-   const double eps = 1.e-13;
    printf("%.15e\n",nrm);
    if (dim==2)
    {
@@ -0,0 +1,1442 @@
+// Copyright (c) 2017, Lawrence Livermore National Security, LLC. Produced at
+// the Lawrence Livermore National Laboratory. LLNL-CODE-734707. All Rights
+// reserved. See files LICENSE and NOTICE for details.
+//
+// This file is part of CEED, a collection of benchmarks, miniapps, software
+// libraries and APIs for efficient high-order finite element and spectral
+// element discretizations for exascale applications. For more information and
+// source code availability see http://github.com/ceed.
+//
+// The CEED research is supported by the Exascale Computing Project 17-SC-20-SC,
+// a collaborative effort of two U.S. Department of Energy organizations (Office
+// of Science and the National Nuclear Security Administration) responsible for
+// the planning and preparation of a capable exascale ecosystem, including
+// software, applications, hardware, advanced system engineering and early
+// testbed platforms, in support of the nation's exascale computing imperative.
+
+#include "laghos_api.hpp"
+#include "laghos_api.h"
+#include "laghos_partition.hpp"
+
+using std::cout;
+using std::endl;
+
+namespace mfem
+{
+
+namespace hydrodynamics
+{
+
+// Choice for the problem setup.
+static int problem, dim;
+
+static double e0(const Vector &);
+static double rho0(const Vector &);
+static double gamma_func(const Vector &);
+static void v0(const Vector &, Vector &);
+
+LaghosOptions::LaghosOptions()
+   : problem(1), dim(3), mesh_file("default"), par_mesh_in(""),
+     par_mesh_out(""), rs_levels(2), rp_levels(0),
+     order_v(2), order_e(1), order_q(-1), ode_solver_type(4),
+     t_final(0.6), cfl(0.5), cg_tol(1e-8), ftz_tol(0.0), cg_max_iter(300),
+     cg_adaptive(false), cg_safety(1.0), cg_tol_max(1e-4), max_tsteps(-1),
+     p_assembly(true), sell(false), impose_visc(false), huge_pages(false),
+     reproducible(false), structured(false), index64(false),
+     const_basis(false), compact_stress(false), node_geometry(false),
+     partition_type(0), ale_period(0), ale_relax(1.0), balance_steps(0),
+     restart_in(""), restart_out("laghos.restart"), restart_period(0),
+     node_partition(false), partition_report(false), blast_energy(0.25)
+{
+   blast_position[0] = blast_position[1] = blast_position[2] = 0.0;
+}
+
+void LaghosOptions::AddOptions(OptionsParser &args)
+{
+   args.AddOption(&dim, "-dim", "--dimension", "Dimension of the problem.");
+   args.AddOption(&mesh_file, "-m", "--mesh", "Mesh file to use.");
+   args.AddOption(&par_mesh_in, "-rpm", "--read-par-mesh",
+                  "Read the partitioned mesh <basename>.<rank> written by\n\t"
+                  "-wpm with the same number of ranks, instead of -m/-rs.");
+   args.AddOption(&par_mesh_out, "-wpm", "--write-par-mesh",
+                  "Write the serially refined and partitioned mesh to one\n\t"
+                  "binary file per rank, <basename>.<rank>, and exit.");
+   args.AddOption(&rs_levels, "-rs", "--refine-serial",
+                  "Number of times to refine the mesh uniformly in serial.");
+   args.AddOption(&rp_levels, "-rp", "--refine-parallel",
+                  "Number of times to refine the mesh uniformly in parallel.");
+   args.AddOption(&cxyz, "-c", "--cartesian-partitioning",
+                  "Use Cartesian partitioning.");
+   args.AddOption(&problem, "-p", "--problem", "Problem setup to use.");
+   args.AddOption(&order_v, "-ok", "--order-kinematic",
+                  "Order (degree) of the kinematic finite element space.");
+   args.AddOption(&order_e, "-ot", "--order-thermo",
+                  "Order (degree) of the thermodynamic finite element space.");
+   args.AddOption(&order_q, "-oq", "--order-intrule",
+                  "Order  of the integration rule.");
+   args.AddOption(&ode_solver_type, "-s", "--ode-solver",
+                  "ODE solver: 1 - Forward Euler,\n\t"
+                  "            2 - RK2 SSP, 3 - RK3 SSP, 4 - RK4, 6 - RK6,\n\t"
+                  "            7 - RK2Avg,\n\t"
+                  "            12 - AB2, 13 - AB3 (variable step).");
+   args.AddOption(&t_final, "-tf", "--t-final",
+                  "Final time; start time is 0.");
+   args.AddOption(&cfl, "-cfl", "--cfl", "CFL-condition number.");
+   args.AddOption(&cg_tol, "-cgt", "--cg-tol",
+                  "Relative CG tolerance (velocity linear solve).");
+   args.AddOption(&cg_adaptive, "-acg", "--adaptive-cg", "-no-acg",
+                  "--no-adaptive-cg",
+                  "Warm start the CG solves from the previous stage, with\n\t"
+                  "tolerances that follow the stage increment of the\n\t"
+                  "right-hand side rho, for a slope error of\n\t"
+                  "max(cgt, cgs * rho^order), within [cgt, cgtm].");
+   args.AddOption(&cg_safety, "-cgs", "--cg-safety",
+                  "Safety factor of the adaptive CG tolerances.");
+   args.AddOption(&cg_tol_max, "-cgtm", "--cg-tol-max",
+                  "Maximum relative tolerance of the adaptive CG solves.");
+   args.AddOption(&ftz_tol, "-ftz", "--ftz-tol",
+                  "Absolute flush-to-zero tolerance.");
+   args.AddOption(&cg_max_iter, "-cgm", "--cg-max-steps",
+                  "Maximum number of CG iterations (velocity linear solve).");
+   args.AddOption(&max_tsteps, "-ms", "--max-steps",
+                  "Maximum number of steps (negative means no restriction).");
+   args.AddOption(&p_assembly, "-pa", "--partial-assembly", "-fa",
+                  "--full-assembly",
+                  "Activate 1D tensor-based assembly (partial assembly).");
+   args.AddOption(&sell, "-sell", "--sell-format", "-no-sell",
+                  "--no-sell-format",
+                  "Use the SELL-C-sigma sparse format for the full assembly\n\t"
+                  "force and mass matrix-vector products (needs -fa).");
+   args.AddOption(&impose_visc, "-iv", "--impose-viscosity", "-niv",
+                  "--no-impose-viscosity",
+                  "Use active viscosity terms even for smooth problems.");
+   args.AddOption(&huge_pages, "-hp", "--huge-pages", "-no-hp",
+                  "--no-huge-pages",
+                  "Allocate the state, quadrature data and QUpdate arrays\n\t"
+                  "in 2 MB huge pages, preferably on the local NUMA node.");
+   args.AddOption(&reproducible, "-repro", "--reproducible", "-no-repro",
+                  "--no-reproducible",
+                  "Bitwise reproducible global sums (CG, energies, norms)\n\t"
+                  "for any number of ranks and threads.");
+   args.AddOption(&structured, "-sm", "--structured-mesh", "-no-sm",
+                  "--no-structured-mesh",
+                  "Structured mode for uniform Cartesian meshes: store the\n\t"
+                  "initial Jacobians of one zone, shared by all zones.");
+   args.AddOption(&index64, "-i64", "--index64", "-no-i64", "--no-index64",
+                  "Use 64-bit offsets in the quadrature update kernel,\n\t"
+                  "instead of the 32-bit ones (to measure their cost).");
+   args.AddOption(&const_basis, "-cbt", "--const-basis-tables", "-no-cbt",
+                  "--no-const-basis-tables",
+                  "Use the compile-time basis tables and quadrature weights\n\t"
+                  "in the partial assembly kernels, when they match.");
+   args.AddOption(&compact_stress, "-cs", "--compact-stress", "-no-cs",
+                  "--no-compact-stress",
+                  "Store the symmetric stress at the quadrature points, and\n\t"
+                  "recompute the Jacobians in the force kernels (3D PA).");
+   args.AddOption(&node_geometry, "-ng", "--node-geometry", "-no-ng",
+                  "--no-node-geometry",
+                  "Store the bitwise equal initial Jacobians of the zones\n\t"
+                  "once per compute node, in shared memory (PA).");
+   args.AddOption(&partition_type, "-pt", "--partition",
+                  "Customized x/y/z Cartesian MPI partitioning of the serial mesh.\n\t"
+                  "Here x,y,z are relative task ratios in each direction.\n\t"
+                  "Example: with 48 mpi tasks and -pt 321, one would get a Cartesian\n\t"
+                  "partition of the serial mesh by (6,4,2) MPI tasks in (x,y,z).\n\t"
+                  "NOTE: the serially refined mesh must have the appropriate number\n\t"
+                  "of zones in each direction, e.g., the number of zones in direction x\n\t"
+                  "must be divisible by the number of MPI tasks in direction x.\n\t"
+                  "Available options: 11, 21, 111, 211, 221, 311, 321, 322, 432.\n\t"
+                  "With -pt 1, the rank grid is chosen automatically for any\n\t"
+                  "number of ranks, with uneven slabs if needed.");
+   args.AddOption(&ale_period, "-ale", "--ale-period",
+                  "ALE mode: remap the state every n cycles to a mesh\n\t"
+                  "relaxed toward the initial one (0 = Lagrangian).");
+   args.AddOption(&ale_relax, "-aler", "--ale-relax",
+                  "ALE relaxation factor toward the initial mesh, in (0, 1].");
+   args.AddOption(&balance_steps, "-lb", "--load-balance",
+                  "Measure the zone costs over the first n steps, then\n\t"
+                  "repartition once with them (0 = off, FA mode only).");
+   args.AddOption(&restart_in, "-rsi", "--restart-in",
+                  "Continue from this restart file, written by a run with\n\t"
+                  "the same mesh, refinements and orders on any number of\n\t"
+                  "ranks.");
+   args.AddOption(&restart_out, "-rso", "--restart-out",
+                  "Restart file written with -rsp.");
+   args.AddOption(&restart_period, "-rsp", "--restart-period",
+                  "Write the restart file every n cycles and at the last\n\t"
+                  "one (0 = never).");
+   args.AddOption(&node_partition, "-nap", "--node-aware-partition", "-no-nap",
+                  "--no-node-aware-partition",
+                  "Cartesian partitioning of the serial mesh in one box per\n\t"
+                  "compute node, each split between the ranks of the node.\n\t"
+                  "Overrides -pt and -c when all nodes have the same number\n\t"
+                  "of ranks.");
+   args.AddOption(&partition_report, "-prep", "--partition-report", "-no-prep",
+                  "--no-partition-report",
+                  "Print the neighbors, intra/inter-node shared faces and\n\t"
+                  "ghost H1 dofs of each rank.");
+}
+
+LaghosSimulation::LaghosSimulation(MPI_Comm comm, const LaghosOptions &options)
+   : comm(comm), opt(options),
+     pmesh(nullptr), L2FEC(nullptr), l2_fec(nullptr), mat_fec(nullptr),
+     H1FEC(nullptr), L2FESpace(nullptr), H1FESpace(nullptr), l2_fes(nullptr),
+     mat_fes(nullptr), offset(4), rho0_coeff(rho0), v_coeff(nullptr),
+     rho0_gf(nullptr), mat_gf(nullptr), hydro(nullptr), ode_solver(nullptr),
+     rk2avg(nullptr), remap(nullptr), rk2avg_norm(false), t(0.0), dt(0.0),
+     cycle(0), steps(0), last_step(false), callback(nullptr),
+     callback_data(nullptr)
+{
+   MPI_Comm_rank(comm, &myid);
+}
+
+LaghosSimulation::~LaghosSimulation()
+{
+   delete remap;
+   delete ode_solver;
+   delete hydro;
+   delete mat_gf;
+   delete rho0_gf;
+   delete v_coeff;
+   delete mat_fes;
+   delete l2_fes;
+   delete H1FESpace;
+   delete L2FESpace;
+   delete H1FEC;
+   delete mat_fec;
+   delete l2_fec;
+   delete L2FEC;
+   delete pmesh;
+}
+
+int LaghosSimulation::PartitionSerialMesh()
+{
+   // On all processors, use the default builtin 1D/2D/3D mesh or read the
+   // serial one given on the command line.
+   Mesh *mesh;
+   if (strncmp(opt.mesh_file, "default", 7) != 0)
+   {
+      mesh = new Mesh(opt.mesh_file, true, true);
+   }
+   else
+   {
+      if (dim == 1)
+      {
+         mesh = new Mesh(Mesh::MakeCartesian1D(2));
+         mesh->GetBdrElement(0)->SetAttribute(1);
+         mesh->GetBdrElement(1)->SetAttribute(1);
+      }
+      if (dim == 2)
+      {
+         mesh = new Mesh(Mesh::MakeCartesian2D(2, 2, Element::QUADRILATERAL,
+                                               true));
+         const int NBE = mesh->GetNBE();
+         for (int b = 0; b < NBE; b++)
+         {
+            Element *bel = mesh->GetBdrElement(b);
+            const int attr = (b < NBE/2) ? 2 : 1;
+            bel->SetAttribute(attr);
+         }
+      }
+      if (dim == 3)
+      {
+         mesh = new Mesh(Mesh::MakeCartesian3D(2, 2, 2, Element::HEXAHEDRON,
+                                               true));
+         const int NBE = mesh->GetNBE();
+         for (int b = 0; b < NBE; b++)
+         {
+            Element *bel = mesh->GetBdrElement(b);
+            const int attr = (b < NBE/3) ? 3 : (b < 2*NBE/3) ? 1 : 2;
+            bel->SetAttribute(attr);
+         }
+      }
+   }
+   dim = mesh->Dimension();
+
+   // Refine the mesh in serial to increase the resolution.
+   for (int lev = 0; lev < opt.rs_levels; lev++) { mesh->UniformRefinement(); }
+   const int mesh_NE = mesh->GetNE();
+   if (myid == 0)
+   {
+      cout << "Number of zones in the serial mesh: " << mesh_NE << endl;
+   }
+
+   // The rebalance needs the nonconforming mesh structures.
+   if (opt.balance_steps > 0) { mesh->EnsureNCMesh(); }
+
+   // Parallel partitioning of the mesh.
+   int num_tasks; MPI_Comm_size(comm, &num_tasks);
+   int unit = 1;
+   int *nxyz = new int[dim];
+   switch (opt.partition_type)
+   {
+      case 0:
+      case 1: // Automatic, see below.
+         for (int d = 0; d < dim; d++) { nxyz[d] = unit; }
+         break;
+      case 11:
+      case 111:
+         unit = static_cast<int>(floor(pow(num_tasks, 1.0 / dim) + 1e-2));
+         for (int d = 0; d < dim; d++) { nxyz[d] = unit; }
+         break;
+      case 21: // 2D
+         unit = static_cast<int>(floor(pow(num_tasks / 2, 1.0 / 2) + 1e-2));
+         nxyz[0] = 2 * unit; nxyz[1] = unit;
+         break;
+      case 31: // 2D
+         unit = static_cast<int>(floor(pow(num_tasks / 3, 1.0 / 2) + 1e-2));
+         nxyz[0] = 3 * unit; nxyz[1] = unit;
+         break;
+      case 32: // 2D
+         unit = static_cast<int>(floor(pow(2 * num_tasks / 3, 1.0 / 2) + 1e-2));
+         nxyz[0] = 3 * unit / 2; nxyz[1] = unit;
+         break;
+      case 49: // 2D
+         unit = static_cast<int>(floor(pow(9 * num_tasks / 4, 1.0 / 2) + 1e-2));
+         nxyz[0] = 4 * unit / 9; nxyz[1] = unit;
+         break;
+      case 51: // 2D
+         unit = static_cast<int>(floor(pow(num_tasks / 5, 1.0 / 2) + 1e-2));
+         nxyz[0] = 5 * unit; nxyz[1] = unit;
+         break;
+      case 211: // 3D.
+         unit = static_cast<int>(floor(pow(num_tasks / 2, 1.0 / 3) + 1e-2));
+         nxyz[0] = 2 * unit; nxyz[1] = unit; nxyz[2] = unit;
+         break;
+      case 221: // 3D.
+         unit = static_cast<int>(floor(pow(num_tasks / 4, 1.0 / 3) + 1e-2));
+         nxyz[0] = 2 * unit; nxyz[1] = 2 * unit; nxyz[2] = unit;
+         break;
+      case 311: // 3D.
+         unit = static_cast<int>(floor(pow(num_tasks / 3, 1.0 / 3) + 1e-2));
+         nxyz[0] = 3 * unit; nxyz[1] = unit; nxyz[2] = unit;
+         break;
+      case 321: // 3D.
+         unit = static_cast<int>(floor(pow(num_tasks / 6, 1.0 / 3) + 1e-2));
+         nxyz[0] = 3 * unit; nxyz[1] = 2 * unit; nxyz[2] = unit;
+         break;
+      case 322: // 3D.
+         unit = static_cast<int>(floor(pow(2 * num_tasks / 3, 1.0 / 3) + 1e-2));
+         nxyz[0] = 3 * unit / 2; nxyz[1] = unit; nxyz[2] = unit;
+         break;
+      case 432: // 3D.
+         unit = static_cast<int>(floor(pow(num_tasks / 3, 1.0 / 3) + 1e-2));
+         nxyz[0] = 2 * unit; nxyz[1] = 3 * unit / 2; nxyz[2] = unit;
+         break;
+      case 511: // 3D.
+         unit = static_cast<int>(floor(pow(num_tasks / 5, 1.0 / 3) + 1e-2));
+         nxyz[0] = 5 * unit; nxyz[1] = unit; nxyz[2] = unit;
+         break;
+      case 521: // 3D.
+         unit = static_cast<int>(floor(pow(num_tasks / 10, 1.0 / 3) + 1e-2));
+         nxyz[0] = 5 * unit; nxyz[1] = 2 * unit; nxyz[2] = unit;
+         break;
+      case 522: // 3D.
+         unit = static_cast<int>(floor(pow(num_tasks / 20, 1.0 / 3) + 1e-2));
+         nxyz[0] = 5 * unit; nxyz[1] = 2 * unit; nxyz[2] = 2 * unit;
+         break;
+      case 911: // 3D.
+         unit = static_cast<int>(floor(pow(num_tasks / 9, 1.0 / 3) + 1e-2));
+         nxyz[0] = 9 * unit; nxyz[1] = unit; nxyz[2] = unit;
+         break;
+      case 921: // 3D.
+         unit = static_cast<int>(floor(pow(num_tasks / 18, 1.0 / 3) + 1e-2));
+         nxyz[0] = 9 * unit; nxyz[1] = 2 * unit; nxyz[2] = unit;
+         break;
+      case 922: // 3D.
+         unit = static_cast<int>(floor(pow(num_tasks / 36, 1.0 / 3) + 1e-2));
+         nxyz[0] = 9 * unit; nxyz[1] = 2 * unit; nxyz[2] = 2 * unit;
+         break;
+      default:
+         if (myid == 0)
+         {
+            cout << "Unknown partition type: " << opt.partition_type << '\n';
+         }
+         delete [] nxyz;
+         delete mesh;
+         return 3;
+   }
+   int product = 1;
+   for (int d = 0; d < dim; d++) { product *= nxyz[d]; }
+   const bool cartesian_partitioning = (opt.cxyz.Size()>0)?true:false;
+   int *node_partitioning = opt.node_partition ?
+                            NodeAwarePartitioning(comm, *mesh) : nullptr;
+   if (opt.node_partition && !node_partitioning && myid == 0)
+   {
+      cout << "The nodes have different numbers of ranks, "
+           << "node-aware partitioning is disabled." << endl;
+   }
+   int *auto_partitioning = nullptr;
+   if (!node_partitioning && !cartesian_partitioning &&
+       opt.partition_type == 1)
+   {
+      auto_partitioning = AutoCartesianPartitioning(*mesh, num_tasks,
+                                                    myid == 0);
+      if (!auto_partitioning && myid == 0)
+      {
+         cout << "The mesh is not a structured box, "
+              << "automatic Cartesian partitioning is disabled." << endl;
+      }
+   }
+   if (node_partitioning)
+   {
+      pmesh = new ParMesh(comm, *mesh, node_partitioning);
+      SetZoneIds(*mesh, node_partitioning);
+      delete [] node_partitioning;
+   }
+   else if (auto_partitioning)
+   {
+      pmesh = new ParMesh(comm, *mesh, auto_partitioning);
+      SetZoneIds(*mesh, auto_partitioning);
+      delete [] auto_partitioning;
+   }
+   else if (product == num_tasks || cartesian_partitioning)
+   {
+      if (cartesian_partitioning)
+      {
+         int cproduct = 1;
+         for (int d = 0; d < dim; d++) { cproduct *= opt.cxyz[d]; }
+         MFEM_VERIFY(!cartesian_partitioning || opt.cxyz.Size() == dim,
+                     "Expected " << mesh->SpaceDimension() << " integers with the "
+                     "option --cartesian-partitioning.");
+         MFEM_VERIFY(!cartesian_partitioning || num_tasks == cproduct,
+                     "Expected cartesian partitioning product to match number of ranks.");
+      }
+      int *partitioning = cartesian_partitioning ?
+                          mesh->CartesianPartitioning(opt.cxyz):
+                          mesh->CartesianPartitioning(nxyz);
+      pmesh = new ParMesh(comm, *mesh, partitioning);
+      SetZoneIds(*mesh, partitioning);
+      delete [] partitioning;
+   }
+   else
+   {
+      if (myid == 0)
+      {
+         cout << "Non-Cartesian partitioning through METIS will be used.\n";
+#ifndef MFEM_USE_METIS
+         cout << "MFEM was built without METIS. "
+              << "Adjust the number of tasks to use a Cartesian split." << endl;
+#endif
+      }
+#ifndef MFEM_USE_METIS
+      delete [] nxyz;
+      delete mesh;
+      return 1;
+#endif
+      int *partitioning = mesh->GeneratePartitioning(num_tasks);
+      pmesh = new ParMesh(comm, *mesh, partitioning);
+      SetZoneIds(*mesh, partitioning);
+      delete [] partitioning;
+   }
+   delete [] nxyz;
+   delete mesh;
+   return 0;
+}
+
+void LaghosSimulation::SetZoneIds(const Mesh &mesh, const int *partitioning)
+{
+   // ParMesh keeps the serial order of the local zones.
+   zone_ids.SetSize(0);
+   for (int i = 0; i < mesh.GetNE(); i++)
+   {
+      if (partitioning[i] == myid) { zone_ids.Append(i); }
+   }
+}
+
+void LaghosSimulation::RefineZoneIds()
+{
+   const CoarseFineTransformations &tr = pmesh->GetRefinementTransforms();
+   const int children = 1 << dim;
+   Array<long long> parent_ids(zone_ids);
+   zone_ids.SetSize(pmesh->GetNE());
+   for (int i = 0; i < pmesh->GetNE(); i++)
+   {
+      const Embedding &emb = tr.embeddings[i];
+      MFEM_VERIFY((int) emb.matrix < children,
+                  "The restart files need 2^dim children per refined zone.");
+      zone_ids[i] = parent_ids[emb.parent] * children + emb.matrix;
+   }
+}
+
+void LaghosSimulation::SetEssentialDofs()
+{
+   // Boundary conditions: all tests use v.n = 0 on the boundary, and we assume
+   // that the boundaries are straight.
+   Array<int> ess_bdr(pmesh->bdr_attributes.Max()), dofs_marker, dofs_list;
+   ess_tdofs.SetSize(0);
+   ess_vdofs.SetSize(0);
+   for (int d = 0; d < pmesh->Dimension(); d++)
+   {
+      // Attributes 1/2/3 correspond to fixed-x/y/z boundaries,
+      // i.e., we must enforce v_x/y/z = 0 for the velocity components.
+      ess_bdr = 0; ess_bdr[d] = 1;
+      H1FESpace->GetEssentialTrueDofs(ess_bdr, dofs_list, d);
+      ess_tdofs.Append(dofs_list);
+      H1FESpace->GetEssentialVDofs(ess_bdr, dofs_marker, d);
+      FiniteElementSpace::MarkerToList(dofs_marker, dofs_list);
+      ess_vdofs.Append(dofs_list);
+   }
+}
+
+LagrangianHydroOperator *LaghosSimulation::NewHydroOperator()
+{
+   // Additional details, depending on the problem.
+   int source = 0; bool visc = true, vorticity = false;
+   switch (problem)
+   {
+      case 0: if (pmesh->Dimension() == 2) { source = 1; } visc = false; break;
+      case 1: visc = true; break;
+      case 2: visc = true; break;
+      case 3: visc = true; S.HostRead(); break;
+      case 4: visc = false; break;
+      case 5: visc = true; break;
+      case 6: visc = true; break;
+      case 7: source = 2; visc = true; vorticity = true;  break;
+      default: MFEM_ABORT("Wrong problem specification!");
+   }
+   if (opt.impose_visc) { visc = true; }
+
+   LagrangianHydroOperator *oper =
+      new LagrangianHydroOperator(S.Size(),
+                                  *H1FESpace, *L2FESpace, ess_tdofs,
+                                  rho0_coeff, *rho0_gf,
+                                  *mat_gf, source, opt.cfl,
+                                  visc, vorticity, opt.p_assembly,
+                                  opt.cg_tol, opt.cg_max_iter, opt.ftz_tol,
+                                  opt.order_q, opt.sell, opt.structured,
+                                  opt.compact_stress, opt.node_geometry);
+
+   if (opt.cg_adaptive)
+   {
+      int ode_order = 0;
+      switch (opt.ode_solver_type)
+      {
+         case 1: ode_order = 1; break;
+         case 2: ode_order = 2; break;
+         case 3: ode_order = 3; break;
+         case 4: ode_order = 4; break;
+         case 6: ode_order = 6; break;
+         case 7: ode_order = 2; break;
+         case 12: ode_order = 2; break;
+         case 13: ode_order = 3; break;
+      }
+      oper->SetAdaptiveCGTolerance(ode_order, opt.cg_safety, opt.cg_tol_max);
+   }
+   return oper;
+}
+
+int LaghosSimulation::Setup()
+{
+   MFEM_VERIFY(hydro == nullptr, "Setup() can be called only once.");
+   problem = opt.problem;
+   dim = opt.dim;
+
+   // Read the pre-partitioned mesh, or partition the serial mesh.
+   if (opt.par_mesh_in[0] != '\0')
+   {
+      pmesh = ReadPartitionedMesh(comm, opt.par_mesh_in);
+   }
+   else
+   {
+      const int mesh_error = PartitionSerialMesh();
+      if (mesh_error) { return mesh_error; }
+      // Tool mode: only write the mesh.
+      if (opt.par_mesh_out[0] != '\0')
+      {
+         WritePartitionedMesh(*pmesh, opt.par_mesh_out);
+         return 0;
+      }
+   }
+   dim = pmesh->Dimension();
+   opt.dim = dim;
+
+   // 1D vs partial assembly sanity check.
+   if (opt.p_assembly && dim == 1)
+   {
+      opt.p_assembly = false;
+      if (myid == 0)
+      {
+         cout << "Laghos does not support PA in 1D. Switching to FA." << endl;
+      }
+   }
+   MFEM_VERIFY(!opt.sell || !opt.p_assembly,
+               "The SELL-C-sigma format needs full assembly (-fa).");
+   MFEM_VERIFY(opt.balance_steps == 0 || (!opt.p_assembly &&
+                                          opt.par_mesh_in[0] == '\0' &&
+                                          opt.ale_period == 0),
+               "The load balancing needs FA, a serial mesh and no ALE.");
+   MFEM_VERIFY(!opt.compact_stress || (opt.p_assembly && dim == 3),
+               "The compact stress needs partial assembly in 3D.");
+   if (opt.compact_stress)
+   {
+      // The compact kernels exist for Q2-Q1 and Q3-Q2, with the default
+      // quadrature points per direction (4 and 6).
+      const int ir_order = (opt.order_q > 0) ? opt.order_q :
+                           3*opt.order_v + opt.order_e - 1;
+      const int Q1D = IntRules.Get(Geometry::SEGMENT, ir_order).GetNPoints();
+      MFEM_VERIFY((opt.order_v == 2 && opt.order_e == 1 && Q1D == 4) ||
+                  (opt.order_v == 3 && opt.order_e == 2 && Q1D == 6),
+                  "The compact stress needs -ok 2 -ot 1 or -ok 3 -ot 2, with "
+                  "the default quadrature (4 or 6 points per direction), "
+                  "not " << Q1D << " points.");
+   }
+   MFEM_VERIFY(!opt.node_geometry || (opt.p_assembly && !opt.structured &&
+                                      opt.balance_steps == 0),
+               "The node shared geometry needs partial assembly, and no "
+               "structured mode or load balancing.");
+   const bool restart = opt.restart_in[0] != '\0' || opt.restart_period > 0;
+   MFEM_VERIFY(!restart || (opt.par_mesh_in[0] == '\0' &&
+                            opt.balance_steps == 0),
+               "The restart files need a serial mesh and no load balancing.");
+
+   // Refine the mesh further in parallel to increase the resolution.
+   for (int lev = 0; lev < opt.rp_levels; lev++)
+   {
+      pmesh->UniformRefinement();
+      if (restart) { RefineZoneIds(); }
+   }
+
+   int NE = pmesh->GetNE(), ne_min, ne_max;
+   MPI_Reduce(&NE, &ne_min, 1, MPI_INT, MPI_MIN, 0, pmesh->GetComm());
+   MPI_Reduce(&NE, &ne_max, 1, MPI_INT, MPI_MAX, 0, pmesh->GetComm());
+   if (myid == 0)
+   { cout << "Zones min/max: " << ne_min << " " << ne_max << endl; }
+
+   // Define the parallel finite element spaces. We use:
+   // - H1 (Gauss-Lobatto, continuous) for position and velocity.
+   // - L2 (Bernstein, discontinuous) for specific internal energy.
+   L2FEC = new L2_FECollection(opt.order_e, dim, BasisType::Positive);
+   H1FEC = new H1_FECollection(opt.order_v, dim);
+   L2FESpace = new ParFiniteElementSpace(pmesh, L2FEC);
+   H1FESpace = new ParFiniteElementSpace(pmesh, H1FEC, pmesh->Dimension());
+   if (opt.partition_report) { PrintPartitionReport(*pmesh, *H1FESpace); }
+
+   SetEssentialDofs();
+
+   // Define the explicit ODE solver used for time integration.
+   switch (opt.ode_solver_type)
+   {
+      case 1: ode_solver = new ForwardEulerSolver; break;
+      case 2: ode_solver = new RK2Solver(0.5); break;
+      case 3: ode_solver = new RK3SSPSolver; break;
+      case 4: ode_solver = new RK4Solver; break;
+      case 6: ode_solver = new RK6Solver; break;
+      case 7: ode_solver = new RK2AvgSolver; break;
+      case 12: ode_solver = new AdamsBashforthSolver(2); break;
+      case 13: ode_solver = new AdamsBashforthSolver(3); break;
+      default:
+         if (myid == 0)
+         {
+            cout << "Unknown ODE solver type: " << opt.ode_solver_type << '\n';
+         }
+         return 3;
+   }
+
+   const HYPRE_Int glob_size_l2 = L2FESpace->GlobalTrueVSize();
+   const HYPRE_Int glob_size_h1 = H1FESpace->GlobalTrueVSize();
+   if (myid == 0)
+   {
+      cout << "Number of kinematic (position, velocity) dofs: "
+           << glob_size_h1 << endl;
+      cout << "Number of specific internal energy dofs: "
+           << glob_size_l2 << endl;
+   }
+
+   const int Vsize_l2 = L2FESpace->GetVSize();
+   const int Vsize_h1 = H1FESpace->GetVSize();
+   offset[0] = 0;
+   offset[1] = offset[0] + Vsize_h1;
+   offset[2] = offset[1] + Vsize_h1;
+   offset[3] = offset[2] + Vsize_l2;
+   SetHugePageArrays(opt.huge_pages);
+   SetReproducibleReductions(opt.reproducible);
+   SetKernelIndex64(opt.index64);
+   SetConstBasisTables(opt.const_basis);
+   arrays.Allocate(S, offset);
+
+   // Define GridFunction objects for the position, velocity and specific
+   // internal energy. There is no function for the density, as we can always
+   // compute the density values given the current mesh position, using the
+   // property of pointwise mass conservation.
+   x_gf.MakeRef(H1FESpace, S, offset[0]);
+   v_gf.MakeRef(H1FESpace, S, offset[1]);
+   e_gf.MakeRef(L2FESpace, S, offset[2]);
+
+   // Initialize x_gf using the starting mesh coordinates.
+   pmesh->SetNodalGridFunction(&x_gf);
+   // Sync the data location of x_gf with its base, S
+   x_gf.SyncAliasMemory(S);
+
+   // Initialize the velocity.
+   v_coeff = new VectorFunctionCoefficient(pmesh->Dimension(), v0);
+   v_gf.ProjectCoefficient(*v_coeff);
+   for (int i = 0; i < ess_vdofs.Size(); i++)
+   {
+      v_gf(ess_vdofs[i]) = 0.0;
+   }
+   // Sync the data location of v_gf with its base, S
+   v_gf.SyncAliasMemory(S);
+
+   // Initialize density and specific internal energy values. We interpolate in
+   // a non-positive basis to get the correct values at the dofs. Then we do an
+   // L2 projection to the positive basis in which we actually compute. The goal
+   // is to get a high-order representation of the initial condition. Note that
+   // this density is a temporary function and it will not be updated during the
+   // time evolution.
+   rho0_gf = new ParGridFunction(L2FESpace);
+   l2_fec = new L2_FECollection(opt.order_e, pmesh->Dimension());
+   l2_fes = new ParFiniteElementSpace(pmesh, l2_fec);
+   ParGridFunction l2_rho0_gf(l2_fes), l2_e(l2_fes);
+   l2_rho0_gf.ProjectCoefficient(rho0_coeff);
+   rho0_gf->ProjectGridFunction(l2_rho0_gf);
+   if (problem == 1)
+   {
+      // For the Sedov test, we use a delta function at the origin.
+      DeltaCoefficient e_coeff(opt.blast_position[0], opt.blast_position[1],
+                               opt.blast_position[2], opt.blast_energy);
+      l2_e.ProjectCoefficient(e_coeff);
+   }
+   else
+   {
+      FunctionCoefficient e_coeff(e0);
+      l2_e.ProjectCoefficient(e_coeff);
+   }
+   e_gf.ProjectGridFunction(l2_e);
+   // Sync the data location of e_gf with its base, S
+   e_gf.SyncAliasMemory(S);
+
+   // Piecewise constant ideal gas coefficient over the Lagrangian mesh. The
+   // gamma values are projected on function that's constant on the moving mesh.
+   mat_fec = new L2_FECollection(0, pmesh->Dimension());
+   mat_fes = new ParFiniteElementSpace(pmesh, mat_fec);
+   mat_gf = new ParGridFunction(mat_fes);
+   FunctionCoefficient mat_coeff(gamma_func);
+   mat_gf->ProjectCoefficient(mat_coeff);
+
+   hydro = NewHydroOperator();
+   if (opt.structured)
+   {
+      int loc = hydro->UniformZones() ? 1 : 0, glob;
+      MPI_Allreduce(&loc, &glob, 1, MPI_INT, MPI_MIN, pmesh->GetComm());
+      MFEM_VERIFY(glob, "The structured mode needs a uniform Cartesian mesh, "
+                  "where all zones are translates of each other.");
+      loc = hydro->BoxNodeGather() ? 1 : 0;
+      MPI_Allreduce(&loc, &glob, 1, MPI_INT, MPI_SUM, pmesh->GetComm());
+      if (myid == 0)
+      {
+         cout << "Structured mode: box node table H1 gather on " << glob
+              << " of " << pmesh->GetNRanks() << " ranks." << endl;
+      }
+   }
+   if (opt.compact_stress && myid == 0)
+   {
+      // Values read per zone by each force kernel: the quadrature data and,
+      // in the compact layout, the positions.
+      const int NQ = hydro->GetIntRule().GetNPoints(), D1D = opt.order_v + 1;
+      cout << "Compact stress: the force kernels read "
+           << 6*NQ + dim*D1D*D1D*D1D << " values per zone, instead of "
+           << 9*NQ << "." << endl;
+   }
+   if (const NodeSharedTable *table = hydro->GetJac0invTable())
+   {
+      // Largest memory over the nodes, with and without the sharing. The
+      // setup adds the matrices to the table zone by zone, from the
+      // Jacobians of the MFEM geometric factors, which are freed after it.
+      long long loc[2] = { table->NodeBytesIn(), table->NodeBytes() }, glob[2];
+      MPI_Allreduce(loc, glob, 2, MPI_LONG_LONG, MPI_MAX, pmesh->GetComm());
+      if (myid == 0)
+      {
+         cout << "Initial Jacobians per node (max): " << glob[1] / 1048576.0
+              << " MB, instead of " << glob[0] / 1048576.0 << " MB." << endl;
+      }
+   }
+   if (opt.balance_steps > 0) { hydro->MeasureZoneCosts(true); }
+
+   // The object hydro is of type LagrangianHydroOperator that defines the
+   // Mult() method that used by the time integrators.
+   ode_solver->Init(*hydro);
+   hydro->ResetTimeStepEstimate();
+   dt = hydro->GetTimeStepEstimate(S);
+   arrays.Allocate(S_old, offset);
+   S_old = S;
+   // RK2Avg stores the initial state of each step directly in S_old, and it
+   // computes e.e together with the final update of S.
+   rk2avg = dynamic_cast<RK2AvgSolver *>(ode_solver);
+   if (rk2avg) { rk2avg->SetInitialStateStorage(S_old); }
+
+   if (opt.ale_period > 0)
+   {
+      MFEM_VERIFY(opt.ale_relax > 0.0 && opt.ale_relax <= 1.0,
+                  "The ALE relaxation factor must be in (0, 1].");
+      remap = new ALERemap(*H1FESpace, *L2FESpace, hydro->GetIntRule(), x_gf,
+                           opt.ale_relax);
+   }
+   // After the remap setup, which keeps the initial mesh.
+   if (opt.restart_in[0] != '\0') { ReadRestart(opt.restart_in); }
+   return 0;
+}
+
+void LaghosSimulation::Step()
+{
+   MFEM_VERIFY(hydro, "Setup() must be called before Step().");
+   if (last_step) { return; }
+   for (;;)
+   {
+      if (t + dt >= opt.t_final)
+      {
+         dt = opt.t_final - t;
+         last_step = true;
+      }
+      if (steps == opt.max_tsteps) { last_step = true; }
+      if (!rk2avg) { S_old = S; }
+      const double t_old = t;
+      hydro->ResetTimeStepEstimate();
+
+      // S is the vector of dofs, t is the current time, and dt is the time step
+      // to advance.
+      hydro->SetTimeStep(dt);
+      ode_solver->Step(S, t, dt);
+      steps++;
+
+      // Adaptive time step control.
+      const double dt_est = hydro->GetTimeStepEstimate(S);
+      if (dt_est >= dt)
+      {
+         if (dt_est > 1.25 * dt) { dt *= 1.02; }
+         break;
+      }
+      // Repeat (solve again) with a decreased time step - decrease of the
+      // time estimate suggests appearance of oscillations.
+      dt *= 0.85;
+      if (dt < std::numeric_limits<double>::epsilon())
+      { MFEM_ABORT("The time step crashed!"); }
+      t = t_old;
+      S = S_old;
+      hydro->ResetQuadratureData();
+      if (myid == 0) { cout << "Repeating step " << cycle + 1 << endl; }
+      if (steps < opt.max_tsteps) { last_step = false; }
+   }
+   cycle++;
+   rk2avg_norm = (rk2avg != nullptr);
+
+   // Ensure the sub-vectors x_gf, v_gf, and e_gf know the location of the
+   // data in S. This operation simply updates the Memory validity flags of
+   // the sub-vectors to match those of S.
+   x_gf.SyncAliasMemory(S);
+   v_gf.SyncAliasMemory(S);
+   e_gf.SyncAliasMemory(S);
+
+   // Make sure that the mesh corresponds to the new solution state. This is
+   // needed, because some time integrators use different S-type vectors
+   // and the oper object might have redirected the mesh positions to those.
+   pmesh->NewNodes(x_gf, false);
+
+   if (remap && !last_step && cycle % opt.ale_period == 0) { Remap(); }
+   if (opt.balance_steps > 0 && !last_step)
+   {
+      if (cycle == opt.balance_steps) { Rebalance(); }
+      else if (cycle == 2 * opt.balance_steps)
+      {
+         PrintImbalance("measured after the rebalance");
+         hydro->MeasureZoneCosts(false);
+      }
+   }
+   if (opt.restart_period > 0 &&
+       (last_step || cycle % opt.restart_period == 0))
+   {
+      WriteRestart(opt.restart_out);
+   }
+
+   if (callback) { callback(*this, callback_data); }
+}
+
+void LaghosSimulation::Remap()
+{
+   S.HostReadWrite();
+   remap->Remap(x_gf, v_gf, e_gf, *mat_gf, hydro->GetQuadratureData(),
+                ess_vdofs);
+   hydro->UpdateMassMatrices();
+   StateModified();
+   // The ODE solvers restart, as their stored slopes refer to the old mesh.
+   ode_solver->Init(*hydro);
+   if (rk2avg) { rk2avg->SetInitialStateStorage(S_old); }
+   hydro->ResetTimeStepEstimate();
+   dt = hydro->GetTimeStepEstimate(S);
+}
+
+void LaghosSimulation::PrintImbalance(const char *when) const
+{
+   const double my_cost = hydro->GetZoneCosts().Sum();
+   double max_cost, sum_cost;
+   MPI_Reduce(&my_cost, &max_cost, 1, MPI_DOUBLE, MPI_MAX, 0, comm);
+   MPI_Reduce(&my_cost, &sum_cost, 1, MPI_DOUBLE, MPI_SUM, 0, comm);
+   if (myid == 0)
+   {
+      int num_tasks;
+      MPI_Comm_size(comm, &num_tasks);
+      cout << "Zone cost imbalance (max/avg), " << when << ": "
+           << max_cost * num_tasks / sum_cost << endl;
+   }
+}
+
+void LaghosSimulation::Rebalance()
+{
+   PrintImbalance("measured before the rebalance");
+   Array<int> partition;
+   Vector part_cost;
+   WeightedSFCPartitioning(*pmesh, hydro->GetZoneCosts(), partition,
+                           part_cost);
+   if (myid == 0)
+   {
+      cout << "Zone cost imbalance (max/avg), predicted after the rebalance: "
+           << part_cost.Max() * part_cost.Size() / part_cost.Sum() << endl;
+   }
+
+   // The quadrature data is not a grid function, so it moves as the values
+   // of a piecewise constant field with one vector value per zone. A shared
+   // Jac0inv (structured mode) stays the same.
+   const QuadratureData &qd = hydro->GetQuadratureData();
+   const int NQ = hydro->GetIntRule().GetNPoints();
+   const int JS = qd.shared_Jac0inv ? 0 : dim * dim;
+   const int qsize = NQ * (1 + JS);
+   const DenseTensor shared_Jac0inv(qd.Jac0inv);
+   L2_FECollection zone_fec(0, dim);
+   ParFiniteElementSpace zone_fes(pmesh, &zone_fec, qsize, Ordering::byVDIM);
+   ParGridFunction zone_data(&zone_fes);
+   const double *rho0DetJ0w = qd.rho0DetJ0w.HostRead();
+   for (int z = 0; z < pmesh->GetNE(); z++)
+   {
+      double *zd = zone_data.GetData() + z * qsize;
+      for (int q = 0; q < NQ; q++)
+      {
+         zd[q] = rho0DetJ0w[z*NQ + q];
+         const double *J = qd.Jac0invAt(z, q).Data();
+         for (int i = 0; i < JS; i++) { zd[NQ + q*JS + i] = J[i]; }
+      }
+   }
+   const double h0 = qd.h0;
+
+   // Migrate the mesh, which also moves its nodes (x_gf) to the new ranks,
+   // then the fields and the state.
+   Array<int> old_offset(offset);
+   Vector old_S(S);
+   double *os = old_S.HostReadWrite();
+   pmesh->Rebalance(partition);
+   H1FESpace->Update();
+   L2FESpace->Update();
+   l2_fes->Update(false);
+   mat_fes->Update();
+   zone_fes.Update();
+   rho0_gf->Update();
+   mat_gf->Update();
+   zone_data.Update();
+
+   offset[1] = offset[0] + H1FESpace->GetVSize();
+   offset[2] = offset[1] + H1FESpace->GetVSize();
+   offset[3] = offset[2] + L2FESpace->GetVSize();
+   arrays.Free(S);
+   arrays.Free(S_old);
+   arrays.Allocate(S, offset);
+   arrays.Allocate(S_old, offset);
+   double *s = S.HostWrite();
+   for (int b = 0; b < 3; b++)
+   {
+      ParFiniteElementSpace *fes = (b < 2) ? H1FESpace : L2FESpace;
+      Vector in(os + old_offset[b], old_offset[b+1] - old_offset[b]);
+      Vector out(s + offset[b], offset[b+1] - offset[b]);
+      fes->GetUpdateOperator()->Mult(in, out);
+   }
+   H1FESpace->UpdatesFinished();
+   L2FESpace->UpdatesFinished();
+   x_gf.MakeRef(H1FESpace, S, offset[0]);
+   v_gf.MakeRef(H1FESpace, S, offset[1]);
+   e_gf.MakeRef(L2FESpace, S, offset[2]);
+   pmesh->NewNodes(x_gf, false);
+   SetEssentialDofs();
+
+   // New operator, with the migrated quadrature data and the statistics of
+   // the old one. The time step is kept.
+   LagrangianHydroOperator *old_hydro = hydro;
+   hydro = NewHydroOperator();
+   hydro->ContinueFrom(*old_hydro);
+   delete old_hydro;
+   QuadratureData &nqd = hydro->GetQuadratureData();
+   double *nrho0DetJ0w = nqd.rho0DetJ0w.HostWrite();
+   for (int z = 0; z < pmesh->GetNE(); z++)
+   {
+      const double *zd = zone_data.GetData() + z * qsize;
+      for (int q = 0; q < NQ; q++)
+      {
+         nrho0DetJ0w[z*NQ + q] = zd[q];
+         double *J = nqd.Jac0invAt(z, q).Data();
+         for (int i = 0; i < JS; i++) { J[i] = zd[NQ + q*JS + i]; }
+      }
+   }
+   if (nqd.shared_Jac0inv) { nqd.Jac0inv = shared_Jac0inv; }
+   nqd.h0 = h0;
+   hydro->UpdateMassMatrices();
+   hydro->MeasureZoneCosts(true);
+
+   ode_solver->Init(*hydro);
+   S_old = S;
+   if (rk2avg) { rk2avg->SetInitialStateStorage(S_old); }
+   StateModified();
+}
+
+RestartHeader LaghosSimulation::RestartInfo() const
+{
+   const QuadratureData &qd = hydro->GetQuadratureData();
+   const int NQ = hydro->GetIntRule().GetNPoints();
+   const int JS = qd.shared_Jac0inv ? 0 : dim * dim;
+   const int h1_dofs = H1FESpace->GetFE(0)->GetDof() * dim;
+   const int l2_dofs = L2FESpace->GetFE(0)->GetDof();
+   long long NE = pmesh->GetNE(), glob_NE;
+   MPI_Allreduce(&NE, &glob_NE, 1, MPI_LONG_LONG, MPI_SUM, comm);
+
+   RestartHeader hdr;
+   hdr.ints[RestartHeader::DIM] = dim;
+   hdr.ints[RestartHeader::PROBLEM] = problem;
+   hdr.ints[RestartHeader::ORDER_V] = opt.order_v;
+   hdr.ints[RestartHeader::ORDER_E] = opt.order_e;
+   hdr.ints[RestartHeader::NQ] = NQ;
+   hdr.ints[RestartHeader::JAC0INV_SIZE] = JS;
+   hdr.ints[RestartHeader::RS_LEVELS] = opt.rs_levels;
+   hdr.ints[RestartHeader::RP_LEVELS] = opt.rp_levels;
+   hdr.ints[RestartHeader::ZONES] = glob_NE;
+   // x and v, e, gamma, rho0DetJ0w and Jac0inv.
+   hdr.ints[RestartHeader::RECORD_SIZE] = 2*h1_dofs + l2_dofs + 1 + NQ*(1+JS);
+   hdr.ints[RestartHeader::CYCLE] = cycle;
+   hdr.ints[RestartHeader::STEPS] = steps;
+   hdr.reals[RestartHeader::TIME] = t;
+   hdr.reals[RestartHeader::DT] = dt;
+   hdr.reals[RestartHeader::H0] = qd.h0;
+   return hdr;
+}
+
+void LaghosSimulation::WriteRestart(const char *file) const
+{
+   const RestartHeader hdr = RestartInfo();
+   const int rsize = (int) hdr.ints[RestartHeader::RECORD_SIZE];
+   const QuadratureData &qd = hydro->GetQuadratureData();
+   const int NQ = hdr.ints[RestartHeader::NQ];
+   const int JS = hdr.ints[RestartHeader::JAC0INV_SIZE];
+   const int NE = pmesh->GetNE();
+   Vector records(NE * rsize);
+   double *r = records.HostWrite();
+   const double *rho0DetJ0w = qd.rho0DetJ0w.HostRead();
+   const double *gamma = mat_gf->HostRead();
+   S.HostRead();
+   Array<int> h1_vdofs, l2_dofs;
+   for (int z = 0; z < NE; z++, r += rsize)
+   {
+      H1FESpace->GetElementVDofs(z, h1_vdofs);
+      L2FESpace->GetElementDofs(z, l2_dofs);
+      double *zr = r;
+      x_gf.GetSubVector(h1_vdofs, zr);
+      v_gf.GetSubVector(h1_vdofs, zr + h1_vdofs.Size());
+      zr += 2 * h1_vdofs.Size();
+      e_gf.GetSubVector(l2_dofs, zr);
+      zr += l2_dofs.Size();
+      *zr++ = gamma[z];
+      for (int q = 0; q < NQ; q++)
+      {
+         zr[q] = rho0DetJ0w[z*NQ + q];
+         const double *J = qd.Jac0invAt(z, q).Data();
+         for (int i = 0; i < JS; i++) { zr[NQ + q*JS + i] = J[i]; }
+      }
+   }
+   hydrodynamics::WriteRestart(comm, file, hdr, zone_ids, records);
+   if (myid == 0)
+   {
+      cout << "Restart file " << file << " written at cycle " << cycle
+           << ", t = " << t << endl;
+   }
+}
+
+void LaghosSimulation::ReadRestart(const char *file)
+{
+   const RestartHeader info = RestartInfo();
+   RestartHeader hdr;
+   Vector records;
+   hydrodynamics::ReadRestart(comm, file, hdr, zone_ids, records);
+   for (int i = RestartHeader::DIM; i <= RestartHeader::RECORD_SIZE; i++)
+   {
+      MFEM_VERIFY(hdr.ints[i] == info.ints[i], "The restart file " << file
+                  << " does not match the simulation (header entry " << i
+                  << ": " << hdr.ints[i] << " vs " << info.ints[i] << ").");
+   }
+
+   const int rsize = (int) hdr.ints[RestartHeader::RECORD_SIZE];
+   QuadratureData &qd = hydro->GetQuadratureData();
+   const int NQ = hdr.ints[RestartHeader::NQ];
+   const int JS = hdr.ints[RestartHeader::JAC0INV_SIZE];
+   double *r = records.HostReadWrite();
+   double *rho0DetJ0w = qd.rho0DetJ0w.HostWrite();
+   double *gamma = mat_gf->HostReadWrite();
+   S.HostReadWrite();
+   Array<int> h1_vdofs, l2_dofs;
+   for (int z = 0; z < pmesh->GetNE(); z++, r += rsize)
+   {
+      H1FESpace->GetElementVDofs(z, h1_vdofs);
+      L2FESpace->GetElementDofs(z, l2_dofs);
+      double *zr = r;
+      x_gf.SetSubVector(h1_vdofs, zr);
+      v_gf.SetSubVector(h1_vdofs, zr + h1_vdofs.Size());
+      zr += 2 * h1_vdofs.Size();
+      e_gf.SetSubVector(l2_dofs, zr);
+      zr += l2_dofs.Size();
+      gamma[z] = *zr++;
+      for (int q = 0; q < NQ; q++)
+      {
+         rho0DetJ0w[z*NQ + q] = zr[q];
+         double *J = qd.Jac0invAt(z, q).Data();
+         for (int i = 0; i < JS; i++) { J[i] = zr[NQ + q*JS + i]; }
+      }
+   }
+   qd.h0 = hdr.reals[RestartHeader::H0];
+
+   // As after a remap, the ODE solvers restart from the new state.
+   StateModified();
+   hydro->UpdateMassMatrices();
+   ode_solver->Init(*hydro);
+   S_old = S;
+   if (rk2avg) { rk2avg->SetInitialStateStorage(S_old); }
+   hydro->ResetTimeStepEstimate();
+   t = hdr.reals[RestartHeader::TIME];
+   dt = hdr.reals[RestartHeader::DT];
+   cycle = (int) hdr.ints[RestartHeader::CYCLE];
+   steps = (int) hdr.ints[RestartHeader::STEPS];
+   last_step = false;
+   if (myid == 0)
+   {
+      cout << "Restarted from " << file << " at cycle " << cycle << ", t = "
+           << t << endl;
+   }
+}
+
+void LaghosSimulation::Run()
+{
+   while (!last_step) { Step(); }
+}
+
+double LaghosSimulation::EnergyNorm2() const
+{
+   const MPI_Comm comm = pmesh->GetComm();
+   if (ReproducibleReductions() || !rk2avg_norm)
+   {
+      return GlobalDot(comm, e_gf, e_gf);
+   }
+   double loc = rk2avg->GetLocalEnergyNorm2(), glob;
+   MPI_Allreduce(&loc, &glob, 1, MPI_DOUBLE, MPI_SUM, comm);
+   return glob;
+}
+
+void LaghosSimulation::StateModified()
+{
+   x_gf.SyncAliasMemory(S);
+   v_gf.SyncAliasMemory(S);
+   e_gf.SyncAliasMemory(S);
+   pmesh->NewNodes(x_gf, false);
+   hydro->ResetQuadratureData();
+   rk2avg_norm = false;
+}
+
+static double rho0(const Vector &x)
+{
+   switch (problem)
+   {
+      case 0: return 1.0;
+      case 1: return 1.0;
+      case 2: return (x(0) < 0.5) ? 1.0 : 0.1;
+      case 3: return (dim == 2) ? (x(0) > 1.0 && x(1) > 1.5) ? 0.125 : 1.0
+                        : x(0) > 1.0 && ((x(1) < 1.5 && x(2) < 1.5) ||
+                                         (x(1) > 1.5 && x(2) > 1.5)) ? 0.125 : 1.0;
+      case 4: return 1.0;
+      case 5:
+      {
+         if (x(0) >= 0.5 && x(1) >= 0.5) { return 0.5313; }
+         if (x(0) <  0.5 && x(1) <  0.5) { return 0.8; }
+         return 1.0;
+      }
+      case 6:
+      {
+         if (x(0) <  0.5 && x(1) >= 0.5) { return 2.0; }
+         if (x(0) >= 0.5 && x(1) <  0.5) { return 3.0; }
+         return 1.0;
+      }
+      case 7: return x(1) >= 0.0 ? 2.0 : 1.0;
+      default: MFEM_ABORT("Bad number given for problem id!"); return 0.0;
+   }
+}
+
+static double gamma_func(const Vector &x)
+{
+   switch (problem)
+   {
+      case 0: return 5.0 / 3.0;
+      case 1: return 1.4;
+      case 2: return 1.4;
+      case 3: return (x(0) > 1.0 && x(1) <= 1.5) ? 1.4 : 1.5;
+      case 4: return 5.0 / 3.0;
+      case 5: return 1.4;
+      case 6: return 1.4;
+      case 7: return 5.0 / 3.0;
+      default: MFEM_ABORT("Bad number given for problem id!"); return 0.0;
+   }
+}
+
+static double rad(double x, double y) { return sqrt(x*x + y*y); }
+
+static void v0(const Vector &x, Vector &v)
+{
+   const double atn = pow((x(0)*(1.0-x(0))*4*x(1)*(1.0-x(1))*4.0),0.4);
+   switch (problem)
+   {
+      case 0:
+         v(0) =  sin(M_PI*x(0)) * cos(M_PI*x(1));
+         v(1) = -cos(M_PI*x(0)) * sin(M_PI*x(1));
+         if (x.Size() == 3)
+         {
+            v(0) *= cos(M_PI*x(2));
+            v(1) *= cos(M_PI*x(2));
+            v(2) = 0.0;
+         }
+         break;
+      case 1: v = 0.0; break;
+      case 2: v = 0.0; break;
+      case 3: v = 0.0; break;
+      case 4:
+      {
+         v = 0.0;
+         const double r = rad(x(0), x(1));
+         if (r < 0.2)
+         {
+            v(0) =  5.0 * x(1);
+            v(1) = -5.0 * x(0);
+         }
+         else if (r < 0.4)
+         {
+            v(0) =  2.0 * x(1) / r - 5.0 * x(1);
+            v(1) = -2.0 * x(0) / r + 5.0 * x(0);
+         }
+         else { }
+         break;
+      }
+      case 5:
+      {
+         v = 0.0;
+         if (x(0) >= 0.5 && x(1) >= 0.5) { v(0)=0.0*atn, v(1)=0.0*atn; return;}
+         if (x(0) <  0.5 && x(1) >= 0.5) { v(0)=0.7276*atn, v(1)=0.0*atn; return;}
+         if (x(0) <  0.5 && x(1) <  0.5) { v(0)=0.0*atn, v(1)=0.0*atn; return;}
+         if (x(0) >= 0.5 && x(1) <  0.5) { v(0)=0.0*atn, v(1)=0.7276*atn; return; }
+         MFEM_ABORT("Error in problem 5!");
+         return;
+      }
+      case 6:
+      {
+         v = 0.0;
+         if (x(0) >= 0.5 && x(1) >= 0.5) { v(0)=+0.75*atn, v(1)=-0.5*atn; return;}
+         if (x(0) <  0.5 && x(1) >= 0.5) { v(0)=+0.75*atn, v(1)=+0.5*atn; return;}
+         if (x(0) <  0.5 && x(1) <  0.5) { v(0)=-0.75*atn, v(1)=+0.5*atn; return;}
+         if (x(0) >= 0.5 && x(1) <  0.5) { v(0)=-0.75*atn, v(1)=-0.5*atn; return;}
+         MFEM_ABORT("Error in problem 6!");
+         return;
+      }
+      case 7:
+      {
+         v = 0.0;
+         v(1) = 0.02 * exp(-2*M_PI*x(1)*x(1)) * cos(2*M_PI*x(0));
+         break;
+      }
+      default: MFEM_ABORT("Bad number given for problem id!");
+   }
+}
+
+static double e0(const Vector &x)
+{
+   switch (problem)
+   {
+      case 0:
+      {
+         const double denom = 2.0 / 3.0;  // (5/3 - 1) * density.
+         double val;
+         if (x.Size() == 2)
+         {
+            val = 1.0 + (cos(2*M_PI*x(0)) + cos(2*M_PI*x(1))) / 4.0;
+         }
+         else
+         {
+            val = 100.0 + ((cos(2*M_PI*x(2)) + 2) *
+                           (cos(2*M_PI*x(0)) + cos(2*M_PI*x(1))) - 2) / 16.0;
+         }
+         return val/denom;
+      }
+      case 1: return 0.0; // This case in initialized in Setup().
+      case 2: return (x(0) < 0.5) ? 1.0 / rho0(x) / (gamma_func(x) - 1.0)
+                        : 0.1 / rho0(x) / (gamma_func(x) - 1.0);
+      case 3: return (x(0) > 1.0) ? 0.1 / rho0(x) / (gamma_func(x) - 1.0)
+                        : 1.0 / rho0(x) / (gamma_func(x) - 1.0);
+      case 4:
+      {
+         const double r = rad(x(0), x(1)), rsq = x(0) * x(0) + x(1) * x(1);
+         const double gamma = 5.0 / 3.0;
+         if (r < 0.2)
+         {
+            return (5.0 + 25.0 / 2.0 * rsq) / (gamma - 1.0);
+         }
+         else if (r < 0.4)
+         {
+            const double t1 = 9.0 - 4.0 * log(0.2) + 25.0 / 2.0 * rsq;
+            const double t2 = 20.0 * r - 4.0 * log(r);
+            return (t1 - t2) / (gamma - 1.0);
+         }
+         else { return (3.0 + 4.0 * log(2.0)) / (gamma - 1.0); }
+      }
+      case 5:
+      {
+         const double irg = 1.0 / rho0(x) / (gamma_func(x) - 1.0);
+         if (x(0) >= 0.5 && x(1) >= 0.5) { return 0.4 * irg; }
+         if (x(0) <  0.5 && x(1) >= 0.5) { return 1.0 * irg; }
+         if (x(0) <  0.5 && x(1) <  0.5) { return 1.0 * irg; }
+         if (x(0) >= 0.5 && x(1) <  0.5) { return 1.0 * irg; }
+         MFEM_ABORT("Error in problem 5!");
+         return 0.0;
+      }
+      case 6:
+      {
+         const double irg = 1.0 / rho0(x) / (gamma_func(x) - 1.0);
+         if (x(0) >= 0.5 && x(1) >= 0.5) { return 1.0 * irg; }
+         if (x(0) <  0.5 && x(1) >= 0.5) { return 1.0 * irg; }
+         if (x(0) <  0.5 && x(1) <  0.5) { return 1.0 * irg; }
+         if (x(0) >= 0.5 && x(1) <  0.5) { return 1.0 * irg; }
+         MFEM_ABORT("Error in problem 5!");
+         return 0.0;
+      }
+      case 7:
+      {
+         const double rho = rho0(x), gamma = gamma_func(x);
+         return (6.0 - rho * x(1)) / (gamma - 1.0) / rho;
+      }
+      default: MFEM_ABORT("Bad number given for problem id!"); return 0.0;
+   }
+}
+
+} // namespace hydrodynamics
+
+} // namespace mfem
+
+using mfem::hydrodynamics::LaghosOptions;
+using mfem::hydrodynamics::LaghosSimulation;
+
+// The C handle holds the options parser, which keeps pointers to the options.
+struct laghos_simulation
+{
+   LaghosOptions options;
+   mfem::OptionsParser args;
+   LaghosSimulation *sim;
+   laghos_step_callback callback;
+   void *callback_data;
+
+   laghos_simulation(int argc, char *argv[])
+      : args(argc, argv), sim(nullptr), callback(nullptr),
+        callback_data(nullptr) { }
+   ~laghos_simulation() { delete sim; }
+};
+
+static void laghos_c_callback(LaghosSimulation &, void *data)
+{
+   laghos_simulation *s = static_cast<laghos_simulation *>(data);
+   s->callback(s, s->callback_data);
+}
+
+static double *laghos_host_data(mfem::Vector &v, int *size)
+{
+   if (size) { *size = v.Size(); }
+   return v.HostReadWrite();
+}
+
+laghos_simulation *laghos_create(MPI_Comm comm, int argc, char *argv[])
+{
+   laghos_simulation *s = new laghos_simulation(argc, argv);
+   s->options.AddOptions(s->args);
+   s->args.Parse();
+   if (!s->args.Good())
+   {
+      int myid;
+      MPI_Comm_rank(comm, &myid);
+      if (myid == 0) { s->args.PrintUsage(std::cout); }
+      delete s;
+      return nullptr;
+   }
+   s->sim = new LaghosSimulation(comm, s->options);
+   return s;
+}
+
+int laghos_setup(laghos_simulation *s) { return s->sim->Setup(); }
+
+void laghos_step(laghos_simulation *s) { s->sim->Step(); }
+
+void laghos_run(laghos_simulation *s) { s->sim->Run(); }
+
+int laghos_done(const laghos_simulation *s) { return s->sim->Done(); }
+
+int laghos_cycle(const laghos_simulation *s) { return s->sim->GetCycle(); }
+
+double laghos_time(const laghos_simulation *s) { return s->sim->GetTime(); }
+
+double laghos_dt(const laghos_simulation *s) { return s->sim->GetTimeStep(); }
+
+void laghos_set_dt(laghos_simulation *s, double dt)
+{
+   s->sim->SetTimeStep(dt);
+}
+
+void laghos_set_step_callback(laghos_simulation *s,
+                              laghos_step_callback callback, void *data)
+{
+   s->callback = callback;
+   s->callback_data = data;
+   if (callback) { s->sim->SetStepCallback(laghos_c_callback, s); }
+   else { s->sim->SetStepCallback(nullptr, nullptr); }
+}
+
+double *laghos_position(laghos_simulation *s, int *size)
+{
+   return laghos_host_data(s->sim->GetPosition(), size);
+}
+
+double *laghos_velocity(laghos_simulation *s, int *size)
+{
+   return laghos_host_data(s->sim->GetVelocity(), size);
+}
+
+double *laghos_energy(laghos_simulation *s, int *size)
+{
+   return laghos_host_data(s->sim->GetEnergy(), size);
+}
+
+double *laghos_qdata_stress(laghos_simulation *s, int *size)
+{
+   mfem::hydrodynamics::QuadratureData &qd = s->sim->GetQuadratureData();
+   if (qd.compact_stress) { return laghos_host_data(qd.stress, size); }
+   mfem::DenseTensor &t = qd.stressJinvT;
+   if (size) { *size = t.TotalSize(); }
+   return t.HostReadWrite();
+}
+
+double *laghos_qdata_rho0DetJ0w(laghos_simulation *s, int *size)
+{
+   return laghos_host_data(s->sim->GetQuadratureData().rho0DetJ0w, size);
+}
+
+double *laghos_qdata_Jac0inv(laghos_simulation *s, int *size)
+{
+   mfem::DenseTensor &t = s->sim->GetQuadratureData().Jac0inv;
+   if (size) { *size = t.TotalSize(); }
+   return t.HostReadWrite();
+}
+
+void laghos_state_modified(laghos_simulation *s) { s->sim->StateModified(); }
+
+void laghos_destroy(laghos_simulation *s) { delete s; }
@@ -0,0 +1,86 @@
+/* Copyright (c) 2017, Lawrence Livermore National Security, LLC. Produced at
+ * the Lawrence Livermore National Laboratory. LLNL-CODE-734707. All Rights
+ * reserved. See files LICENSE and NOTICE for details.
+ *
+ * This file is part of CEED, a collection of benchmarks, miniapps, software
+ * libraries and APIs for efficient high-order finite element and spectral
+ * element discretizations for exascale applications. For more information and
+ * source code availability see http://github.com/ceed.
+ *
+ * The CEED research is supported by the Exascale Computing Project 17-SC-20-SC,
+ * a collaborative effort of two U.S. Department of Energy organizations (Office
+ * of Science and the National Nuclear Security Administration) responsible for
+ * the planning and preparation of a capable exascale ecosystem, including
+ * software, applications, hardware, advanced system engineering and early
+ * testbed platforms, in support of the nation's exascale computing imperative.
+ */
+
+/* C interface of the Laghos library (liblaghos.a). The C++ interface is the
+ * class mfem::hydrodynamics::LaghosSimulation in laghos_api.hpp.
+ *
+ * The field access functions return host pointers directly into the solution
+ * and quadrature data of the simulation, i.e., no copies are made. Changes of
+ * the state made through them must be followed by laghos_state_modified(). */
+
+#ifndef MFEM_LAGHOS_API_H
+#define MFEM_LAGHOS_API_H
+
+#include <mpi.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct laghos_simulation laghos_simulation;
+
+/* Called after each accepted time step. */
+typedef void (*laghos_step_callback)(laghos_simulation *sim, void *data);
+
+/* Creates a simulation on the communicator comm, with the same command line
+ * options as the laghos executable (argv[0] is skipped). The strings in argv
+ * must stay valid during the lifetime of the simulation. Returns NULL if the
+ * options could not be parsed. */
+laghos_simulation *laghos_create(MPI_Comm comm, int argc, char *argv[]);
+
+/* Builds the mesh, spaces, initial state and operators. Returns 0 on
+ * success. */
+int laghos_setup(laghos_simulation *sim);
+
+/* Advances by one accepted time step, or until the final time. */
+void laghos_step(laghos_simulation *sim);
+void laghos_run(laghos_simulation *sim);
+int laghos_done(const laghos_simulation *sim);
+
+int laghos_cycle(const laghos_simulation *sim);
+double laghos_time(const laghos_simulation *sim);
+double laghos_dt(const laghos_simulation *sim);
+void laghos_set_dt(laghos_simulation *sim, double dt);
+
+void laghos_set_step_callback(laghos_simulation *sim,
+                              laghos_step_callback callback, void *data);
+
+/* Local position, velocity and specific internal energy dofs (size is set to
+ * the number of values). */
+double *laghos_position(laghos_simulation *sim, int *size);
+double *laghos_velocity(laghos_simulation *sim, int *size);
+double *laghos_energy(laghos_simulation *sim, int *size);
+
+/* Quadrature data, see struct QuadratureData in laghos_assembly.hpp. The mass
+ * matrices are assembled from rho0DetJ0w during setup, so it should only be
+ * read. The stress data is stressJinvT, or the compact stress with -cs. With
+ * -sm or -ng, Jac0inv has the matrices of the zone classes only, and with -ng
+ * it is shared by the ranks of the node, so it must not be modified. */
+double *laghos_qdata_stress(laghos_simulation *sim, int *size);
+double *laghos_qdata_rho0DetJ0w(laghos_simulation *sim, int *size);
+double *laghos_qdata_Jac0inv(laghos_simulation *sim, int *size);
+
+/* Must be called after the state was modified through the pointers above. */
+void laghos_state_modified(laghos_simulation *sim);
+
+void laghos_destroy(laghos_simulation *sim);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MFEM_LAGHOS_API_H */
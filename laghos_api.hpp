@@ -0,0 +1,231 @@
+// Copyright (c) 2017, Lawrence Livermore National Security, LLC. Produced at
+// the Lawrence Livermore National Laboratory. LLNL-CODE-734707. All Rights
+// reserved. See files LICENSE and NOTICE for details.
+//
+// This file is part of CEED, a collection of benchmarks, miniapps, software
+// libraries and APIs for efficient high-order finite element and spectral
+// element discretizations for exascale applications. For more information and
+// source code availability see http://github.com/ceed.
+//
+// The CEED research is supported by the Exascale Computing Project 17-SC-20-SC,
+// a collaborative effort of two U.S. Department of Energy organizations (Office
+// of Science and the National Nuclear Security Administration) responsible for
+// the planning and preparation of a capable exascale ecosystem, including
+// software, applications, hardware, advanced system engineering and early
+// testbed platforms, in support of the nation's exascale computing imperative.
+
+#ifndef MFEM_LAGHOS_API
+#define MFEM_LAGHOS_API
+
+#include "mfem.hpp"
+#include "laghos_solver.hpp"
+#include "laghos_remap.hpp"
+#include "laghos_restart.hpp"
+
+namespace mfem
+{
+
+namespace hydrodynamics
+{
+
+// Physics and discretization options of a simulation. The defaults are the
+// ones of the laghos executable.
+struct LaghosOptions
+{
+   int problem, dim;
+   const char *mesh_file;
+   // Basenames of the pre-partitioned mesh files to read or to write.
+   const char *par_mesh_in, *par_mesh_out;
+   int rs_levels, rp_levels;
+   Array<int> cxyz;
+   int order_v, order_e, order_q;
+   int ode_solver_type;
+   double t_final, cfl;
+   double cg_tol, ftz_tol;
+   int cg_max_iter;
+   bool cg_adaptive;
+   double cg_safety, cg_tol_max;
+   int max_tsteps;
+   bool p_assembly, sell, impose_visc;
+   bool huge_pages, reproducible;
+   // Structured mode for uniform Cartesian meshes: the initial geometry is
+   // stored once for all zones.
+   bool structured;
+   // 64-bit offsets in the quadrature update kernel, instead of the 32-bit
+   // ones (to measure their cost).
+   bool index64;
+   // Compile-time basis tables and quadrature weights in the force and
+   // quadrature update kernels, when they match the discretization.
+   bool const_basis;
+   // Compact quadrature data (3D partial assembly): the symmetric stress,
+   // with the Jacobians recomputed in the force kernels.
+   bool compact_stress;
+   // Initial Jacobians stored once per compute node for each class of zones
+   // with bitwise equal matrices, in a shared memory window (partial
+   // assembly).
+   bool node_geometry;
+   int partition_type;
+   // ALE mode: remap every ale_period cycles (0 = Lagrangian), toward the
+   // initial mesh with the relaxation factor ale_relax.
+   int ale_period;
+   double ale_relax;
+   // Repartition once with the zone costs measured over the first
+   // balance_steps cycles (0 = no rebalance).
+   int balance_steps;
+   // Restart file to continue from (empty = none), and restart file written
+   // every restart_period cycles and at the last one (0 = never).
+   const char *restart_in, *restart_out;
+   int restart_period;
+   bool node_partition, partition_report;
+   double blast_energy, blast_position[3];
+
+   LaghosOptions();
+   // Registers the options above with their command line names.
+   void AddOptions(OptionsParser &args);
+};
+
+// Owns the mesh, the spaces, the state and the operators of one simulation, and
+// advances it step by step. The accessors give direct references to the data
+// used by the solver, so a coupled code can read and modify the state between
+// the steps without copies. StateModified() must be called after the state or
+// the quadrature data was changed from the outside.
+//
+// The problem setup functions (initial conditions, gamma) are global, i.e.,
+// all simulations in one process must use the same problem.
+//
+// With the balance_steps option, the step that rebalances the mesh replaces
+// the hydro operator and the ODE solver state, and changes the local sizes of
+// the spaces and of the state. The mesh, space and grid function objects stay
+// the same.
+class LaghosSimulation
+{
+public:
+   typedef void (*StepCallback)(LaghosSimulation &sim, void *data);
+
+private:
+   const MPI_Comm comm;
+   int myid;
+   LaghosOptions opt;
+
+   ParMesh *pmesh;
+   L2_FECollection *L2FEC, *l2_fec, *mat_fec;
+   H1_FECollection *H1FEC;
+   ParFiniteElementSpace *L2FESpace, *H1FESpace, *l2_fes, *mat_fes;
+   Array<int> ess_tdofs, ess_vdofs;
+
+   // The monolithic BlockVector stores unknown fields as:
+   // - 0 -> position
+   // - 1 -> velocity
+   // - 2 -> specific internal energy
+   Array<int> offset;
+   LargeArrays arrays;
+   BlockVector S, S_old;
+   ParGridFunction x_gf, v_gf, e_gf;
+
+   FunctionCoefficient rho0_coeff;
+   VectorFunctionCoefficient *v_coeff;
+   ParGridFunction *rho0_gf, *mat_gf;
+
+   LagrangianHydroOperator *hydro;
+   ODESolver *ode_solver;
+   RK2AvgSolver *rk2avg;
+   ALERemap *remap;
+   // The e.e value of the last RK2Avg step is valid.
+   bool rk2avg_norm;
+
+   double t, dt;
+   int cycle, steps;
+   bool last_step;
+
+   StepCallback callback;
+   void *callback_data;
+
+   // Global ids of the local zones, independent of the decomposition: the
+   // indices in the serial mesh, then parent * 2^dim + child for each
+   // parallel refinement. Valid with a serial mesh and without rebalance.
+   Array<long long> zone_ids;
+   void SetZoneIds(const Mesh &mesh, const int *partitioning);
+   void RefineZoneIds();
+   // Header of a restart file written now.
+   RestartHeader RestartInfo() const;
+
+   // Reads, refines and partitions the serial mesh into pmesh. Returns 0 on
+   // success, or the exit code of the laghos executable.
+   int PartitionSerialMesh();
+   // Remaps the state to the relaxed mesh and rebuilds the operators that
+   // depend on the mesh.
+   void Remap();
+   // Essential dofs of the velocity boundary conditions.
+   void SetEssentialDofs();
+   // New hydro operator for the current spaces and state.
+   LagrangianHydroOperator *NewHydroOperator();
+   // Repartitions the mesh with the measured zone costs, and migrates the
+   // state, the fields and the quadrature data. The hydro operator is rebuilt.
+   void Rebalance();
+   void PrintImbalance(const char *when) const;
+
+public:
+   LaghosSimulation(MPI_Comm comm, const LaghosOptions &options);
+   ~LaghosSimulation();
+
+   // Builds the mesh, spaces, initial state and operators. Returns 0 on
+   // success, or the exit code of the laghos executable for bad options. With
+   // the par_mesh_out option, only writes the partitioned mesh.
+   int Setup();
+
+   // Advances by one accepted time step (the rejected steps are repeated with
+   // a smaller time step), then calls the step callback.
+   void Step();
+   // Steps until the final time or the maximum number of steps is reached.
+   void Run();
+   bool Done() const { return last_step; }
+
+   double GetTime() const { return t; }
+   // Time step of the next Step(), can be changed by the caller.
+   double GetTimeStep() const { return dt; }
+   void SetTimeStep(double new_dt) { dt = new_dt; }
+   // Number of accepted steps, and number of steps including the rejected ones.
+   int GetCycle() const { return cycle; }
+   int GetSteps() const { return steps; }
+   // The options after Setup(), with the actual dimension and assembly type.
+   const LaghosOptions &GetOptions() const { return opt; }
+
+   void SetStepCallback(StepCallback cb, void *data)
+   { callback = cb; callback_data = data; }
+
+   // Views of the state and of its position, velocity and energy blocks.
+   BlockVector &GetState() { return S; }
+   ParGridFunction &GetPosition() { return x_gf; }
+   ParGridFunction &GetVelocity() { return v_gf; }
+   ParGridFunction &GetEnergy() { return e_gf; }
+   QuadratureData &GetQuadratureData() { return hydro->GetQuadratureData(); }
+
+   ParMesh &GetParMesh() { return *pmesh; }
+   ParFiniteElementSpace &GetH1Space() { return *H1FESpace; }
+   ParFiniteElementSpace &GetL2Space() { return *L2FESpace; }
+   LagrangianHydroOperator &GetHydroOperator() { return *hydro; }
+   ODESolver &GetODESolver() { return *ode_solver; }
+   VectorCoefficient &GetInitialVelocity() { return *v_coeff; }
+   // The ALE remap, or nullptr in Lagrangian mode.
+   const ALERemap *GetRemap() const { return remap; }
+
+   // Global e.e after the last step (RK2Avg computes the local part together
+   // with its final update, except in the reproducible reductions mode).
+   double EnergyNorm2() const;
+
+   // Updates the mesh and the quadrature data after outside state changes.
+   void StateModified();
+
+   // Restart files with the state, the gamma values and the initial zone
+   // data, by global zone. A file can be read by a run on any number of
+   // ranks, with the same mesh, refinements and orders. Reading replaces the
+   // state, the time and the counters of a simulation after its Setup().
+   void WriteRestart(const char *file) const;
+   void ReadRestart(const char *file);
+};
+
+} // namespace hydrodynamics
+
+} // namespace mfem
+
+#endif // MFEM_LAGHOS_API
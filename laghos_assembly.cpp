@@ -16,6 +16,7 @@
 
 #include "laghos_assembly.hpp"
 #include <unordered_map>
+#include <algorithm>
 
 namespace mfem
 {
@@ -23,6 +24,20 @@ namespace mfem
 namespace hydrodynamics
 {
 
+double MassCoefficient::Eval(ElementTransformation &T,
+                             const IntegrationPoint &ip)
+{
+   if (!use_qdata) { return rho0.Eval(T, ip); }
+   const int NQ = ir.GetNPoints();
+   int q = 0;
+   while (q < NQ && (ir.IntPoint(q).x != ip.x || ir.IntPoint(q).y != ip.y ||
+                     ir.IntPoint(q).z != ip.z)) { q++; }
+   MFEM_VERIFY(q < NQ, "The point is not in the quadrature data rule!");
+   T.SetIntPoint(&ip);
+   const double *rho0DetJ0w = qdata.rho0DetJ0w.HostRead();
+   return rho0DetJ0w[T.ElementNo * NQ + q] / (T.Weight() * ip.weight);
+}
+
 void DensityIntegrator::AssembleRHSElementVect(const FiniteElement &fe,
                                                ElementTransformation &Tr,
                                                Vector &elvect)
@@ -67,7 +82,7 @@ void ForceIntegrator::AssembleElementMatrix2(const FiniteElement &trial_fe,
             for (int gd = 0; gd < dim; gd++) // Gradient components.
             {
                const int eq = e*nqp + q;
-               const double stressJinvT = qdata.stressJinvT(vd)(eq, gd);
+               const double stressJinvT = qdata.stressJinvT(eq, gd, vd);
                loc_force(i, vd) +=  stressJinvT * vshape(i,gd);
             }
          }
@@ -77,6 +92,16 @@ void ForceIntegrator::AssembleElementMatrix2(const FiniteElement &trial_fe,
    }
 }
 
+// Gives access to the partial assembly data of the mass integrator.
+class CaptureMassIntegrator : public mfem::MassIntegrator
+{
+public:
+   CaptureMassIntegrator(Coefficient &Q, const IntegrationRule *ir)
+      : mfem::MassIntegrator(Q, ir) { }
+   const Vector &GetPAData() const { return pa_data; }
+   const DofToQuad *GetMaps() const { return maps; }
+};
+
 MassPAOperator::MassPAOperator(ParFiniteElementSpace &pfes,
                                const IntegrationRule &ir,
                                Coefficient &Q) :
@@ -89,10 +114,13 @@ MassPAOperator::MassPAOperator(ParFiniteElementSpace &pfes,
    ess_tdofs_count(0),
    ess_tdofs(0)
 {
+   CaptureMassIntegrator *mi = new CaptureMassIntegrator(Q, &ir);
    pabf.SetAssemblyLevel(AssemblyLevel::PARTIAL);
-   pabf.AddDomainIntegrator(new mfem::MassIntegrator(Q, &ir));
+   pabf.AddDomainIntegrator(mi);
    pabf.Assemble();
    pabf.FormSystemMatrix(mfem::Array<int>(), mass);
+   pa_data = &mi->GetPAData();
+   maps = mi->GetMaps();
 }
 
 void MassPAOperator::SetEssentialTrueDofs(Array<int> &dofs)
@@ -120,10 +148,273 @@ void MassPAOperator::Mult(const Vector &x, Vector &y) const
    if (ess_tdofs_count > 0) { y.SetSubVector(ess_tdofs, 0.0); }
 }
 
+void MassPAOperator::RecordSolve(KernelCapture &capture, const int component,
+                                 const IterativeSolver &cg, const bool jacobi,
+                                 const double tol, const int max_iter,
+                                 const Vector &x0, const Vector &b,
+                                 const Vector &x) const
+{
+   // The global true dof of each E-vector entry, in the lexicographic order
+   // of the partial assembly kernels. The replay exchanges the shared ones.
+   ParFiniteElementSpace &pfes = *pabf.ParFESpace();
+   const int ND = NE > 0 ? pfes.GetFE(0)->GetDof() : 0;
+   Vector gtdofs(NE * ND);
+   Array<int> dofs;
+   for (int e = 0; e < NE; e++)
+   {
+      const TensorBasisElement *tbe =
+         dynamic_cast<const TensorBasisElement *>(pfes.GetFE(e));
+      MFEM_VERIFY(tbe, "The mass capture needs tensor elements!");
+      const Array<int> &dof_map = tbe->GetDofMap();
+      pfes.GetElementDofs(e, dofs);
+      for (int i = 0; i < ND; i++)
+      {
+         const int d = dofs[dof_map.Size() ? dof_map[i] : i];
+         const int ldof = d >= 0 ? d : -1 - d;
+         gtdofs(e*ND + i) = (double) pfes.GetGlobalTDofNumber(ldof);
+      }
+   }
+   Vector ess(ess_tdofs_count), diag;
+   for (int i = 0; i < ess_tdofs_count; i++) { ess(i) = ess_tdofs[i]; }
+   if (jacobi)
+   {
+      diag.SetSize(height);
+      pabf.AssembleDiagonal(diag);
+   }
+   capture.Record(KernelCapture::MASS_CG,
+                  {component, dim, maps->ndof, maps->nqpt, NE,
+                   cg.GetNumIterations(), cg.iterative_mode, max_iter, jacobi},
+                  {tol, (double) pfes.GetMyTDofOffset()},
+                  {maps->B, *pa_data, gtdofs, ess, diag, x0, b, x});
+}
+
+H1Gather::H1Gather(const ParFiniteElementSpace &h1, const bool structured) :
+   NE(h1.GetNE()),
+   ND(NE > 0 ? h1.GetFE(0)->GetDof() : 0),
+   vdim(h1.GetVDim()),
+   vsize(h1.GetVSize()),
+   cstride(h1.GetOrdering() == Ordering::byNODES ? h1.GetNDofs() : 1),
+   compressed(false),
+   box_nodes(false),
+   map(NE*ND),
+   D1D(0)
+{
+   cells[0] = cells[1] = cells[2] = 1;
+   const int dstride = (h1.GetOrdering() == Ordering::byNODES) ? 1 : vdim;
+   const TensorBasisElement *tbe = (NE > 0) ?
+                                   dynamic_cast<const TensorBasisElement*>
+                                   (h1.GetFE(0)) : nullptr;
+   MFEM_VERIFY(NE == 0 || tbe, "H1Gather needs tensor product elements!");
+   Array<int> dof_map;
+   if (tbe) { dof_map = tbe->GetDofMap(); }
+   Array<int> dofs;
+   int *M = map.HostWrite();
+   for (int e = 0; e < NE; e++)
+   {
+      h1.GetElementDofs(e, dofs);
+      for (int d = 0; d < ND; d++)
+      {
+         const int k = dof_map.Size() ? dof_map[d] : d;
+         M[e*ND + d] = dofs[k] * dstride;
+      }
+   }
+
+   if (structured)
+   {
+      if (SetupBoxNodes(h1, M))
+      {
+         box_nodes = true;
+         map.DeleteAll();
+         return;
+      }
+      elem_cell.DeleteAll();
+      node_map.DeleteAll();
+   }
+
+   // Split the elements into runs with constant dof strides, and keep the
+   // compressed map when it is at most half the size of the plain one.
+   Array<int> first, base, step;
+   for (int e = 0; e < NE; )
+   {
+      const int *m0 = M + e*ND, *m1 = M + (e+1)*ND;
+      int len = 1;
+      if (e + 1 < NE)
+      {
+         for (len = 2; e + len < NE; len++)
+         {
+            const int *m = M + (e+len)*ND;
+            bool same = true;
+            for (int d = 0; d < ND && same; d++)
+            {
+               same = (m[d] - m0[d] == len * (m1[d] - m0[d]));
+            }
+            if (!same) { break; }
+         }
+      }
+      first.Append(e);
+      for (int d = 0; d < ND; d++)
+      {
+         base.Append(m0[d]);
+         step.Append(len > 1 ? m1[d] - m0[d] : 0);
+      }
+      e += len;
+   }
+   compressed = NE > 0 && 2*(NE + first.Size() + 2*base.Size()) <= NE*ND;
+   if (compressed)
+   {
+      elem_run.SetSize(NE);
+      for (int r = 0; r < first.Size(); r++)
+      {
+         const int end = (r + 1 < first.Size()) ? first[r+1] : NE;
+         for (int e = first[r]; e < end; e++) { elem_run[e] = r; }
+      }
+      run_first = first;
+      run_base = base;
+      run_step = step;
+      map.DeleteAll();
+   }
+}
+
+bool H1Gather::SetupBoxNodes(const ParFiniteElementSpace &h1, const int *M)
+{
+   ParMesh &mesh = *h1.GetParMesh();
+   const int dim = mesh.Dimension();
+   if (NE == 0) { return false; }
+   D1D = h1.GetFE(0)->GetOrder() + 1;
+   int nd = 1;
+   for (int k = 0; k < dim; k++) { nd *= D1D; }
+   if (nd != ND) { return false; }
+
+   // Lower corner of each element, from the vertices of the initial mesh, and
+   // its size, which must be the same for all elements.
+   Vector corner(NE*dim);
+   double lo[3], size[3];
+   Array<int> verts;
+   for (int e = 0; e < NE; e++)
+   {
+      mesh.GetElementVertices(e, verts);
+      for (int k = 0; k < dim; k++)
+      {
+         double vmin = mesh.GetVertex(verts[0])[k], vmax = vmin;
+         for (int i = 1; i < verts.Size(); i++)
+         {
+            vmin = fmin(vmin, mesh.GetVertex(verts[i])[k]);
+            vmax = fmax(vmax, mesh.GetVertex(verts[i])[k]);
+         }
+         if (e == 0) { lo[k] = vmin; size[k] = vmax - vmin; }
+         if (fabs(vmax - vmin - size[k]) > 1e-10 * size[k]) { return false; }
+         lo[k] = fmin(lo[k], vmin);
+         corner(e*dim + k) = vmin;
+      }
+   }
+
+   // Cell of each element in the box of the elements.
+   Array<int> cell(NE*dim);
+   for (int k = 0; k < 3; k++) { cells[k] = 1; }
+   for (int e = 0; e < NE; e++)
+   {
+      for (int k = 0; k < dim; k++)
+      {
+         const double s = (corner(e*dim + k) - lo[k]) / size[k];
+         const int i = (int) floor(s + 0.5);
+         if (fabs(s - i) > 1e-6) { return false; }
+         cell[e*dim + k] = i;
+         cells[k] = std::max(cells[k], i + 1);
+      }
+   }
+   if ((long long) cells[0] * cells[1] * cells[2] != NE) { return false; }
+   const int P = D1D - 1;
+   const int nx = cells[0]*P + 1, ny = (dim > 1) ? cells[1]*P + 1 : 1;
+   const int nz = (dim > 2) ? cells[2]*P + 1 : 1;
+   elem_cell.SetSize(NE);
+   elem_cell = -1;
+   Array<int> cell_elem(NE);
+   cell_elem = -1;
+   node_map.SetSize(nx*ny*nz);
+   node_map = -1;
+   for (int e = 0; e < NE; e++)
+   {
+      int c[3] = { 0, 0, 0 };
+      for (int k = 0; k < dim; k++) { c[k] = cell[e*dim + k]; }
+      const int ci = c[0] + cells[0]*(c[1] + cells[1]*c[2]);
+      if (cell_elem[ci] >= 0) { return false; }
+      cell_elem[ci] = e;
+      elem_cell[e] = ci;
+      // The node table must reproduce the plain map.
+      for (int d = 0; d < ND; d++)
+      {
+         const int dx = d % D1D, dy = (d / D1D) % D1D, dz = d / (D1D*D1D);
+         const int n = (c[0]*P + dx) + nx*((c[1]*P + dy) + ny*(c[2]*P + dz));
+         int &j = node_map[n];
+         if (j >= 0 && j != M[e*ND + d]) { return false; }
+         j = M[e*ND + d];
+      }
+   }
+   return true;
+}
+
+void H1Gather::Gather(const Vector &x, const bool xv,
+                      Vector &X, Vector &V) const
+{
+   const int NE = this->NE, ND = this->ND, VD = vdim, cs = cstride;
+   const int vs = vsize;
+   const bool comp = compressed, box = box_nodes;
+   const int *M = (comp || box) ? nullptr : map.Read();
+   const int *R = comp ? elem_run.Read() : nullptr;
+   const int *F = comp ? run_first.Read() : nullptr;
+   const int *B = comp ? run_base.Read() : nullptr;
+   const int *T = comp ? run_step.Read() : nullptr;
+   const int *C = box ? elem_cell.Read() : nullptr;
+   const int *N = box ? node_map.Read() : nullptr;
+   const int CX = cells[0], CY = cells[1], Q = D1D, P = D1D - 1;
+   const int NX = CX*P + 1, NY = CY*P + 1;
+   const double *d_x = x.Read();
+   double *d_X = X.Write();
+   double *d_V = xv ? V.Write() : nullptr;
+   MFEM_FORALL(i, NE*ND,
+   {
+      const int e = i / ND, d = i % ND;
+      int j;
+      if (comp)
+      {
+         const int r = R[e];
+         j = B[r*ND + d] + (e - F[r]) * T[r*ND + d];
+      }
+      else if (box)
+      {
+         // Node of the dof in the lexicographic grid of the box. In 2D (1D)
+         // the z (y) cell and dof indices are zero.
+         const int ce = C[e];
+         const int cx = ce % CX, cy = (ce / CX) % CY, cz = ce / (CX*CY);
+         const int dx = d % Q, dy = (d / Q) % Q, dz = d / (Q*Q);
+         j = N[(cx*P + dx) + NX*((cy*P + dy) + NY*(cz*P + dz))];
+      }
+      else { j = M[i]; }
+      for (int c = 0; c < VD; c++)
+      {
+         const int k = d + ND*(c + VD*e);
+         d_X[k] = d_x[j + c*cs];
+         if (xv) { d_V[k] = d_x[vs + j + c*cs]; }
+      }
+   });
+}
+
+void H1Gather::Mult(const Vector &x, Vector &X) const
+{
+   Gather(x, false, X, X);
+}
+
+void H1Gather::MultXV(const Vector &S, Vector &X, Vector &V) const
+{
+   MFEM_ASSERT(S.Size() >= 2*vsize, "The state vector is too small!");
+   Gather(S, true, X, V);
+}
+
 ForcePAOperator::ForcePAOperator(const QuadratureData &qdata,
                                  ParFiniteElementSpace &h1,
                                  ParFiniteElementSpace &l2,
-                                 const IntegrationRule &ir) :
+                                 const IntegrationRule &ir,
+                                 const bool structured) :
    Operator(),
    dim(h1.GetMesh()->Dimension()),
    NE(h1.GetMesh()->GetNE()),
@@ -132,6 +423,7 @@ ForcePAOperator::ForcePAOperator(const QuadratureData &qdata,
    L2(l2),
    H1R(H1.GetElementRestriction(ElementDofOrdering::LEXICOGRAPHIC)),
    L2R(L2.GetElementRestriction(ElementDofOrdering::LEXICOGRAPHIC)),
+   h1_gather(h1, structured),
    ir1D(IntRules.Get(Geometry::SEGMENT, ir.GetOrder())),
    D1D(H1.GetFE(0)->GetOrder()+1),
    Q1D(ir1D.GetNPoints()),
@@ -140,15 +432,22 @@ ForcePAOperator::ForcePAOperator(const QuadratureData &qdata,
    L2sz(L2.GetFE(0)->GetDof() * NE),
    L2D2Q(&L2.GetFE(0)->GetDofToQuad(ir, DofToQuad::TENSOR)),
    H1D2Q(&H1.GetFE(0)->GetDofToQuad(ir, DofToQuad::TENSOR)),
-   X(L2sz), Y(H1sz) { }
+   cb_mult(ConstBasisTables() &&
+           ConstBasisMatches(D1D, Q1D, L1D, L2D2Q->B, H1D2Q->Bt, H1D2Q->Gt,
+                             true)),
+   cb_transpose(ConstBasisTables() &&
+                ConstBasisMatches(D1D, Q1D, L1D, L2D2Q->Bt, H1D2Q->B,
+                                  H1D2Q->G, false)),
+   X(L2sz), Y(H1sz), capture(nullptr) { }
 
-template<int DIM, int D1D, int Q1D, int L1D, int NBZ = 1> static
-void ForceMult2D(const int NE,
-                 const Array<double> &B_,
-                 const Array<double> &Bt_,
-                 const Array<double> &Gt_,
-                 const DenseTensor &sJit_,
-                 const Vector &x, Vector &y)
+template<int DIM, int D1D, int Q1D, int L1D, int NBZ = 1, bool CB = false>
+static void ForceMult2D(const int NE,
+                        const Array<double> &B_,
+                        const Array<double> &Bt_,
+                        const Array<double> &Gt_,
+                        const DenseTensor &sJit_,
+                        const Vector &, const Vector &,
+                        const Vector &x, Vector &y)
 {
    auto b = Reshape(B_.Read(), Q1D, L1D);
    auto bt = Reshape(Bt_.Read(), D1D, Q1D);
@@ -164,9 +463,14 @@ void ForceMult2D(const int NE,
    {
       const int z = MFEM_THREAD_ID(z);
 
-      MFEM_SHARED double B[Q1D][L1D];
-      MFEM_SHARED double Bt[D1D][Q1D];
-      MFEM_SHARED double Gt[D1D][Q1D];
+      MFEM_SHARED double sB[Q1D][L1D];
+      MFEM_SHARED double sBt[D1D][Q1D];
+      MFEM_SHARED double sGt[D1D][Q1D];
+      // With CB, the compile-time tables replace the loaded ones.
+      constexpr ConstBasis<D1D, Q1D, L1D> cb;
+      const double (*B)[L1D] = CB ? cb.L2B : sB;
+      const double (*Bt)[Q1D] = CB ? cb.H1Bt : sBt;
+      const double (*Gt)[Q1D] = CB ? cb.H1Gt : sGt;
 
       MFEM_SHARED double Ez[NBZ][L1D][L1D];
       double (*E)[L1D] = (double (*)[L1D])(Ez + z);
@@ -180,15 +484,15 @@ void ForceMult2D(const int NE,
       double (*QQ0)[Q1D] = (double (*)[Q1D])(QQz[1] + z);
       double (*QQ1)[Q1D] = (double (*)[Q1D])(QQz[2] + z);
 
-      if (z == 0)
+      if (!CB && z == 0)
       {
          MFEM_FOREACH_THREAD(q,x,Q1D)
          {
             MFEM_FOREACH_THREAD(l,y,Q1D)
             {
-               if (l < L1D) { B[q][l] = b(q,l); }
-               if (l < D1D) { Bt[l][q] = bt(l,q); }
-               if (l < D1D) { Gt[l][q] = gt(l,q); }
+               if (l < L1D) { sB[q][l] = b(q,l); }
+               if (l < D1D) { sBt[l][q] = bt(l,q); }
+               if (l < D1D) { sGt[l][q] = gt(l,q); }
             }
          }
       }
@@ -293,19 +597,166 @@ void ForceMult2D(const int NE,
    });
 }
 
-template<int DIM, int D1D, int Q1D, int L1D> static
+// Products of the compact quadrature data S (w sigma, see QuadratureData) of
+// zone e with the cofactor matrix of the Jacobian J = dx/dxi, interpolated
+// from the position E-vector X. Since cof(J) = det(J) J^{-T}, P[g + 3*c][q]
+// is then the entry (c, g) of stressJinvT at the point q = qx+Q1D*(qy+Q1D*qz).
+// The H1 basis and gradient at (q, d) are B[q*bq + d*bd] and G[q*bq + d*bd].
+// The 3+3 blocks of sm0 and sm1 are used as scratch.
+template<int D1D, int Q1D> MFEM_HOST_DEVICE static inline
+void CompactStressJinvT3D(const int e, const int NE,
+                          const double *B, const double *G,
+                          const int bq, const int bd,
+                          const double *X, const double *S,
+                          double (*sm0)[Q1D*Q1D*Q1D],
+                          double (*sm1)[Q1D*Q1D*Q1D],
+                          double (*P)[Q1D*Q1D*Q1D])
+{
+   constexpr int NQ = Q1D*Q1D*Q1D;
+   double (*XX)[D1D][D1D]   = (double (*)[D1D][D1D]) (sm0+0);
+   double (*DDQ0)[D1D][Q1D] = (double (*)[D1D][Q1D]) (sm0+1);
+   double (*DDQ1)[D1D][Q1D] = (double (*)[D1D][Q1D]) (sm0+2);
+   double (*DQQ0)[Q1D][Q1D] = (double (*)[Q1D][Q1D]) (sm1+0);
+   double (*DQQ1)[Q1D][Q1D] = (double (*)[Q1D][Q1D]) (sm1+1);
+   double (*DQQ2)[Q1D][Q1D] = (double (*)[Q1D][Q1D]) (sm1+2);
+   // Column i of the Jacobian, J(i,j) in P[i + 3*j].
+   for (int i = 0; i < 3; ++i)
+   {
+      MFEM_FOREACH_THREAD(dz,z,D1D)
+      {
+         MFEM_FOREACH_THREAD(dy,y,D1D)
+         {
+            MFEM_FOREACH_THREAD(dx,x,D1D)
+            {
+               XX[dz][dy][dx] = X[dx + D1D*(dy + D1D*(dz + D1D*(i + 3*e)))];
+            }
+         }
+      }
+      MFEM_SYNC_THREAD;
+      MFEM_FOREACH_THREAD(dz,z,D1D)
+      {
+         MFEM_FOREACH_THREAD(dy,y,D1D)
+         {
+            MFEM_FOREACH_THREAD(qx,x,Q1D)
+            {
+               double u = 0.0;
+               double v = 0.0;
+               for (int dx = 0; dx < D1D; ++dx)
+               {
+                  const double input = XX[dz][dy][dx];
+                  u += B[qx*bq + dx*bd] * input;
+                  v += G[qx*bq + dx*bd] * input;
+               }
+               DDQ0[dz][dy][qx] = u;
+               DDQ1[dz][dy][qx] = v;
+            }
+         }
+      }
+      MFEM_SYNC_THREAD;
+      MFEM_FOREACH_THREAD(dz,z,D1D)
+      {
+         MFEM_FOREACH_THREAD(qy,y,Q1D)
+         {
+            MFEM_FOREACH_THREAD(qx,x,Q1D)
+            {
+               double u = 0.0;
+               double v = 0.0;
+               double w = 0.0;
+               for (int dy = 0; dy < D1D; ++dy)
+               {
+                  u += B[qy*bq + dy*bd] * DDQ0[dz][dy][qx];
+                  v += B[qy*bq + dy*bd] * DDQ1[dz][dy][qx];
+                  w += G[qy*bq + dy*bd] * DDQ0[dz][dy][qx];
+               }
+               DQQ0[dz][qy][qx] = u;
+               DQQ1[dz][qy][qx] = v;
+               DQQ2[dz][qy][qx] = w;
+            }
+         }
+      }
+      MFEM_SYNC_THREAD;
+      MFEM_FOREACH_THREAD(qz,z,Q1D)
+      {
+         MFEM_FOREACH_THREAD(qy,y,Q1D)
+         {
+            MFEM_FOREACH_THREAD(qx,x,Q1D)
+            {
+               double u = 0.0;
+               double v = 0.0;
+               double w = 0.0;
+               for (int dz = 0; dz < D1D; ++dz)
+               {
+                  u += B[qz*bq + dz*bd] * DQQ1[dz][qy][qx];
+                  v += B[qz*bq + dz*bd] * DQQ2[dz][qy][qx];
+                  w += G[qz*bq + dz*bd] * DQQ0[dz][qy][qx];
+               }
+               const int q = qx + Q1D*(qy + Q1D*qz);
+               P[i + 0][q] = u;
+               P[i + 3][q] = v;
+               P[i + 6][q] = w;
+            }
+         }
+      }
+      MFEM_SYNC_THREAD;
+   }
+   MFEM_FOREACH_THREAD(qz,z,Q1D)
+   {
+      MFEM_FOREACH_THREAD(qy,y,Q1D)
+      {
+         MFEM_FOREACH_THREAD(qx,x,Q1D)
+         {
+            const int q = qx + Q1D*(qy + Q1D*qz);
+            double J[3][3], cof[3][3], s[6];
+            for (int k = 0; k < 9; k++) { J[k%3][k/3] = P[k][q]; }
+            for (int k = 0; k < 6; k++) { s[k] = S[e*NQ + q + NQ*NE*k]; }
+            const double sig[3][3] = { { s[0], s[5], s[4] },
+               { s[5], s[1], s[3] },
+               { s[4], s[3], s[2] }
+            };
+            cof[0][0] = J[1][1]*J[2][2] - J[1][2]*J[2][1];
+            cof[0][1] = J[1][2]*J[2][0] - J[1][0]*J[2][2];
+            cof[0][2] = J[1][0]*J[2][1] - J[1][1]*J[2][0];
+            cof[1][0] = J[0][2]*J[2][1] - J[0][1]*J[2][2];
+            cof[1][1] = J[0][0]*J[2][2] - J[0][2]*J[2][0];
+            cof[1][2] = J[0][1]*J[2][0] - J[0][0]*J[2][1];
+            cof[2][0] = J[0][1]*J[1][2] - J[0][2]*J[1][1];
+            cof[2][1] = J[0][2]*J[1][0] - J[0][0]*J[1][2];
+            cof[2][2] = J[0][0]*J[1][1] - J[0][1]*J[1][0];
+            for (int c = 0; c < 3; c++)
+            {
+               for (int g = 0; g < 3; g++)
+               {
+                  P[g + 3*c][q] = sig[c][0] * cof[0][g] +
+                                  sig[c][1] * cof[1][g] +
+                                  sig[c][2] * cof[2][g];
+               }
+            }
+         }
+      }
+   }
+   MFEM_SYNC_THREAD;
+}
+
+// With CS, the products of the quadrature data are computed from the compact
+// stress S_ and the positions X_, see CompactStressJinvT3D().
+template<int DIM, int D1D, int Q1D, int L1D, bool CB = false,
+         bool CS = false> static
 void ForceMult3D(const int NE,
                  const Array<double> &B_,
                  const Array<double> &Bt_,
                  const Array<double> &Gt_,
                  const DenseTensor &sJit_,
+                 const Vector &S_, const Vector &X_,
                  const Vector &x, Vector &y)
 {
    auto b = Reshape(B_.Read(), Q1D, L1D);
    auto bt = Reshape(Bt_.Read(), D1D, Q1D);
    auto gt = Reshape(Gt_.Read(), D1D, Q1D);
-   const double *StressJinvT = Read(sJit_.GetMemory(), Q1D*Q1D*Q1D*NE*DIM*DIM);
+   const double *StressJinvT =
+      CS ? nullptr : Read(sJit_.GetMemory(), Q1D*Q1D*Q1D*NE*DIM*DIM);
    auto sJit = Reshape(StressJinvT, Q1D, Q1D, Q1D, NE, DIM, DIM);
+   const double *S = CS ? S_.Read() : nullptr;
+   const double *X = CS ? X_.Read() : nullptr;
    auto energy = Reshape(x.Read(), L1D, L1D, L1D, NE);
    const double eps1 = std::numeric_limits<double>::epsilon();
    const double eps2 = eps1*eps1;
@@ -315,9 +766,14 @@ void ForceMult3D(const int NE,
    {
       const int z = MFEM_THREAD_ID(z);
 
-      MFEM_SHARED double B[Q1D][L1D];
-      MFEM_SHARED double Bt[D1D][Q1D];
-      MFEM_SHARED double Gt[D1D][Q1D];
+      MFEM_SHARED double sB[Q1D][L1D];
+      MFEM_SHARED double sBt[D1D][Q1D];
+      MFEM_SHARED double sGt[D1D][Q1D];
+      // With CB, the compile-time tables replace the loaded ones.
+      constexpr ConstBasis<D1D, Q1D, L1D> cb;
+      const double (*B)[L1D] = CB ? cb.L2B : sB;
+      const double (*Bt)[Q1D] = CB ? cb.H1Bt : sBt;
+      const double (*Gt)[Q1D] = CB ? cb.H1Gt : sGt;
 
       MFEM_SHARED double E[L1D][L1D][L1D];
 
@@ -337,19 +793,27 @@ void ForceMult3D(const int NE,
       double (*QQQ1)[Q1D][Q1D] = (double (*)[Q1D][Q1D]) (sm0+1);
       double (*QQQ2)[Q1D][Q1D] = (double (*)[Q1D][Q1D]) (sm0+2);
 
-      if (z == 0)
+      MFEM_SHARED double sP[CS ? 9 : 1][CS ? Q1D*Q1D*Q1D : 1];
+
+      if (!CB && z == 0)
       {
          MFEM_FOREACH_THREAD(q,x,Q1D)
          {
             MFEM_FOREACH_THREAD(l,y,Q1D)
             {
-               if (l < L1D) { B[q][l] = b(q,l); }
-               if (l < D1D) { Bt[l][q] = bt(l,q); }
-               if (l < D1D) { Gt[l][q] = gt(l,q); }
+               if (l < L1D) { sB[q][l] = b(q,l); }
+               if (l < D1D) { sBt[l][q] = bt(l,q); }
+               if (l < D1D) { sGt[l][q] = gt(l,q); }
             }
          }
       }
       MFEM_SYNC_THREAD;
+      if (CS)
+      {
+         CompactStressJinvT3D<D1D,Q1D>(e, NE, &Bt[0][0], &Gt[0][0], 1, Q1D,
+                                       X, S, sm0, sm1,
+                                       (double (*)[Q1D*Q1D*Q1D]) sP);
+      }
       MFEM_FOREACH_THREAD(lx,x,L1D)
       {
          MFEM_FOREACH_THREAD(ly,y,L1D)
@@ -417,9 +881,13 @@ void ForceMult3D(const int NE,
             {
                MFEM_FOREACH_THREAD(qx,x,Q1D)
                {
-                  const double esx = QQQ[qz][qy][qx] * sJit(qx,qy,qz,e,0,c);
-                  const double esy = QQQ[qz][qy][qx] * sJit(qx,qy,qz,e,1,c);
-                  const double esz = QQQ[qz][qy][qx] * sJit(qx,qy,qz,e,2,c);
+                  const int q = qx + Q1D*(qy + Q1D*qz);
+                  const double sx = CS ? sP[3*c+0][q] : sJit(qx,qy,qz,e,0,c);
+                  const double sy = CS ? sP[3*c+1][q] : sJit(qx,qy,qz,e,1,c);
+                  const double sz = CS ? sP[3*c+2][q] : sJit(qx,qy,qz,e,2,c);
+                  const double esx = QQQ[qz][qy][qx] * sx;
+                  const double esy = QQQ[qz][qy][qx] * sy;
+                  const double esz = QQQ[qz][qy][qx] * sz;
                   QQQ0[qz][qy][qx] = esx;
                   QQQ1[qz][qy][qx] = esy;
                   QQQ2[qz][qy][qx] = esz;
@@ -518,20 +986,26 @@ typedef void (*fForceMult)(const int E,
                            const Array<double> &Bt,
                            const Array<double> &Gt,
                            const DenseTensor &stressJinvT,
+                           const Vector &S, const Vector &P,
                            const Vector &X, Vector &Y);
 
-static void ForceMult(const int DIM, const int D1D, const int Q1D,
-                      const int L1D, const int H1D, const int NE,
-                      const Array<double> &B,
-                      const Array<double> &Bt,
-                      const Array<double> &Gt,
-                      const DenseTensor &stressJinvT,
-                      const Vector &e,
-                      Vector &v)
+void ForceMult(const int DIM, const int D1D, const int Q1D,
+               const int L1D, const int H1D, const int NE,
+               const Array<double> &B,
+               const Array<double> &Bt,
+               const Array<double> &Gt,
+               const DenseTensor &stressJinvT,
+               const Vector &e,
+               Vector &v,
+               const Vector *stress,
+               const Vector *positions,
+               const bool cb)
 {
    MFEM_VERIFY(D1D==H1D, "D1D!=H1D");
    MFEM_VERIFY(L1D==D1D-1,"L1D!=D1D-1");
-   const int id = ((DIM)<<8)|(D1D)<<4|(Q1D);
+   const bool cs = stress != nullptr;
+   MFEM_VERIFY(!cs || positions, "Missing positions of the compact stress!");
+   const int id = (cs<<13)|(cb<<12)|((DIM)<<8)|(D1D)<<4|(Q1D);
    static std::unordered_map<int, fForceMult> call =
    {
       // 2D
@@ -542,32 +1016,54 @@ static void ForceMult(const int DIM, const int D1D, const int Q1D,
       {0x334,&ForceMult3D<3,3,4,2>},
       {0x346,&ForceMult3D<3,4,6,3>},
       {0x358,&ForceMult3D<3,5,8,4>},
+      // Compile-time basis tables
+      {0x1234,&ForceMult2D<2,3,4,2,1,true>},
+      {0x1246,&ForceMult2D<2,4,6,3,1,true>},
+      {0x1258,&ForceMult2D<2,5,8,4,1,true>},
+      {0x1334,&ForceMult3D<3,3,4,2,true>},
+      {0x1346,&ForceMult3D<3,4,6,3,true>},
+      {0x1358,&ForceMult3D<3,5,8,4,true>},
+      // Compact stress (3D, the products take 9 Q1D^3 more shared values)
+      {0x2334,&ForceMult3D<3,3,4,2,false,true>},
+      {0x2346,&ForceMult3D<3,4,6,3,false,true>},
+      {0x3334,&ForceMult3D<3,3,4,2,true,true>},
+      {0x3346,&ForceMult3D<3,4,6,3,true,true>},
    };
    if (!call[id])
    {
       mfem::out << "Unknown kernel 0x" << std::hex << id << std::endl;
       MFEM_ABORT("Unknown kernel");
    }
-   call[id](NE, B, Bt, Gt, stressJinvT, e, v);
+   const Vector none;
+   call[id](NE, B, Bt, Gt, stressJinvT, cs ? *stress : none,
+            cs ? *positions : none, e, v);
 }
 
 void ForcePAOperator::Mult(const Vector &x, Vector &y) const
 {
    if (L2R) { L2R->Mult(x, X); }
    else { X = x; }
+   const Vector *stress = qdata.compact_stress ? &qdata.stress : nullptr;
    ForceMult(dim, D1D, Q1D, L1D, D1D, NE,
              L2D2Q->B, H1D2Q->Bt, H1D2Q->Gt,
-             qdata.stressJinvT, X, Y);
+             qdata.stressJinvT, X, Y, stress, qdata.positions, cb_mult);
+   if (capture)
+   {
+      capture->Record(KernelCapture::FORCE_MULT, {dim, D1D, Q1D, L1D, NE}, {},
+                      {L2D2Q->B, H1D2Q->Bt, H1D2Q->Gt, qdata.stressJinvT,
+                       X, Y});
+   }
    H1R->MultTranspose(Y, y);
 }
 
-template<int DIM, int D1D, int Q1D, int L1D, int NBZ = 1> static
-void ForceMultTranspose2D(const int NE,
-                          const Array<double> &Bt_,
-                          const Array<double> &B_,
-                          const Array<double> &G_,
-                          const DenseTensor &sJit_,
-                          const Vector &x, Vector &y)
+template<int DIM, int D1D, int Q1D, int L1D, int NBZ = 1, bool CB = false>
+static void ForceMultTranspose2D(const int NE,
+                                 const Array<double> &Bt_,
+                                 const Array<double> &B_,
+                                 const Array<double> &G_,
+                                 const DenseTensor &sJit_,
+                                 const Vector &, const Vector &,
+                                 const Vector &x, Vector &y)
 {
    auto b = Reshape(B_.Read(), Q1D, D1D);
    auto g = Reshape(G_.Read(), Q1D, D1D);
@@ -581,9 +1077,14 @@ void ForceMultTranspose2D(const int NE,
    {
       const int z = MFEM_THREAD_ID(z);
 
-      MFEM_SHARED double Bt[L1D][Q1D];
-      MFEM_SHARED double B[Q1D][D1D];
-      MFEM_SHARED double G[Q1D][D1D];
+      MFEM_SHARED double sBt[L1D][Q1D];
+      MFEM_SHARED double sB[Q1D][D1D];
+      MFEM_SHARED double sG[Q1D][D1D];
+      // With CB, the compile-time tables replace the loaded ones.
+      constexpr ConstBasis<D1D, Q1D, L1D> cb;
+      const double (*Bt)[Q1D] = CB ? cb.L2Bt : sBt;
+      const double (*B)[D1D] = CB ? cb.H1B : sB;
+      const double (*G)[D1D] = CB ? cb.H1G : sG;
 
       MFEM_SHARED double Vz[NBZ][D1D*D1D];
       double (*V)[D1D] = (double (*)[D1D])(Vz + z);
@@ -600,16 +1101,16 @@ void ForceMultTranspose2D(const int NE,
       MFEM_SHARED double QLz[NBZ][Q1D*L1D];
       double (*QL)[L1D] = (double (*)[L1D]) (QLz + z);
 
-      if (z == 0)
+      if (!CB && z == 0)
       {
          MFEM_FOREACH_THREAD(q,x,Q1D)
          {
             MFEM_FOREACH_THREAD(h,y,Q1D)
             {
-               if (h < D1D) { B[q][h] = b(q,h); }
-               if (h < D1D) { G[q][h] = g(q,h); }
+               if (h < D1D) { sB[q][h] = b(q,h); }
+               if (h < D1D) { sG[q][h] = g(q,h); }
                const int l = h;
-               if (l < L1D) { Bt[l][q] = bt(l,q); }
+               if (l < L1D) { sBt[l][q] = bt(l,q); }
             }
          }
       }
@@ -709,20 +1210,25 @@ void ForceMultTranspose2D(const int NE,
    });
 }
 
-template<int DIM, int D1D, int Q1D, int L1D> static
+template<int DIM, int D1D, int Q1D, int L1D, bool CB = false,
+         bool CS = false> static
 void ForceMultTranspose3D(const int NE,
                           const Array<double> &Bt_,
                           const Array<double> &B_,
                           const Array<double> &G_,
                           const DenseTensor &sJit_,
+                          const Vector &S_, const Vector &X_,
                           const Vector &v_,
                           Vector &e_)
 {
    auto b = Reshape(B_.Read(), Q1D, D1D);
    auto g = Reshape(G_.Read(), Q1D, D1D);
    auto bt = Reshape(Bt_.Read(), L1D, Q1D);
-   const double *StressJinvT = Read(sJit_.GetMemory(), Q1D*Q1D*Q1D*NE*DIM*DIM);
+   const double *StressJinvT =
+      CS ? nullptr : Read(sJit_.GetMemory(), Q1D*Q1D*Q1D*NE*DIM*DIM);
    auto sJit = Reshape(StressJinvT, Q1D, Q1D, Q1D, NE, DIM, DIM);
+   const double *S = CS ? S_.Read() : nullptr;
+   const double *X = CS ? X_.Read() : nullptr;
    auto velocity = Reshape(v_.Read(), D1D, D1D, D1D, DIM, NE);
    auto energy = Reshape(e_.Write(), L1D, L1D, L1D, NE);
 
@@ -730,9 +1236,14 @@ void ForceMultTranspose3D(const int NE,
    {
       const int z = MFEM_THREAD_ID(z);
 
-      MFEM_SHARED double Bt[L1D][Q1D];
-      MFEM_SHARED double B[Q1D][D1D];
-      MFEM_SHARED double G[Q1D][D1D];
+      MFEM_SHARED double sBt[L1D][Q1D];
+      MFEM_SHARED double sB[Q1D][D1D];
+      MFEM_SHARED double sG[Q1D][D1D];
+      // With CB, the compile-time tables replace the loaded ones.
+      constexpr ConstBasis<D1D, Q1D, L1D> cb;
+      const double (*Bt)[Q1D] = CB ? cb.L2Bt : sBt;
+      const double (*B)[D1D] = CB ? cb.H1B : sB;
+      const double (*G)[D1D] = CB ? cb.H1G : sG;
 
       MFEM_SHARED double sm0[3][Q1D*Q1D*Q1D];
       MFEM_SHARED double sm1[3][Q1D*Q1D*Q1D];
@@ -750,20 +1261,28 @@ void ForceMultTranspose3D(const int NE,
 
       MFEM_SHARED double QQQ[Q1D][Q1D][Q1D];
 
-      if (z == 0)
+      MFEM_SHARED double sP[CS ? 9 : 1][CS ? Q1D*Q1D*Q1D : 1];
+
+      if (!CB && z == 0)
       {
          MFEM_FOREACH_THREAD(q,x,Q1D)
          {
             MFEM_FOREACH_THREAD(h,y,Q1D)
             {
-               if (h < D1D) { B[q][h] = b(q,h); }
-               if (h < D1D) { G[q][h] = g(q,h); }
+               if (h < D1D) { sB[q][h] = b(q,h); }
+               if (h < D1D) { sG[q][h] = g(q,h); }
                const int l = h;
-               if (l < L1D) { Bt[l][q] = bt(l,q); }
+               if (l < L1D) { sBt[l][q] = bt(l,q); }
             }
          }
       }
       MFEM_SYNC_THREAD;
+      if (CS)
+      {
+         CompactStressJinvT3D<D1D,Q1D>(e, NE, &B[0][0], &G[0][0], D1D, 1,
+                                       X, S, sm0, sm1,
+                                       (double (*)[Q1D*Q1D*Q1D]) sP);
+      }
       MFEM_FOREACH_THREAD(qz,z,Q1D)
       {
          MFEM_FOREACH_THREAD(qy,y,Q1D)
@@ -859,9 +1378,13 @@ void ForceMultTranspose3D(const int NE,
             {
                MFEM_FOREACH_THREAD(qx,x,Q1D)
                {
-                  const double esx = QQQ0[qz][qy][qx] * sJit(qx,qy,qz,e,0,c);
-                  const double esy = QQQ1[qz][qy][qx] * sJit(qx,qy,qz,e,1,c);
-                  const double esz = QQQ2[qz][qy][qx] * sJit(qx,qy,qz,e,2,c);
+                  const int q = qx + Q1D*(qy + Q1D*qz);
+                  const double sx = CS ? sP[3*c+0][q] : sJit(qx,qy,qz,e,0,c);
+                  const double sy = CS ? sP[3*c+1][q] : sJit(qx,qy,qz,e,1,c);
+                  const double sz = CS ? sP[3*c+2][q] : sJit(qx,qy,qz,e,2,c);
+                  const double esx = QQQ0[qz][qy][qx] * sx;
+                  const double esy = QQQ1[qz][qy][qx] * sy;
+                  const double esz = QQQ2[qz][qy][qx] * sz;
                   QQQ[qz][qy][qx] += esx + esy + esz;
                }
             }
@@ -925,20 +1448,26 @@ typedef void (*fForceMultTranspose)(const int NE,
                                     const Array<double> &B,
                                     const Array<double> &G,
                                     const DenseTensor &sJit,
+                                    const Vector &S, const Vector &P,
                                     const Vector &X, Vector &Y);
 
-static void ForceMultTranspose(const int DIM, const int D1D, const int Q1D,
-                               const int L1D, const int NE,
-                               const Array<double> &L2Bt,
-                               const Array<double> &H1B,
-                               const Array<double> &H1G,
-                               const DenseTensor &stressJinvT,
-                               const Vector &v,
-                               Vector &e)
+void ForceMultTranspose(const int DIM, const int D1D, const int Q1D,
+                        const int L1D, const int NE,
+                        const Array<double> &L2Bt,
+                        const Array<double> &H1B,
+                        const Array<double> &H1G,
+                        const DenseTensor &stressJinvT,
+                        const Vector &v,
+                        Vector &e,
+                        const Vector *stress,
+                        const Vector *positions,
+                        const bool cb)
 {
    // DIM, D1D, Q1D, L1D(=D1D-1)
    MFEM_VERIFY(L1D==D1D-1, "L1D!=D1D-1");
-   const int id = ((DIM)<<8)|(D1D)<<4|(Q1D);
+   const bool cs = stress != nullptr;
+   MFEM_VERIFY(!cs || positions, "Missing positions of the compact stress!");
+   const int id = (cs<<13)|(cb<<12)|((DIM)<<8)|(D1D)<<4|(Q1D);
    static std::unordered_map<int, fForceMultTranspose> call =
    {
       {0x234,&ForceMultTranspose2D<2,3,4,2>},
@@ -946,26 +1475,202 @@ static void ForceMultTranspose(const int DIM, const int D1D, const int Q1D,
       {0x258,&ForceMultTranspose2D<2,5,8,4>},
       {0x334,&ForceMultTranspose3D<3,3,4,2>},
       {0x346,&ForceMultTranspose3D<3,4,6,3>},
-      {0x358,&ForceMultTranspose3D<3,5,8,4>}
+      {0x358,&ForceMultTranspose3D<3,5,8,4>},
+      // Compile-time basis tables
+      {0x1234,&ForceMultTranspose2D<2,3,4,2,1,true>},
+      {0x1246,&ForceMultTranspose2D<2,4,6,3,1,true>},
+      {0x1258,&ForceMultTranspose2D<2,5,8,4,1,true>},
+      {0x1334,&ForceMultTranspose3D<3,3,4,2,true>},
+      {0x1346,&ForceMultTranspose3D<3,4,6,3,true>},
+      {0x1358,&ForceMultTranspose3D<3,5,8,4,true>},
+      // Compact stress (3D, the products take 9 Q1D^3 more shared values)
+      {0x2334,&ForceMultTranspose3D<3,3,4,2,false,true>},
+      {0x2346,&ForceMultTranspose3D<3,4,6,3,false,true>},
+      {0x3334,&ForceMultTranspose3D<3,3,4,2,true,true>},
+      {0x3346,&ForceMultTranspose3D<3,4,6,3,true,true>}
    };
    if (!call[id])
    {
       mfem::out << "Unknown kernel 0x" << std::hex << id << std::endl;
       MFEM_ABORT("Unknown kernel");
    }
-   call[id](NE, L2Bt, H1B, H1G, stressJinvT, v, e);
+   const Vector none;
+   call[id](NE, L2Bt, H1B, H1G, stressJinvT, cs ? *stress : none,
+            cs ? *positions : none, v, e);
 }
 
 void ForcePAOperator::MultTranspose(const Vector &x, Vector &y) const
 {
-   H1R->Mult(x, Y);
+   h1_gather.Mult(x, Y);
+   MultTransposeE(Y, y);
+}
+
+void ForcePAOperator::MultTransposeE(const Vector &V, Vector &y) const
+{
+   const Vector *stress = qdata.compact_stress ? &qdata.stress : nullptr;
    ForceMultTranspose(dim, D1D, Q1D, L1D, NE,
                       L2D2Q->Bt, H1D2Q->B, H1D2Q->G,
-                      qdata.stressJinvT, Y, X);
+                      qdata.stressJinvT, V, X, stress, qdata.positions,
+                      cb_transpose);
+   if (capture)
+   {
+      capture->Record(KernelCapture::FORCE_MULT_TRANSPOSE,
+                      {dim, D1D, Q1D, L1D, NE}, {},
+                      {L2D2Q->Bt, H1D2Q->B, H1D2Q->G, qdata.stressJinvT, V, X});
+   }
    if (L2R) { L2R->MultTranspose(X, y); }
    else { y = X; }
 }
 
+// Upper bound for the slice height, i.e. the number of row accumulators.
+static constexpr int SELL_MAX_C = 64;
+
+void SellMatrix::Slices::Setup(const int C, const int sigma, const int nrows,
+                               const int *I, const int *J, const int *pos)
+{
+   rows = nrows;
+   nslices = (rows + C - 1) / C;
+   // Sort the rows by decreasing length inside each window of sigma rows.
+   Array<int> order(rows);
+   for (int r = 0; r < rows; r++) { order[r] = r; }
+   for (int w = 0; w < rows; w += sigma)
+   {
+      std::stable_sort(order.GetData() + w,
+                       order.GetData() + std::min(w + sigma, rows),
+                       [&](const int a, const int b)
+      { return I[a+1] - I[a] > I[b+1] - I[b]; });
+   }
+   perm.SetSize(nslices * C);
+   perm = -1;
+   for (int r = 0; r < rows; r++) { perm[r] = order[r]; }
+   offsets.SetSize(nslices + 1);
+   widths.SetSize(nslices);
+   offsets[0] = 0;
+   for (int s = 0; s < nslices; s++)
+   {
+      int width = 0;
+      for (int i = 0; i < C; i++)
+      {
+         const int r = perm[s*C + i];
+         if (r >= 0) { width = std::max(width, I[r+1] - I[r]); }
+      }
+      widths[s] = width;
+      offsets[s+1] = offsets[s] + width * C;
+   }
+   const int size = offsets[nslices];
+   col.SetSize(size);
+   src.SetSize(size);
+   val.SetSize(size);
+   for (int s = 0; s < nslices; s++)
+   {
+      for (int i = 0; i < C; i++)
+      {
+         const int r = perm[s*C + i];
+         const int len = (r >= 0) ? I[r+1] - I[r] : 0;
+         for (int j = 0; j < widths[s]; j++)
+         {
+            const int k = offsets[s] + j*C + i;
+            // Padding entries use a valid column and a zero value.
+            if (j < len)
+            {
+               col[k] = J[I[r] + j];
+               src[k] = pos ? pos[I[r] + j] : I[r] + j;
+            }
+            else { col[k] = 0; src[k] = -1; }
+         }
+      }
+   }
+}
+
+void SellMatrix::Slices::Update(const double *data)
+{
+   const int size = val.Size();
+   const int *s = src.HostRead();
+   double *v = val.HostWrite();
+#ifdef MFEM_USE_OPENMP
+   #pragma omp parallel for
+#endif
+   for (int k = 0; k < size; k++) { v[k] = (s[k] >= 0) ? data[s[k]] : 0.0; }
+}
+
+void SellMatrix::Slices::Mult(const int C, const double *x, double *y) const
+{
+   const int *p = perm.HostRead();
+   const int *o = offsets.HostRead();
+   const int *w = widths.HostRead();
+   const int *c = col.HostRead();
+   const double *v = val.HostRead();
+#ifdef MFEM_USE_OPENMP
+   #pragma omp parallel for schedule(static)
+#endif
+   for (int s = 0; s < nslices; s++)
+   {
+      double sum[SELL_MAX_C];
+      for (int i = 0; i < C; i++) { sum[i] = 0.0; }
+      for (int j = 0; j < w[s]; j++)
+      {
+         const int k = o[s] + j*C;
+#ifdef MFEM_USE_OPENMP
+         #pragma omp simd
+#endif
+         for (int i = 0; i < C; i++) { sum[i] += v[k+i] * x[c[k+i]]; }
+      }
+      for (int i = 0; i < C; i++)
+      {
+         const int r = p[s*C + i];
+         if (r >= 0) { y[r] = sum[i]; }
+      }
+   }
+}
+
+SellMatrix::SellMatrix(const SparseMatrix &M, const int C, const int sigma) :
+   Operator(M.Height(), M.Width()),
+   C(C), sigma(sigma), nnz(M.NumNonZeroElems())
+{
+   MFEM_VERIFY(M.Finalized(), "SellMatrix expects a finalized CSR matrix!");
+   MFEM_VERIFY(C > 0 && C <= SELL_MAX_C, "Unsupported slice height " << C);
+   MFEM_VERIFY(sigma >= C && sigma % C == 0,
+               "The sorting window must be a multiple of the slice height!");
+   const int *I = M.GetI(), *J = M.GetJ();
+   A.Setup(C, sigma, height, I, J, nullptr);
+   // Transposed CSR structure, which keeps the positions of the entries in
+   // the data array of M.
+   Array<int> It(width + 1), Jt(nnz), pos(nnz), next(width);
+   It = 0;
+   for (int k = 0; k < nnz; k++) { It[J[k] + 1]++; }
+   for (int j = 0; j < width; j++) { It[j+1] += It[j]; }
+   for (int j = 0; j < width; j++) { next[j] = It[j]; }
+   for (int i = 0; i < height; i++)
+   {
+      for (int k = I[i]; k < I[i+1]; k++)
+      {
+         const int t = next[J[k]]++;
+         Jt[t] = i;
+         pos[t] = k;
+      }
+   }
+   At.Setup(C, sigma, width, It.GetData(), Jt.GetData(), pos.GetData());
+   UpdateValues(M);
+}
+
+void SellMatrix::UpdateValues(const SparseMatrix &M)
+{
+   MFEM_VERIFY(M.NumNonZeroElems() == nnz, "The sparsity pattern has changed!");
+   const double *data = M.GetData();
+   A.Update(data);
+   At.Update(data);
+}
+
+void SellMatrix::Mult(const Vector &x, Vector &y) const
+{
+   A.Mult(C, x.HostRead(), y.HostWrite());
+}
+
+void SellMatrix::MultTranspose(const Vector &x, Vector &y) const
+{
+   At.Mult(C, x.HostRead(), y.HostWrite());
+}
+
 } // namespace hydrodynamics
 
 } // namespace mfem
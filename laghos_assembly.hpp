@@ -18,8 +18,12 @@
 #define MFEM_LAGHOS_ASSEMBLY
 
 #include "mfem.hpp"
+#include "laghos_basis.hpp"
 #include "general/forall.hpp"
 #include "linalg/dtensor.hpp"
+#include "laghos_capture.hpp"
+#include "laghos_memory.hpp"
+#include <climits>
 
 namespace mfem
 {
@@ -30,9 +34,20 @@ namespace hydrodynamics
 // Container for all data needed at quadrature points.
 struct QuadratureData
 {
+   // Owns the tensors below, when they use the huge page allocation policy.
+   LargeArrays arrays;
+
    // Reference to physical Jacobian for the initial mesh.
-   // These are computed only at time zero and stored here.
+   // These are computed only at time zero and stored here. With shared_Jac0inv,
+   // the NQ matrices of each zone are those of its class jac0_class[z] in
+   // Jac0inv. In the structured mode, all the initial zones are translates of
+   // each other, and only the class of the first zone is stored. With the node
+   // shared geometry, the classes of congruent zones are in a table shared by
+   // the ranks of the compute node.
    DenseTensor Jac0inv;
+   const int NQ;
+   const bool shared_Jac0inv;
+   Array<int> jac0_class;
 
    // Quadrature data used for full/partial assembly of the force operator.
    // At each quadrature point, it combines the stress, inverse Jacobian,
@@ -40,6 +55,16 @@ struct QuadratureData
    // It must be recomputed in every time step.
    DenseTensor stressJinvT;
 
+   // Compact alternative to stressJinvT, used instead of it by the 3D partial
+   // assembly kernels: the symmetric stress times the integration weight,
+   // w sigma, with the components xx, yy, zz, yz, xz, xy (xx, yy, xy in 2D).
+   // The force kernels multiply it by the cofactor matrix det(J) J^{-T}, with
+   // J interpolated from the positions, the H1 E-vector of the last update.
+   // This reads 6 values per point instead of 9, plus the zone positions.
+   const bool compact_stress;
+   Vector stress;
+   const Vector *positions;
+
    // Quadrature data used for full/partial assembly of the mass matrices.
    // At time zero, we compute and store (rho0 * det(J0) * qp_weight) at each
    // quadrature point. Note the at any other time, we can compute
@@ -55,10 +80,61 @@ struct QuadratureData
    // recomputed at every time step to achieve adaptive time stepping.
    double dt_est;
 
-   QuadratureData(int dim, int NE, int quads_per_el)
-      : Jac0inv(dim, dim, NE * quads_per_el),
-        stressJinvT(NE * quads_per_el, dim, dim),
-        rho0DetJ0w(NE * quads_per_el) { }
+   QuadratureData(int dim, int NE, int quads_per_el, bool shared = false,
+                  bool compact = false)
+      : NQ(quads_per_el), shared_Jac0inv(shared), compact_stress(compact),
+        positions(nullptr)
+   {
+      // The MFEM arrays have int sizes.
+      MFEM_VERIFY((long long) NE * quads_per_el * dim * dim <= INT_MAX,
+                  "Too many quadrature points on this rank (" << NE << " x "
+                  << quads_per_el << "), use more ranks!");
+      arrays.Allocate(Jac0inv, dim, dim, (shared ? 1 : NE) * quads_per_el);
+      if (shared)
+      {
+         jac0_class.SetSize(NE);
+         jac0_class = 0;
+      }
+      if (compact)
+      {
+         arrays.Allocate(stress, NE * quads_per_el * dim * (dim + 1) / 2);
+      }
+      else { arrays.Allocate(stressJinvT, NE * quads_per_el, dim, dim); }
+      arrays.Allocate(rho0DetJ0w, NE * quads_per_el);
+   }
+
+   // Jac0inv at the quadrature point q of zone z.
+   DenseMatrix &Jac0invAt(int z, int q)
+   { return Jac0inv(Jac0invIndex(z, q)); }
+   const DenseMatrix &Jac0invAt(int z, int q) const
+   { return Jac0inv(Jac0invIndex(z, q)); }
+   // Data of Jac0invAt(z, q). Unlike the matrix returned by Jac0invAt, which
+   // is a view owned by the DenseTensor, it can be used by several threads.
+   const double *Jac0invData(int z, int q) const
+   { return Jac0inv.GetData(Jac0invIndex(z, q)); }
+   int Jac0invIndex(int z, int q) const
+   { return (shared_Jac0inv ? jac0_class[z] : z)*NQ + q; }
+};
+
+// Density coefficient of the mass matrices. It is the initial density until
+// UseQuadratureData() is called, and then the density given by the pointwise
+// mass conservation, rho = rho0DetJ0w / (det(J) w), e.g., after a remap of the
+// quadrature data. It must be evaluated at the points of the given rule.
+class MassCoefficient : public Coefficient
+{
+private:
+   Coefficient &rho0;
+   const QuadratureData &qdata;
+   const IntegrationRule &ir;
+   bool use_qdata;
+
+public:
+   MassCoefficient(Coefficient &rho0, const QuadratureData &qdata,
+                   const IntegrationRule &ir)
+      : rho0(rho0), qdata(qdata), ir(ir), use_qdata(false) { }
+
+   void UseQuadratureData() { use_qdata = true; }
+   virtual double Eval(ElementTransformation &T, const IntegrationPoint &ip);
 };
 
 // This class is used only for visualization. It assembles (rho, phi) in each
@@ -90,6 +166,51 @@ public:
                                        DenseMatrix &elmat);
 };
 
+// Gather of the lexicographic element dofs of H1 vector fields, i.e., the
+// action of the LEXICOGRAPHIC ElementRestriction of H1. The positions and the
+// velocities are adjacent blocks of the state vector, so MultXV() reads both
+// with the same indices and fills their E-vectors in a single pass. The
+// element-to-dof map is computed once. On structured partitions, the dofs of
+// consecutive elements (e.g. along a row of a Cartesian mesh) differ by fixed
+// strides, and the map is stored compressed as runs of elements, with one base
+// index and one stride per dof of each run. In the structured mode, when the
+// elements of the rank fill a box of a uniform Cartesian mesh, the map is a
+// table of the L-vector index of each node of the lexicographic grid of the
+// box, looked up from the (i, j, k) cell of the element and the position of
+// the dof in it. This stores one index per node of the box instead of one per
+// dof of every element; the L-vector numbering of MFEM is not ordered along
+// the box, so the indices themselves still come from the table.
+class H1Gather
+{
+private:
+   const int NE, ND, vdim, vsize;
+   // Distance between the components of a dof in the L-vector.
+   int cstride;
+   bool compressed, box_nodes;
+   // Plain map: L-vector index of the first component of each element dof.
+   Array<int> map;
+   // Compressed map: run of each element, first element of each run, and
+   // base index and stride of each dof of each run.
+   Array<int> elem_run, run_first, run_base, run_step;
+   // Box node map: cells of the box per direction, nodes per cell edge, cell
+   // of each element and L-vector index of each node of the box.
+   int cells[3], D1D;
+   Array<int> elem_cell, node_map;
+   // Sets up the box node map, if the elements fill a box of a uniform
+   // Cartesian mesh and the node table reproduces the plain map M.
+   bool SetupBoxNodes(const ParFiniteElementSpace &h1, const int *M);
+   void Gather(const Vector &x, const bool xv, Vector &X, Vector &V) const;
+public:
+   H1Gather(const ParFiniteElementSpace &h1, const bool structured = false);
+   // E-vector of the H1 field x.
+   void Mult(const Vector &x, Vector &X) const;
+   // E-vectors X and V of the H1 fields stored at the start of S and right
+   // after it, i.e., of the positions and velocities of the state vector S.
+   void MultXV(const Vector &S, Vector &X, Vector &V) const;
+   bool IsCompressed() const { return compressed; }
+   bool UsesBoxNodes() const { return box_nodes; }
+};
+
 // Performs partial assembly for the force operator.
 class ForcePAOperator : public Operator
 {
@@ -98,17 +219,91 @@ private:
    const QuadratureData &qdata;
    const ParFiniteElementSpace &H1, &L2;
    const Operator *H1R, *L2R;
+   const H1Gather h1_gather;
    const IntegrationRule &ir1D;
    const int D1D, Q1D, L1D, H1sz, L2sz;
    const DofToQuad *L2D2Q, *H1D2Q;
+   // Whether Mult and MultTranspose use the compile-time basis tables.
+   const bool cb_mult, cb_transpose;
    mutable Vector X, Y;
+   KernelCapture *capture;
 public:
+   // With structured, the H1 gather uses the box node map when possible.
    ForcePAOperator(const QuadratureData&,
                    ParFiniteElementSpace&,
                    ParFiniteElementSpace&,
-                   const IntegrationRule&);
+                   const IntegrationRule&,
+                   const bool structured = false);
    virtual void Mult(const Vector&, Vector&) const;
    virtual void MultTranspose(const Vector&, Vector&) const;
+   // Same as MultTranspose(), with the velocity given as an H1 E-vector.
+   void MultTransposeE(const Vector &V, Vector &y) const;
+   const H1Gather &GetH1Gather() const { return h1_gather; }
+   void SetKernelCapture(KernelCapture *c) { capture = c; }
+};
+
+// Element kernels of ForcePAOperator::Mult and MultTranspose, acting on the
+// L2 and H1 E-vectors. When the compact stress and the position E-vector are
+// given (3D, see QuadratureData::stress), stressJinvT is not used. With cb,
+// the kernels use the compile-time basis tables, which must match the given
+// ones (see ConstBasisMatches()).
+void ForceMult(const int DIM, const int D1D, const int Q1D,
+               const int L1D, const int H1D, const int NE,
+               const Array<double> &B,
+               const Array<double> &Bt,
+               const Array<double> &Gt,
+               const DenseTensor &stressJinvT,
+               const Vector &e,
+               Vector &v,
+               const Vector *stress = nullptr,
+               const Vector *positions = nullptr,
+               const bool cb = false);
+void ForceMultTranspose(const int DIM, const int D1D, const int Q1D,
+                        const int L1D, const int NE,
+                        const Array<double> &L2Bt,
+                        const Array<double> &H1B,
+                        const Array<double> &H1G,
+                        const DenseTensor &stressJinvT,
+                        const Vector &v,
+                        Vector &e,
+                        const Vector *stress = nullptr,
+                        const Vector *positions = nullptr,
+                        const bool cb = false);
+
+// Sliced ELLPACK (SELL-C-sigma) copy of an assembled CSR matrix, used for the
+// full assembly mat-vecs. Inside windows of sigma rows, the rows are sorted by
+// decreasing length and then packed into slices of C rows. Each slice is stored
+// column-major, so that its C rows are processed together by the SIMD lanes.
+// The slicing is computed once from the sparsity pattern, UpdateValues() only
+// copies the new nonzero values. The transpose is stored in the same format,
+// so that both products are row-parallel and do not need atomics.
+class SellMatrix : public Operator
+{
+private:
+   struct Slices
+   {
+      int rows, nslices;
+      // Original row of each slice lane (-1 for padding lanes).
+      Array<int> perm;
+      // Offset and width (longest row) of each slice.
+      Array<int> offsets, widths;
+      // Column index and position in the CSR data array of each entry
+      // (-1 for padding entries).
+      Array<int> col, src;
+      Vector val;
+      void Setup(const int C, const int sigma, const int nrows,
+                 const int *I, const int *J, const int *pos);
+      void Update(const double *data);
+      void Mult(const int C, const double *x, double *y) const;
+   };
+   const int C, sigma, nnz;
+   Slices A, At;
+public:
+   SellMatrix(const SparseMatrix &M, const int C = 8, const int sigma = 256);
+   // M must have the same sparsity pattern as the one used in the constructor.
+   void UpdateValues(const SparseMatrix &M);
+   virtual void Mult(const Vector &x, Vector &y) const;
+   virtual void MultTranspose(const Vector &x, Vector &y) const;
 };
 
 // Performs partial assembly for the velocity mass matrix.
@@ -121,6 +316,9 @@ private:
    int ess_tdofs_count;
    Array<int> ess_tdofs;
    OperatorPtr mass;
+   // Quadrature data and 1D basis of the mass integrator, for the capture.
+   const Vector *pa_data;
+   const DofToQuad *maps;
 public:
    MassPAOperator(ParFiniteElementSpace&, const IntegrationRule&, Coefficient&);
    virtual void Mult(const Vector&, Vector&) const;
@@ -128,6 +326,13 @@ public:
    virtual void SetEssentialTrueDofs(Array<int>&);
    virtual void EliminateRHS(Vector&) const;
    const ParBilinearForm &GetBF() const { return pabf; }
+   // Records the CG solve of M x = b, started from x0, as a
+   // KernelCapture::MASS_CG record. With jacobi, the solver is preconditioned
+   // by the inverse diagonal of the operator.
+   void RecordSolve(KernelCapture &capture, const int component,
+                    const IterativeSolver &cg, const bool jacobi,
+                    const double tol, const int max_iter, const Vector &x0,
+                    const Vector &b, const Vector &x) const;
 };
 
 } // namespace hydrodynamics
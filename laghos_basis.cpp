@@ -0,0 +1,123 @@
+// Copyright (c) 2017, Lawrence Livermore National Security, LLC. Produced at
+// the Lawrence Livermore National Laboratory. LLNL-CODE-734707. All Rights
+// reserved. See files LICENSE and NOTICE for details.
+//
+// This file is part of CEED, a collection of benchmarks, miniapps, software
+// libraries and APIs for efficient high-order finite element and spectral
+// element discretizations for exascale applications. For more information and
+// source code availability see http://github.com/ceed.
+//
+// The CEED research is supported by the Exascale Computing Project 17-SC-20-SC,
+// a collaborative effort of two U.S. Department of Energy organizations (Office
+// of Science and the National Nuclear Security Administration) responsible for
+// the planning and preparation of a capable exascale ecosystem, including
+// software, applications, hardware, advanced system engineering and early
+// testbed platforms, in support of the nation's exascale computing imperative.
+
+#include "laghos_basis.hpp"
+#include <cmath>
+
+namespace mfem
+{
+
+namespace hydrodynamics
+{
+
+static bool const_basis_tables = false;
+
+void SetConstBasisTables(bool enable)
+{
+#ifndef LAGHOS_CONST_BASIS
+   MFEM_VERIFY(!enable, "The compile-time basis tables need C++14.");
+#endif
+   const_basis_tables = enable;
+}
+
+bool ConstBasisTables() { return const_basis_tables; }
+
+#ifdef LAGHOS_CONST_BASIS
+static bool Near(const double a, const double b)
+{
+   return std::fabs(a - b) <= 1e-12 * std::fmax(1.0, std::fabs(b));
+}
+
+// The force kernels read the L2 basis as B(q,l) and the H1 ones as Bt(d,q)
+// and Gt(d,q), and their transposes are read as Bt(l,q), B(q,d) and G(q,d).
+template <int D1D, int Q1D, int L1D>
+static bool BasisMatches(const Array<double> &L2, const Array<double> &H1B,
+                         const Array<double> &H1G, const bool mult)
+{
+   constexpr ConstBasis<D1D, Q1D, L1D> cb;
+   const double *l2 = L2.HostRead(), *b = H1B.HostRead(),
+                 *g = H1G.HostRead();
+   for (int q = 0; q < Q1D; q++)
+   {
+      for (int l = 0; l < L1D; l++)
+      {
+         const double v = mult ? l2[q + Q1D*l] : l2[l + L1D*q];
+         if (!Near(cb.L2B[q][l], v)) { return false; }
+      }
+      for (int d = 0; d < D1D; d++)
+      {
+         const int k = mult ? d + D1D*q : q + Q1D*d;
+         if (!Near(cb.H1B[q][d], b[k]) || !Near(cb.H1G[q][d], g[k]))
+         {
+            return false;
+         }
+      }
+   }
+   return true;
+}
+#endif
+
+bool ConstBasisMatches(int D1D, int Q1D, int L1D,
+                       const Array<double> &L2, const Array<double> &H1B,
+                       const Array<double> &H1G, bool mult)
+{
+#ifdef LAGHOS_CONST_BASIS
+   if (L2.Size() != Q1D*L1D || H1B.Size() != Q1D*D1D ||
+       H1G.Size() != Q1D*D1D) { return false; }
+   switch ((D1D << 8) | (Q1D << 4) | L1D)
+   {
+      case 0x342: return BasisMatches<3,4,2>(L2, H1B, H1G, mult);
+      case 0x463: return BasisMatches<4,6,3>(L2, H1B, H1G, mult);
+      case 0x584: return BasisMatches<5,8,4>(L2, H1B, H1G, mult);
+   }
+#endif
+   return false;
+}
+
+#ifdef LAGHOS_CONST_BASIS
+template <int DIM, int Q1D>
+static bool WeightsMatch(const Array<double> &weights)
+{
+   constexpr ConstWeights<DIM, Q1D> cw;
+   if (weights.Size() != cw.NQ) { return false; }
+   const double *w = weights.HostRead();
+   for (int q = 0; q < cw.NQ; q++)
+   {
+      if (!Near(cw.W[q], w[q])) { return false; }
+   }
+   return true;
+}
+#endif
+
+bool ConstWeightsMatch(int dim, int Q1D, const Array<double> &weights)
+{
+#ifdef LAGHOS_CONST_BASIS
+   switch ((dim << 4) | Q1D)
+   {
+      case 0x24: return WeightsMatch<2,4>(weights);
+      case 0x26: return WeightsMatch<2,6>(weights);
+      case 0x28: return WeightsMatch<2,8>(weights);
+      case 0x34: return WeightsMatch<3,4>(weights);
+      case 0x36: return WeightsMatch<3,6>(weights);
+      case 0x38: return WeightsMatch<3,8>(weights);
+   }
+#endif
+   return false;
+}
+
+} // namespace hydrodynamics
+
+} // namespace mfem
@@ -0,0 +1,249 @@
+// Copyright (c) 2017, Lawrence Livermore National Security, LLC. Produced at
+// the Lawrence Livermore National Laboratory. LLNL-CODE-734707. All Rights
+// reserved. See files LICENSE and NOTICE for details.
+//
+// This file is part of CEED, a collection of benchmarks, miniapps, software
+// libraries and APIs for efficient high-order finite element and spectral
+// element discretizations for exascale applications. For more information and
+// source code availability see http://github.com/ceed.
+//
+// The CEED research is supported by the Exascale Computing Project 17-SC-20-SC,
+// a collaborative effort of two U.S. Department of Energy organizations (Office
+// of Science and the National Nuclear Security Administration) responsible for
+// the planning and preparation of a capable exascale ecosystem, including
+// software, applications, hardware, advanced system engineering and early
+// testbed platforms, in support of the nation's exascale computing imperative.
+
+#ifndef MFEM_LAGHOS_BASIS
+#define MFEM_LAGHOS_BASIS
+
+#include "mfem.hpp"
+
+namespace mfem
+{
+
+namespace hydrodynamics
+{
+
+// Compile-time 1D tables of the partial assembly kernels: the Gauss-Legendre
+// points and weights of IntRules, the H1 nodal basis at the Gauss-Lobatto
+// points with its derivative, and the L2 positive (Bernstein) basis. They are
+// computed by constexpr Newton iterations, so each kernel instantiation for
+// given (D1D, Q1D, L1D) carries its tables as constants, instead of loading
+// the DofToQuad arrays of MFEM for every element. The constexpr functions
+// with loops need C++14: with an older standard, LAGHOS_CONST_BASIS is not
+// defined, the tables are empty and never match, and -cbt is rejected.
+#if __cplusplus >= 201402L
+#define LAGHOS_CONST_BASIS
+#endif
+
+#ifdef LAGHOS_CONST_BASIS
+namespace cbasis
+{
+
+constexpr double pi = 3.14159265358979323846;
+
+// cos(x) for |x| <= pi, only for the initial guesses of the Newton iterations.
+MFEM_HOST_DEVICE constexpr double Cos(const double x)
+{
+   double term = 1.0, sum = 1.0;
+   for (int k = 1; k < 30; k++)
+   {
+      term *= -x * x / ((2*k - 1) * (2*k));
+      sum += term;
+   }
+   return sum;
+}
+
+// Legendre polynomials P_n(x) and P_{n-1}(x) on [-1,1], n >= 1.
+MFEM_HOST_DEVICE constexpr void Legendre(const int n, const double x,
+                                         double &p, double &p1)
+{
+   p1 = 1.0;
+   p = x;
+   for (int k = 2; k <= n; k++)
+   {
+      const double p2 = p1;
+      p1 = p;
+      p = ((2*k - 1) * x * p1 - (k - 1) * p2) / k;
+   }
+}
+
+// N Gauss-Legendre points on [0,1], in increasing order, with their weights.
+template <int N> struct GaussLegendre
+{
+   double x[N], w[N];
+
+   MFEM_HOST_DEVICE constexpr GaussLegendre() : x(), w()
+   {
+      for (int i = 0; i < N; i++)
+      {
+         double z = Cos(pi * (i + 0.75) / (N + 0.5)), p = 0.0, p1 = 0.0;
+         for (int it = 0; it < 100; it++)
+         {
+            Legendre(N, z, p, p1);
+            const double dz = p * (z*z - 1.0) / (N * (z*p - p1));
+            z -= dz;
+            if (dz == 0.0) { break; }
+         }
+         Legendre(N, z, p, p1);
+         const double dp = N * (z*p - p1) / (z*z - 1.0);
+         x[i] = 0.5 * (1.0 - z);
+         w[i] = 1.0 / ((1.0 - z*z) * dp*dp);
+      }
+   }
+};
+
+// N Gauss-Lobatto points on [0,1], N >= 2, in increasing order.
+template <int N> struct GaussLobatto
+{
+   double x[N];
+
+   MFEM_HOST_DEVICE constexpr GaussLobatto() : x()
+   {
+      const int p = N - 1;
+      x[0] = 0.0;
+      x[p] = 1.0;
+      for (int i = 1; i < p; i++)
+      {
+         double z = Cos(pi * i / p), P = 0.0, P1 = 0.0;
+         for (int it = 0; it < 100; it++)
+         {
+            Legendre(p, z, P, P1);
+            const double dz = (z*P - P1) / (N * P);
+            z -= dz;
+            if (dz == 0.0) { break; }
+         }
+         x[i] = 0.5 * (1.0 - z);
+      }
+   }
+};
+
+// Lagrange polynomial j of the nodes z[0..n-1], and its derivative, at t.
+MFEM_HOST_DEVICE constexpr double Lagrange(const double *z, const int n,
+                                           const int j, const double t)
+{
+   double v = 1.0;
+   for (int k = 0; k < n; k++)
+   {
+      if (k != j) { v *= (t - z[k]) / (z[j] - z[k]); }
+   }
+   return v;
+}
+
+MFEM_HOST_DEVICE constexpr double DLagrange(const double *z, const int n,
+                                            const int j, const double t)
+{
+   double s = 0.0;
+   for (int m = 0; m < n; m++)
+   {
+      if (m == j) { continue; }
+      double v = 1.0 / (z[j] - z[m]);
+      for (int k = 0; k < n; k++)
+      {
+         if (k != j && k != m) { v *= (t - z[k]) / (z[j] - z[k]); }
+      }
+      s += v;
+   }
+   return s;
+}
+
+// Bernstein polynomial l of degree p at t.
+MFEM_HOST_DEVICE constexpr double Bernstein(const int p, const int l,
+                                            const double t)
+{
+   double v = 1.0;
+   for (int k = 0; k < l; k++) { v *= (p - k) * t / (k + 1); }
+   for (int k = l; k < p; k++) { v *= 1.0 - t; }
+   return v;
+}
+
+} // namespace cbasis
+
+#endif // LAGHOS_CONST_BASIS
+
+// Tables of the force kernels, with the layouts of their shared arrays: the
+// L2 basis B[q][l] and its transpose, the H1 basis B[q][d], its gradient
+// G[q][d] and their transposes.
+template <int D1D, int Q1D, int L1D> struct ConstBasis
+{
+   double L2B[Q1D][L1D], L2Bt[L1D][Q1D];
+   double H1B[Q1D][D1D], H1Bt[D1D][Q1D], H1G[Q1D][D1D], H1Gt[D1D][Q1D];
+
+#ifndef LAGHOS_CONST_BASIS
+   MFEM_HOST_DEVICE constexpr ConstBasis()
+      : L2B(), L2Bt(), H1B(), H1Bt(), H1G(), H1Gt() { }
+#else
+   MFEM_HOST_DEVICE constexpr ConstBasis()
+      : L2B(), L2Bt(), H1B(), H1Bt(), H1G(), H1Gt()
+   {
+      const cbasis::GaussLegendre<Q1D> qp;
+      const cbasis::GaussLobatto<D1D> nodes;
+      for (int q = 0; q < Q1D; q++)
+      {
+         for (int d = 0; d < D1D; d++)
+         {
+            H1B[q][d] = H1Bt[d][q] =
+                           cbasis::Lagrange(nodes.x, D1D, d, qp.x[q]);
+            H1G[q][d] = H1Gt[d][q] =
+                           cbasis::DLagrange(nodes.x, D1D, d, qp.x[q]);
+         }
+         for (int l = 0; l < L1D; l++)
+         {
+            L2B[q][l] = L2Bt[l][q] = cbasis::Bernstein(L1D - 1, l, qp.x[q]);
+         }
+      }
+   }
+#endif
+};
+
+// Tensor product quadrature weights, in the point order of IntRules.
+template <int DIM, int Q1D> struct ConstWeights
+{
+   static constexpr int NQ = (DIM == 3) ? Q1D*Q1D*Q1D : Q1D*Q1D;
+   double W[NQ];
+
+#ifndef LAGHOS_CONST_BASIS
+   MFEM_HOST_DEVICE constexpr ConstWeights() : W() { }
+#else
+   MFEM_HOST_DEVICE constexpr ConstWeights() : W()
+   {
+      const cbasis::GaussLegendre<Q1D> qp;
+      for (int qz = 0; qz < ((DIM == 3) ? Q1D : 1); qz++)
+      {
+         for (int qy = 0; qy < Q1D; qy++)
+         {
+            for (int qx = 0; qx < Q1D; qx++)
+            {
+               const double w = qp.w[qx] * qp.w[qy];
+               W[qx + Q1D*(qy + Q1D*qz)] = (DIM == 3) ? w * qp.w[qz] : w;
+            }
+         }
+      }
+   }
+#endif
+};
+
+// Use of the compile-time tables by the force and quadrature update kernels
+// (off by default). A kernel uses them only when they match the tables of the
+// discretization, see ConstBasisMatches() and ConstWeightsMatch(), which the
+// operators check once at setup. The results then differ from those with the
+// MFEM tables at round-off level.
+void SetConstBasisTables(bool enable);
+bool ConstBasisTables();
+
+// Whether the compile-time tables of (D1D, Q1D, L1D) exist and agree with the
+// given DofToQuad arrays, up to round-off: the (B, Bt, Gt) arrays of ForceMult
+// when mult is true, and the (Bt, B, G) ones of ForceMultTranspose otherwise.
+bool ConstBasisMatches(int D1D, int Q1D, int L1D,
+                       const Array<double> &L2, const Array<double> &H1B,
+                       const Array<double> &H1G, bool mult);
+
+// Whether the compile-time weights of (dim, Q1D) agree with the given ones.
+bool ConstWeightsMatch(int dim, int Q1D, const Array<double> &weights);
+
+} // namespace hydrodynamics
+
+} // namespace mfem
+
+#endif // MFEM_LAGHOS_BASIS
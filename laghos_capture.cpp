@@ -0,0 +1,539 @@
+// Copyright (c) 2017, Lawrence Livermore National Security, LLC. Produced at
+// the Lawrence Livermore National Laboratory. LLNL-CODE-734707. All Rights
+// reserved. See files LICENSE and NOTICE for details.
+//
+// This file is part of CEED, a collection of benchmarks, miniapps, software
+// libraries and APIs for efficient high-order finite element and spectral
+// element discretizations for exascale applications. For more information and
+// source code availability see http://github.com/ceed.
+//
+// The CEED research is supported by the Exascale Computing Project 17-SC-20-SC,
+// a collaborative effort of two U.S. Department of Energy organizations (Office
+// of Science and the National Nuclear Security Administration) responsible for
+// the planning and preparation of a capable exascale ecosystem, including
+// software, applications, hardware, advanced system engineering and early
+// testbed platforms, in support of the nation's exascale computing imperative.
+
+#include "laghos_capture.hpp"
+#include "laghos_solver.hpp"
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <vector>
+
+namespace mfem
+{
+
+namespace hydrodynamics
+{
+
+// File layout (native byte order): the magic string, then the records. Each
+// record starts with four ints: kernel id, number of ints, number of doubles
+// and number of arrays. The ints and doubles follow, then each array as its
+// long size and its values.
+static const char capture_magic[8] = {'L','G','H','S','C','A','P','1'};
+
+static std::string CaptureFilename(MPI_Comm comm, const char *basename)
+{
+   int myid;
+   MPI_Comm_rank(comm, &myid);
+   return MakeParFilename(std::string(basename) + ".", myid);
+}
+
+KernelCapture::KernelCapture(MPI_Comm comm, const char *basename)
+   : os(CaptureFilename(comm, basename).c_str(), std::ios::binary),
+     records(0)
+{
+   MFEM_VERIFY(os.good(), "Cannot open the capture file "
+               << CaptureFilename(comm, basename));
+   os.write(capture_magic, sizeof(capture_magic));
+}
+
+void KernelCapture::Record(Kernel kernel, std::initializer_list<int> ints,
+                           std::initializer_list<double> scalars,
+                           std::initializer_list<Data> arrays)
+{
+   const int header[4] = { kernel, (int) ints.size(), (int) scalars.size(),
+                           (int) arrays.size()
+                         };
+   os.write((const char *) header, sizeof(header));
+   for (int i : ints) { os.write((const char *) &i, sizeof(int)); }
+   for (double d : scalars) { os.write((const char *) &d, sizeof(double)); }
+   for (const Data &a : arrays)
+   {
+      os.write((const char *) &a.size, sizeof(long));
+      os.write((const char *) a.data, a.size * sizeof(double));
+   }
+   MFEM_VERIFY(os.good(), "Error writing the capture file!");
+   records++;
+}
+
+// One record, as read back by the replay.
+struct KernelRecord
+{
+   int kernel;
+   Array<int> ints;
+   Array<double> scalars;
+   std::vector<Vector> arrays;
+
+   bool Read(std::istream &is)
+   {
+      int header[4];
+      if (!is.read((char *) header, sizeof(header))) { return false; }
+      kernel = header[0];
+      ints.SetSize(header[1]);
+      scalars.SetSize(header[2]);
+      is.read((char *) ints.GetData(), ints.Size() * sizeof(int));
+      is.read((char *) scalars.GetData(), scalars.Size() * sizeof(double));
+      arrays.resize(header[3]);
+      for (Vector &a : arrays)
+      {
+         long size;
+         is.read((char *) &size, sizeof(long));
+         a.SetSize(size);
+         is.read((char *) a.GetData(), size * sizeof(double));
+      }
+      MFEM_VERIFY(is.good(), "Truncated capture record!");
+      return true;
+   }
+};
+
+// Bit-for-bit comparison of a kernel output with the recorded one.
+static bool SameBits(const double *out, const Vector &ref)
+{
+   return std::memcmp(out, ref.GetData(), ref.Size() * sizeof(double)) == 0;
+}
+
+struct ReplayStats
+{
+   int calls = 0, mismatches = 0;
+   double time = 0.0;
+};
+
+// Times the repetitions of a kernel whose output has been checked.
+template <typename Kernel>
+static void TimeReplay(Kernel &&kernel, const bool match,
+                       const int repetitions, ReplayStats &stats)
+{
+   StopWatch sw;
+   sw.Start();
+   for (int r = 0; r < repetitions; r++) { kernel(); }
+   MFEM_DEVICE_SYNC;
+   sw.Stop();
+   stats.calls++;
+   stats.time += sw.RealTime() / (repetitions > 0 ? repetitions : 1);
+   if (!match) { stats.mismatches++; }
+}
+
+// Runs the kernel once to check the output, then times the repetitions.
+// Returns true if the output matches.
+template <typename Kernel>
+static bool Replay(Kernel &&kernel, const Vector &out, const Vector &ref,
+                   const int repetitions, ReplayStats &stats)
+{
+   kernel();
+   const bool match = SameBits(out.HostRead(), ref);
+   TimeReplay(kernel, match, repetitions, stats);
+   return match;
+}
+
+// Contracts the axis a of the tensor u, of sizes n[0] x n[1] x n[2] (first
+// index fastest), with the 1D basis B (Q1D x D1D), or with its transpose. The
+// size of the axis in n is updated.
+static void Contract(const double *B, const int Q1D, const int D1D,
+                     const bool transpose, const int a, int n[3],
+                     const double *u, double *v)
+{
+   int s[3] = { n[0], n[1], n[2] };
+   s[a] = transpose ? D1D : Q1D;
+   for (int k2 = 0; k2 < s[2]; k2++)
+   {
+      for (int k1 = 0; k1 < s[1]; k1++)
+      {
+         for (int k0 = 0; k0 < s[0]; k0++)
+         {
+            int k[3] = { k0, k1, k2 };
+            const int o = k[a];
+            double sum = 0.0;
+            for (int j = 0; j < n[a]; j++)
+            {
+               k[a] = j;
+               const double b = transpose ? B[j + Q1D*o] : B[o + Q1D*j];
+               sum += b * u[k[0] + n[0]*(k[1] + n[1]*k[2])];
+            }
+            v[k0 + s[0]*(k1 + s[1]*k2)] = sum;
+         }
+      }
+   }
+   n[a] = s[a];
+}
+
+// Partial assembly mass operator of a MASS_CG record, on the true dofs of the
+// rank. The true dofs of the E-vector entries owned by other ranks (ghosts)
+// are exchanged with MPI_Alltoallv in each product, so the shared dofs are
+// summed in another order than with hypre.
+class MassReplayOperator : public Operator
+{
+private:
+   const MPI_Comm comm;
+   const int dim, D1D, Q1D, NE, ND, NQ;
+   const Vector &B, &coef;
+   // Index of each E-vector entry in the true dofs followed by the ghosts.
+   Array<int> emap;
+   // Essential true dofs, whose outputs are zero.
+   Array<int> ess;
+   // True dofs sent to each rank, ghosts received from each rank.
+   Array<int> send_idx, send_cnt, send_dsp, recv_cnt, recv_dsp;
+   mutable Vector xg, xe, ye, send_buf, t0, t1;
+
+   void ElementMult(const double *x, const double *c, double *y) const;
+
+public:
+   MassReplayOperator(MPI_Comm comm, const KernelRecord &rec);
+   virtual void Mult(const Vector &x, Vector &y) const;
+};
+
+static int Power(const int b, const int e) { return e ? b * Power(b, e-1) : 1; }
+
+MassReplayOperator::MassReplayOperator(MPI_Comm comm, const KernelRecord &rec)
+   : Operator(rec.arrays[6].Size()), comm(comm),
+     dim(rec.ints[1]), D1D(rec.ints[2]), Q1D(rec.ints[3]), NE(rec.ints[4]),
+     ND(Power(D1D, dim)), NQ(Power(Q1D, dim)),
+     B(rec.arrays[0]), coef(rec.arrays[1])
+{
+   int nranks;
+   MPI_Comm_size(comm, &nranks);
+   const long long n = height;
+   const long long offset = (long long) rec.scalars[1];
+   // First true dof of each rank, to find the owners of the ghosts.
+   std::vector<long long> offsets(nranks);
+   MPI_Allgather(&offset, 1, MPI_LONG_LONG, offsets.data(), 1, MPI_LONG_LONG,
+                 comm);
+   const Vector &gtdofs = rec.arrays[2];
+   std::map<long long, int> ghosts;
+   for (int i = 0; i < gtdofs.Size(); i++)
+   {
+      const long long g = (long long) gtdofs(i);
+      if (g < offset || g >= offset + n) { ghosts[g] = 0; }
+   }
+   // The ghosts are numbered in the order of their global numbers, which
+   // groups them by owner.
+   recv_cnt.SetSize(nranks);
+   recv_cnt = 0;
+   std::vector<long long> requests;
+   int slot = n;
+   for (auto &g : ghosts)
+   {
+      g.second = slot++;
+      const int owner = std::upper_bound(offsets.begin(), offsets.end(),
+                                         g.first) - offsets.begin() - 1;
+      recv_cnt[owner]++;
+      requests.push_back(g.first);
+   }
+   emap.SetSize(gtdofs.Size());
+   for (int i = 0; i < gtdofs.Size(); i++)
+   {
+      const long long g = (long long) gtdofs(i);
+      emap[i] = (g < offset || g >= offset + n) ? ghosts[g] : g - offset;
+   }
+   send_cnt.SetSize(nranks);
+   MPI_Alltoall(recv_cnt.GetData(), 1, MPI_INT, send_cnt.GetData(), 1,
+                MPI_INT, comm);
+   send_dsp.SetSize(nranks);
+   recv_dsp.SetSize(nranks);
+   send_dsp[0] = recv_dsp[0] = 0;
+   for (int p = 1; p < nranks; p++)
+   {
+      send_dsp[p] = send_dsp[p-1] + send_cnt[p-1];
+      recv_dsp[p] = recv_dsp[p-1] + recv_cnt[p-1];
+   }
+   const int nsend = send_dsp[nranks-1] + send_cnt[nranks-1];
+   std::vector<long long> sent(nsend);
+   MPI_Alltoallv(requests.data(), recv_cnt.GetData(), recv_dsp.GetData(),
+                 MPI_LONG_LONG, sent.data(), send_cnt.GetData(),
+                 send_dsp.GetData(), MPI_LONG_LONG, comm);
+   send_idx.SetSize(nsend);
+   for (int i = 0; i < nsend; i++) { send_idx[i] = sent[i] - offset; }
+   const Vector &ess_dofs = rec.arrays[3];
+   ess.SetSize(ess_dofs.Size());
+   for (int i = 0; i < ess.Size(); i++) { ess[i] = (int) ess_dofs(i); }
+   xg.SetSize(slot);
+   xe.SetSize(NE * ND);
+   ye.SetSize(NE * ND);
+   send_buf.SetSize(nsend);
+   t0.SetSize(Power(std::max(D1D, Q1D), dim));
+   t1.SetSize(t0.Size());
+}
+
+void MassReplayOperator::ElementMult(const double *x, const double *c,
+                                     double *y) const
+{
+   // B^T diag(c) B x, by sum factorization.
+   int n[3] = { D1D, dim > 1 ? D1D : 1, dim > 2 ? D1D : 1 };
+   double *buf[2] = { t0.GetData(), t1.GetData() };
+   int k = 0;
+   const double *in = x;
+   for (int a = 0; a < dim; a++)
+   {
+      Contract(B.GetData(), Q1D, D1D, false, a, n, in, buf[k]);
+      in = buf[k];
+      k = 1 - k;
+   }
+   for (int q = 0; q < NQ; q++) { buf[k][q] = c[q] * in[q]; }
+   in = buf[k];
+   k = 1 - k;
+   for (int a = 0; a < dim; a++)
+   {
+      double *out = (a == dim - 1) ? y : buf[k];
+      Contract(B.GetData(), Q1D, D1D, true, a, n, in, out);
+      in = out;
+      k = 1 - k;
+   }
+}
+
+void MassReplayOperator::Mult(const Vector &x, Vector &y) const
+{
+   const int n = height;
+   // Values of the ghosts, from their owners.
+   for (int i = 0; i < send_idx.Size(); i++) { send_buf(i) = x(send_idx[i]); }
+   MPI_Alltoallv(send_buf.GetData(), send_cnt.GetData(), send_dsp.GetData(),
+                 MPI_DOUBLE, xg.GetData() + n, recv_cnt.GetData(),
+                 recv_dsp.GetData(), MPI_DOUBLE, comm);
+   for (int i = 0; i < n; i++) { xg(i) = x(i); }
+   for (int i = 0; i < emap.Size(); i++) { xe(i) = xg(emap[i]); }
+   for (int e = 0; e < NE; e++)
+   {
+      ElementMult(xe.GetData() + e*ND, coef.GetData() + e*NQ,
+                  ye.GetData() + e*ND);
+   }
+   // Sum the E-vector entries, then the ghost sums on their owners.
+   xg = 0.0;
+   for (int i = 0; i < emap.Size(); i++) { xg(emap[i]) += ye(i); }
+   MPI_Alltoallv(xg.GetData() + n, recv_cnt.GetData(), recv_dsp.GetData(),
+                 MPI_DOUBLE, send_buf.GetData(), send_cnt.GetData(),
+                 send_dsp.GetData(), MPI_DOUBLE, comm);
+   for (int i = 0; i < n; i++) { y(i) = xg(i); }
+   for (int i = 0; i < send_idx.Size(); i++) { y(send_idx[i]) += send_buf(i); }
+   for (int i = 0; i < ess.Size(); i++) { y(ess[i]) = 0.0; }
+}
+
+// Jacobi preconditioner of the replayed velocity mass solves, as the
+// OperatorJacobiSmoother of the hydro operator.
+class JacobiReplaySolver : public Solver
+{
+private:
+   Vector dinv;
+
+public:
+   JacobiReplaySolver(const Vector &diag) : Solver(diag.Size()), dinv(diag)
+   {
+      for (int i = 0; i < dinv.Size(); i++) { dinv(i) = 1.0 / diag(i); }
+   }
+   virtual void Mult(const Vector &x, Vector &y) const
+   {
+      for (int i = 0; i < dinv.Size(); i++) { y(i) = dinv(i) * x(i); }
+   }
+   virtual void SetOperator(const Operator &) { }
+};
+
+// Preconditioned norm of the residual of M x = b, as in CGSolver.
+static double ResidualNorm(MPI_Comm comm, const Operator &M, const Solver *P,
+                           const Vector &b, const Vector &x)
+{
+   Vector r(b.Size()), z(b.Size());
+   M.Mult(x, r);
+   subtract(b, r, r);
+   if (P) { P->Mult(r, z); }
+   else { z = r; }
+   return sqrt(GlobalDot(comm, r, z));
+}
+
+int ReplayKernels(MPI_Comm comm, const char *basename, const int repetitions)
+{
+   int myid;
+   MPI_Comm_rank(comm, &myid);
+   const std::string filename = CaptureFilename(comm, basename);
+   std::ifstream is(filename.c_str(), std::ios::binary);
+   MFEM_VERIFY(is.good(), "Cannot open the capture file " << filename);
+   char magic[sizeof(capture_magic)];
+   is.read(magic, sizeof(magic));
+   MFEM_VERIFY(is.good() &&
+               std::memcmp(magic, capture_magic, sizeof(magic)) == 0,
+               "Not a Laghos capture file: " << filename);
+
+   const char *names[] = { "", "QUpdate", "ForceMult", "ForceMultTranspose",
+                           "EnergyMassInverse", "MassCG", "QUpdate (64-bit)"
+                         };
+   // The last slot is the QUpdate kernel with the 64-bit offsets, which is
+   // also replayed to measure their cost, unless they are already used.
+   const int QUPDATE64 = 6;
+   ReplayStats stats[7];
+   KernelRecord rec;
+   while (rec.Read(is))
+   {
+      std::vector<Vector> &a = rec.arrays;
+      switch (rec.kernel)
+      {
+         case KernelCapture::QUPDATE:
+         {
+            const int dim = rec.ints[0], Q1D = rec.ints[1];
+            const int NE = rec.ints[2], NQ = rec.ints[3];
+            const double dt_est0 = rec.scalars[3];
+            const Array<double> weights(a[1].GetData(), a[1].Size());
+            DenseTensor Jac0inv, stressJinvT;
+            Jac0inv.UseExternalData(a[6].GetData(), dim, dim,
+                                    a[6].Size() / (dim*dim));
+            stressJinvT.SetSize(NE*NQ, dim, dim);
+            Vector dt_est(NE*NQ);
+            const bool cw = ConstBasisTables() &&
+                            ConstWeightsMatch(dim, Q1D, weights);
+            auto kernel = [&]()
+            {
+               dt_est = dt_est0;
+               QUpdateKernel(dim, Q1D, NE, NQ, rec.ints[4], rec.ints[5],
+                             rec.scalars[0], rec.scalars[1], rec.scalars[2],
+                             a[0], weights, a[2], a[3], a[4], a[5],
+                             Jac0inv, dt_est, stressJinvT, nullptr, nullptr,
+                             cw);
+            };
+            if (Replay(kernel, dt_est, a[7], repetitions,
+                       stats[rec.kernel]))
+            {
+               if (!SameBits(stressJinvT.HostRead(), a[8]))
+               {
+                  stats[rec.kernel].mismatches++;
+               }
+            }
+            if (!KernelIndex64())
+            {
+               SetKernelIndex64(true);
+               if (Replay(kernel, dt_est, a[7], repetitions,
+                          stats[QUPDATE64]))
+               {
+                  if (!SameBits(stressJinvT.HostRead(), a[8]))
+                  {
+                     stats[QUPDATE64].mismatches++;
+                  }
+               }
+               SetKernelIndex64(false);
+            }
+            break;
+         }
+         case KernelCapture::FORCE_MULT:
+         case KernelCapture::FORCE_MULT_TRANSPOSE:
+         {
+            const int dim = rec.ints[0], D1D = rec.ints[1], Q1D = rec.ints[2];
+            const int L1D = rec.ints[3], NE = rec.ints[4];
+            const Array<double> t0(a[0].GetData(), a[0].Size());
+            const Array<double> t1(a[1].GetData(), a[1].Size());
+            const Array<double> t2(a[2].GetData(), a[2].Size());
+            DenseTensor stressJinvT;
+            stressJinvT.UseExternalData(a[3].GetData(), a[3].Size()/(dim*dim),
+                                        dim, dim);
+            Vector out(a[5].Size());
+            const bool mult = rec.kernel == KernelCapture::FORCE_MULT;
+            const bool cb = ConstBasisTables() &&
+                            ConstBasisMatches(D1D, Q1D, L1D, t0, t1, t2, mult);
+            auto kernel = [&]()
+            {
+               if (mult)
+               {
+                  ForceMult(dim, D1D, Q1D, L1D, D1D, NE, t0, t1, t2,
+                            stressJinvT, a[4], out, nullptr, nullptr, cb);
+               }
+               else
+               {
+                  ForceMultTranspose(dim, D1D, Q1D, L1D, NE, t0, t1, t2,
+                                     stressJinvT, a[4], out, nullptr, nullptr,
+                                     cb);
+               }
+            };
+            Replay(kernel, out, a[5], repetitions,
+                   stats[rec.kernel]);
+            break;
+         }
+         case KernelCapture::ENERGY_MASS_INVERSE:
+         {
+            const int NE = rec.ints[0], nd = rec.ints[1];
+            DenseTensor Me_inv;
+            Me_inv.UseExternalData(a[0].GetData(), nd, nd, NE);
+            Vector out(NE*nd);
+            auto kernel = [&]()
+            {
+               for (int e = 0; e < NE; e++)
+               {
+                  Me_inv(e).Mult(a[1].GetData() + e*nd, out.GetData() + e*nd);
+               }
+            };
+            Replay(kernel, out, a[2], repetitions, stats[rec.kernel]);
+            break;
+         }
+         case KernelCapture::MASS_CG:
+         {
+            // The replayed operator is checked with the recorded solution,
+            // which must reach the recorded tolerance with it, up to the
+            // round-off of the different summation order. The replayed solve
+            // must converge.
+            const double tol = rec.scalars[0];
+            const bool warm = rec.ints[6], jacobi = rec.ints[8];
+            MassReplayOperator M(comm, rec);
+            JacobiReplaySolver jacobi_prec(a[4]);
+            const Solver *P = jacobi ? &jacobi_prec : nullptr;
+            ReproducibleCGSolver cg(comm);
+            if (jacobi) { cg.SetPreconditioner(jacobi_prec); }
+            cg.SetOperator(M);
+            cg.iterative_mode = warm;
+            cg.SetRelTol(tol);
+            cg.SetAbsTol(0.0);
+            cg.SetMaxIter(rec.ints[7]);
+            cg.SetPrintLevel(-1);
+            Vector x(a[5].Size()), zero(a[5].Size());
+            zero = 0.0;
+            auto kernel = [&]()
+            {
+               x = a[5];
+               cg.Mult(a[6], x);
+            };
+            kernel();
+            const double r0 = ResidualNorm(comm, M, P, a[6],
+                                           warm ? a[5] : zero);
+            const bool match = cg.GetConverged() &&
+                               ResidualNorm(comm, M, P, a[6], a[7]) <=
+                               10.0 * tol * r0;
+            TimeReplay(kernel, match, repetitions, stats[rec.kernel]);
+            break;
+         }
+         default: MFEM_ABORT("Unknown kernel id " << rec.kernel);
+      }
+   }
+
+   int mismatches = 0;
+   for (int k = 1; k < 7; k++) { mismatches += stats[k].mismatches; }
+   if (myid == 0)
+   {
+      using namespace std;
+      cout << "Replay of " << filename << " (rank 0), " << repetitions
+           << " timed repetitions:" << endl;
+      for (int k = 1; k < 7; k++)
+      {
+         if (stats[k].calls == 0) { continue; }
+         cout << std::setw(20) << names[k] << ": " << stats[k].calls
+              << " calls, " << std::scientific << std::setprecision(3)
+              << stats[k].time / stats[k].calls << " s/call, "
+              << stats[k].mismatches << " mismatches" << endl;
+      }
+      const ReplayStats &q32 = stats[KernelCapture::QUPDATE],
+                         &q64 = stats[QUPDATE64];
+      if (q64.calls > 0 && q32.time > 0.0)
+      {
+         cout << "64-bit offsets in the QUpdate kernel: " << std::fixed
+              << std::setprecision(1) << 100.0 * (q64.time / q32.time - 1.0)
+              << "% time overhead" << endl;
+      }
+   }
+   return mismatches;
+}
+
+} // namespace hydrodynamics
+
+} // namespace mfem
@@ -0,0 +1,86 @@
+// Copyright (c) 2017, Lawrence Livermore National Security, LLC. Produced at
+// the Lawrence Livermore National Laboratory. LLNL-CODE-734707. All Rights
+// reserved. See files LICENSE and NOTICE for details.
+//
+// This file is part of CEED, a collection of benchmarks, miniapps, software
+// libraries and APIs for efficient high-order finite element and spectral
+// element discretizations for exascale applications. For more information and
+// source code availability see http://github.com/ceed.
+//
+// The CEED research is supported by the Exascale Computing Project 17-SC-20-SC,
+// a collaborative effort of two U.S. Department of Energy organizations (Office
+// of Science and the National Nuclear Security Administration) responsible for
+// the planning and preparation of a capable exascale ecosystem, including
+// software, applications, hardware, advanced system engineering and early
+// testbed platforms, in support of the nation's exascale computing imperative.
+
+#ifndef MFEM_LAGHOS_CAPTURE
+#define MFEM_LAGHOS_CAPTURE
+
+#include <initializer_list>
+#include "mfem.hpp"
+
+namespace mfem
+{
+
+namespace hydrodynamics
+{
+
+// Writes the inputs and outputs of the main kernels to one binary file per
+// rank, <basename>.<rank>. Each call of a kernel is one record: the kernel id,
+// the integer sizes/flags, the double parameters and the data arrays, with the
+// outputs last. The element (E-vector) data is recorded, so that the kernels
+// can be replayed without the mesh and the spaces, see ReplayKernels(). The
+// partial assembly mass CG solves are recorded with the quadrature data of the
+// mass operator, the global true dof of each E-vector entry, the essential
+// true dofs and the diagonal of the preconditioner.
+class KernelCapture
+{
+public:
+   enum Kernel
+   {
+      QUPDATE = 1,
+      FORCE_MULT = 2,
+      FORCE_MULT_TRANSPOSE = 3,
+      // Local inverse energy mass matrices (full assembly).
+      ENERGY_MASS_INVERSE = 4,
+      // Mass CG solve (partial assembly), component -1 is the energy.
+      MASS_CG = 5
+   };
+
+   // Host view of a recorded array.
+   struct Data
+   {
+      const double *data;
+      long size;
+      Data(const Vector &v) : data(v.HostRead()), size(v.Size()) { }
+      Data(const Array<double> &a) : data(a.HostRead()), size(a.Size()) { }
+      Data(const DenseTensor &t) : data(t.HostRead()), size(t.TotalSize()) { }
+   };
+
+private:
+   std::ofstream os;
+   int records;
+
+public:
+   KernelCapture(MPI_Comm comm, const char *basename);
+
+   void Record(Kernel kernel, std::initializer_list<int> ints,
+               std::initializer_list<double> scalars,
+               std::initializer_list<Data> arrays);
+   int GetRecords() const { return records; }
+};
+
+// Re-executes the kernels recorded in <basename>.<rank>, reports their time
+// per call and checks bit-for-bit that the outputs match the recorded ones.
+// The mass CG solves sum the shared dofs in another order than hypre, so the
+// recorded solution is only checked to reach the recorded tolerance with the
+// replayed operator, and the replayed solve to converge. Returns the number of
+// mismatching records on this rank.
+int ReplayKernels(MPI_Comm comm, const char *basename, const int repetitions);
+
+} // namespace hydrodynamics
+
+} // namespace mfem
+
+#endif // MFEM_LAGHOS_CAPTURE
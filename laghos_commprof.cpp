@@ -0,0 +1,390 @@
+// Copyright (c) 2017, Lawrence Livermore National Security, LLC. Produced at
+// the Lawrence Livermore National Laboratory. LLNL-CODE-734707. All Rights
+// reserved. See files LICENSE and NOTICE for details.
+//
+// This file is part of CEED, a collection of benchmarks, miniapps, software
+// libraries and APIs for efficient high-order finite element and spectral
+// element discretizations for exascale applications. For more information and
+// source code availability see http://github.com/ceed.
+//
+// The CEED research is supported by the Exascale Computing Project 17-SC-20-SC,
+// a collaborative effort of two U.S. Department of Energy organizations (Office
+// of Science and the National Nuclear Security Administration) responsible for
+// the planning and preparation of a capable exascale ecosystem, including
+// software, applications, hardware, advanced system engineering and early
+// testbed platforms, in support of the nation's exascale computing imperative.
+
+#include "laghos_commprof.hpp"
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+namespace mfem
+{
+
+namespace hydrodynamics
+{
+
+struct CommCounters
+{
+   long long collectives, messages, bytes;
+   double time;
+};
+
+static CommProfile::Phase comm_phase = CommProfile::OTHER;
+static CommCounters comm_counters[CommProfile::NUM_PHASES];
+
+bool CommProfile::Enabled()
+{
+#ifdef LAGHOS_MPI_PROFILE
+   return true;
+#else
+   return false;
+#endif
+}
+
+CommProfile::Phase CommProfile::SetPhase(Phase phase)
+{
+   const Phase prev = comm_phase;
+   comm_phase = phase;
+   return prev;
+}
+
+void CommProfile::Print(MPI_Comm comm, long long steps)
+{
+   if (!Enabled()) { return; }
+   // Snapshot, before the reductions below are counted.
+   const int nc = 4 * NUM_PHASES;
+   double loc[nc], gsum[nc], gmax[nc];
+   for (int p = 0; p < NUM_PHASES; p++)
+   {
+      const CommCounters &c = comm_counters[p];
+      loc[4*p + 0] = c.collectives;
+      loc[4*p + 1] = c.messages;
+      loc[4*p + 2] = c.bytes;
+      loc[4*p + 3] = c.time;
+   }
+   MPI_Reduce(loc, gsum, nc, MPI_DOUBLE, MPI_SUM, 0, comm);
+   MPI_Reduce(loc, gmax, nc, MPI_DOUBLE, MPI_MAX, 0, comm);
+   int myid, nranks;
+   MPI_Comm_rank(comm, &myid);
+   MPI_Comm_size(comm, &nranks);
+   if (myid != 0) { return; }
+
+   using namespace std;
+   const char *names[NUM_PHASES] = { "other", "CG (H1)", "CG (L2)", "forces",
+                                     "UpdateQuadData", "dt estimate",
+                                     "output"
+                                   };
+   const double s = 1.0 / std::max(steps, 1LL);
+   const ios_base::fmtflags flags = cout.flags();
+   const streamsize precision = cout.precision();
+   cout << endl << "MPI traffic per time step (avg/max over the ranks):"
+        << endl << "           phase         collectives            messages"
+        << "               bytes         MPI time (s)" << endl;
+   cout << setprecision(3);
+   for (int p = 1; p <= NUM_PHASES; p++)
+   {
+      // The phases in the order of TimingData, then "other".
+      const int q = p % NUM_PHASES;
+      cout << setw(16) << names[q];
+      for (int k = 0; k < 4; k++)
+      {
+         ostringstream avg_max;
+         avg_max << setprecision(3) << gsum[4*q + k] * s / nranks << "/"
+                 << gmax[4*q + k] * s;
+         cout << setw(20) << avg_max.str();
+      }
+      cout << endl;
+   }
+   cout.flags(flags);
+   cout.precision(precision);
+}
+
+// Adds an MPI call that started at t0 to the current phase.
+static void CountMPI(const double t0, const int collectives,
+                     const int messages, const int count,
+                     MPI_Datatype type)
+{
+   CommCounters &c = comm_counters[comm_phase];
+   c.time += PMPI_Wtime() - t0;
+   c.collectives += collectives;
+   c.messages += messages;
+   if (count > 0)
+   {
+      int size;
+      PMPI_Type_size(type, &size);
+      c.bytes += (long long) count * size;
+   }
+}
+
+} // namespace hydrodynamics
+
+} // namespace mfem
+
+#ifdef LAGHOS_MPI_PROFILE
+
+using mfem::hydrodynamics::CountMPI;
+
+// PMPI wrappers. The bytes are the ones sent by this rank (for the in-place
+// collectives, the size of the local contribution).
+extern "C"
+{
+
+int MPI_Send(const void *buf, int count, MPI_Datatype type, int dest,
+             int tag, MPI_Comm comm)
+{
+   const double t0 = PMPI_Wtime();
+   const int err = PMPI_Send(buf, count, type, dest, tag, comm);
+   CountMPI(t0, 0, 1, count, type);
+   return err;
+}
+
+int MPI_Isend(const void *buf, int count, MPI_Datatype type, int dest,
+              int tag, MPI_Comm comm, MPI_Request *request)
+{
+   const double t0 = PMPI_Wtime();
+   const int err = PMPI_Isend(buf, count, type, dest, tag, comm, request);
+   CountMPI(t0, 0, 1, count, type);
+   return err;
+}
+
+int MPI_Recv(void *buf, int count, MPI_Datatype type, int source, int tag,
+             MPI_Comm comm, MPI_Status *status)
+{
+   const double t0 = PMPI_Wtime();
+   const int err = PMPI_Recv(buf, count, type, source, tag, comm, status);
+   CountMPI(t0, 0, 0, 0, type);
+   return err;
+}
+
+int MPI_Irecv(void *buf, int count, MPI_Datatype type, int source, int tag,
+              MPI_Comm comm, MPI_Request *request)
+{
+   const double t0 = PMPI_Wtime();
+   const int err = PMPI_Irecv(buf, count, type, source, tag, comm, request);
+   CountMPI(t0, 0, 0, 0, type);
+   return err;
+}
+
+int MPI_Wait(MPI_Request *request, MPI_Status *status)
+{
+   const double t0 = PMPI_Wtime();
+   const int err = PMPI_Wait(request, status);
+   CountMPI(t0, 0, 0, 0, MPI_BYTE);
+   return err;
+}
+
+int MPI_Waitall(int count, MPI_Request requests[], MPI_Status statuses[])
+{
+   const double t0 = PMPI_Wtime();
+   const int err = PMPI_Waitall(count, requests, statuses);
+   CountMPI(t0, 0, 0, 0, MPI_BYTE);
+   return err;
+}
+
+int MPI_Waitany(int count, MPI_Request requests[], int *index,
+                MPI_Status *status)
+{
+   const double t0 = PMPI_Wtime();
+   const int err = PMPI_Waitany(count, requests, index, status);
+   CountMPI(t0, 0, 0, 0, MPI_BYTE);
+   return err;
+}
+
+int MPI_Waitsome(int incount, MPI_Request requests[], int *outcount,
+                 int indices[], MPI_Status statuses[])
+{
+   const double t0 = PMPI_Wtime();
+   const int err = PMPI_Waitsome(incount, requests, outcount, indices,
+                                 statuses);
+   CountMPI(t0, 0, 0, 0, MPI_BYTE);
+   return err;
+}
+
+int MPI_Test(MPI_Request *request, int *flag, MPI_Status *status)
+{
+   const double t0 = PMPI_Wtime();
+   const int err = PMPI_Test(request, flag, status);
+   CountMPI(t0, 0, 0, 0, MPI_BYTE);
+   return err;
+}
+
+int MPI_Testall(int count, MPI_Request requests[], int *flag,
+                MPI_Status statuses[])
+{
+   const double t0 = PMPI_Wtime();
+   const int err = PMPI_Testall(count, requests, flag, statuses);
+   CountMPI(t0, 0, 0, 0, MPI_BYTE);
+   return err;
+}
+
+int MPI_Sendrecv(const void *sendbuf, int sendcount, MPI_Datatype sendtype,
+                 int dest, int sendtag, void *recvbuf, int recvcount,
+                 MPI_Datatype recvtype, int source, int recvtag,
+                 MPI_Comm comm, MPI_Status *status)
+{
+   const double t0 = PMPI_Wtime();
+   const int err = PMPI_Sendrecv(sendbuf, sendcount, sendtype, dest, sendtag,
+                                 recvbuf, recvcount, recvtype, source,
+                                 recvtag, comm, status);
+   CountMPI(t0, 0, 1, sendcount, sendtype);
+   return err;
+}
+
+int MPI_Barrier(MPI_Comm comm)
+{
+   const double t0 = PMPI_Wtime();
+   const int err = PMPI_Barrier(comm);
+   CountMPI(t0, 1, 0, 0, MPI_BYTE);
+   return err;
+}
+
+int MPI_Bcast(void *buf, int count, MPI_Datatype type, int root,
+              MPI_Comm comm)
+{
+   const double t0 = PMPI_Wtime();
+   const int err = PMPI_Bcast(buf, count, type, root, comm);
+   CountMPI(t0, 1, 0, count, type);
+   return err;
+}
+
+int MPI_Ibcast(void *buf, int count, MPI_Datatype type, int root,
+               MPI_Comm comm, MPI_Request *request)
+{
+   const double t0 = PMPI_Wtime();
+   const int err = PMPI_Ibcast(buf, count, type, root, comm, request);
+   CountMPI(t0, 1, 0, count, type);
+   return err;
+}
+
+int MPI_Allreduce(const void *sendbuf, void *recvbuf, int count,
+                  MPI_Datatype type, MPI_Op op, MPI_Comm comm)
+{
+   const double t0 = PMPI_Wtime();
+   const int err = PMPI_Allreduce(sendbuf, recvbuf, count, type, op, comm);
+   CountMPI(t0, 1, 0, count, type);
+   return err;
+}
+
+int MPI_Iallreduce(const void *sendbuf, void *recvbuf, int count,
+                   MPI_Datatype type, MPI_Op op, MPI_Comm comm,
+                   MPI_Request *request)
+{
+   const double t0 = PMPI_Wtime();
+   const int err = PMPI_Iallreduce(sendbuf, recvbuf, count, type, op, comm,
+                                   request);
+   CountMPI(t0, 1, 0, count, type);
+   return err;
+}
+
+int MPI_Reduce(const void *sendbuf, void *recvbuf, int count,
+               MPI_Datatype type, MPI_Op op, int root, MPI_Comm comm)
+{
+   const double t0 = PMPI_Wtime();
+   const int err = PMPI_Reduce(sendbuf, recvbuf, count, type, op, root, comm);
+   CountMPI(t0, 1, 0, count, type);
+   return err;
+}
+
+int MPI_Scan(const void *sendbuf, void *recvbuf, int count,
+             MPI_Datatype type, MPI_Op op, MPI_Comm comm)
+{
+   const double t0 = PMPI_Wtime();
+   const int err = PMPI_Scan(sendbuf, recvbuf, count, type, op, comm);
+   CountMPI(t0, 1, 0, count, type);
+   return err;
+}
+
+int MPI_Allgather(const void *sendbuf, int sendcount, MPI_Datatype sendtype,
+                  void *recvbuf, int recvcount, MPI_Datatype recvtype,
+                  MPI_Comm comm)
+{
+   const double t0 = PMPI_Wtime();
+   const int err = PMPI_Allgather(sendbuf, sendcount, sendtype, recvbuf,
+                                  recvcount, recvtype, comm);
+   if (sendbuf == MPI_IN_PLACE) { CountMPI(t0, 1, 0, recvcount, recvtype); }
+   else { CountMPI(t0, 1, 0, sendcount, sendtype); }
+   return err;
+}
+
+int MPI_Allgatherv(const void *sendbuf, int sendcount, MPI_Datatype sendtype,
+                   void *recvbuf, const int recvcounts[], const int displs[],
+                   MPI_Datatype recvtype, MPI_Comm comm)
+{
+   const double t0 = PMPI_Wtime();
+   const int err = PMPI_Allgatherv(sendbuf, sendcount, sendtype, recvbuf,
+                                   recvcounts, displs, recvtype, comm);
+   if (sendbuf == MPI_IN_PLACE)
+   {
+      int rank;
+      PMPI_Comm_rank(comm, &rank);
+      CountMPI(t0, 1, 0, recvcounts[rank], recvtype);
+   }
+   else { CountMPI(t0, 1, 0, sendcount, sendtype); }
+   return err;
+}
+
+int MPI_Gather(const void *sendbuf, int sendcount, MPI_Datatype sendtype,
+               void *recvbuf, int recvcount, MPI_Datatype recvtype, int root,
+               MPI_Comm comm)
+{
+   const double t0 = PMPI_Wtime();
+   const int err = PMPI_Gather(sendbuf, sendcount, sendtype, recvbuf,
+                               recvcount, recvtype, root, comm);
+   if (sendbuf == MPI_IN_PLACE) { CountMPI(t0, 1, 0, recvcount, recvtype); }
+   else { CountMPI(t0, 1, 0, sendcount, sendtype); }
+   return err;
+}
+
+int MPI_Gatherv(const void *sendbuf, int sendcount, MPI_Datatype sendtype,
+                void *recvbuf, const int recvcounts[], const int displs[],
+                MPI_Datatype recvtype, int root, MPI_Comm comm)
+{
+   const double t0 = PMPI_Wtime();
+   const int err = PMPI_Gatherv(sendbuf, sendcount, sendtype, recvbuf,
+                                recvcounts, displs, recvtype, root, comm);
+   if (sendbuf == MPI_IN_PLACE) { CountMPI(t0, 1, 0, 0, recvtype); }
+   else { CountMPI(t0, 1, 0, sendcount, sendtype); }
+   return err;
+}
+
+int MPI_Alltoall(const void *sendbuf, int sendcount, MPI_Datatype sendtype,
+                 void *recvbuf, int recvcount, MPI_Datatype recvtype,
+                 MPI_Comm comm)
+{
+   const double t0 = PMPI_Wtime();
+   const int err = PMPI_Alltoall(sendbuf, sendcount, sendtype, recvbuf,
+                                 recvcount, recvtype, comm);
+   int nranks;
+   PMPI_Comm_size(comm, &nranks);
+   if (sendbuf == MPI_IN_PLACE)
+   {
+      CountMPI(t0, 1, 0, recvcount * nranks, recvtype);
+   }
+   else { CountMPI(t0, 1, 0, sendcount * nranks, sendtype); }
+   return err;
+}
+
+int MPI_Alltoallv(const void *sendbuf, const int sendcounts[],
+                  const int sdispls[], MPI_Datatype sendtype, void *recvbuf,
+                  const int recvcounts[], const int rdispls[],
+                  MPI_Datatype recvtype, MPI_Comm comm)
+{
+   const double t0 = PMPI_Wtime();
+   const int err = PMPI_Alltoallv(sendbuf, sendcounts, sdispls, sendtype,
+                                  recvbuf, recvcounts, rdispls, recvtype,
+                                  comm);
+   int nranks;
+   PMPI_Comm_size(comm, &nranks);
+   const bool in_place = (sendbuf == MPI_IN_PLACE);
+   const int *counts = in_place ? recvcounts : sendcounts;
+   int count = 0;
+   for (int r = 0; r < nranks; r++) { count += counts[r]; }
+   CountMPI(t0, 1, 0, count, in_place ? recvtype : sendtype);
+   return err;
+}
+
+} // extern "C"
+
+#endif // LAGHOS_MPI_PROFILE
@@ -0,0 +1,78 @@
+// Copyright (c) 2017, Lawrence Livermore National Security, LLC. Produced at
+// the Lawrence Livermore National Laboratory. LLNL-CODE-734707. All Rights
+// reserved. See files LICENSE and NOTICE for details.
+//
+// This file is part of CEED, a collection of benchmarks, miniapps, software
+// libraries and APIs for efficient high-order finite element and spectral
+// element discretizations for exascale applications. For more information and
+// source code availability see http://github.com/ceed.
+//
+// The CEED research is supported by the Exascale Computing Project 17-SC-20-SC,
+// a collaborative effort of two U.S. Department of Energy organizations (Office
+// of Science and the National Nuclear Security Administration) responsible for
+// the planning and preparation of a capable exascale ecosystem, including
+// software, applications, hardware, advanced system engineering and early
+// testbed platforms, in support of the nation's exascale computing imperative.
+
+#ifndef MFEM_LAGHOS_COMMPROF
+#define MFEM_LAGHOS_COMMPROF
+
+#include "mfem.hpp"
+
+namespace mfem
+{
+
+namespace hydrodynamics
+{
+
+// MPI traffic by solver phase. When Laghos is built with LAGHOS_MPI_PROFILE
+// (make MPI_PROFILE=YES), laghos_commprof.cpp defines PMPI wrappers of the
+// point-to-point, wait, test and (nonblocking) collective calls used by
+// Laghos, MFEM and hypre.
+// They count the calls, the sent bytes and the time spent in MPI, and add them
+// to the current phase. Without it, the phases are still tracked, but nothing
+// is counted.
+class CommProfile
+{
+public:
+   enum Phase { OTHER, CG_H1, CG_L2, FORCE, QDATA, TIME_STEP, OUTPUT,
+                NUM_PHASES
+              };
+
+   static bool Enabled();
+   // Sets the current phase, and returns the previous one.
+   static Phase SetPhase(Phase phase);
+   // Prints the collectives, messages, bytes and MPI time per time step of
+   // each phase, as the average and maximum over the ranks of comm.
+   static void Print(MPI_Comm comm, long long steps);
+
+   // Attributes the MPI calls to a phase until the end of the scope.
+   class Scope
+   {
+   private:
+      const Phase prev;
+   public:
+      Scope(Phase phase) : prev(SetPhase(phase)) { }
+      ~Scope() { SetPhase(prev); }
+   };
+};
+
+// StopWatch of one of the TimingData phases, which also attributes the MPI
+// calls made between Start() and Stop() to that phase.
+class PhaseWatch : public StopWatch
+{
+private:
+   const CommProfile::Phase phase;
+   CommProfile::Phase prev;
+public:
+   PhaseWatch(CommProfile::Phase phase)
+      : phase(phase), prev(CommProfile::OTHER) { }
+   void Start() { StopWatch::Start(); prev = CommProfile::SetPhase(phase); }
+   void Stop() { CommProfile::SetPhase(prev); StopWatch::Stop(); }
+};
+
+} // namespace hydrodynamics
+
+} // namespace mfem
+
+#endif // MFEM_LAGHOS_COMMPROF
@@ -0,0 +1,220 @@
+// Copyright (c) 2017, Lawrence Livermore National Security, LLC. Produced at
+// the Lawrence Livermore National Laboratory. LLNL-CODE-734707. All Rights
+// reserved. See files LICENSE and NOTICE for details.
+//
+// This file is part of CEED, a collection of benchmarks, miniapps, software
+// libraries and APIs for efficient high-order finite element and spectral
+// element discretizations for exascale applications. For more information and
+// source code availability see http://github.com/ceed.
+//
+// The CEED research is supported by the Exascale Computing Project 17-SC-20-SC,
+// a collaborative effort of two U.S. Department of Energy organizations (Office
+// of Science and the National Nuclear Security Administration) responsible for
+// the planning and preparation of a capable exascale ecosystem, including
+// software, applications, hardware, advanced system engineering and early
+// testbed platforms, in support of the nation's exascale computing imperative.
+
+#include "laghos_memory.hpp"
+#include <cstdlib>
+#include <cstring>
+#ifdef __linux__
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include <unistd.h>
+#endif
+
+namespace mfem
+{
+
+namespace hydrodynamics
+{
+
+static bool huge_page_arrays = false;
+static long hugetlb_bytes = 0, thp_bytes = 0;
+
+static const size_t huge_page_size = 2 << 20;
+static const size_t alignment = 64;
+
+void SetHugePageArrays(bool enable) { huge_page_arrays = enable; }
+
+bool HugePageArrays()
+{
+   return huge_page_arrays && Device::GetMemoryType() == MemoryType::HOST;
+}
+
+void GetHugePageBytes(long &hugetlb, long &thp)
+{
+   hugetlb = hugetlb_bytes;
+   thp = thp_bytes;
+}
+
+#ifdef __linux__
+// Prefers the NUMA node of the CPU running this rank for the pages of the
+// given range. Without the node, or on a kernel without NUMA support, the
+// pages stay with the default first-touch policy. MPOL_BIND is not used: with
+// it, the first touch of a page fails (SIGBUS for the hugetlbfs pages, which
+// are reserved from all the nodes) when the node is full, while the preferred
+// node only moves the pages that do not fit to another node.
+static void BindToLocalNode(void *ptr, size_t bytes)
+{
+   unsigned cpu, node;
+   if (syscall(SYS_getcpu, &cpu, &node, nullptr) != 0) { return; }
+   const int mpol_preferred = 1; // from <numaif.h>
+   const unsigned long max_node = 1024;
+   const int bits = 8 * sizeof(unsigned long);
+   unsigned long mask[max_node / bits] = { 0 };
+   if (node >= max_node) { return; }
+   mask[node / bits] = 1UL << (node % bits);
+   syscall(SYS_mbind, ptr, bytes, mpol_preferred, mask, max_node, 0);
+}
+
+// Maps whole huge pages: from the hugetlbfs pool if possible, or else 2 MB
+// aligned anonymous memory marked for transparent huge pages.
+static void *MapHugePages(size_t bytes)
+{
+   void *ptr = mmap(nullptr, bytes, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+   if (ptr != MAP_FAILED)
+   {
+      hugetlb_bytes += bytes;
+      return ptr;
+   }
+   // Over-allocate by one huge page, then unmap the unaligned head and tail.
+   char *raw = (char *) mmap(nullptr, bytes + huge_page_size,
+                             PROT_READ | PROT_WRITE,
+                             MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+   if (raw == MAP_FAILED) { return nullptr; }
+   const size_t head = (huge_page_size - (size_t) raw % huge_page_size) %
+                       huge_page_size;
+   if (head > 0) { munmap(raw, head); }
+   munmap(raw + head + bytes, huge_page_size - head);
+   madvise(raw + head, bytes, MADV_HUGEPAGE);
+   thp_bytes += bytes;
+   return raw + head;
+}
+#endif
+
+double *LargeArrays::Allocate(size_t size)
+{
+   Block block = { nullptr, size * sizeof(double), false };
+#ifdef __linux__
+   if (block.bytes >= huge_page_size)
+   {
+      block.bytes = (block.bytes + huge_page_size - 1) / huge_page_size *
+                    huge_page_size;
+      block.ptr = MapHugePages(block.bytes);
+      block.mapped = block.ptr != nullptr;
+      if (block.mapped) { BindToLocalNode(block.ptr, block.bytes); }
+   }
+#endif
+   if (!block.mapped)
+   {
+      const size_t bytes = block.bytes > 0 ? block.bytes : alignment;
+      MFEM_VERIFY(posix_memalign(&block.ptr, alignment, bytes) == 0,
+                  "Cannot allocate " << bytes << " bytes!");
+   }
+   blocks.push_back(block);
+   return static_cast<double *>(block.ptr);
+}
+
+void LargeArrays::Release(const Block &block)
+{
+#ifdef __linux__
+   if (block.mapped) { munmap(block.ptr, block.bytes); return; }
+#endif
+   free(block.ptr);
+}
+
+LargeArrays::~LargeArrays()
+{
+   for (const Block &block : blocks) { Release(block); }
+}
+
+void LargeArrays::Free(Vector &v)
+{
+   const double *data = v.GetData();
+   v.Destroy();
+   for (size_t b = 0; b < blocks.size(); b++)
+   {
+      if (blocks[b].ptr != data) { continue; }
+      Release(blocks[b]);
+      blocks.erase(blocks.begin() + b);
+      return;
+   }
+}
+
+void LargeArrays::Allocate(Vector &v, int size)
+{
+   if (!HugePageArrays()) { v.SetSize(size); return; }
+   v.NewDataAndSize(Allocate(size), size);
+}
+
+void LargeArrays::Allocate(DenseTensor &t, int i, int j, int k)
+{
+   if (!HugePageArrays()) { t.SetSize(i, j, k); return; }
+   t.UseExternalData(Allocate((size_t) i * j * k), i, j, k);
+}
+
+void LargeArrays::Allocate(BlockVector &v, const Array<int> &offsets)
+{
+   if (HugePageArrays()) { v.Update(Allocate(offsets[offsets.Size() - 1]), offsets); }
+   else { v.Update(offsets, Device::GetMemoryType()); }
+}
+
+TLBMissCounter::TLBMissCounter() : fd(-1)
+{
+#ifdef __linux__
+   perf_event_attr attr;
+   memset(&attr, 0, sizeof(attr));
+   attr.size = sizeof(attr);
+   attr.type = PERF_TYPE_HW_CACHE;
+   attr.config = PERF_COUNT_HW_CACHE_DTLB |
+                 (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                 (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+   attr.disabled = 1;
+   attr.exclude_kernel = 1;
+   attr.exclude_hv = 1;
+   fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+#endif
+}
+
+TLBMissCounter::~TLBMissCounter()
+{
+#ifdef __linux__
+   if (fd >= 0) { close(fd); }
+#endif
+}
+
+void TLBMissCounter::Start()
+{
+#ifdef __linux__
+   if (fd < 0) { return; }
+   ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+   ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+#endif
+}
+
+void TLBMissCounter::Stop()
+{
+#ifdef __linux__
+   if (fd >= 0) { ioctl(fd, PERF_EVENT_IOC_DISABLE, 0); }
+#endif
+}
+
+long long TLBMissCounter::Count() const
+{
+   long long count = 0;
+#ifdef __linux__
+   if (fd >= 0 && read(fd, &count, sizeof(count)) != sizeof(count))
+   {
+      count = 0;
+   }
+#endif
+   return count;
+}
+
+} // namespace hydrodynamics
+
+} // namespace mfem
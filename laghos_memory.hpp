@@ -0,0 +1,89 @@
+// Copyright (c) 2017, Lawrence Livermore National Security, LLC. Produced at
+// the Lawrence Livermore National Laboratory. LLNL-CODE-734707. All Rights
+// reserved. See files LICENSE and NOTICE for details.
+//
+// This file is part of CEED, a collection of benchmarks, miniapps, software
+// libraries and APIs for efficient high-order finite element and spectral
+// element discretizations for exascale applications. For more information and
+// source code availability see http://github.com/ceed.
+//
+// The CEED research is supported by the Exascale Computing Project 17-SC-20-SC,
+// a collaborative effort of two U.S. Department of Energy organizations (Office
+// of Science and the National Nuclear Security Administration) responsible for
+// the planning and preparation of a capable exascale ecosystem, including
+// software, applications, hardware, advanced system engineering and early
+// testbed platforms, in support of the nation's exascale computing imperative.
+
+#ifndef MFEM_LAGHOS_MEMORY
+#define MFEM_LAGHOS_MEMORY
+
+#include "mfem.hpp"
+#include <vector>
+
+namespace mfem
+{
+
+namespace hydrodynamics
+{
+
+// Allocation policy of the large solver arrays (state, quadrature data and
+// QUpdate scratch). When enabled, the arrays of at least one huge page are
+// mapped from the hugetlbfs pool if it has free pages, or else aligned to 2 MB
+// and marked for transparent huge pages with madvise. Their pages prefer the
+// NUMA node of the calling rank (MPOL_PREFERRED), and come from the other
+// nodes when it is full. The smaller arrays are aligned to 64
+// bytes. The policy applies to the arrays allocated after it is set, and only
+// to host memory: with a GPU device, the arrays are allocated by mfem::Memory.
+void SetHugePageArrays(bool enable);
+bool HugePageArrays();
+
+// Bytes mapped from hugetlbfs and with transparent huge pages on this rank.
+void GetHugePageBytes(long &hugetlb, long &thp);
+
+// Owner of the arrays allocated with the policy above. Without the policy, the
+// arrays are allocated as usual, and own their data.
+class LargeArrays
+{
+private:
+   struct Block { void *ptr; size_t bytes; bool mapped; };
+   std::vector<Block> blocks;
+
+   double *Allocate(size_t size);
+   static void Release(const Block &block);
+
+public:
+   LargeArrays() { }
+   LargeArrays(const LargeArrays &) = delete;
+   LargeArrays &operator=(const LargeArrays &) = delete;
+   ~LargeArrays();
+
+   void Allocate(Vector &v, int size);
+   void Allocate(DenseTensor &t, int i, int j, int k);
+   void Allocate(BlockVector &v, const Array<int> &offsets);
+   // Releases the block of v, if it was allocated here, and leaves v empty.
+   // Used before a new allocation of v, e.g., after a repartitioning.
+   void Free(Vector &v);
+};
+
+// Data TLB load misses of this process, from the Linux perf events. Available()
+// is false when the counter cannot be opened (not Linux, no hardware counter,
+// or restricted by perf_event_paranoid).
+class TLBMissCounter
+{
+private:
+   int fd;
+
+public:
+   TLBMissCounter();
+   ~TLBMissCounter();
+   bool Available() const { return fd >= 0; }
+   void Start();
+   void Stop();
+   long long Count() const;
+};
+
+} // namespace hydrodynamics
+
+} // namespace mfem
+
+#endif // MFEM_LAGHOS_MEMORY
@@ -0,0 +1,145 @@
+// Copyright (c) 2017, Lawrence Livermore National Security, LLC. Produced at
+// the Lawrence Livermore National Laboratory. LLNL-CODE-734707. All Rights
+// reserved. See files LICENSE and NOTICE for details.
+//
+// This file is part of CEED, a collection of benchmarks, miniapps, software
+// libraries and APIs for efficient high-order finite element and spectral
+// element discretizations for exascale applications. For more information and
+// source code availability see http://github.com/ceed.
+//
+// The CEED research is supported by the Exascale Computing Project 17-SC-20-SC,
+// a collaborative effort of two U.S. Department of Energy organizations (Office
+// of Science and the National Nuclear Security Administration) responsible for
+// the planning and preparation of a capable exascale ecosystem, including
+// software, applications, hardware, advanced system engineering and early
+// testbed platforms, in support of the nation's exascale computing imperative.
+
+#include "laghos_nodetable.hpp"
+#include <climits>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+namespace mfem
+{
+
+namespace hydrodynamics
+{
+
+NodeSharedTable::LocalRows::LocalRows(int w) : w(w)
+{
+   MFEM_VERIFY(w > 0, "The rows of the node table cannot be empty!");
+}
+
+int NodeSharedTable::LocalRows::Add(const double *r)
+{
+   size_t key = 0;
+   for (int k = 0; k < w; k++)
+   {
+      long long v;
+      std::memcpy(&v, r + k, sizeof(v));
+      key ^= std::hash<long long>()(v) + 0x9e3779b9 + (key << 6) + (key >> 2);
+   }
+   std::vector<int> &bucket = buckets[key];
+   for (int c : bucket)
+   {
+      const double *rc = rows.data() + (size_t) c * w;
+      if (std::memcmp(r, rc, (size_t) w * sizeof(double)) == 0)
+      {
+         index.push_back(c);
+         return c;
+      }
+   }
+   const int c = Kept();
+   MFEM_VERIFY((long long) (c + 1) * w <= INT_MAX,
+               "The node table is too large!");
+   bucket.push_back(c);
+   rows.insert(rows.end(), r, r + w);
+   index.push_back(c);
+   return c;
+}
+
+NodeSharedTable::NodeSharedTable(MPI_Comm comm, const LocalRows &local,
+                                 Array<int> &index)
+{
+   const int w = local.Width(), n = local.Added(), nu = local.Kept();
+   int myid;
+   MPI_Comm_rank(comm, &myid);
+   MPI_Comm node;
+   MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, myid, MPI_INFO_NULL,
+                       &node);
+   int node_rank, node_size;
+   MPI_Comm_rank(node, &node_rank);
+   MPI_Comm_size(node, &node_size);
+
+   // The kept rows of the ranks are merged on the first rank of the node.
+   std::vector<int> counts(node_size), displs(node_size);
+   MPI_Gather(&nu, 1, MPI_INT, counts.data(), 1, MPI_INT, 0, node);
+   std::vector<double> gathered;
+   std::vector<int> node_cls, vcounts(node_size), vdispls(node_size);
+   LocalRows merged(w);
+   if (node_rank == 0)
+   {
+      long long total = 0;
+      for (int r = 0; r < node_size; r++)
+      {
+         displs[r] = (int) total;
+         vdispls[r] = (int) (total * w);
+         vcounts[r] = counts[r] * w;
+         total += counts[r];
+      }
+      MFEM_VERIFY(total * w <= INT_MAX, "The node table is too large!");
+      gathered.resize((size_t) total * w);
+      node_cls.resize(total);
+   }
+   MPI_Gatherv(local.Data(), nu * w, MPI_DOUBLE, gathered.data(),
+               vcounts.data(), vdispls.data(), MPI_DOUBLE, 0, node);
+   if (node_rank == 0)
+   {
+      for (size_t i = 0; i < node_cls.size(); i++)
+      {
+         node_cls[i] = merged.Add(gathered.data() + i * w);
+      }
+      std::vector<double>().swap(gathered);
+      rows = merged.Kept();
+   }
+   std::vector<int> node_index(nu);
+   MPI_Scatterv(node_cls.data(), counts.data(), displs.data(), MPI_INT,
+                node_index.data(), nu, MPI_INT, 0, node);
+   MPI_Bcast(&rows, 1, MPI_INT, 0, node);
+   index.SetSize(n);
+   for (int i = 0; i < n; i++) { index[i] = node_index[local.Index()[i]]; }
+
+   // The first rank of the node allocates and fills the table.
+   const MPI_Aint bytes =
+      (node_rank == 0) ? (MPI_Aint) rows * w * sizeof(double) : 0;
+   double *base;
+   MPI_Win_allocate_shared(bytes, sizeof(double), MPI_INFO_NULL, node, &base,
+                           &win);
+   MPI_Aint size;
+   int disp_unit;
+   MPI_Win_shared_query(win, 0, &size, &disp_unit, &data);
+   MPI_Win_fence(0, win);
+   if (node_rank == 0)
+   {
+      std::copy(merged.Data(), merged.Data() + (size_t) rows * w, data);
+   }
+   MPI_Win_fence(0, win);
+
+   long long loc[2] = { (long long) n * w * (long long) sizeof(double),
+                        (long long) n * (long long) sizeof(int)
+                      }, sums[2];
+   MPI_Allreduce(loc, sums, 2, MPI_LONG_LONG, MPI_SUM, node);
+   node_bytes_in = sums[0];
+   node_bytes = (long long) rows * w * sizeof(double) + sums[1];
+   MPI_Comm_free(&node);
+}
+
+NodeSharedTable::~NodeSharedTable()
+{
+   MPI_Win_free(&win);
+}
+
+} // namespace hydrodynamics
+
+} // namespace mfem
@@ -0,0 +1,89 @@
+// Copyright (c) 2017, Lawrence Livermore National Security, LLC. Produced at
+// the Lawrence Livermore National Laboratory. LLNL-CODE-734707. All Rights
+// reserved. See files LICENSE and NOTICE for details.
+//
+// This file is part of CEED, a collection of benchmarks, miniapps, software
+// libraries and APIs for efficient high-order finite element and spectral
+// element discretizations for exascale applications. For more information and
+// source code availability see http://github.com/ceed.
+//
+// The CEED research is supported by the Exascale Computing Project 17-SC-20-SC,
+// a collaborative effort of two U.S. Department of Energy organizations (Office
+// of Science and the National Nuclear Security Administration) responsible for
+// the planning and preparation of a capable exascale ecosystem, including
+// software, applications, hardware, advanced system engineering and early
+// testbed platforms, in support of the nation's exascale computing imperative.
+
+#ifndef MFEM_LAGHOS_NODETABLE
+#define MFEM_LAGHOS_NODETABLE
+
+#include "mfem.hpp"
+#include <unordered_map>
+#include <vector>
+
+namespace mfem
+{
+
+namespace hydrodynamics
+{
+
+// Read-only table of rows of doubles, stored once per compute node. The rows
+// given by the ranks of a node are merged when they are bitwise equal, and the
+// unique ones are kept in an MPI shared memory window of the node. Each rank
+// accesses them through an index per local row. Since only equal rows are
+// merged, the values seen by a rank do not depend on the ranks it shares its
+// node with.
+class NodeSharedTable
+{
+public:
+   // Rows of width w added one at a time, e.g., zone by zone as they are
+   // computed, of which only the bitwise distinct ones are kept. The rows are
+   // hashed by their bits, so that each row is compared with the few kept
+   // rows of the same hash only.
+   class LocalRows
+   {
+   private:
+      const int w;
+      // Kept rows, and index of the kept row of each added row.
+      std::vector<double> rows;
+      std::vector<int> index;
+      std::unordered_map<size_t, std::vector<int>> buckets;
+   public:
+      LocalRows(int w);
+      // Adds the row r, and returns the index of its kept row.
+      int Add(const double *r);
+      int Width() const { return w; }
+      int Added() const { return (int) index.size(); }
+      int Kept() const { return (int) (rows.size() / w); }
+      const double *Data() const { return rows.data(); }
+      const std::vector<int> &Index() const { return index; }
+   };
+
+private:
+   MPI_Win win;
+   double *data;
+   int rows;
+   // Bytes of the rows given by the ranks of the node, and of the shared
+   // table together with the row indices.
+   long long node_bytes_in, node_bytes;
+
+public:
+   // Collective over comm. index[i] gets the row of the shared table equal to
+   // the i-th row added to local.
+   NodeSharedTable(MPI_Comm comm, const LocalRows &local, Array<int> &index);
+   ~NodeSharedTable();
+
+   // The table, shared by the ranks of the node. It must not be modified.
+   double *GetData() const { return data; }
+   int Rows() const { return rows; }
+
+   // Memory of the node before and after the sharing.
+   long long NodeBytesIn() const { return node_bytes_in; }
+   long long NodeBytes() const { return node_bytes; }
+};
+
+} // namespace hydrodynamics
+
+} // namespace mfem
+
+#endif // MFEM_LAGHOS_NODETABLE
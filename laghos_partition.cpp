@@ -0,0 +1,587 @@
+// Copyright (c) 2017, Lawrence Livermore National Security, LLC. Produced at
+// the Lawrence Livermore National Laboratory. LLNL-CODE-734707. All Rights
+// reserved. See files LICENSE and NOTICE for details.
+//
+// This file is part of CEED, a collection of benchmarks, miniapps, software
+// libraries and APIs for efficient high-order finite element and spectral
+// element discretizations for exascale applications. For more information and
+// source code availability see http://github.com/ceed.
+//
+// The CEED research is supported by the Exascale Computing Project 17-SC-20-SC,
+// a collaborative effort of two U.S. Department of Energy organizations (Office
+// of Science and the National Nuclear Security Administration) responsible for
+// the planning and preparation of a capable exascale ecosystem, including
+// software, applications, hardware, advanced system engineering and early
+// testbed platforms, in support of the nation's exascale computing imperative.
+
+#include "laghos_partition.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <sstream>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace mfem
+{
+
+namespace hydrodynamics
+{
+
+// Node index of each rank, and the ranks of each node in node-local order.
+struct NodeLayout
+{
+   int nodes, ranks_per_node;
+   Array<int> node_of, rank_of;
+};
+
+// Returns false if the nodes have different numbers of ranks.
+static bool GetNodeLayout(MPI_Comm comm, NodeLayout &layout)
+{
+   int myid, num_tasks;
+   MPI_Comm_rank(comm, &myid);
+   MPI_Comm_size(comm, &num_tasks);
+   MPI_Comm node_comm, leader_comm;
+   MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, myid, MPI_INFO_NULL,
+                       &node_comm);
+   int node_rank, node_size, node_min, node_max;
+   MPI_Comm_rank(node_comm, &node_rank);
+   MPI_Comm_size(node_comm, &node_size);
+   MPI_Allreduce(&node_size, &node_min, 1, MPI_INT, MPI_MIN, comm);
+   MPI_Allreduce(&node_size, &node_max, 1, MPI_INT, MPI_MAX, comm);
+
+   // The node index is the rank of the node leader among the leaders.
+   int node = 0;
+   MPI_Comm_split(comm, node_rank == 0 ? 0 : MPI_UNDEFINED, myid, &leader_comm);
+   if (leader_comm != MPI_COMM_NULL)
+   {
+      MPI_Comm_rank(leader_comm, &node);
+      MPI_Comm_free(&leader_comm);
+   }
+   MPI_Bcast(&node, 1, MPI_INT, 0, node_comm);
+   MPI_Comm_free(&node_comm);
+   if (node_min != node_max) { return false; }
+
+   int mine[2] = { node, node_rank };
+   Array<int> all(2*num_tasks);
+   MPI_Allgather(mine, 2, MPI_INT, all.GetData(), 2, MPI_INT, comm);
+   layout.ranks_per_node = node_size;
+   layout.nodes = num_tasks / node_size;
+   layout.node_of.SetSize(num_tasks);
+   layout.rank_of.SetSize(num_tasks);
+   for (int r = 0; r < num_tasks; r++)
+   {
+      layout.node_of[r] = all[2*r];
+      layout.rank_of[all[2*r]*node_size + all[2*r+1]] = r;
+   }
+   return true;
+}
+
+// Splits a box with the given extents into n sub-boxes, n = split[0]*...,
+// minimizing the total area of the cuts.
+static void BoxSplit(const int n, const int dim, const double *ext, int *split)
+{
+   double best = std::numeric_limits<double>::infinity();
+   for (int a = 1; a <= n; a++)
+   {
+      if (n % a) { continue; }
+      for (int b = 1; b <= n / a; b++)
+      {
+         if ((n / a) % b) { continue; }
+         const int c = n / a / b;
+         if ((dim < 2 && b*c > 1) || (dim < 3 && c > 1)) { continue; }
+         const int s[3] = { a, b, c };
+         double area = 0.0;
+         for (int d = 0; d < dim; d++)
+         {
+            double cut = s[d] - 1;
+            for (int e = 0; e < dim; e++) { if (e != d) { cut *= ext[e]; } }
+            area += cut;
+         }
+         if (area < best)
+         {
+            best = area;
+            for (int d = 0; d < dim; d++) { split[d] = s[d]; }
+         }
+      }
+   }
+}
+
+// First zone of each of the n slabs of a row of nz zones, as even as possible.
+static int SlabStart(const int nz, const int n, const int s)
+{
+   return s * (nz / n) + std::min(s, nz % n);
+}
+
+int *AutoCartesianPartitioning(Mesh &mesh, const int num_tasks,
+                               const bool report)
+{
+   // Grid index of each zone: rank of its center among the distinct center
+   // coordinates of each direction.
+   const int dim = mesh.Dimension(), NE = mesh.GetNE();
+   Vector pmin, pmax, center(dim);
+   mesh.GetBoundingBox(pmin, pmax, 0);
+   std::vector<double> coords[3];
+   Array<int> idx(NE * dim);
+   for (int e = 0; e < NE; e++)
+   {
+      mesh.GetElementCenter(e, center);
+      for (int d = 0; d < dim; d++) { coords[d].push_back(center(d)); }
+   }
+   std::vector<double> grid[3];
+   long nz[3] = { 1, 1, 1 }, zones = 1;
+   for (int d = 0; d < dim; d++)
+   {
+      const double tol = 1e-8 * (pmax(d) - pmin(d));
+      grid[d] = coords[d];
+      std::sort(grid[d].begin(), grid[d].end());
+      auto close = [tol](double a, double b) { return b - a <= tol; };
+      grid[d].erase(std::unique(grid[d].begin(), grid[d].end(), close),
+                    grid[d].end());
+      for (int e = 0; e < NE; e++)
+      {
+         idx[e*dim + d] = std::lower_bound(grid[d].begin(), grid[d].end(),
+                                           coords[d][e] - tol) -
+                          grid[d].begin();
+      }
+      nz[d] = grid[d].size();
+      zones *= nz[d];
+   }
+   if (zones != NE) { return nullptr; }
+
+   // Rank grid: smallest largest box, then fewest cut faces.
+   int split[3] = { 1, 1, 1 };
+   long best_zones = -1, best_cut = -1;
+   for (int a = 1; a <= num_tasks; a++)
+   {
+      if (num_tasks % a) { continue; }
+      for (int b = 1; b <= num_tasks / a; b++)
+      {
+         if ((num_tasks / a) % b) { continue; }
+         const int c = num_tasks / a / b;
+         if ((dim < 2 && b*c > 1) || (dim < 3 && c > 1)) { continue; }
+         const int s[3] = { a, b, c };
+         bool fits = true;
+         long box = 1, cut = 0;
+         for (int d = 0; d < dim; d++)
+         {
+            fits = fits && s[d] <= nz[d];
+            box *= (nz[d] + s[d] - 1) / s[d];
+            cut += (s[d] - 1) * zones / nz[d];
+         }
+         if (!fits) { continue; }
+         if (best_zones < 0 || box < best_zones ||
+             (box == best_zones && cut < best_cut))
+         {
+            best_zones = box;
+            best_cut = cut;
+            for (int d = 0; d < dim; d++) { split[d] = s[d]; }
+         }
+      }
+   }
+   MFEM_VERIFY(best_zones > 0, "Too many ranks (" << num_tasks
+               << ") for " << NE << " zones!");
+
+   // Slab of each grid index, in each direction.
+   Array<int> slab_of[3];
+   for (int d = 0; d < dim; d++)
+   {
+      slab_of[d].SetSize(nz[d]);
+      for (int s = 0; s < split[d]; s++)
+      {
+         const int end = SlabStart(nz[d], split[d], s + 1);
+         for (int i = SlabStart(nz[d], split[d], s); i < end; i++)
+         {
+            slab_of[d][i] = s;
+         }
+      }
+   }
+   int *partitioning = new int[NE];
+   for (int e = 0; e < NE; e++)
+   {
+      int rank = 0;
+      for (int d = dim - 1; d >= 0; d--)
+      {
+         rank = rank * split[d] + slab_of[d][idx[e*dim + d]];
+      }
+      partitioning[e] = rank;
+   }
+   if (!report) { return partitioning; }
+
+   // Halo of the largest box: its cut faces, with interior boxes on both
+   // sides in each split direction.
+   long max_halo = 0;
+   for (int d = 0; d < dim; d++)
+   {
+      long faces = (split[d] > 2) ? 2 : split[d] - 1;
+      for (int e = 0; e < dim; e++)
+      {
+         if (e != d) { faces *= (nz[e] + split[e] - 1) / split[e]; }
+      }
+      max_halo += faces;
+   }
+   using namespace std;
+   cout << "Automatic Cartesian partitioning of " << nz[0];
+   for (int d = 1; d < dim; d++) { cout << " x " << nz[d]; }
+   cout << " zones by " << split[0];
+   for (int d = 1; d < dim; d++) { cout << " x " << split[d]; }
+   cout << " ranks" << endl;
+   cout << "Zone imbalance (max/avg): "
+        << double(best_zones) * num_tasks / NE
+        << ", cut faces: " << best_cut << ", largest rank halo: "
+        << max_halo << " faces" << endl;
+   return partitioning;
+}
+
+int *NodeAwarePartitioning(MPI_Comm comm, Mesh &mesh)
+{
+   NodeLayout layout;
+   if (!GetNodeLayout(comm, layout)) { return nullptr; }
+
+   const int dim = mesh.Dimension();
+   Vector pmin, pmax, center(dim);
+   mesh.GetBoundingBox(pmin, pmax, 0);
+   double ext[3], node_ext[3];
+   for (int d = 0; d < dim; d++) { ext[d] = pmax(d) - pmin(d); }
+   int nodes_xyz[3] = { 1, 1, 1 }, ranks_xyz[3] = { 1, 1, 1 };
+   BoxSplit(layout.nodes, dim, ext, nodes_xyz);
+   for (int d = 0; d < dim; d++) { node_ext[d] = ext[d] / nodes_xyz[d]; }
+   BoxSplit(layout.ranks_per_node, dim, node_ext, ranks_xyz);
+
+   const int NE = mesh.GetNE();
+   int *partitioning = new int[NE];
+   for (int e = 0; e < NE; e++)
+   {
+      mesh.GetElementCenter(e, center);
+      int node = 0, local = 0;
+      for (int d = dim - 1; d >= 0; d--)
+      {
+         const int n = nodes_xyz[d] * ranks_xyz[d];
+         int idx = (int) floor(n * (center(d) - pmin(d)) / ext[d]);
+         idx = std::min(std::max(idx, 0), n - 1);
+         node = node * nodes_xyz[d] + idx / ranks_xyz[d];
+         local = local * ranks_xyz[d] + idx % ranks_xyz[d];
+      }
+      partitioning[e] = layout.rank_of[node * layout.ranks_per_node + local];
+   }
+   return partitioning;
+}
+
+void PrintPartitionReport(ParMesh &pmesh, const ParFiniteElementSpace &H1)
+{
+   const MPI_Comm comm = pmesh.GetComm();
+   const int myid = pmesh.GetMyRank(), num_tasks = pmesh.GetNRanks();
+   NodeLayout layout;
+   const bool uniform = GetNodeLayout(comm, layout);
+   if (!uniform)
+   {
+      // Only the node of each rank is needed for the report. The nodes are
+      // identified by the rank of their first rank.
+      MPI_Comm node_comm;
+      MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, myid, MPI_INFO_NULL,
+                          &node_comm);
+      int node = myid;
+      MPI_Bcast(&node, 1, MPI_INT, 0, node_comm);
+      MPI_Comm_free(&node_comm);
+      layout.node_of.SetSize(num_tasks);
+      MPI_Allgather(&node, 1, MPI_INT, layout.node_of.GetData(), 1, MPI_INT,
+                    comm);
+   }
+
+   // Shared faces per neighbor rank.
+   pmesh.ExchangeFaceNbrData();
+   std::map<int, int> faces_of;
+   const int nsf = pmesh.GetNSharedFaces();
+   for (int sf = 0; sf < nsf; sf++)
+   {
+      int e1, e2;
+      pmesh.GetFaceElements(pmesh.GetSharedFace(sf), &e1, &e2);
+      const int nbr_el = -1 - e2;
+      int fn = 0;
+      while (pmesh.face_nbr_elements_offset[fn+1] <= nbr_el) { fn++; }
+      faces_of[pmesh.GetFaceNbrRank(fn)]++;
+   }
+   int data[5] = { (int) faces_of.size(), 0, 0,
+                   H1.GetVSize() - H1.GetTrueVSize(), pmesh.GetNE()
+                 };
+   for (const auto &nf : faces_of)
+   {
+      const bool same_node = layout.node_of[nf.first] == layout.node_of[myid];
+      data[same_node ? 1 : 2] += nf.second;
+   }
+
+   Array<int> all(myid == 0 ? 5*num_tasks : 0);
+   MPI_Gather(data, 5, MPI_INT, all.GetData(), 5, MPI_INT, 0, comm);
+   if (myid != 0) { return; }
+
+   using namespace std;
+   const ios_base::fmtflags flags = cout.flags();
+   const streamsize precision = cout.precision();
+   // Per-rank lines only for moderate numbers of ranks.
+   const int max_lines = 64;
+   cout << endl << "Partition report:" << endl;
+   if (num_tasks <= max_lines)
+   {
+      cout << "  rank  node  zones  neighbors  intra faces  inter faces"
+           << "  ghost H1 dofs" << endl;
+      for (int r = 0; r < num_tasks; r++)
+      {
+         const int *d = &all[5*r];
+         cout << setw(6) << r << setw(6) << layout.node_of[r]
+              << setw(7) << d[4] << setw(11) << d[0] << setw(13) << d[1]
+              << setw(13) << d[2] << setw(15) << d[3] << endl;
+      }
+   }
+   long total[5] = { 0, 0, 0, 0, 0 };
+   int dmin[5], dmax[5];
+   for (int k = 0; k < 5; k++) { dmin[k] = dmax[k] = all[k]; }
+   for (int r = 0; r < num_tasks; r++)
+   {
+      for (int k = 0; k < 5; k++)
+      {
+         total[k] += all[5*r+k];
+         dmin[k] = std::min(dmin[k], all[5*r+k]);
+         dmax[k] = std::max(dmax[k], all[5*r+k]);
+      }
+   }
+   const char *names[5] = { "neighbors", "intra-node faces",
+                            "inter-node faces", "ghost H1 dofs", "zones"
+                          };
+   for (int k = 0; k < 5; k++)
+   {
+      cout << setw(18) << names[k] << " min/avg/max: " << dmin[k] << " "
+           << fixed << setprecision(1) << double(total[k]) / num_tasks
+           << " " << dmax[k] << endl;
+   }
+   // Each shared face is counted by both of its ranks.
+   const long faces = total[1] + total[2];
+   cout << "Shared faces: " << faces / 2 << ", inter-node fraction: "
+        << setprecision(3) << (faces ? double(total[2]) / faces : 0.0)
+        << endl << endl;
+   cout.flags(flags);
+   cout.precision(precision);
+}
+
+static const char par_mesh_magic[8] = {'L','G','H','S','P','M','S','2'};
+
+struct ParMeshHeader
+{
+   char magic[sizeof(par_mesh_magic)];
+   int num_ranks, rank;
+   // Sizes of the text part (bytes) and of the binary coordinates (doubles).
+   long size, coords;
+};
+
+// The coordinates that define the geometry of the mesh: the nodes of a curved
+// mesh, else the vertices, which MFEM stores contiguously with 3 each.
+static void MeshCoordinates(ParMesh &pmesh, double *&data, long &size)
+{
+   if (GridFunction *nodes = pmesh.GetNodes())
+   {
+      data = nodes->HostReadWrite();
+      size = nodes->Size();
+   }
+   else
+   {
+      data = pmesh.GetNV() > 0 ? pmesh.GetVertex(0) : nullptr;
+      size = (long) pmesh.GetNV() * 3;
+   }
+}
+
+static std::string ParMeshFilename(MPI_Comm comm, const char *basename)
+{
+   int myid;
+   MPI_Comm_rank(comm, &myid);
+   return MakeParFilename(std::string(basename) + ".", myid);
+}
+
+void WritePartitionedMesh(ParMesh &pmesh, const char *basename)
+{
+   const std::string filename = ParMeshFilename(pmesh.GetComm(), basename);
+   std::ostringstream mesh_os;
+   mesh_os.precision(std::numeric_limits<double>::max_digits10);
+   pmesh.ParPrint(mesh_os);
+   const std::string mesh_str = mesh_os.str();
+   double *coords;
+   long coords_size;
+   MeshCoordinates(pmesh, coords, coords_size);
+
+   ParMeshHeader header;
+   std::memcpy(header.magic, par_mesh_magic, sizeof(par_mesh_magic));
+   header.num_ranks = pmesh.GetNRanks();
+   header.rank = pmesh.GetMyRank();
+   header.size = mesh_str.size();
+   header.coords = coords_size;
+   std::ofstream os(filename.c_str(), std::ios::binary);
+   os.write((const char *) &header, sizeof(header));
+   os.write(mesh_str.data(), header.size);
+   os.write((const char *) coords, coords_size * sizeof(double));
+   MFEM_VERIFY(os.good(), "Error writing the mesh file " << filename);
+}
+
+// Input buffer over the memory-mapped file, so that the mesh is parsed without
+// copying the file contents.
+class MappedBuffer : public std::streambuf
+{
+public:
+   MappedBuffer(char *data, long size) { setg(data, data, data + size); }
+};
+
+ParMesh *ReadPartitionedMesh(MPI_Comm comm, const char *basename)
+{
+   int myid, num_tasks;
+   MPI_Comm_rank(comm, &myid);
+   MPI_Comm_size(comm, &num_tasks);
+   const std::string filename = ParMeshFilename(comm, basename);
+   const int fd = open(filename.c_str(), O_RDONLY);
+   MFEM_VERIFY(fd >= 0, "Cannot open the mesh file " << filename);
+   struct stat st;
+   MFEM_VERIFY(fstat(fd, &st) == 0 &&
+               st.st_size >= (off_t) sizeof(ParMeshHeader),
+               "Not a Laghos partitioned mesh file: " << filename);
+   void *map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+   close(fd);
+   MFEM_VERIFY(map != MAP_FAILED, "Cannot map the mesh file " << filename);
+
+   char *data = static_cast<char *>(map);
+   ParMeshHeader header;
+   std::memcpy(&header, data, sizeof(header));
+   const long coords_offset = sizeof(header) + header.size;
+   MFEM_VERIFY(std::memcmp(header.magic, par_mesh_magic,
+                           sizeof(par_mesh_magic)) == 0 &&
+               coords_offset + header.coords * (long) sizeof(double) <=
+               (long) st.st_size,
+               "Not a Laghos partitioned mesh file: " << filename);
+   MFEM_VERIFY(header.num_ranks == num_tasks && header.rank == myid,
+               "The mesh file " << filename << " was written for "
+               << header.num_ranks << " ranks, expected " << num_tasks);
+   MappedBuffer buffer(data + sizeof(header), header.size);
+   std::istream is(&buffer);
+   ParMesh *pmesh = new ParMesh(comm, is);
+   // The binary coordinates replace the parsed ones, so that the geometry is
+   // bitwise the one of the writing run.
+   double *coords;
+   long coords_size;
+   MeshCoordinates(*pmesh, coords, coords_size);
+   MFEM_VERIFY(coords_size == header.coords,
+               "Inconsistent coordinates in the mesh file " << filename);
+   std::memcpy(coords, data + coords_offset, coords_size * sizeof(double));
+   munmap(map, st.st_size);
+   if (pmesh->GetNodes()) { pmesh->NodesUpdated(); }
+   return pmesh;
+}
+
+// Morton key of the point x in the box [lo, hi], with bits per dimension.
+static uint64_t MortonKey(const Vector &x, const double *lo, const double *hi,
+                          const int bits)
+{
+   const int dim = x.Size();
+   const uint64_t max_cell = (uint64_t(1) << bits) - 1;
+   uint64_t cell[3], key = 0;
+   for (int d = 0; d < dim; d++)
+   {
+      const double len = hi[d] - lo[d];
+      const double s = (len > 0.0) ? (x(d) - lo[d]) / len : 0.0;
+      cell[d] = std::min(max_cell, (uint64_t) (std::max(0.0, s) * max_cell));
+   }
+   for (int b = bits - 1; b >= 0; b--)
+   {
+      for (int d = 0; d < dim; d++) { key = (key << 1) | ((cell[d] >> b) & 1); }
+   }
+   return key;
+}
+
+void WeightedSFCPartitioning(ParMesh &pmesh, const Vector &weights,
+                             Array<int> &partition, Vector &part_weights)
+{
+   const MPI_Comm comm = pmesh.GetComm();
+   const int NE = pmesh.GetNE(), dim = pmesh.Dimension();
+   MFEM_VERIFY(weights.Size() == NE, "One weight per zone is expected!");
+   int num_tasks;
+   MPI_Comm_size(comm, &num_tasks);
+
+   // Global bounding box of the zone centers: min of x and of -x.
+   Array<Vector> centers(NE);
+   double loc[6], glob[6];
+   for (int d = 0; d < 3; d++) { loc[d] = loc[3+d] = HUGE_VAL; }
+   for (int z = 0; z < NE; z++)
+   {
+      pmesh.GetElementCenter(z, centers[z]);
+      for (int d = 0; d < dim; d++)
+      {
+         loc[d] = std::min(loc[d], centers[z](d));
+         loc[3+d] = std::min(loc[3+d], -centers[z](d));
+      }
+   }
+   MPI_Allreduce(loc, glob, 6, MPI_DOUBLE, MPI_MIN, comm);
+   double hi[3];
+   for (int d = 0; d < 3; d++) { hi[d] = -glob[3+d]; }
+
+   // Local keys in curve order, with the prefix sums of their weights.
+   const int bits = std::min(52, 63 / dim);
+   std::vector<std::pair<uint64_t, int>> keys(NE);
+   for (int z = 0; z < NE; z++)
+   {
+      keys[z] = std::make_pair(MortonKey(centers[z], glob, hi, bits), z);
+   }
+   std::sort(keys.begin(), keys.end());
+   std::vector<double> prefix(NE + 1, 0.0);
+   for (int i = 0; i < NE; i++)
+   {
+      prefix[i+1] = prefix[i] + weights(keys[i].second);
+   }
+   double total;
+   MPI_Allreduce(&prefix[NE], &total, 1, MPI_DOUBLE, MPI_SUM, comm);
+
+   // Bisection of the boundaries s_k, k = 1..P-1: the smallest keys with a
+   // weight below them of at least k/P of the total.
+   const int nb = num_tasks - 1;
+   const uint64_t end = uint64_t(1) << (bits * dim);
+   std::vector<uint64_t> lo(nb, 0), hi_key(nb, end);
+   std::vector<double> below(nb), glob_below(nb);
+   for (int it = 0; it <= bits * dim; it++)
+   {
+      std::vector<uint64_t> mid(nb);
+      for (int k = 0; k < nb; k++)
+      {
+         mid[k] = lo[k] + (hi_key[k] - lo[k]) / 2;
+         const auto pos = std::lower_bound(
+                             keys.begin(), keys.end(),
+                             std::make_pair(mid[k], -1));
+         below[k] = prefix[pos - keys.begin()];
+      }
+      MPI_Allreduce(below.data(), glob_below.data(), nb, MPI_DOUBLE,
+                    MPI_SUM, comm);
+      for (int k = 0; k < nb; k++)
+      {
+         const double target = (k + 1) * total / num_tasks;
+         if (glob_below[k] >= target) { hi_key[k] = mid[k]; }
+         else { lo[k] = mid[k] + 1; }
+      }
+   }
+
+   // The new rank of a zone is the number of boundaries at or before its key.
+   Vector my_part_weights(num_tasks);
+   my_part_weights = 0.0;
+   partition.SetSize(NE);
+   for (int i = 0; i < NE; i++)
+   {
+      const int z = keys[i].second;
+      partition[z] = std::upper_bound(hi_key.begin(), hi_key.end(),
+                                      keys[i].first) - hi_key.begin();
+      my_part_weights(partition[z]) += weights(z);
+   }
+   part_weights.SetSize(num_tasks);
+   MPI_Allreduce(my_part_weights.GetData(), part_weights.GetData(), num_tasks,
+                 MPI_DOUBLE, MPI_SUM, comm);
+}
+
+} // namespace hydrodynamics
+
+} // namespace mfem
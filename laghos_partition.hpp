@@ -0,0 +1,74 @@
+// Copyright (c) 2017, Lawrence Livermore National Security, LLC. Produced at
+// the Lawrence Livermore National Laboratory. LLNL-CODE-734707. All Rights
+// reserved. See files LICENSE and NOTICE for details.
+//
+// This file is part of CEED, a collection of benchmarks, miniapps, software
+// libraries and APIs for efficient high-order finite element and spectral
+// element discretizations for exascale applications. For more information and
+// source code availability see http://github.com/ceed.
+//
+// The CEED research is supported by the Exascale Computing Project 17-SC-20-SC,
+// a collaborative effort of two U.S. Department of Energy organizations (Office
+// of Science and the National Nuclear Security Administration) responsible for
+// the planning and preparation of a capable exascale ecosystem, including
+// software, applications, hardware, advanced system engineering and early
+// testbed platforms, in support of the nation's exascale computing imperative.
+
+#ifndef MFEM_LAGHOS_PARTITION
+#define MFEM_LAGHOS_PARTITION
+
+#include "mfem.hpp"
+
+namespace mfem
+{
+
+namespace hydrodynamics
+{
+
+// Two-level Cartesian partitioning of the serial mesh. The bounding box is first
+// split into one sub-box per node (the ranks sharing memory, as given by
+// MPI_Comm_split_type), and each node box is then split between the ranks of
+// the node. Both splits minimize the cut area, so that most of the shared
+// faces stay inside the nodes. Returns nullptr if the nodes do not all have the
+// same number of ranks, otherwise an array to be deleted with delete [].
+int *NodeAwarePartitioning(MPI_Comm comm, Mesh &mesh);
+
+// Cartesian partitioning of a structured box mesh (zones on an nx x ny x nz
+// grid) between any number of ranks. The rank grid minimizes the largest
+// number of zones per rank, and then the number of cut faces. Zone counts that
+// are not divisible give slabs whose widths differ by one zone. With report,
+// prints the rank grid, the zone imbalance and the halo (cut faces). Returns
+// nullptr if the mesh is not a structured box, otherwise an array to be
+// deleted with delete [].
+int *AutoCartesianPartitioning(Mesh &mesh, const int num_tasks,
+                               const bool report);
+
+// Prints the number of neighbors, shared faces (split into intra- and
+// inter-node faces) and non-owned H1 dofs of each rank, with a summary.
+void PrintPartitionReport(ParMesh &pmesh, const ParFiniteElementSpace &H1);
+
+// New rank of each local zone for a rebalance with the given zone weights. A
+// Morton curve through the zone centers is split into parts of equal weight,
+// with one bisection of the curve positions per part boundary, so the zones
+// are never sorted globally. Also returns the weight of each new part.
+void WeightedSFCPartitioning(ParMesh &pmesh, const Vector &weights,
+                             Array<int> &partition, Vector &part_weights);
+
+// Pre-partitioned mesh files, one per rank: <basename>.<rank>. Each file holds
+// a binary header (magic, number of ranks, rank, payload sizes), the local
+// piece of the mesh in the MFEM parallel mesh format (ParMesh::ParPrint), which
+// includes the shared entities and the communication groups, and the binary
+// coordinates of the vertices (or of the nodes of a curved mesh). MFEM has no
+// binary mesh format, so the topology stays in text, while the coordinates are
+// restored bitwise from the binary part. Reading it back touches only the local
+// file, which is memory-mapped and parsed in place, so the startup cost is
+// proportional to the local number of zones.
+void WritePartitionedMesh(ParMesh &pmesh, const char *basename);
+// The number of ranks must be the one used to write the files.
+ParMesh *ReadPartitionedMesh(MPI_Comm comm, const char *basename);
+
+} // namespace hydrodynamics
+
+} // namespace mfem
+
+#endif // MFEM_LAGHOS_PARTITION
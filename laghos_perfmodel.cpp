@@ -0,0 +1,244 @@
+// Copyright (c) 2017, Lawrence Livermore National Security, LLC. Produced at
+// the Lawrence Livermore National Laboratory. LLNL-CODE-734707. All Rights
+// reserved. See files LICENSE and NOTICE for details.
+//
+// This file is part of CEED, a collection of benchmarks, miniapps, software
+// libraries and APIs for efficient high-order finite element and spectral
+// element discretizations for exascale applications. For more information and
+// source code availability see http://github.com/ceed.
+//
+// The CEED research is supported by the Exascale Computing Project 17-SC-20-SC,
+// a collaborative effort of two U.S. Department of Energy organizations (Office
+// of Science and the National Nuclear Security Administration) responsible for
+// the planning and preparation of a capable exascale ecosystem, including
+// software, applications, hardware, advanced system engineering and early
+// testbed platforms, in support of the nation's exascale computing imperative.
+
+#include "laghos_perfmodel.hpp"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <string>
+
+namespace mfem
+{
+
+namespace hydrodynamics
+{
+
+// Fields of the calibration files, in the order of PerfCounts.
+static const int num_perf_fields = 24;
+static const char *perf_fields[num_perf_fields] =
+{
+   "dim", "problem", "order_v", "order_e", "ranks", "zones", "h1_dofs",
+   "l2_dofs", "quads", "steps", "time", "h1_iters", "l2_work", "force_evals",
+   "qdata_updates", "t_cgH1", "t_cgL2", "t_force", "t_qdata", "t_loop", "mem",
+   "mem0", "rate_steps", "rate_time"
+};
+
+void PerfModel::Save(const char *file) const
+{
+   std::ofstream out(file);
+   MFEM_VERIFY(out, "Cannot write the calibration file " << file);
+   const double v[num_perf_fields] =
+   {
+      (double) cal.dim, (double) cal.problem, (double) cal.order_v,
+      (double) cal.order_e, (double) cal.ranks, cal.zones, cal.h1_dofs,
+      cal.l2_dofs, cal.quads, cal.steps, cal.time, cal.h1_iters,
+      cal.l2_work, cal.force_evals, cal.qdata_updates, cal.t_cgH1,
+      cal.t_cgL2, cal.t_force, cal.t_qdata, cal.t_loop, cal.mem, cal.mem0,
+      cal.rate_steps, cal.rate_time
+   };
+   out << std::setprecision(16);
+   for (int i = 0; i < num_perf_fields; i++)
+   {
+      out << perf_fields[i] << ' ' << v[i] << '\n';
+   }
+}
+
+void PerfModel::Load(const char *file)
+{
+   std::ifstream in(file);
+   MFEM_VERIFY(in, "Cannot read the calibration file " << file);
+   double v[num_perf_fields];
+   for (int i = 0; i < num_perf_fields; i++)
+   {
+      std::string key;
+      in >> key >> v[i];
+      MFEM_VERIFY(in && key == perf_fields[i], "Missing calibration field "
+                  << perf_fields[i] << " in " << file);
+   }
+   cal.dim = (int) v[0];
+   cal.problem = (int) v[1];
+   cal.order_v = (int) v[2];
+   cal.order_e = (int) v[3];
+   cal.ranks = (int) v[4];
+   double *d[num_perf_fields - 5] =
+   {
+      &cal.zones, &cal.h1_dofs, &cal.l2_dofs, &cal.quads, &cal.steps,
+      &cal.time, &cal.h1_iters, &cal.l2_work, &cal.force_evals,
+      &cal.qdata_updates, &cal.t_cgH1, &cal.t_cgL2, &cal.t_force,
+      &cal.t_qdata, &cal.t_loop, &cal.mem, &cal.mem0, &cal.rate_steps,
+      &cal.rate_time
+   };
+   for (int i = 5; i < num_perf_fields; i++) { *d[i-5] = v[i]; }
+   MFEM_VERIFY(cal.steps > 0.0 && cal.time > 0.0 && cal.ranks > 0,
+               "Invalid calibration file " << file);
+}
+
+PerfCounts PerfModel::Sizes(int dim, double serial_zones, int refinements,
+                            int order_v, int order_e, int order_q, int ranks)
+{
+   PerfCounts s = PerfCounts();
+   s.dim = dim;
+   s.order_v = order_v;
+   s.order_e = order_e;
+   s.ranks = ranks;
+   s.zones = serial_zones * std::ldexp(1.0, dim * refinements);
+   // Zones per direction of the equivalent box, with its H1 dofs.
+   const double n = std::pow(s.zones, 1.0 / dim);
+   s.h1_dofs = dim * std::pow(order_v * n + 1.0, dim);
+   s.l2_dofs = s.zones * std::pow(order_e + 1.0, dim);
+   // Gauss-Legendre points of the integration rule of the hydro operator.
+   const int ir_order = (order_q > 0) ? order_q : 3*order_v + order_e - 1;
+   s.quads = std::pow(ir_order / 2 + 1.0, dim);
+   return s;
+}
+
+// Time of the given work at the rate of the calibration (work / time), per
+// rank. A kernel that did not run in the calibration costs nothing.
+static double ScaledTime(double work, double ranks,
+                         double cal_work, double cal_ranks, double cal_time)
+{
+   if (cal_work <= 0.0 || cal_time <= 0.0) { return 0.0; }
+   return (work / ranks) / ((cal_work / cal_ranks) / cal_time);
+}
+
+// Memory per rank of the given dofs, at the bytes per dof per rank of the
+// calibration.
+static double ScaledMemory(double dofs, double ranks,
+                           double cal_dofs, double cal_ranks, double cal_mem)
+{
+   if (cal_dofs <= 0.0 || cal_mem <= 0.0) { return 0.0; }
+   return cal_mem * (dofs / ranks) / (cal_dofs / cal_ranks);
+}
+
+void PerfModel::Predict(PerfCounts &t, double t_final, int max_tsteps) const
+{
+   t.time = t_final;
+   // The time step is proportional to the zone size over the velocity order.
+   // The steps of the first half of the calibration, while the time step
+   // adapts to the initial conditions, do not give the rate of a long run.
+   const double refine = std::pow(t.zones / cal.zones, 1.0 / cal.dim) *
+                         t.order_v / cal.order_v;
+   const double rate = (cal.rate_steps > 0.0 && cal.rate_time > 0.0) ?
+                       cal.rate_steps / cal.rate_time : cal.steps / cal.time;
+   t.steps = std::ceil(rate * refine * t_final);
+   if (max_tsteps > 0) { t.steps = std::min(t.steps, (double) max_tsteps); }
+
+   // Work of the target run, at the work per step of the calibration.
+   const double steps = t.steps / cal.steps;
+   t.h1_iters = cal.h1_iters * steps;
+   t.l2_work = cal.l2_work / cal.l2_dofs * t.l2_dofs * steps;
+   t.force_evals = cal.force_evals * steps;
+   t.qdata_updates = cal.qdata_updates / cal.zones * t.zones * steps;
+
+   const double R = t.ranks, cR = cal.ranks;
+   t.t_cgH1 = ScaledTime(t.h1_dofs * t.h1_iters, R,
+                         cal.h1_dofs * cal.h1_iters, cR, cal.t_cgH1);
+   t.t_cgL2 = ScaledTime(t.l2_work, R, cal.l2_work, cR, cal.t_cgL2);
+   t.t_force = ScaledTime((t.h1_dofs + t.l2_dofs) * t.force_evals, R,
+                          (cal.h1_dofs + cal.l2_dofs) * cal.force_evals, cR,
+                          cal.t_force);
+   t.t_qdata = ScaledTime(t.quads * t.qdata_updates, R,
+                          cal.quads * cal.qdata_updates, cR, cal.t_qdata);
+   // The rest of the loop (time step control, vector updates, output) keeps
+   // its calibrated fraction of the kernel time.
+   const double other = (cal.KernelTime() > 0.0) ?
+                        std::max(cal.t_loop / cal.KernelTime(), 1.0) : 1.0;
+   t.t_loop = other * t.KernelTime();
+   // A fixed part per rank, and a part proportional to the dofs per rank.
+   t.mem0 = cal.mem0;
+   t.mem = cal.mem0 + ScaledMemory(t.NDofs(), R, cal.NDofs(), cR,
+                                   cal.mem - cal.mem0);
+}
+
+void PerfModel::Compare(std::ostream &out, const PerfCounts &t) const
+{
+   if (cal.dim != t.dim || cal.problem != t.problem ||
+       cal.order_v != t.order_v || cal.order_e != t.order_e)
+   {
+      out << "Warning: the calibration run (problem " << cal.problem
+          << ", dim " << cal.dim << ", orders " << cal.order_v << "/"
+          << cal.order_e << ") differs from the target (problem "
+          << t.problem << ", dim " << t.dim << ", orders " << t.order_v
+          << "/" << t.order_e << "), the rates may not carry over.\n";
+   }
+   if (cal.steps < min_calibration_steps)
+   {
+      out << "Warning: the calibration has only " << cal.steps
+          << " time steps, at least " << min_calibration_steps
+          << " are needed for a stable step rate.\n";
+   }
+}
+
+void PerfModel::Print(std::ostream &out, const PerfCounts &p,
+                      const PerfCounts *m)
+{
+   const int rows = 8;
+   const char *names[rows] =
+   {
+      "Time steps", "CG (H1) time/step", "CG (L2) time/step",
+      "Forces time/step", "UpdateQuadData time/step", "Time/step",
+      "Total time", "Memory/rank (MB)"
+   };
+   double vals[2][rows];
+   for (int k = 0; k < (m ? 2 : 1); k++)
+   {
+      const PerfCounts &c = k ? *m : p;
+      const double steps = std::max(c.steps, 1.0);
+      const double v[rows] =
+      {
+         c.steps, c.t_cgH1 / steps, c.t_cgL2 / steps, c.t_force / steps,
+         c.t_qdata / steps, c.t_loop / steps, c.t_loop, c.mem
+      };
+      for (int i = 0; i < rows; i++) { vals[k][i] = v[i]; }
+   }
+
+   const std::ios::fmtflags flags = out.flags();
+   const std::streamsize prec = out.precision();
+   out.unsetf(std::ios::floatfield);
+   out << std::setprecision(4) << '\n'
+       << "Performance model: " << p.ranks << " ranks, " << p.zones
+       << " zones, " << p.h1_dofs << " H1 dofs, " << p.l2_dofs
+       << " L2 dofs, " << p.quads << " QP\n";
+   out << std::left << std::setw(26) << "" << std::right
+       << std::setw(12) << "predicted";
+   if (m) { out << std::setw(12) << "measured" << std::setw(10) << "error"; }
+   out << '\n';
+   for (int i = 0; i < rows; i++)
+   {
+      out << std::left << std::setw(26) << names[i] << std::right
+          << std::setw(12) << vals[0][i];
+      if (m)
+      {
+         out << std::setw(12) << vals[1][i];
+         if (vals[1][i] != 0.0)
+         {
+            const double err = 100.0 * (vals[0][i] - vals[1][i]) / vals[1][i];
+            out << std::fixed << std::setprecision(1) << std::setw(9) << err
+                << '%' << std::setprecision(4);
+            out.unsetf(std::ios::floatfield);
+         }
+      }
+      out << '\n';
+   }
+   out << std::flush;
+   out.flags(flags);
+   out.precision(prec);
+}
+
+} // namespace hydrodynamics
+
+} // namespace mfem
@@ -0,0 +1,109 @@
+// Copyright (c) 2017, Lawrence Livermore National Security, LLC. Produced at
+// the Lawrence Livermore National Laboratory. LLNL-CODE-734707. All Rights
+// reserved. See files LICENSE and NOTICE for details.
+//
+// This file is part of CEED, a collection of benchmarks, miniapps, software
+// libraries and APIs for efficient high-order finite element and spectral
+// element discretizations for exascale applications. For more information and
+// source code availability see http://github.com/ceed.
+//
+// The CEED research is supported by the Exascale Computing Project 17-SC-20-SC,
+// a collaborative effort of two U.S. Department of Energy organizations (Office
+// of Science and the National Nuclear Security Administration) responsible for
+// the planning and preparation of a capable exascale ecosystem, including
+// software, applications, hardware, advanced system engineering and early
+// testbed platforms, in support of the nation's exascale computing imperative.
+
+#ifndef MFEM_LAGHOS_PERFMODEL
+#define MFEM_LAGHOS_PERFMODEL
+
+#include "mfem.hpp"
+#include <iostream>
+
+namespace mfem
+{
+
+namespace hydrodynamics
+{
+
+// Global sizes, work counts and times of a run: the quantities behind the
+// rates and the FOM of LagrangianHydroOperator::PrintTimingData. A value
+// initialized PerfCounts() is all zeros.
+struct PerfCounts
+{
+   int dim, problem, order_v, order_e, ranks;
+   // Zones, H1 (vector) and L2 true dofs, and quadrature points per zone.
+   double zones, h1_dofs, l2_dofs, quads;
+   // Time steps and the simulated time they covered.
+   double steps, time;
+   // H1 CG iterations (per component with partial assembly), sum over the
+   // ranks of the local L2 dofs x iterations, force evaluations (RK stages)
+   // and zone quadrature data updates.
+   double h1_iters, l2_work, force_evals, qdata_updates;
+   // Times (maximum over the ranks) of the CG (H1), CG (L2), force and
+   // quadrature data computations, and of the whole time loop.
+   double t_cgH1, t_cgL2, t_force, t_qdata, t_loop;
+   // Maximum resident set size of a rank (MB), and the part of it reached
+   // before the mesh and the operators are built (libraries, MPI buffers).
+   double mem, mem0;
+   // Time steps and simulated time of the second half of the run, after the
+   // time step has adapted to the initial conditions (0: not recorded).
+   double rate_steps, rate_time;
+
+   // Degrees of freedom of the FOM table: 2 H1 + L2 + quadrature points.
+   double NDofs() const { return 2*h1_dofs + l2_dofs + quads*zones; }
+   // Time of the four major kernels.
+   double KernelTime() const { return t_cgH1 + t_cgL2 + t_force + t_qdata; }
+};
+
+// Analytic performance model, calibrated by a (short) run on the local
+// machine. The calibration provides the rate per rank of each major kernel,
+// in the units of the FOM (dofs x iterations, dofs x stages, quadrature
+// points x updates per second), the work per time step, the fraction of the
+// loop spent outside of the kernels, the fixed memory per rank plus the memory
+// per degree of freedom, and the number of time steps per unit of simulated
+// time over the second half of the calibration. A prediction scales these
+// with the sizes of the target run, estimated from its serial zones,
+// refinements and orders as those of a structured box of tensor product
+// zones. The number of time steps scales with the zones per direction and the
+// velocity order (the CFL condition), while the CG iterations per step are
+// assumed independent of the mesh size. Hence, the calibration should use the
+// problem, orders and ODE solver of the target run, and enough time steps
+// (min_calibration_steps) for the step rate to settle.
+class PerfModel
+{
+private:
+   PerfCounts cal;
+
+public:
+   static const int min_calibration_steps = 100;
+
+   PerfModel() { }
+   explicit PerfModel(const PerfCounts &calibration) : cal(calibration) { }
+
+   // Calibration files: one "key value" line per field of PerfCounts.
+   void Save(const char *file) const;
+   void Load(const char *file);
+
+   // Estimated sizes of a run with the given serial mesh zones, refinement
+   // levels, orders and number of ranks.
+   static PerfCounts Sizes(int dim, double serial_zones, int refinements,
+                           int order_v, int order_e, int order_q, int ranks);
+
+   // Completes the sizes of the target run with the predicted steps, work,
+   // times and memory, for the given final time and maximum step count.
+   void Predict(PerfCounts &target, double t_final, int max_tsteps) const;
+
+   // Prints a prediction, and its relative error when the measured counts of
+   // the same run are given.
+   static void Print(std::ostream &out, const PerfCounts &pred,
+                     const PerfCounts *measured = nullptr);
+   // Warns about the calibration parameters that differ from the target.
+   void Compare(std::ostream &out, const PerfCounts &target) const;
+};
+
+} // namespace hydrodynamics
+
+} // namespace mfem
+
+#endif // MFEM_LAGHOS_PERFMODEL
@@ -0,0 +1,115 @@
+// Copyright (c) 2017, Lawrence Livermore National Security, LLC. Produced at
+// the Lawrence Livermore National Laboratory. LLNL-CODE-734707. All Rights
+// reserved. See files LICENSE and NOTICE for details.
+//
+// This file is part of CEED, a collection of benchmarks, miniapps, software
+// libraries and APIs for efficient high-order finite element and spectral
+// element discretizations for exascale applications. For more information and
+// source code availability see http://github.com/ceed.
+//
+// The CEED research is supported by the Exascale Computing Project 17-SC-20-SC,
+// a collaborative effort of two U.S. Department of Energy organizations (Office
+// of Science and the National Nuclear Security Administration) responsible for
+// the planning and preparation of a capable exascale ecosystem, including
+// software, applications, hardware, advanced system engineering and early
+// testbed platforms, in support of the nation's exascale computing imperative.
+
+#include "laghos_reduce.hpp"
+#include <cmath>
+
+namespace mfem
+{
+
+namespace hydrodynamics
+{
+
+static bool reproducible_reductions = false;
+
+void SetReproducibleReductions(bool enable)
+{
+   reproducible_reductions = enable;
+}
+
+bool ReproducibleReductions() { return reproducible_reductions; }
+
+// Global sum of the n values f(i) by pre-rounding. With |f| < 2^e and at most
+// 2^(W-1) values in total, the bin boundary s = 1.5 2^(e+W) splits each value
+// into q = (s + f) - s, a multiple of u = 2^(e+W-52), and the remainder f - q
+// with |f - q| <= 2^(e+W-53), which goes to the next bin. All the partial sums
+// of a bin are multiples of u below 2^(e+W-1), so they are exact in any order,
+// including the one of MPI_Allreduce. Only the part of the values below the
+// last bin is lost, and it is the same for any distribution of the values,
+// since e and W depend only on the global maximum and the global count.
+template <typename F>
+static double BinnedSum(MPI_Comm comm, const int n, F &&f)
+{
+   const int nbins = 3;
+   // Maximum magnitude and non-finite flag.
+   double loc[2] = { 0.0, 0.0 }, glob[2];
+   for (int i = 0; i < n; i++)
+   {
+      const double v = f(i);
+      if (std::isfinite(v)) { loc[0] = std::fmax(loc[0], std::fabs(v)); }
+      else { loc[1] = 1.0; }
+   }
+   MPI_Allreduce(loc, glob, 2, MPI_DOUBLE, MPI_MAX, comm);
+   if (glob[0] == 0.0 && glob[1] == 0.0) { return 0.0; }
+   long long count = n, glob_count;
+   MPI_Allreduce(&count, &glob_count, 1, MPI_LONG_LONG, MPI_SUM, comm);
+
+   const int W = std::ilogb((double) glob_count) + 2;
+   int e = std::ilogb(glob[0]) + 1;
+   if (glob[1] > 0.0 || e + W > std::numeric_limits<double>::max_exponent - 2)
+   {
+      // Inf, NaN or overflow: the plain sum gives the same non-finite value.
+      double sum = 0.0, glob_sum;
+      for (int i = 0; i < n; i++) { sum += f(i); }
+      MPI_Allreduce(&sum, &glob_sum, 1, MPI_DOUBLE, MPI_SUM, comm);
+      return glob_sum;
+   }
+
+   double s[nbins], bins[nbins] = { 0.0 }, glob_bins[nbins];
+   for (int k = 0; k < nbins; k++)
+   {
+      s[k] = 1.5 * std::ldexp(1.0, e + W);
+      e += W - 53;
+   }
+   for (int i = 0; i < n; i++)
+   {
+      double r = f(i);
+      for (int k = 0; k < nbins; k++)
+      {
+         const double q = (s[k] + r) - s[k];
+         bins[k] += q;
+         r -= q;
+      }
+   }
+   MPI_Allreduce(bins, glob_bins, nbins, MPI_DOUBLE, MPI_SUM, comm);
+   double sum = 0.0;
+   for (int k = nbins - 1; k >= 0; k--) { sum += glob_bins[k]; }
+   return sum;
+}
+
+double GlobalSum(MPI_Comm comm, const Vector &x)
+{
+   if (!reproducible_reductions)
+   {
+      double loc = x.Sum(), glob;
+      MPI_Allreduce(&loc, &glob, 1, MPI_DOUBLE, MPI_SUM, comm);
+      return glob;
+   }
+   const double *X = x.HostRead();
+   return BinnedSum(comm, x.Size(), [&](int i) { return X[i]; });
+}
+
+double GlobalDot(MPI_Comm comm, const Vector &x, const Vector &y)
+{
+   if (!reproducible_reductions) { return InnerProduct(comm, x, y); }
+   MFEM_ASSERT(x.Size() == y.Size(), "Incompatible vector sizes.");
+   const double *X = x.HostRead(), *Y = y.HostRead();
+   return BinnedSum(comm, x.Size(), [&](int i) { return X[i] * Y[i]; });
+}
+
+} // namespace hydrodynamics
+
+} // namespace mfem
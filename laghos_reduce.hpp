@@ -0,0 +1,59 @@
+// Copyright (c) 2017, Lawrence Livermore National Security, LLC. Produced at
+// the Lawrence Livermore National Laboratory. LLNL-CODE-734707. All Rights
+// reserved. See files LICENSE and NOTICE for details.
+//
+// This file is part of CEED, a collection of benchmarks, miniapps, software
+// libraries and APIs for efficient high-order finite element and spectral
+// element discretizations for exascale applications. For more information and
+// source code availability see http://github.com/ceed.
+//
+// The CEED research is supported by the Exascale Computing Project 17-SC-20-SC,
+// a collaborative effort of two U.S. Department of Energy organizations (Office
+// of Science and the National Nuclear Security Administration) responsible for
+// the planning and preparation of a capable exascale ecosystem, including
+// software, applications, hardware, advanced system engineering and early
+// testbed platforms, in support of the nation's exascale computing imperative.
+
+#ifndef MFEM_LAGHOS_REDUCE
+#define MFEM_LAGHOS_REDUCE
+
+#include "mfem.hpp"
+
+namespace mfem
+{
+
+namespace hydrodynamics
+{
+
+// Reproducible mode of the global sums (CG inner products, energy integrals
+// and the norm of e). The values are pre-rounded into a few bins, aligned to
+// boundaries that depend only on the global maximum magnitude and count. The
+// bin sums are then exact, so the result does not depend on the summation
+// order, i.e., on the number of ranks or threads for the same values. The
+// values themselves still depend on the partition, through the assembly of the
+// shared dofs. This costs two extra reductions per sum, of the maximum and of
+// the count. The min-reductions of the time step are exact in both modes.
+void SetReproducibleReductions(bool enable);
+bool ReproducibleReductions();
+
+// Global sum of the entries of x, and global inner product of x and y, over
+// all the ranks of comm. Without the reproducible mode, these are the usual
+// local sums followed by MPI_Allreduce.
+double GlobalSum(MPI_Comm comm, const Vector &x);
+double GlobalDot(MPI_Comm comm, const Vector &x, const Vector &y);
+
+// CG solver with the inner products computed by GlobalDot.
+class ReproducibleCGSolver : public CGSolver
+{
+public:
+   ReproducibleCGSolver(MPI_Comm comm) : CGSolver(comm) { }
+
+   virtual double Dot(const Vector &x, const Vector &y) const
+   { return GlobalDot(comm, x, y); }
+};
+
+} // namespace hydrodynamics
+
+} // namespace mfem
+
+#endif // MFEM_LAGHOS_REDUCE
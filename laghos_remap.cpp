@@ -0,0 +1,344 @@
+// Copyright (c) 2017, Lawrence Livermore National Security, LLC. Produced at
+// the Lawrence Livermore National Laboratory. LLNL-CODE-734707. All Rights
+// reserved. See files LICENSE and NOTICE for details.
+//
+// This file is part of CEED, a collection of benchmarks, miniapps, software
+// libraries and APIs for efficient high-order finite element and spectral
+// element discretizations for exascale applications. For more information and
+// source code availability see http://github.com/ceed.
+//
+// The CEED research is supported by the Exascale Computing Project 17-SC-20-SC,
+// a collaborative effort of two U.S. Department of Energy organizations (Office
+// of Science and the National Nuclear Security Administration) responsible for
+// the planning and preparation of a capable exascale ecosystem, including
+// software, applications, hardware, advanced system engineering and early
+// testbed platforms, in support of the nation's exascale computing imperative.
+
+#include "laghos_remap.hpp"
+
+namespace mfem
+{
+
+namespace hydrodynamics
+{
+
+ALERemap::ALERemap(ParFiniteElementSpace &h1, ParFiniteElementSpace &l2,
+                   const IntegrationRule &ir, const ParGridFunction &x_init,
+                   const double relax)
+   : H1(h1), L2(l2), pmesh(*h1.GetParMesh()), ir(ir),
+     face_ir(IntRules.Get(pmesh.GetFaceBaseGeometry(0),
+                          2 * l2.GetOrder(0) + h1.GetOrder(0) + 1)),
+     dim(pmesh.Dimension()), NE(pmesh.GetNE()), NQ(ir.GetNPoints()),
+     l2dofs(l2.GetFE(0)->GetDof()), x0(&h1), relax(relax),
+     remaps(0), substeps(0)
+{
+   x0 = x_init;
+   for (int k = 0; k < nfields; k++) { u[k].SetSpace(&L2); }
+}
+
+int ALERemap::Substeps(const ParGridFunction &w) const
+{
+   // Courant number of the upwind DG scheme with SSP-RK2.
+   const double courant = 0.5 / (2 * L2.GetOrder(0) + 1);
+   const int h1dofs = H1.GetFE(0)->GetDof();
+   Array<int> vdofs;
+   double ratio = 0.0;
+   for (int e = 0; e < NE; e++)
+   {
+      H1.GetElementVDofs(e, vdofs);
+      double disp = 0.0;
+      for (int i = 0; i < h1dofs; i++)
+      {
+         double d2 = 0.0;
+         for (int c = 0; c < dim; c++)
+         {
+            const double wc = w(vdofs[c*h1dofs + i]);
+            d2 += wc * wc;
+         }
+         disp = std::max(disp, sqrt(d2));
+      }
+      const double h = pow(fabs(pmesh.GetElementVolume(e)), 1.0 / dim);
+      ratio = std::max(ratio, disp / h);
+   }
+   double max_ratio;
+   MPI_Allreduce(&ratio, &max_ratio, 1, MPI_DOUBLE, MPI_MAX,
+                 pmesh.GetComm());
+   return std::max(1, (int) ceil(max_ratio / courant));
+}
+
+void ALERemap::Densities(const Vector (&m)[nfields])
+{
+   MassIntegrator mi(&ir);
+   DenseMatrix M;
+   Vector me, ue;
+   for (int e = 0; e < NE; e++)
+   {
+      mi.AssembleElementMatrix(*L2.GetFE(e), *L2.GetElementTransformation(e),
+                               M);
+      DenseMatrixInverse inv(M);
+      for (int k = 0; k < nfields; k++)
+      {
+         me.SetDataAndSize(m[k].GetData() + e*l2dofs, l2dofs);
+         ue.SetDataAndSize(u[k].GetData() + e*l2dofs, l2dofs);
+         inv.Mult(me, ue);
+      }
+   }
+   for (int k = 0; k < nfields; k++) { u[k].ExchangeFaceNbrData(); }
+}
+
+void ALERemap::Rates(const ParGridFunction &w, const ParGridFunction &v,
+                     Vector (&dm)[nfields], ParGridFunction &dv)
+{
+   for (int k = 0; k < nfields; k++) { dm[k] = 0.0; }
+   Vector shape(l2dofs), shape2(l2dofs), wq(dim), nor(dim);
+   DenseMatrix dshape(l2dofs, dim);
+   Vector dshape_w(l2dofs);
+
+   // Volume terms, -(u, w.grad(phi)), for the elements moving with w.
+   for (int e = 0; e < NE; e++)
+   {
+      const FiniteElement &fe = *L2.GetFE(e);
+      ElementTransformation &T = *L2.GetElementTransformation(e);
+      for (int q = 0; q < NQ; q++)
+      {
+         const IntegrationPoint &ip = ir.IntPoint(q);
+         T.SetIntPoint(&ip);
+         fe.CalcShape(ip, shape);
+         fe.CalcPhysDShape(T, dshape);
+         w.GetVectorValue(e, ip, wq);
+         dshape.Mult(wq, dshape_w);
+         const double wt = ip.weight * T.Weight();
+         for (int k = 0; k < nfields; k++)
+         {
+            const double uk = shape * (u[k].GetData() + e*l2dofs);
+            for (int i = 0; i < l2dofs; i++)
+            {
+               dm[k](e*l2dofs + i) -= wt * uk * dshape_w(i);
+            }
+         }
+      }
+   }
+
+   // Face terms, with the upwind value of the material entering the element:
+   // the neighbor value where the face moves outward (w.n > 0). There is no
+   // flux through the boundary, where w.n = 0.
+   Array<int> nbr_dofs;
+   const int nsf = pmesh.GetNSharedFaces(), nf = pmesh.GetNumFaces();
+   for (int f = 0; f < nf + nsf; f++)
+   {
+      const bool shared = f >= nf;
+      FaceElementTransformations *ft =
+         shared ? pmesh.GetSharedFaceTransformations(f - nf) :
+         pmesh.GetInteriorFaceTransformations(f);
+      if (ft == nullptr) { continue; }
+      const int e1 = ft->Elem1No;
+      const int e2 = shared ? ft->Elem2No - NE : ft->Elem2No;
+      const FiniteElement &fe1 = *L2.GetFE(e1);
+      const FiniteElement &fe2 = shared ? *L2.GetFaceNbrFE(e2) : *L2.GetFE(e2);
+      const double *u2_data[nfields];
+      if (shared)
+      {
+         L2.GetFaceNbrElementVDofs(e2, nbr_dofs);
+         for (int k = 0; k < nfields; k++)
+         {
+            u2_data[k] = u[k].FaceNbrData().GetData() + nbr_dofs[0];
+         }
+      }
+      else
+      {
+         for (int k = 0; k < nfields; k++)
+         {
+            u2_data[k] = u[k].GetData() + e2*l2dofs;
+         }
+      }
+      for (int q = 0; q < face_ir.GetNPoints(); q++)
+      {
+         const IntegrationPoint &ip = face_ir.IntPoint(q);
+         ft->SetAllIntPoints(&ip);
+         const IntegrationPoint &eip1 = ft->GetElement1IntPoint();
+         const IntegrationPoint &eip2 = ft->GetElement2IntPoint();
+         fe1.CalcShape(eip1, shape);
+         fe2.CalcShape(eip2, shape2);
+         if (dim == 1) { nor(0) = 2.0 * eip1.x - 1.0; }
+         else { CalcOrtho(ft->Jacobian(), nor); }
+         w.GetVectorValue(e1, eip1, wq);
+         const double un = wq * nor;
+         for (int k = 0; k < nfields; k++)
+         {
+            const double u1 = shape * (u[k].GetData() + e1*l2dofs);
+            const double u2 = shape2 * u2_data[k];
+            const double flux = ip.weight * un * (un > 0.0 ? u2 : u1);
+            for (int i = 0; i < l2dofs; i++)
+            {
+               dm[k](e1*l2dofs + i) += flux * shape(i);
+               if (!shared) { dm[k](e2*l2dofs + i) -= flux * shape2(i); }
+            }
+         }
+      }
+   }
+
+   // Velocity: dv/dt = w.grad(v) at the nodes, with the lumped mass matrix.
+   ParGridFunction rhs(&H1), lumped(&H1);
+   rhs = 0.0;
+   lumped = 0.0;
+   const int h1dofs = H1.GetFE(0)->GetDof();
+   Vector h1shape(h1dofs);
+   DenseMatrix grad_v;
+   Array<int> vdofs;
+   for (int e = 0; e < NE; e++)
+   {
+      const FiniteElement &fe = *H1.GetFE(e);
+      ElementTransformation &T = *H1.GetElementTransformation(e);
+      H1.GetElementVDofs(e, vdofs);
+      for (int q = 0; q < NQ; q++)
+      {
+         const IntegrationPoint &ip = ir.IntPoint(q);
+         T.SetIntPoint(&ip);
+         fe.CalcShape(ip, h1shape);
+         v.GetVectorGradient(T, grad_v);
+         w.GetVectorValue(e, ip, wq);
+         const double wt = ip.weight * T.Weight();
+         for (int c = 0; c < dim; c++)
+         {
+            double w_grad_vc = 0.0;
+            for (int d = 0; d < dim; d++) { w_grad_vc += grad_v(c, d) * wq(d); }
+            for (int i = 0; i < h1dofs; i++)
+            {
+               rhs(vdofs[c*h1dofs + i]) += wt * w_grad_vc * h1shape(i);
+               lumped(vdofs[c*h1dofs + i]) += wt * h1shape(i);
+            }
+         }
+      }
+   }
+   Vector rhs_t(H1.GetTrueVSize()), lumped_t(H1.GetTrueVSize());
+   rhs.ParallelAssemble(rhs_t);
+   lumped.ParallelAssemble(lumped_t);
+   for (int i = 0; i < rhs_t.Size(); i++) { rhs_t(i) /= lumped_t(i); }
+   dv.Distribute(rhs_t);
+}
+
+void ALERemap::Remap(ParGridFunction &x, ParGridFunction &v,
+                     ParGridFunction &e, ParGridFunction &gamma,
+                     QuadratureData &qdata, const Array<int> &ess_vdofs)
+{
+   // The remap runs on the host.
+   x.HostReadWrite();
+   v.HostReadWrite();
+   e.HostReadWrite();
+   gamma.HostReadWrite();
+   double *rho0DetJ0w = qdata.rho0DetJ0w.HostReadWrite();
+
+   // Mesh velocity, constant in the pseudo-time [0, 1].
+   ParGridFunction w(&H1), x_target(&H1);
+   w.Set(relax, x0);
+   w.Add(-relax, x);
+   add(x, 1.0, w, x_target);
+   const int nsteps = Substeps(w);
+
+   // Initial moments of rho, rho e and rho gamma: (rho0DetJ0w f, phi_i).
+   Vector m[nfields], m_old[nfields], dm[nfields];
+   for (int k = 0; k < nfields; k++)
+   {
+      m[k].SetSize(NE * l2dofs);
+      m_old[k].SetSize(NE * l2dofs);
+      dm[k].SetSize(NE * l2dofs);
+      m[k] = 0.0;
+   }
+   Vector shape(l2dofs), e_vals(NQ);
+   for (int z = 0; z < NE; z++)
+   {
+      const FiniteElement &fe = *L2.GetFE(z);
+      e.GetValues(z, ir, e_vals);
+      for (int q = 0; q < NQ; q++)
+      {
+         fe.CalcShape(ir.IntPoint(q), shape);
+         const double mass = rho0DetJ0w[z*NQ + q];
+         const double f[nfields] = { 1.0, e_vals(q), gamma(z) };
+         for (int k = 0; k < nfields; k++)
+         {
+            for (int i = 0; i < l2dofs; i++)
+            {
+               m[k](z*l2dofs + i) += mass * f[k] * shape(i);
+            }
+         }
+      }
+   }
+
+   // SSP-RK2 substeps. The mesh is moved once per substep, as it is linear in
+   // the pseudo-time.
+   const double dtau = 1.0 / nsteps;
+   ParGridFunction v_old(&H1), dv(&H1);
+   for (int s = 0; s < nsteps; s++)
+   {
+      pmesh.ExchangeFaceNbrNodes();
+      Densities(m);
+      Rates(w, v, dm, dv);
+      for (int k = 0; k < nfields; k++)
+      {
+         m_old[k] = m[k];
+         m[k].Add(dtau, dm[k]);
+      }
+      v_old = v;
+      v.Add(dtau, dv);
+      x.Add(dtau, w);
+
+      pmesh.ExchangeFaceNbrNodes();
+      Densities(m);
+      Rates(w, v, dm, dv);
+      for (int k = 0; k < nfields; k++)
+      {
+         m[k].Add(dtau, dm[k]);
+         m[k] += m_old[k];
+         m[k] *= 0.5;
+      }
+      v.Add(dtau, dv);
+      v += v_old;
+      v *= 0.5;
+   }
+   x = x_target;
+   for (int i = 0; i < ess_vdofs.Size(); i++) { v(ess_vdofs[i]) = 0.0; }
+   Densities(m);
+
+   // New quadrature point masses. The density is kept positive.
+   MassIntegrator mi(&ir);
+   DenseMatrix Mrho;
+   Vector rho_vals(NQ), me, ee;
+   for (int z = 0; z < NE; z++)
+   {
+      const FiniteElement &fe = *L2.GetFE(z);
+      ElementTransformation &T = *L2.GetElementTransformation(z);
+      u[0].GetValues(z, ir, rho_vals);
+      double zone_mass = 0.0, zone_gamma = 0.0;
+      for (int i = 0; i < l2dofs; i++)
+      {
+         zone_mass += m[0](z*l2dofs + i);
+         zone_gamma += m[2](z*l2dofs + i);
+      }
+      const double rho_min = 1e-6 * zone_mass / fabs(pmesh.GetElementVolume(z));
+      Mrho.SetSize(l2dofs);
+      Mrho = 0.0;
+      for (int q = 0; q < NQ; q++)
+      {
+         const IntegrationPoint &ip = ir.IntPoint(q);
+         T.SetIntPoint(&ip);
+         const double mass = std::max(rho_vals(q), rho_min) * T.Weight() *
+                             ip.weight;
+         rho0DetJ0w[z*NQ + q] = mass;
+         fe.CalcShape(ip, shape);
+         AddMult_a_VVt(mass, shape, Mrho);
+      }
+      // Mass-weighted projection of the specific internal energy.
+      DenseMatrixInverse inv(Mrho);
+      me.SetDataAndSize(m[1].GetData() + z*l2dofs, l2dofs);
+      ee.SetDataAndSize(e.GetData() + z*l2dofs, l2dofs);
+      inv.Mult(me, ee);
+      if (zone_mass > 0.0) { gamma(z) = zone_gamma / zone_mass; }
+   }
+   pmesh.DeleteGeometricFactors();
+   remaps++;
+   substeps += nsteps;
+}
+
+} // namespace hydrodynamics
+
+} // namespace mfem
@@ -0,0 +1,84 @@
+// Copyright (c) 2017, Lawrence Livermore National Security, LLC. Produced at
+// the Lawrence Livermore National Laboratory. LLNL-CODE-734707. All Rights
+// reserved. See files LICENSE and NOTICE for details.
+//
+// This file is part of CEED, a collection of benchmarks, miniapps, software
+// libraries and APIs for efficient high-order finite element and spectral
+// element discretizations for exascale applications. For more information and
+// source code availability see http://github.com/ceed.
+//
+// The CEED research is supported by the Exascale Computing Project 17-SC-20-SC,
+// a collaborative effort of two U.S. Department of Energy organizations (Office
+// of Science and the National Nuclear Security Administration) responsible for
+// the planning and preparation of a capable exascale ecosystem, including
+// software, applications, hardware, advanced system engineering and early
+// testbed platforms, in support of the nation's exascale computing imperative.
+
+#ifndef MFEM_LAGHOS_REMAP
+#define MFEM_LAGHOS_REMAP
+
+#include "mfem.hpp"
+#include "laghos_assembly.hpp"
+
+namespace mfem
+{
+
+namespace hydrodynamics
+{
+
+// Lagrangian-to-Eulerian remap of the hydro state, used by the ALE mode. The
+// mesh is relaxed toward the initial mesh, x_t = x + relax (x_0 - x), and the
+// fields are transported to x_t by advection in pseudo-time, with the constant
+// mesh velocity w = x_t - x and SSP-RK2 substeps. All the kernels are element
+// and face local, no global matrix is assembled.
+// - The mass, internal energy and gamma densities (rho, rho e, rho gamma) are
+//   remapped conservatively in the L2 space, with upwind face fluxes.
+// - The velocity is advected in the H1 space, with a lumped mass matrix.
+// At the end, rho0DetJ0w is set from the remapped density on the new mesh, e
+// is the mass-weighted projection of (rho e) / rho and gamma is the zone
+// average of (rho gamma) / rho, so the total mass and internal energy are
+// conserved. There is no limiter, so the remap of discontinuities can create
+// small oscillations.
+class ALERemap
+{
+private:
+   ParFiniteElementSpace &H1, &L2;
+   ParMesh &pmesh;
+   const IntegrationRule &ir, &face_ir;
+   const int dim, NE, NQ, l2dofs;
+   ParGridFunction x0;
+   const double relax;
+   int remaps, substeps;
+
+   // Remapped L2 fields: rho, rho e, rho gamma.
+   static const int nfields = 3;
+   ParGridFunction u[nfields];
+
+   // Number of substeps for the displacement w.
+   int Substeps(const ParGridFunction &w) const;
+   // u = M^{-1} m with the local geometric mass matrices of the current mesh.
+   void Densities(const Vector (&m)[nfields]);
+   // Time derivatives of the L2 moments m and of the velocity v.
+   void Rates(const ParGridFunction &w, const ParGridFunction &v,
+              Vector (&dm)[nfields], ParGridFunction &dv);
+
+public:
+   ALERemap(ParFiniteElementSpace &h1, ParFiniteElementSpace &l2,
+            const IntegrationRule &ir, const ParGridFunction &x_init,
+            const double relax);
+
+   // Moves the mesh (the nodes x) and remaps v, e, gamma and the quadrature
+   // data. The normal velocity stays zero at the essential dofs.
+   void Remap(ParGridFunction &x, ParGridFunction &v, ParGridFunction &e,
+              ParGridFunction &gamma, QuadratureData &qdata,
+              const Array<int> &ess_vdofs);
+
+   int GetRemaps() const { return remaps; }
+   int GetSubsteps() const { return substeps; }
+};
+
+} // namespace hydrodynamics
+
+} // namespace mfem
+
+#endif // MFEM_LAGHOS_REMAP
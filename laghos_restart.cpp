@@ -0,0 +1,209 @@
+// Copyright (c) 2017, Lawrence Livermore National Security, LLC. Produced at
+// the Lawrence Livermore National Laboratory. LLNL-CODE-734707. All Rights
+// reserved. See files LICENSE and NOTICE for details.
+//
+// This file is part of CEED, a collection of benchmarks, miniapps, software
+// libraries and APIs for efficient high-order finite element and spectral
+// element discretizations for exascale applications. For more information and
+// source code availability see http://github.com/ceed.
+//
+// The CEED research is supported by the Exascale Computing Project 17-SC-20-SC,
+// a collaborative effort of two U.S. Department of Energy organizations (Office
+// of Science and the National Nuclear Security Administration) responsible for
+// the planning and preparation of a capable exascale ecosystem, including
+// software, applications, hardware, advanced system engineering and early
+// testbed platforms, in support of the nation's exascale computing imperative.
+
+#include "laghos_restart.hpp"
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace mfem
+{
+
+namespace hydrodynamics
+{
+
+// File layout (native byte order): the magic string, the ints and the reals of
+// the header, padded to restart_header_bytes, then the zone records.
+static const char restart_magic[8] = {'L','G','H','S','R','S','T','1'};
+static const int restart_version = 1;
+static const int restart_header_bytes = 256;
+
+RestartHeader::RestartHeader()
+{
+   for (int i = 0; i < NUM_INTS; i++) { ints[i] = 0; }
+   for (int r = 0; r < NUM_REALS; r++) { reals[r] = 0.0; }
+   ints[VERSION] = restart_version;
+}
+
+// Increasing order of the zone ids, as needed by the file view.
+static std::vector<int> SortedOrder(const Array<long long> &zone_ids)
+{
+   std::vector<int> order(zone_ids.Size());
+   for (int i = 0; i < zone_ids.Size(); i++) { order[i] = i; }
+   std::sort(order.begin(), order.end(), [&](int a, int b)
+   { return zone_ids[a] < zone_ids[b]; });
+   return order;
+}
+
+// File view with the records of the given zones (sorted by id), after the
+// header. Returns the error code of MPI_File_set_view.
+static int SetRecordsView(MPI_File fh, const Array<long long> &zone_ids,
+                          const std::vector<int> &order, const int rsize)
+{
+   std::vector<MPI_Aint> displs(order.size());
+   for (size_t i = 0; i < order.size(); i++)
+   {
+      displs[i] = (MPI_Aint) zone_ids[order[i]] * rsize * sizeof(double);
+   }
+   MPI_Datatype record, view;
+   MPI_Type_contiguous(rsize, MPI_DOUBLE, &record);
+   MPI_Type_create_hindexed_block((int) order.size(), 1, displs.data(),
+                                  record, &view);
+   MPI_Type_commit(&view);
+   const int err = MPI_File_set_view(fh, restart_header_bytes, MPI_DOUBLE,
+                                     view, "native", MPI_INFO_NULL);
+   MPI_Type_free(&view);
+   MPI_Type_free(&record);
+   return err;
+}
+
+// Whether all the doubles (or bytes) of a read or write were transferred.
+static bool Transferred(const int err, MPI_Status &status, MPI_Datatype type,
+                        const int count)
+{
+   int done = 0;
+   if (err != MPI_SUCCESS) { return false; }
+   MPI_Get_count(&status, type, &done);
+   return done == count;
+}
+
+void WriteRestart(MPI_Comm comm, const char *file, const RestartHeader &hdr,
+                  const Array<long long> &zone_ids, const Vector &records)
+{
+   const int rsize = (int) hdr.ints[RestartHeader::RECORD_SIZE];
+   const int n = zone_ids.Size();
+   MFEM_VERIFY(records.Size() == (long long) n * rsize,
+               "Wrong size of the restart records!");
+   MFEM_VERIFY((long long) n * rsize <= INT_MAX,
+               "Too many zones per rank for the restart file!");
+   const std::vector<int> order = SortedOrder(zone_ids);
+   std::vector<double> sorted((size_t) n * rsize);
+   const double *r = records.HostRead();
+   for (int i = 0; i < n; i++)
+   {
+      std::copy(r + (size_t) order[i] * rsize,
+                r + (size_t) (order[i] + 1) * rsize,
+                sorted.begin() + (size_t) i * rsize);
+   }
+
+   int myid;
+   MPI_Comm_rank(comm, &myid);
+   const std::string tmp = std::string(file) + ".tmp";
+   MPI_File fh;
+   const int err = MPI_File_open(comm, tmp.c_str(),
+                                 MPI_MODE_CREATE | MPI_MODE_WRONLY,
+                                 MPI_INFO_NULL, &fh);
+   MFEM_VERIFY(err == MPI_SUCCESS, "Cannot open the restart file " << tmp);
+   // The write errors (e.g. a full file system) are reduced over the ranks,
+   // and the previous restart file is kept unless all the ranks succeeded.
+   MPI_File_set_errhandler(fh, MPI_ERRORS_RETURN);
+   int ok = MPI_File_set_size(fh, 0) == MPI_SUCCESS;
+   MPI_Status status;
+   if (myid == 0)
+   {
+      char buf[restart_header_bytes] = { 0 };
+      std::memcpy(buf, restart_magic, sizeof(restart_magic));
+      std::memcpy(buf + sizeof(restart_magic), hdr.ints, sizeof(hdr.ints));
+      std::memcpy(buf + sizeof(restart_magic) + sizeof(hdr.ints), hdr.reals,
+                  sizeof(hdr.reals));
+      ok &= Transferred(MPI_File_write_at(fh, 0, buf, restart_header_bytes,
+                                          MPI_BYTE, &status),
+                        status, MPI_BYTE, restart_header_bytes);
+   }
+   ok &= SetRecordsView(fh, zone_ids, order, rsize) == MPI_SUCCESS;
+   ok &= Transferred(MPI_File_write_all(fh, sorted.data(), n * rsize,
+                                        MPI_DOUBLE, &status),
+                     status, MPI_DOUBLE, n * rsize);
+   ok &= MPI_File_close(&fh) == MPI_SUCCESS;
+   int all_ok;
+   MPI_Allreduce(&ok, &all_ok, 1, MPI_INT, MPI_MIN, comm);
+   if (!all_ok)
+   {
+      if (myid == 0) { std::remove(tmp.c_str()); }
+      MFEM_ABORT("Cannot write the restart file " << tmp << ", the previous "
+                 "file " << file << " is kept.");
+   }
+
+   // The complete file replaces the previous one.
+   if (myid == 0) { ok = (std::rename(tmp.c_str(), file) == 0); }
+   MPI_Bcast(&ok, 1, MPI_INT, 0, comm);
+   MFEM_VERIFY(ok, "Cannot rename the restart file " << tmp);
+}
+
+void ReadRestart(MPI_Comm comm, const char *file, RestartHeader &hdr,
+                 const Array<long long> &zone_ids, Vector &records)
+{
+   static_assert(sizeof(restart_magic) + sizeof(hdr.ints) + sizeof(hdr.reals)
+                 <= restart_header_bytes, "The restart header is too big.");
+   MPI_File fh;
+   const int err = MPI_File_open(comm, file, MPI_MODE_RDONLY, MPI_INFO_NULL,
+                                 &fh);
+   MFEM_VERIFY(err == MPI_SUCCESS, "Cannot open the restart file " << file);
+   // A failed or short read (e.g. a truncated file) stops the run.
+   MPI_File_set_errhandler(fh, MPI_ERRORS_RETURN);
+   char buf[restart_header_bytes];
+   MPI_Status status;
+   MFEM_VERIFY(Transferred(MPI_File_read_at_all(fh, 0, buf,
+                                                restart_header_bytes,
+                                                MPI_BYTE, &status),
+                           status, MPI_BYTE, restart_header_bytes),
+               "Cannot read the header of the restart file " << file);
+   MFEM_VERIFY(std::memcmp(buf, restart_magic, sizeof(restart_magic)) == 0,
+               file << " is not a Laghos restart file!");
+   std::memcpy(hdr.ints, buf + sizeof(restart_magic), sizeof(hdr.ints));
+   std::memcpy(hdr.reals, buf + sizeof(restart_magic) + sizeof(hdr.ints),
+               sizeof(hdr.reals));
+   MFEM_VERIFY(hdr.ints[RestartHeader::VERSION] == restart_version,
+               "Unsupported restart file version "
+               << hdr.ints[RestartHeader::VERSION]);
+
+   const int rsize = (int) hdr.ints[RestartHeader::RECORD_SIZE];
+   const int n = zone_ids.Size();
+   MFEM_VERIFY((long long) n * rsize <= INT_MAX,
+               "Too many zones per rank for the restart file!");
+   for (int i = 0; i < n; i++)
+   {
+      MFEM_VERIFY(zone_ids[i] >= 0 &&
+                  zone_ids[i] < hdr.ints[RestartHeader::ZONES],
+                  "Zone id " << zone_ids[i] << " is not in the restart file!");
+   }
+   const std::vector<int> order = SortedOrder(zone_ids);
+   std::vector<double> sorted((size_t) n * rsize);
+   MFEM_VERIFY(SetRecordsView(fh, zone_ids, order, rsize) == MPI_SUCCESS,
+               "Cannot read the restart file " << file);
+   MFEM_VERIFY(Transferred(MPI_File_read_all(fh, sorted.data(), n * rsize,
+                                             MPI_DOUBLE, &status),
+                           status, MPI_DOUBLE, n * rsize),
+               "Cannot read the zone records of the restart file " << file);
+   MFEM_VERIFY(MPI_File_close(&fh) == MPI_SUCCESS,
+               "Cannot close the restart file " << file);
+
+   records.SetSize(n * rsize);
+   double *r = records.HostWrite();
+   for (int i = 0; i < n; i++)
+   {
+      std::copy(sorted.begin() + (size_t) i * rsize,
+                sorted.begin() + (size_t) (i + 1) * rsize,
+                r + (size_t) order[i] * rsize);
+   }
+}
+
+} // namespace hydrodynamics
+
+} // namespace mfem
@@ -0,0 +1,64 @@
+// Copyright (c) 2017, Lawrence Livermore National Security, LLC. Produced at
+// the Lawrence Livermore National Laboratory. LLNL-CODE-734707. All Rights
+// reserved. See files LICENSE and NOTICE for details.
+//
+// This file is part of CEED, a collection of benchmarks, miniapps, software
+// libraries and APIs for efficient high-order finite element and spectral
+// element discretizations for exascale applications. For more information and
+// source code availability see http://github.com/ceed.
+//
+// The CEED research is supported by the Exascale Computing Project 17-SC-20-SC,
+// a collaborative effort of two U.S. Department of Energy organizations (Office
+// of Science and the National Nuclear Security Administration) responsible for
+// the planning and preparation of a capable exascale ecosystem, including
+// software, applications, hardware, advanced system engineering and early
+// testbed platforms, in support of the nation's exascale computing imperative.
+
+#ifndef MFEM_LAGHOS_RESTART
+#define MFEM_LAGHOS_RESTART
+
+#include "mfem.hpp"
+
+namespace mfem
+{
+
+namespace hydrodynamics
+{
+
+// Restart file that does not depend on the domain decomposition: a header,
+// followed by one record of doubles per zone, stored at the position given by
+// the global zone id. The zone ids come from the serial (refined) mesh, so a
+// run can be continued on any number of ranks. Each rank writes and reads
+// only the records of its own zones, with collective MPI-IO.
+struct RestartHeader
+{
+   enum Int
+   {
+      VERSION, DIM, PROBLEM, ORDER_V, ORDER_E, NQ, JAC0INV_SIZE,
+      RS_LEVELS, RP_LEVELS, ZONES, RECORD_SIZE, CYCLE, STEPS, NUM_INTS
+   };
+   enum Real { TIME, DT, H0, NUM_REALS };
+
+   long long ints[NUM_INTS];
+   double reals[NUM_REALS];
+
+   RestartHeader();
+};
+
+// Writes the header and the records of the local zones, with global ids
+// zone_ids, to <file>.tmp, which then replaces <file> if all the ranks wrote
+// their data; otherwise <file> is kept and the run stops. The records are
+// consecutive in records, in the order of zone_ids.
+void WriteRestart(MPI_Comm comm, const char *file, const RestartHeader &hdr,
+                  const Array<long long> &zone_ids, const Vector &records);
+
+// Reads the header of the file, and the records of the zones with global ids
+// zone_ids. The caller checks that the header matches the simulation.
+void ReadRestart(MPI_Comm comm, const char *file, RestartHeader &hdr,
+                 const Array<long long> &zone_ids, Vector &records);
+
+} // namespace hydrodynamics
+
+} // namespace mfem
+
+#endif // MFEM_LAGHOS_RESTART
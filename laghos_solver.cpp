@@ -17,7 +17,19 @@
 #include "general/forall.hpp"
 #include "laghos_solver.hpp"
 #include "linalg/kernels.hpp"
+#include <algorithm>
+#include <chrono>
+#include <climits>
 #include <unordered_map>
+#include <vector>
+#ifdef MFEM_USE_OPENMP
+#include <omp.h>
+// The element routines of MFEM keep scratch data in the finite elements and
+// integrators, unless MFEM is built thread-safe.
+#ifndef MFEM_THREAD_SAFE
+#error "The threaded element loops need MFEM built with MFEM_THREAD_SAFE."
+#endif
+#endif
 
 #ifdef MFEM_USE_MPI
 
@@ -88,6 +100,11 @@ static void Rho0DetJ0Vol(const int dim, const int NE,
                          QuadratureData &qdata,
                          double &volume);
 
+static void Jac0invZones(const int dim, const int e0, const int ne,
+                         const IntegrationRule &ir,
+                         ParMesh *pmesh,
+                         DenseTensor &Jac0inv);
+
 LagrangianHydroOperator::LagrangianHydroOperator(const int size,
                                                  ParFiniteElementSpace &h1,
                                                  ParFiniteElementSpace &l2,
@@ -103,7 +120,11 @@ LagrangianHydroOperator::LagrangianHydroOperator(const int size,
                                                  const double cgt,
                                                  const int cgiter,
                                                  double ftz,
-                                                 const int oq) :
+                                                 const int oq,
+                                                 const bool sell,
+                                                 const bool structured,
+                                                 const bool compact_stress,
+                                                 const bool node_geometry) :
    TimeDependentOperator(size),
    H1(h1), L2(l2), H1c(H1.GetParMesh(), H1.FEColl(), 1),
    pmesh(H1.GetParMesh()),
@@ -124,7 +145,11 @@ LagrangianHydroOperator::LagrangianHydroOperator(const int size,
    use_viscosity(visc),
    use_vorticity(vort),
    p_assembly(p_assembly),
-   cg_rel_tol(cgt), cg_max_iter(cgiter),ftz_tol(ftz),
+   cg_rel_tol(cgt), cg_max_iter(cgiter),
+   cg_adaptive(false), cg_order(1),
+   cg_safety(1.0), cg_tol_max(cgt), cg_dt(0.0), cg_extra_error(0.0),
+   cg_warm(false), cg_rho(0.0),
+   ftz_tol(ftz),
    gamma_gf(gamma_gf),
    Mv(&H1), Mv_spmat_copy(),
    Me(l2dofs_cnt, l2dofs_cnt, NE),
@@ -132,16 +157,22 @@ LagrangianHydroOperator::LagrangianHydroOperator(const int size,
    ir(IntRules.Get(pmesh->GetElementBaseGeometry(0),
                    (oq > 0) ? oq : 3 * H1.GetOrder(0) + L2.GetOrder(0) - 1)),
    Q1D(int(floor(0.7 + pow(ir.GetNPoints(), 1.0 / dim)))),
-   qdata(dim, NE, ir.GetNPoints()),
+   qdata(dim, NE, ir.GetNPoints(), structured || node_geometry,
+         compact_stress),
+   uniform_zones(true),
+   mass_coeff(rho0_coeff, qdata, ir),
    qdata_is_current(false),
    forcemat_is_assembled(false),
    Force(&L2, &H1),
+   ForceSell(nullptr), MvSell(nullptr),
    ForcePA(nullptr), VMassPA(nullptr), EMassPA(nullptr),
    VMassPA_Jprec(nullptr),
    CG_VMass(H1.GetParMesh()->GetComm()),
    CG_EMass(L2.GetParMesh()->GetComm()),
    timer(p_assembly ? L2TVSize : 1),
    qupdate(nullptr),
+   capture(nullptr),
+   jac0_table(nullptr),
    X(H1c.GetTrueVSize()),
    B(H1c.GetTrueVSize()),
    one(L2Vsize),
@@ -159,11 +190,12 @@ LagrangianHydroOperator::LagrangianHydroOperator(const int size,
 
    if (p_assembly)
    {
+      ForcePA = new ForcePAOperator(qdata, H1, L2, ir, structured);
       qupdate = new QUpdate(dim, NE, Q1D, visc, vort, cfl,
-                            &timer, gamma_gf, ir, H1, L2);
-      ForcePA = new ForcePAOperator(qdata, H1, L2, ir);
-      VMassPA = new MassPAOperator(H1c, ir, rho0_coeff);
-      EMassPA = new MassPAOperator(L2, ir, rho0_coeff);
+                            &timer, gamma_gf, ir, H1, L2,
+                            ForcePA->GetH1Gather());
+      VMassPA = new MassPAOperator(H1c, ir, mass_coeff);
+      EMassPA = new MassPAOperator(L2, ir, mass_coeff);
       // Inside the above constructors for mass, there is reordering of the mesh
       // nodes which is performed on the host. Since the mesh nodes are a
       // subvector, so we need to sync with the rest of the base vector (which
@@ -187,55 +219,108 @@ LagrangianHydroOperator::LagrangianHydroOperator(const int size,
    }
    else
    {
-      // Standard local assembly and inversion for energy mass matrices.
-      // 'Me' is used in the computation of the internal energy
-      // which is used twice: once at the start and once at the end of the run.
-      MassIntegrator mi(rho0_coeff, &ir);
-      for (int e = 0; e < NE; e++)
-      {
-         DenseMatrixInverse inv(&Me(e));
-         const FiniteElement &fe = *L2.GetFE(e);
-         ElementTransformation &Tr = *L2.GetElementTransformation(e);
-         mi.AssembleElementMatrix(fe, Tr, Me(e));
-         inv.Factor();
-         inv.GetInverseMatrix(Me_inv(e));
-      }
+      AssembleEnergyMass();
       // Standard assembly for the velocity mass matrix.
-      VectorMassIntegrator *vmi = new VectorMassIntegrator(rho0_coeff, &ir);
+      VectorMassIntegrator *vmi = new VectorMassIntegrator(mass_coeff, &ir);
       Mv.AddDomainIntegrator(vmi);
       Mv.Assemble();
       Mv_spmat_copy = Mv.SpMat();
+      if (sell) { MvSell = new SellMatrix(Mv_spmat_copy); }
    }
 
-   // Values of rho0DetJ0 and Jac0inv at all quadrature points.
+   // Values of rho0DetJ0 and Jac0inv at all quadrature points. A shared
+   // Jac0inv is computed for a chunk of zones at a time, and each zone of the
+   // chunk is then compared with the first zone (structured mode), or added
+   // to the rows of the node table, which keep only the distinct zones.
    // Initial local mesh size (assumes all mesh elements are the same).
    int Ne, ne = NE;
    double Volume, vol = 0.0;
+   const int NQ = ir.GetNPoints(), JS = dim * dim;
+   const bool shared = qdata.shared_Jac0inv;
+   const int chunk = shared ? std::min(NE, 256) : NE;
+   DenseTensor Jac0inv_chunk;
+   if (shared) { Jac0inv_chunk.SetSize(dim, dim, chunk * NQ); }
+   DenseTensor &Jac0inv = shared ? Jac0inv_chunk : qdata.Jac0inv;
+   NodeSharedTable::LocalRows jac0_rows(NQ * JS);
+   double *J0 = structured ? qdata.Jac0inv.HostWrite() : nullptr;
+   double jmax = 0.0;
    if (dim > 1 && p_assembly)
    {
       Rho0DetJ0Vol(dim, NE, ir, pmesh, L2, rho0_gf, qdata, vol);
    }
-   else
+   Vector rho_vals(NQ);
+   for (int e0 = 0; e0 < NE; e0 += chunk)
    {
-      const int NQ = ir.GetNPoints();
-      Vector rho_vals(NQ);
-      for (int e = 0; e < NE; e++)
+      const int nz = std::min(chunk, NE - e0);
+      if (dim > 1 && p_assembly)
       {
-         rho0_gf.GetValues(e, ir, rho_vals);
-         ElementTransformation &Tr = *H1.GetElementTransformation(e);
-         for (int q = 0; q < NQ; q++)
+         Jac0invZones(dim, e0, nz, ir, pmesh, Jac0inv);
+      }
+      else
+      {
+         for (int e = e0; e < e0 + nz; e++)
          {
-            const IntegrationPoint &ip = ir.IntPoint(q);
-            Tr.SetIntPoint(&ip);
-            DenseMatrixInverse Jinv(Tr.Jacobian());
-            Jinv.GetInverseMatrix(qdata.Jac0inv(e*NQ + q));
-            const double rho0DetJ0 = Tr.Weight() * rho_vals(q);
-            qdata.rho0DetJ0w(e*NQ + q) = rho0DetJ0 * ir.IntPoint(q).weight;
+            rho0_gf.GetValues(e, ir, rho_vals);
+            ElementTransformation &Tr = *H1.GetElementTransformation(e);
+            for (int q = 0; q < NQ; q++)
+            {
+               const IntegrationPoint &ip = ir.IntPoint(q);
+               Tr.SetIntPoint(&ip);
+               DenseMatrixInverse Jinv(Tr.Jacobian());
+               Jinv.GetInverseMatrix(Jac0inv((e - e0)*NQ + q));
+               const double rho0DetJ0 = Tr.Weight() * rho_vals(q);
+               qdata.rho0DetJ0w(e*NQ + q) = rho0DetJ0 * ir.IntPoint(q).weight;
+            }
+            vol += pmesh->GetElementVolume(e);
+         }
+      }
+      if (!shared) { continue; }
+      const double *J = Jac0inv.HostRead();
+      for (int e = 0; e < nz; e++)
+      {
+         const double *Je = J + (size_t) e * NQ * JS;
+         if (!structured)
+         {
+            jac0_rows.Add(Je);
+            continue;
+         }
+         // Keep the first zone, and check that the others are its translates.
+         if (e0 + e == 0)
+         {
+            for (int i = 0; i < NQ * JS; i++)
+            {
+               J0[i] = Je[i];
+               jmax = fmax(jmax, fabs(J0[i]));
+            }
+         }
+         for (int i = 0; i < NQ * JS && uniform_zones; i++)
+         {
+            if (fabs(Je[i] - J0[i]) > 1e-12 * jmax) { uniform_zones = false; }
          }
       }
-      for (int e = 0; e < NE; e++) { vol += pmesh->GetElementVolume(e); }
    }
-   MPI_Allreduce(&vol, &Volume, 1, MPI_DOUBLE, MPI_SUM, pmesh->GetComm());
+   // The Jacobians of all the zones in the geometric factors of the mesh are
+   // not needed anymore.
+   if (shared) { pmesh->DeleteGeometricFactors(); }
+   if (!structured && node_geometry)
+   {
+      // Congruent zones of all the ranks of the node share their matrices,
+      // when these are bitwise equal.
+      jac0_table = new NodeSharedTable(pmesh->GetComm(), jac0_rows,
+                                       qdata.jac0_class);
+      qdata.Jac0inv.UseExternalData(jac0_table->GetData(), dim, dim,
+                                    jac0_table->Rows() * NQ);
+   }
+   if (ReproducibleReductions())
+   {
+      Vector vols(NE);
+      for (int e = 0; e < NE; e++) { vols(e) = pmesh->GetElementVolume(e); }
+      Volume = GlobalSum(pmesh->GetComm(), vols);
+   }
+   else
+   {
+      MPI_Allreduce(&vol, &Volume, 1, MPI_DOUBLE, MPI_SUM, pmesh->GetComm());
+   }
    MPI_Allreduce(&ne, &Ne, 1, MPI_INT, MPI_SUM, pmesh->GetComm());
    switch (pmesh->GetElementBaseGeometry(0))
    {
@@ -277,11 +362,14 @@ LagrangianHydroOperator::LagrangianHydroOperator(const int size,
       // Make a dummy assembly to figure out the sparsity.
       Force.Assemble(0);
       Force.Finalize(0);
+      // The sparsity is now fixed, only the values change in time.
+      if (sell) { ForceSell = new SellMatrix(Force.SpMat()); }
    }
 }
 
 LagrangianHydroOperator::~LagrangianHydroOperator()
 {
+   delete jac0_table;
    delete qupdate;
    if (p_assembly)
    {
@@ -290,6 +378,59 @@ LagrangianHydroOperator::~LagrangianHydroOperator()
       delete VMassPA_Jprec;
       delete ForcePA;
    }
+   else
+   {
+      delete MvSell;
+      delete ForceSell;
+   }
+}
+
+void LagrangianHydroOperator::AssembleEnergyMass()
+{
+   // Standard local assembly and inversion for energy mass matrices.
+   // 'Me' is used in the computation of the internal energy
+   // which is used twice: once at the start and once at the end of the run.
+   MassIntegrator mi(mass_coeff, &ir);
+   for (int e = 0; e < NE; e++)
+   {
+      DenseMatrixInverse inv(&Me(e));
+      const FiniteElement &fe = *L2.GetFE(e);
+      ElementTransformation &Tr = *L2.GetElementTransformation(e);
+      mi.AssembleElementMatrix(fe, Tr, Me(e));
+      inv.Factor();
+      inv.GetInverseMatrix(Me_inv(e));
+   }
+}
+
+void LagrangianHydroOperator::UpdateMassMatrices()
+{
+   mass_coeff.UseQuadratureData();
+   if (p_assembly)
+   {
+      delete VMassPA_Jprec;
+      delete VMassPA;
+      delete EMassPA;
+      VMassPA = new MassPAOperator(H1c, ir, mass_coeff);
+      EMassPA = new MassPAOperator(L2, ir, mass_coeff);
+      H1.GetParMesh()->GetNodes()->ReadWrite();
+      Array<int> empty_tdofs;
+      VMassPA_Jprec = new OperatorJacobiSmoother(VMassPA->GetBF(), empty_tdofs);
+      CG_VMass.SetPreconditioner(*VMassPA_Jprec);
+      CG_VMass.SetOperator(*VMassPA);
+      CG_EMass.SetOperator(*EMassPA);
+   }
+   else
+   {
+      AssembleEnergyMass();
+      Mv.Update();
+      Mv.Assemble();
+      Mv_spmat_copy = Mv.SpMat();
+      if (MvSell)
+      {
+         delete MvSell;
+         MvSell = new SellMatrix(Mv_spmat_copy);
+      }
+   }
 }
 
 void LagrangianHydroOperator::Mult(const Vector &S, Vector &dS_dt) const
@@ -318,6 +459,7 @@ void LagrangianHydroOperator::SolveVelocity(const Vector &S,
 {
    UpdateQuadratureData(S);
    AssembleForceMatrix();
+   timer.force_evals++;
    // The monolithic BlockVector stores the unknown fields as follows:
    // (Position, Velocity, Specific Internal Energy).
    ParGridFunction dv;
@@ -365,10 +507,21 @@ void LagrangianHydroOperator::SolveVelocity(const Vector &S,
          H1c.GetRestrictionMatrix()->Mult(dvc_gf, X);
          VMassPA->SetEssentialTrueDofs(c_tdofs[c]);
          VMassPA->EliminateRHS(B);
+         const double cg_tol = StageCGTolerance(c, B, X);
+         CG_VMass.SetRelTol(cg_tol);
+         CG_VMass.iterative_mode = cg_warm;
+         Vector X0;
+         if (capture) { X0 = X; }
          timer.sw_cgH1.Start();
          CG_VMass.Mult(B, X);
          timer.sw_cgH1.Stop();
          timer.H1iter += CG_VMass.GetNumIterations();
+         if (capture)
+         {
+            VMassPA->RecordSolve(*capture, c, CG_VMass, true, cg_tol,
+                                 cg_max_iter, X0, B, X);
+         }
+         AddCGExtraError(c, cg_tol, B, X);
          if (Pconf) { Pconf->Mult(X, dvc_gf); }
          else { dvc_gf = X; }
          // We need to sync the subvector 'dvc_gf' with its base vector
@@ -379,26 +532,30 @@ void LagrangianHydroOperator::SolveVelocity(const Vector &S,
    else
    {
       timer.sw_force.Start();
-      Force.Mult(one, rhs);
+      if (ForceSell) { ForceSell->Mult(one, rhs); }
+      else { Force.Mult(one, rhs); }
       timer.sw_force.Stop();
       rhs.Neg();
 
       if (source_type == 2)
       {
          Vector rhs_accel(rhs.Size());
-         Mv_spmat_copy.Mult(accel_src_gf, rhs_accel);
+         if (MvSell) { MvSell->Mult(accel_src_gf, rhs_accel); }
+         else { Mv_spmat_copy.Mult(accel_src_gf, rhs_accel); }
          rhs += rhs_accel;
       }
 
       HypreParMatrix A;
       Mv.FormLinearSystem(ess_tdofs, dv, rhs, A, X, B);
 
-      CGSolver cg(H1.GetParMesh()->GetComm());
+      ReproducibleCGSolver cg(H1.GetParMesh()->GetComm());
       HypreSmoother prec;
       prec.SetType(HypreSmoother::Jacobi, 1);
       cg.SetPreconditioner(prec);
       cg.SetOperator(A);
-      cg.SetRelTol(cg_rel_tol);
+      const double cg_tol = StageCGTolerance(0, B, X);
+      cg.iterative_mode = cg_warm;
+      cg.SetRelTol(cg_tol);
       cg.SetAbsTol(0.0);
       cg.SetMaxIter(cg_max_iter);
       cg.SetPrintLevel(-1);
@@ -406,6 +563,7 @@ void LagrangianHydroOperator::SolveVelocity(const Vector &S,
       cg.Mult(B, X);
       timer.sw_cgH1.Stop();
       timer.H1iter += cg.GetNumIterations();
+      AddCGExtraError(0, cg_tol, B, X);
       Mv.RecoverFEMSolution(X, rhs, dv);
    }
 }
@@ -433,18 +591,32 @@ void LagrangianHydroOperator::SolveEnergy(const Vector &S, const Vector &v,
       e_source->Assemble();
    }
 
-   Array<int> l2dofs;
    if (p_assembly)
    {
       timer.sw_force.Start();
-      ForcePA->MultTranspose(v, e_rhs);
+      // Reuse the velocity E-vector of the quadrature update, if v is the
+      // velocity of S.
+      const Vector *V = qupdate->GetVelocityE(v);
+      if (V) { ForcePA->MultTransposeE(*V, e_rhs); }
+      else { ForcePA->MultTranspose(v, e_rhs); }
       timer.sw_force.Stop();
       if (e_source) { e_rhs += *e_source; }
+      const double cg_tol = StageCGTolerance(3, e_rhs, de);
+      CG_EMass.SetRelTol(cg_tol);
+      CG_EMass.iterative_mode = cg_warm;
+      Vector de0;
+      if (capture) { de0 = de; }
       timer.sw_cgL2.Start();
       CG_EMass.Mult(e_rhs, de);
       timer.sw_cgL2.Stop();
       const HYPRE_Int cg_num_iter = CG_EMass.GetNumIterations();
       timer.L2iter += (cg_num_iter==0) ? 1 : cg_num_iter;
+      if (capture)
+      {
+         EMassPA->RecordSolve(*capture, -1, CG_EMass, false, cg_tol,
+                              cg_max_iter, de0, e_rhs, de);
+      }
+      AddCGExtraError(3, cg_tol, e_rhs, de);
       // Move the memory location of the subvector 'de' to the memory
       // location of the base vector 'dS_dt'.
       de.GetMemory().SyncAlias(dS_dt.GetMemory(), de.Size());
@@ -452,24 +624,147 @@ void LagrangianHydroOperator::SolveEnergy(const Vector &S, const Vector &v,
    else // not p_assembly
    {
       timer.sw_force.Start();
-      Force.MultTranspose(v, e_rhs);
+      if (ForceSell) { ForceSell->MultTranspose(v, e_rhs); }
+      else { Force.MultTranspose(v, e_rhs); }
       timer.sw_force.Stop();
       if (e_source) { e_rhs += *e_source; }
-      Vector loc_rhs(l2dofs_cnt), loc_de(l2dofs_cnt);
-      for (int e = 0; e < NE; e++)
+      // Element-wise right-hand sides and solutions, only for the capture.
+      Vector cap_rhs, cap_de;
+      if (capture)
+      {
+         cap_rhs.SetSize(NE * l2dofs_cnt);
+         cap_de.SetSize(NE * l2dofs_cnt);
+      }
+      const double *d_rhs = e_rhs.HostRead();
+      double *d_de = de.HostReadWrite();
+      double *c_rhs = capture ? cap_rhs.HostWrite() : nullptr;
+      double *c_de = capture ? cap_de.HostWrite() : nullptr;
+      timer.sw_cgL2.Start();
+      // The zones have disjoint L2 dofs.
+#ifdef MFEM_USE_OPENMP
+      #pragma omp parallel
+#endif
+      {
+         Array<int> dofs;
+         Vector loc_rhs(l2dofs_cnt), loc_de(l2dofs_cnt);
+#ifdef MFEM_USE_OPENMP
+         #pragma omp for schedule(dynamic, 16)
+#endif
+         for (int e = 0; e < NE; e++)
+         {
+            L2.GetElementDofs(e, dofs);
+            for (int i = 0; i < l2dofs_cnt; i++)
+            {
+               loc_rhs(i) = d_rhs[dofs[i]];
+            }
+            const DenseMatrix M(const_cast<double *>(Me_inv.GetData(e)),
+                                l2dofs_cnt, l2dofs_cnt);
+            M.Mult(loc_rhs, loc_de);
+            for (int i = 0; i < l2dofs_cnt; i++) { d_de[dofs[i]] = loc_de(i); }
+            if (capture)
+            {
+               for (int i = 0; i < l2dofs_cnt; i++)
+               {
+                  c_rhs[e*l2dofs_cnt + i] = loc_rhs(i);
+                  c_de[e*l2dofs_cnt + i] = loc_de(i);
+               }
+            }
+         }
+      }
+      timer.sw_cgL2.Stop();
+      timer.L2iter += NE;
+      if (capture)
       {
-         L2.GetElementDofs(e, l2dofs);
-         e_rhs.GetSubVector(l2dofs, loc_rhs);
-         timer.sw_cgL2.Start();
-         Me_inv(e).Mult(loc_rhs, loc_de);
-         timer.sw_cgL2.Stop();
-         timer.L2iter += 1;
-         de.SetSubVector(l2dofs, loc_de);
+         capture->Record(KernelCapture::ENERGY_MASS_INVERSE,
+                         {NE, l2dofs_cnt}, {}, {Me_inv, cap_rhs, cap_de});
       }
    }
    delete e_source;
 }
 
+void LagrangianHydroOperator::SetAdaptiveCGTolerance(const int order,
+                                                     const double safety,
+                                                     const double tol_max)
+{
+   MFEM_VERIFY(order > 0 && safety > 0.0, "Invalid adaptive CG parameters!");
+   MFEM_VERIFY(tol_max >= cg_rel_tol, "The maximum CG tolerance must not be "
+               "smaller than the fixed one!");
+   cg_adaptive = true;
+   cg_order = order;
+   cg_safety = safety;
+   cg_tol_max = tol_max;
+}
+
+double LagrangianHydroOperator::StageCGTolerance(const int s, const Vector &b,
+                                                 Vector &x) const
+{
+   cg_warm = false;
+   cg_rho = 0.0;
+   const Vector &b_prev = cg_b_prev[s];
+   if (!cg_adaptive || b_prev.Size() != b.Size()) { return cg_rel_tol; }
+   // Relative stage increment of the right-hand side.
+   cg_db = b;
+   cg_db -= b_prev;
+   const MPI_Comm comm = pmesh->GetComm();
+   const double b_norm = sqrt(GlobalDot(comm, b, b));
+   const double rho = sqrt(GlobalDot(comm, cg_db, cg_db)) / b_norm;
+   if (!(rho < 1.0)) { return cg_rel_tol; }
+   // Starting from the previous solution, the initial residual is ~ rho |b|.
+   // A relative tolerance tol gives a slope error ~ tol rho |x|, which is kept
+   // at the level of the fixed solves, cgt |x|, or of the local error of the
+   // integrator, which scales as rho^order relative to the step increment.
+   x = cg_x_prev[s];
+   cg_warm = true;
+   cg_rho = rho;
+   if (rho == 0.0) { return cg_tol_max; }
+   const double level = fmax(cg_rel_tol, cg_safety * pow(rho, cg_order));
+   return fmin(cg_tol_max, fmax(cg_rel_tol, level / rho));
+}
+
+void LagrangianHydroOperator::AddCGExtraError(const int s, const double tol,
+                                              const Vector &b,
+                                              const Vector &x) const
+{
+   if (!cg_adaptive) { return; }
+   cg_b_prev[s] = b;
+   cg_x_prev[s] = x;
+   const double extra = tol * cg_rho - cg_rel_tol;
+   if (!cg_warm || extra <= 0.0) { return; }
+   const double glob_norm = GlobalDot(pmesh->GetComm(), x, x);
+   cg_extra_error += cg_dt * extra * sqrt(glob_norm);
+}
+
+void LagrangianHydroOperator::SetKernelCapture(KernelCapture *c)
+{
+   MFEM_VERIFY(!c || !qdata.compact_stress,
+               "The kernel capture does not support the compact stress.");
+   MFEM_VERIFY(!c || !jac0_table,
+               "The kernel capture does not support the node shared geometry.");
+   capture = c;
+   if (qupdate) { qupdate->SetKernelCapture(c); }
+   if (ForcePA) { ForcePA->SetKernelCapture(c); }
+}
+
+void LagrangianHydroOperator::MeasureZoneCosts(bool enable)
+{
+   zone_cost.SetSize(enable ? NE : 0);
+   zone_cost = 0.0;
+}
+
+void LagrangianHydroOperator::ContinueFrom(const LagrangianHydroOperator &prev)
+{
+   TimingData &pt = prev.timer;
+   timer.prev_rt[0] += pt.sw_cgH1.RealTime() + pt.prev_rt[0];
+   timer.prev_rt[1] += pt.sw_cgL2.RealTime() + pt.prev_rt[1];
+   timer.prev_rt[2] += pt.sw_force.RealTime() + pt.prev_rt[2];
+   timer.prev_rt[3] += pt.sw_qdata.RealTime() + pt.prev_rt[3];
+   timer.H1iter += pt.H1iter;
+   timer.L2iter += pt.L2iter;
+   timer.quad_tstep += pt.quad_tstep;
+   timer.force_evals += pt.force_evals;
+   cg_extra_error += prev.cg_extra_error;
+}
+
 void LagrangianHydroOperator::UpdateMesh(const Vector &S) const
 {
    Vector* sptr = const_cast<Vector*>(&S);
@@ -483,6 +778,7 @@ double LagrangianHydroOperator::GetTimeStepEstimate(const Vector &S) const
    UpdateQuadratureData(S);
    double glob_dt_est;
    const MPI_Comm comm = H1.GetParMesh()->GetComm();
+   CommProfile::Scope scope(CommProfile::TIME_STEP);
    MPI_Allreduce(&qdata.dt_est, &glob_dt_est, 1, MPI_DOUBLE, MPI_MIN, comm);
    return glob_dt_est;
 }
@@ -495,30 +791,43 @@ void LagrangianHydroOperator::ResetTimeStepEstimate() const
 void LagrangianHydroOperator::ComputeDensity(ParGridFunction &rho) const
 {
    rho.SetSpace(&L2);
-   DenseMatrix Mrho(l2dofs_cnt);
-   Vector rhs(l2dofs_cnt), rho_z(l2dofs_cnt);
-   Array<int> dofs(l2dofs_cnt);
-   DenseMatrixInverse inv(&Mrho);
-   MassIntegrator mi(&ir);
-   DensityIntegrator di(qdata);
-   di.SetIntRule(&ir);
-   for (int e = 0; e < NE; e++)
+   double *d_rho = rho.HostWrite();
+   // The zones have disjoint L2 dofs. Each thread has its own integrators,
+   // since they keep scratch data.
+#ifdef MFEM_USE_OPENMP
+   #pragma omp parallel
+#endif
    {
-      const FiniteElement &fe = *L2.GetFE(e);
-      ElementTransformation &eltr = *L2.GetElementTransformation(e);
-      di.AssembleRHSElementVect(fe, eltr, rhs);
-      mi.AssembleElementMatrix(fe, eltr, Mrho);
-      inv.Factor();
-      inv.Mult(rhs, rho_z);
-      L2.GetElementDofs(e, dofs);
-      rho.SetSubVector(dofs, rho_z);
+      DenseMatrix Mrho(l2dofs_cnt);
+      Vector rhs(l2dofs_cnt), rho_z(l2dofs_cnt);
+      Array<int> dofs(l2dofs_cnt);
+      DenseMatrixInverse inv(&Mrho);
+      MassIntegrator mi(&ir);
+      DensityIntegrator di(qdata);
+      di.SetIntRule(&ir);
+      IsoparametricTransformation eltr;
+#ifdef MFEM_USE_OPENMP
+      #pragma omp for schedule(dynamic, 16)
+#endif
+      for (int e = 0; e < NE; e++)
+      {
+         const FiniteElement &fe = *L2.GetFE(e);
+         pmesh->GetElementTransformation(e, &eltr);
+         di.AssembleRHSElementVect(fe, eltr, rhs);
+         mi.AssembleElementMatrix(fe, eltr, Mrho);
+         inv.Factor();
+         inv.Mult(rhs, rho_z);
+         L2.GetElementDofs(e, dofs);
+         for (int i = 0; i < l2dofs_cnt; i++) { d_rho[dofs[i]] = rho_z(i); }
+      }
    }
 }
 
 
 
-double ComputeVolumeIntegral(const int DIM, const int NE,const int NQ,
-                             const int Q1D,const int VDIM,const double ln_norm,
+double ComputeVolumeIntegral(MPI_Comm comm, const int DIM, const int NE,
+                             const int NQ, const int Q1D, const int VDIM,
+                             const double ln_norm,
                              const mfem::Vector& mass, const mfem::Vector& f)
 {
 
@@ -583,14 +892,11 @@ double ComputeVolumeIntegral(const int DIM, const int NE,const int NQ,
       });
 
    }
-   const double integral = integrand * mass;
-   return integral;
+   return GlobalDot(comm, integrand, mass);
 
 }
 double LagrangianHydroOperator::InternalEnergy(const ParGridFunction &gf) const
 {
-   double glob_ie = 0.0;
-
    // get the restriction and interpolator objects
    const QuadratureInterpolator* l2_interpolator = L2.GetQuadratureInterpolator(
                                                       ir);
@@ -604,19 +910,12 @@ double LagrangianHydroOperator::InternalEnergy(const ParGridFunction &gf) const
    L2r->Mult(gf, e_vector);
    l2_interpolator->Values(e_vector, eintQ);
 
-   double internal_energy = ComputeVolumeIntegral(dim,NE,NQ,Q1D,1,1.0,
-                                                  qdata.rho0DetJ0w,eintQ);
-
-   MPI_Allreduce(&internal_energy, &glob_ie, 1, MPI_DOUBLE, MPI_SUM,
-                 L2.GetParMesh()->GetComm());
-
-   return glob_ie;
+   return ComputeVolumeIntegral(L2.GetParMesh()->GetComm(),dim,NE,NQ,Q1D,1,1.0,
+                                qdata.rho0DetJ0w,eintQ);
 }
 
 double LagrangianHydroOperator::KineticEnergy(const ParGridFunction &v) const
 {
-   double glob_ke = 0.0;
-
    // get the restriction and interpolator objects
    const QuadratureInterpolator* h1_interpolator = H1.GetQuadratureInterpolator(
                                                       ir);
@@ -632,38 +931,36 @@ double LagrangianHydroOperator::KineticEnergy(const ParGridFunction &v) const
 
    // Get the IE, initial weighted mass
 
-   double kinetic_energy = ComputeVolumeIntegral(dim,NE,NQ,Q1D,dim,2.0,
-                                                 qdata.rho0DetJ0w,ekinQ);
-
-   MPI_Allreduce(&kinetic_energy, &glob_ke, 1, MPI_DOUBLE, MPI_SUM,
-                 H1.GetParMesh()->GetComm());
+   const double kinetic_energy =
+      ComputeVolumeIntegral(H1.GetParMesh()->GetComm(),dim,NE,NQ,Q1D,dim,2.0,
+                            qdata.rho0DetJ0w,ekinQ);
 
-   return 0.5*glob_ke;
+   return 0.5*kinetic_energy;
 }
 
-void LagrangianHydroOperator::PrintTimingData(bool IamRoot, int steps,
+void LagrangianHydroOperator::PrintTimingData(bool IamRoot, long long steps,
                                               const bool fom) const
 {
    const MPI_Comm com = H1.GetComm();
    double my_rt[5], T[5];
-   my_rt[0] = timer.sw_cgH1.RealTime();
-   my_rt[1] = timer.sw_cgL2.RealTime();
-   my_rt[2] = timer.sw_force.RealTime();
-   my_rt[3] = timer.sw_qdata.RealTime();
+   my_rt[0] = timer.sw_cgH1.RealTime() + timer.prev_rt[0];
+   my_rt[1] = timer.sw_cgL2.RealTime() + timer.prev_rt[1];
+   my_rt[2] = timer.sw_force.RealTime() + timer.prev_rt[2];
+   my_rt[3] = timer.sw_qdata.RealTime() + timer.prev_rt[3];
    my_rt[4] = my_rt[0] + my_rt[2] + my_rt[3];
    MPI_Reduce(my_rt, T, 5, MPI_DOUBLE, MPI_MAX, 0, com);
 
-   HYPRE_Int mydata[3], alldata[3];
+   long long mydata[3], alldata[3];
    mydata[0] = timer.L2dof * timer.L2iter;
    mydata[1] = timer.quad_tstep;
    mydata[2] = NE;
-   MPI_Reduce(mydata, alldata, 3, HYPRE_MPI_INT, MPI_SUM, 0, com);
+   MPI_Reduce(mydata, alldata, 3, MPI_LONG_LONG, MPI_SUM, 0, com);
 
    if (IamRoot)
    {
       using namespace std;
       // FOM = (FOM1 * T1 + FOM2 * T2 + FOM3 * T3) / (T1 + T2 + T3)
-      const HYPRE_Int H1iter = p_assembly ? (timer.H1iter/dim) : timer.H1iter;
+      const long long H1iter = p_assembly ? (timer.H1iter/dim) : timer.H1iter;
       const double FOM1 = 1e-6 * H1GTVSize * H1iter / T[0];
       const double FOM2 = 1e-6 * steps * (H1GTVSize + L2GTVSize) / T[2];
       const double FOM3 = 1e-6 * alldata[1] * ir.GetNPoints() / T[3];
@@ -691,7 +988,7 @@ void LagrangianHydroOperator::PrintTimingData(bool IamRoot, int steps,
            << FOM << endl;
       if (!fom) { return; }
       const int QPT = ir.GetNPoints();
-      const HYPRE_Int GNZones = alldata[2];
+      const long long GNZones = alldata[2];
       const long ndofs = 2*H1GTVSize + L2GTVSize + QPT*GNZones;
       cout << endl;
       cout << "| Ranks " << "| Zones   "
@@ -723,6 +1020,39 @@ void LagrangianHydroOperator::PrintTimingData(bool IamRoot, int steps,
    }
 }
 
+void LagrangianHydroOperator::GetPerfCounts(long long steps,
+                                            PerfCounts &c) const
+{
+   const MPI_Comm com = H1.GetComm();
+   double my_rt[4], T[4];
+   my_rt[0] = timer.sw_cgH1.RealTime() + timer.prev_rt[0];
+   my_rt[1] = timer.sw_cgL2.RealTime() + timer.prev_rt[1];
+   my_rt[2] = timer.sw_force.RealTime() + timer.prev_rt[2];
+   my_rt[3] = timer.sw_qdata.RealTime() + timer.prev_rt[3];
+   MPI_Allreduce(my_rt, T, 4, MPI_DOUBLE, MPI_MAX, com);
+
+   long long mydata[3], alldata[3];
+   mydata[0] = timer.L2dof * timer.L2iter;
+   mydata[1] = timer.quad_tstep;
+   mydata[2] = NE;
+   MPI_Allreduce(mydata, alldata, 3, MPI_LONG_LONG, MPI_SUM, com);
+
+   c.dim = dim;
+   c.ranks = H1.GetNRanks();
+   c.zones = alldata[2];
+   c.h1_dofs = H1GTVSize;
+   c.l2_dofs = L2GTVSize;
+   c.quads = ir.GetNPoints();
+   c.h1_iters = p_assembly ? (timer.H1iter/dim) : timer.H1iter;
+   c.l2_work = alldata[0];
+   c.force_evals = steps;
+   c.qdata_updates = alldata[1];
+   c.t_cgH1 = T[0];
+   c.t_cgL2 = T[1];
+   c.t_force = T[2];
+   c.t_qdata = T[3];
+}
+
 // Smooth transition between 0 and 1 for x in [-eps, eps].
 MFEM_HOST_DEVICE inline double smooth_step_01(double x, double eps)
 {
@@ -749,161 +1079,193 @@ void LagrangianHydroOperator::UpdateQuadratureData(const Vector &S) const
    x.MakeRef(&H1, *sptr, 0);
    v.MakeRef(&H1, *sptr, H1.GetVSize());
    e.MakeRef(&L2, *sptr, 2*H1.GetVSize());
-   Vector e_vals;
-   DenseMatrix Jpi(dim), sgrad_v(dim), Jinv(dim), stress(dim), stressJiT(dim);
 
    // Batched computations are needed, because hydrodynamic codes usually
    // involve expensive computations of material properties. Although this
    // miniapp uses simple EOS equations, we still want to represent the batched
    // cycle structure.
-   int nzones_batch = 3;
-   const int nbatches =  NE / nzones_batch + 1; // +1 for the remainder.
-   int nqp_batch = nqp * nzones_batch;
-   double *gamma_b = new double[nqp_batch],
-   *rho_b = new double[nqp_batch],
-   *e_b   = new double[nqp_batch],
-   *p_b   = new double[nqp_batch],
-   *cs_b  = new double[nqp_batch];
-   // Jacobians of reference->physical transformations for all quadrature points
-   // in the batch.
-   DenseTensor *Jpr_b = new DenseTensor[nzones_batch];
-   for (int b = 0; b < nbatches; b++)
+   const int nzones_batch = 3;
+   const int nbatches = (NE + nzones_batch - 1) / nzones_batch;
+   // The batch part of the cost is split evenly between its zones.
+   typedef std::chrono::steady_clock Clock;
+   const bool measure = zone_cost.Size() == NE;
+   double *cost = measure ? zone_cost.HostReadWrite() : nullptr;
+   const double *rho0DetJ0w = qdata.rho0DetJ0w.HostRead();
+   DenseTensor &stressJinvT = qdata.stressJinvT;
+   stressJinvT.HostReadWrite();
+   double dt_est = qdata.dt_est;
+
+   // The cost of the zones varies, e.g., with the compression that decides the
+   // viscosity, so the threads take the batches dynamically. Each thread has
+   // its own element transformation and scratch data, the zones write disjoint
+   // quadrature data, and the minimum time step does not depend on the order.
+#ifdef MFEM_USE_OPENMP
+   #pragma omp parallel reduction(min:dt_est)
+#endif
    {
-      int z_id = b * nzones_batch; // Global index over zones.
-      // The last batch might not be full.
-      if (z_id == NE) { break; }
-      else if (z_id + nzones_batch > NE)
+      IsoparametricTransformation T;
+      Vector e_vals, compr_dir(dim), ph_dir(dim);
+      DenseMatrix Jpi(dim), sgrad_v(dim), Jinv(dim), stress(dim),
+                  stressJiT(dim);
+      const int nqp_batch = nqp * nzones_batch;
+      std::vector<double> gamma_b(nqp_batch), rho_b(nqp_batch),
+          e_b(nqp_batch), p_b(nqp_batch), cs_b(nqp_batch);
+      // Jacobians of reference->physical transformations for all quadrature
+      // points in the batch.
+      DenseTensor Jpr_b[nzones_batch];
+#ifdef MFEM_USE_OPENMP
+      #pragma omp for schedule(dynamic)
+#endif
+      for (int b = 0; b < nbatches; b++)
       {
-         nzones_batch = NE - z_id;
-         nqp_batch    = nqp * nzones_batch;
-      }
-
-      double min_detJ = std::numeric_limits<double>::infinity();
-      for (int z = 0; z < nzones_batch; z++)
-      {
-         ElementTransformation *T = H1.GetElementTransformation(z_id);
-         Jpr_b[z].SetSize(dim, dim, nqp);
-         e.GetValues(z_id, ir, e_vals);
-         for (int q = 0; q < nqp; q++)
+         Clock::time_point tic;
+         if (measure) { tic = Clock::now(); }
+         const int z0 = b * nzones_batch; // Global index over zones.
+         // The last batch might not be full.
+         const int nz = std::min(nzones_batch, NE - z0);
+
+         double min_detJ = std::numeric_limits<double>::infinity();
+         for (int z = 0; z < nz; z++)
          {
-            const IntegrationPoint &ip = ir.IntPoint(q);
-            T->SetIntPoint(&ip);
-            Jpr_b[z](q) = T->Jacobian();
-            const double detJ = Jpr_b[z](q).Det();
-            min_detJ = fmin(min_detJ, detJ);
-            const int idx = z * nqp + q;
-            // Assuming piecewise constant gamma that moves with the mesh.
-            gamma_b[idx] = gamma_gf(z_id);
-            rho_b[idx] = qdata.rho0DetJ0w(z_id*nqp + q) / detJ / ip.weight;
-            e_b[idx] = fmax(0.0, e_vals(q));
+            const int z_id = z0 + z;
+            pmesh->GetElementTransformation(z_id, &T);
+            Jpr_b[z].SetSize(dim, dim, nqp);
+            e.GetValues(T, ir, e_vals);
+            for (int q = 0; q < nqp; q++)
+            {
+               const IntegrationPoint &ip = ir.IntPoint(q);
+               T.SetIntPoint(&ip);
+               Jpr_b[z](q) = T.Jacobian();
+               const double detJ = Jpr_b[z](q).Det();
+               min_detJ = fmin(min_detJ, detJ);
+               const int idx = z * nqp + q;
+               // Assuming piecewise constant gamma that moves with the mesh.
+               gamma_b[idx] = gamma_gf(z_id);
+               rho_b[idx] = rho0DetJ0w[z_id*nqp + q] / detJ / ip.weight;
+               e_b[idx] = fmax(0.0, e_vals(q));
+            }
          }
-         ++z_id;
-      }
 
-      // Batched computation of material properties.
-      ComputeMaterialProperties(nqp_batch, gamma_b, rho_b, e_b, p_b, cs_b);
+         // Batched computation of material properties.
+         ComputeMaterialProperties(nqp * nz, gamma_b.data(), rho_b.data(),
+                                   e_b.data(), p_b.data(), cs_b.data());
 
-      z_id -= nzones_batch;
-      for (int z = 0; z < nzones_batch; z++)
-      {
-         ElementTransformation *T = H1.GetElementTransformation(z_id);
-         for (int q = 0; q < nqp; q++)
+         if (measure)
          {
-            const IntegrationPoint &ip = ir.IntPoint(q);
-            T->SetIntPoint(&ip);
-            // Note that the Jacobian was already computed above. We've chosen
-            // not to store the Jacobians for all batched quadrature points.
-            const DenseMatrix &Jpr = Jpr_b[z](q);
-            CalcInverse(Jpr, Jinv);
-            const double detJ = Jpr.Det(), rho = rho_b[z*nqp + q],
-                         p = p_b[z*nqp + q], sound_speed = cs_b[z*nqp + q];
-            stress = 0.0;
-            for (int d = 0; d < dim; d++) { stress(d, d) = -p; }
-            double visc_coeff = 0.0;
-            if (use_viscosity)
+            const std::chrono::duration<double> t = Clock::now() - tic;
+            for (int z = 0; z < nz; z++) { cost[z0 + z] += t.count() / nz; }
+         }
+         for (int z = 0; z < nz; z++)
+         {
+            const int z_id = z0 + z;
+            if (measure) { tic = Clock::now(); }
+            pmesh->GetElementTransformation(z_id, &T);
+            for (int q = 0; q < nqp; q++)
             {
-               // Compression-based length scale at the point. The first
-               // eigenvector of the symmetric velocity gradient gives the
-               // direction of maximal compression. This is used to define the
-               // relative change of the initial length scale.
-               v.GetVectorGradient(*T, sgrad_v);
-
-               double vorticity_coeff = 1.0;
-               if (use_vorticity)
+               const IntegrationPoint &ip = ir.IntPoint(q);
+               T.SetIntPoint(&ip);
+               // Note that the Jacobian was already computed above. We've
+               // chosen not to store the Jacobians for all batched quadrature
+               // points.
+               const DenseMatrix &Jpr = Jpr_b[z](q);
+               CalcInverse(Jpr, Jinv);
+               const double detJ = Jpr.Det(), rho = rho_b[z*nqp + q],
+                            p = p_b[z*nqp + q], sound_speed = cs_b[z*nqp + q];
+               stress = 0.0;
+               for (int d = 0; d < dim; d++) { stress(d, d) = -p; }
+               double visc_coeff = 0.0;
+               if (use_viscosity)
                {
-                  const double grad_norm = sgrad_v.FNorm();
-                  const double div_v = fabs(sgrad_v.Trace());
-                  vorticity_coeff = (grad_norm > 0.0) ? div_v / grad_norm : 1.0;
-               }
+                  // Compression-based length scale at the point. The first
+                  // eigenvector of the symmetric velocity gradient gives the
+                  // direction of maximal compression. This is used to define
+                  // the relative change of the initial length scale.
+                  v.GetVectorGradient(T, sgrad_v);
+
+                  double vorticity_coeff = 1.0;
+                  if (use_vorticity)
+                  {
+                     const double grad_norm = sgrad_v.FNorm();
+                     const double div_v = fabs(sgrad_v.Trace());
+                     vorticity_coeff = (grad_norm > 0.0) ?
+                                       div_v / grad_norm : 1.0;
+                  }
 
-               sgrad_v.Symmetrize();
-               double eig_val_data[3], eig_vec_data[9];
-               if (dim==1)
+                  sgrad_v.Symmetrize();
+                  double eig_val_data[3], eig_vec_data[9];
+                  if (dim==1)
+                  {
+                     eig_val_data[0] = sgrad_v(0, 0);
+                     eig_vec_data[0] = 1.;
+                  }
+                  else { sgrad_v.CalcEigenvalues(eig_val_data, eig_vec_data); }
+                  for (int d = 0; d < dim; d++)
+                  {
+                     compr_dir(d) = eig_vec_data[d];
+                  }
+                  // Computes the initial->physical transformation Jacobian.
+                  const DenseMatrix J0inv(
+                     const_cast<double *>(qdata.Jac0invData(z_id, q)),
+                     dim, dim);
+                  mfem::Mult(Jpr, J0inv, Jpi);
+                  Jpi.Mult(compr_dir, ph_dir);
+                  // Change of the initial mesh size in the compression
+                  // direction.
+                  const double h = qdata.h0 * ph_dir.Norml2() /
+                                   compr_dir.Norml2();
+                  // Measure of maximal compression.
+                  const double mu = eig_val_data[0];
+                  visc_coeff = 2.0 * rho * h * h * fabs(mu);
+                  // The following represents a "smooth" version of the
+                  // statement "if (mu < 0) visc_coeff += 0.5 rho h
+                  // sound_speed".  Note that eps must be scaled appropriately
+                  // if a different unit system is being used.
+                  const double eps = 1e-12;
+                  visc_coeff += 0.5 * rho * h * sound_speed * vorticity_coeff *
+                                (1.0 - smooth_step_01(mu - 2.0 * eps, eps));
+                  stress.Add(visc_coeff, sgrad_v);
+               }
+               // Time step estimate at the point. Here the more relevant
+               // length scale is related to the actual mesh deformation; we
+               // use the min singular value of the ref->physical Jacobian. In
+               // addition, the time step estimate should be aware of the
+               // presence of shocks.
+               const double h_min =
+                  Jpr.CalcSingularvalue(dim-1) / (double) H1.GetOrder(0);
+               const double inv_dt = sound_speed / h_min +
+                                     2.5 * visc_coeff / rho / h_min / h_min;
+               if (min_detJ < 0.0)
                {
-                  eig_val_data[0] = sgrad_v(0, 0);
-                  eig_vec_data[0] = 1.;
+                  // This will force repetition of the step with smaller dt.
+                  dt_est = 0.0;
                }
-               else { sgrad_v.CalcEigenvalues(eig_val_data, eig_vec_data); }
-               Vector compr_dir(eig_vec_data, dim);
-               // Computes the initial->physical transformation Jacobian.
-               mfem::Mult(Jpr, qdata.Jac0inv(z_id*nqp + q), Jpi);
-               Vector ph_dir(dim); Jpi.Mult(compr_dir, ph_dir);
-               // Change of the initial mesh size in the compression direction.
-               const double h = qdata.h0 * ph_dir.Norml2() /
-                                compr_dir.Norml2();
-               // Measure of maximal compression.
-               const double mu = eig_val_data[0];
-               visc_coeff = 2.0 * rho * h * h * fabs(mu);
-               // The following represents a "smooth" version of the statement
-               // "if (mu < 0) visc_coeff += 0.5 rho h sound_speed".  Note that
-               // eps must be scaled appropriately if a different unit system is
-               // being used.
-               const double eps = 1e-12;
-               visc_coeff += 0.5 * rho * h * sound_speed * vorticity_coeff *
-                             (1.0 - smooth_step_01(mu - 2.0 * eps, eps));
-               stress.Add(visc_coeff, sgrad_v);
-            }
-            // Time step estimate at the point. Here the more relevant length
-            // scale is related to the actual mesh deformation; we use the min
-            // singular value of the ref->physical Jacobian. In addition, the
-            // time step estimate should be aware of the presence of shocks.
-            const double h_min =
-               Jpr.CalcSingularvalue(dim-1) / (double) H1.GetOrder(0);
-            const double inv_dt = sound_speed / h_min +
-                                  2.5 * visc_coeff / rho / h_min / h_min;
-            if (min_detJ < 0.0)
-            {
-               // This will force repetition of the step with smaller dt.
-               qdata.dt_est = 0.0;
-            }
-            else
-            {
-               if (inv_dt>0.0)
+               else
                {
-                  qdata.dt_est = fmin(qdata.dt_est, cfl*(1.0/inv_dt));
+                  if (inv_dt>0.0)
+                  {
+                     dt_est = fmin(dt_est, cfl*(1.0/inv_dt));
+                  }
                }
-            }
-            // Quadrature data for partial assembly of the force operator.
-            MultABt(stress, Jinv, stressJiT);
-            stressJiT *= ir.IntPoint(q).weight * detJ;
-            for (int vd = 0 ; vd < dim; vd++)
-            {
-               for (int gd = 0; gd < dim; gd++)
+               // Quadrature data for partial assembly of the force operator.
+               MultABt(stress, Jinv, stressJiT);
+               stressJiT *= ir.IntPoint(q).weight * detJ;
+               for (int vd = 0 ; vd < dim; vd++)
                {
-                  qdata.stressJinvT(vd)(z_id*nqp + q, gd) =
-                     stressJiT(vd, gd);
+                  for (int gd = 0; gd < dim; gd++)
+                  {
+                     stressJinvT(z_id*nqp + q, gd, vd) = stressJiT(vd, gd);
+                  }
                }
             }
+            if (measure)
+            {
+               const std::chrono::duration<double> t = Clock::now() - tic;
+               cost[z_id] += t.count();
+            }
          }
-         ++z_id;
       }
    }
-   delete [] gamma_b;
-   delete [] rho_b;
-   delete [] e_b;
-   delete [] p_b;
-   delete [] cs_b;
-   delete [] Jpr_b;
+   qdata.dt_est = dt_est;
    timer.sw_qdata.Stop();
    timer.quad_tstep += NE;
 }
@@ -963,7 +1325,10 @@ double FNorm(const T * __restrict__ data)
    return s*sqrt(n2);
 }
 
-template<int DIM> MFEM_HOST_DEVICE static inline
+// The offsets in the E-vector and quadrature arrays are computed with the
+// index type I. With CS, d_stressJinvT is the compact stress of
+// QuadratureData::stress.
+template<int DIM, typename I, bool CS = false> MFEM_HOST_DEVICE static inline
 void QUpdateBody(const int NE, const int e,
                  const int NQ, const int q,
                  const bool use_viscosity,
@@ -988,17 +1353,19 @@ void QUpdateBody(const int NE, const int e,
                  const double* __restrict__ d_e_quads,
                  const double* __restrict__ d_grad_v_ext,
                  const double* __restrict__ d_Jac0inv,
+                 const int J0z,
+                 const int *d_J0c,
                  double *d_dt_est,
                  double *d_stressJinvT)
 {
    constexpr int DIM2 = DIM*DIM;
    double min_detJ = infinity;
 
-   const int eq = e * NQ + q;
+   const I eq = I(e) * NQ + q;
    const double gamma = d_gamma[e];
    const double weight =  d_weights[q];
    const double inv_weight = 1. / weight;
-   const double *J = d_Jacobians + DIM2*(NQ*e + q);
+   const double *J = d_Jacobians + DIM2*eq;
    const double detJ = kernels::Det<DIM>(J);
    min_detJ = fmin(min_detJ, detJ);
    kernels::CalcInverse<DIM>(J, Jinv);
@@ -1015,7 +1382,7 @@ void QUpdateBody(const int NE, const int e,
       // eigenvector of the symmetric velocity gradient gives the
       // direction of maximal compression. This is used to define the
       // relative change of the initial length scale.
-      const double *dV = d_grad_v_ext + DIM2*(NQ*e + q);
+      const double *dV = d_grad_v_ext + DIM2*eq;
       kernels::Mult(DIM, DIM, DIM, dV, Jinv, sgrad_v);
 
       double vorticity_coeff = 1.0;
@@ -1038,7 +1405,8 @@ void QUpdateBody(const int NE, const int e,
       }
       for (int k=0; k<DIM; k++) { compr_dir[k] = eig_vec_data[k]; }
       // Computes the initial->physical transformation Jacobian.
-      kernels::Mult(DIM, DIM, DIM, J, d_Jac0inv + eq*DIM*DIM, Jpi);
+      const I j0 = (d_J0c ? I(d_J0c[e])*NQ : I(e)*J0z) + q;
+      kernels::Mult(DIM, DIM, DIM, J, d_Jac0inv + j0*DIM2, Jpi);
       kernels::Mult(DIM, DIM, Jpi, compr_dir, ph_dir);
       // Change of the initial mesh size in the compression direction.
       const double ph_dir_nl2 = kernels::Norml2(DIM, ph_dir);
@@ -1078,6 +1446,23 @@ void QUpdateBody(const int NE, const int e,
          d_dt_est[eq] = fmin(d_dt_est[eq], cfl_inv_dt);
       }
    }
+   if (CS)
+   {
+      // The stress is symmetric, since sgrad_v is.
+      const I NQE = I(NQ)*NE;
+      for (int d = 0; d < DIM; d++)
+      {
+         d_stressJinvT[eq + NQE*d] = weight * stress[d*DIM + d];
+      }
+      if (DIM == 2) { d_stressJinvT[eq + NQE*2] = weight * stress[2]; }
+      if (DIM == 3)
+      {
+         d_stressJinvT[eq + NQE*3] = weight * stress[1 + 2*DIM];
+         d_stressJinvT[eq + NQE*4] = weight * stress[0 + 2*DIM];
+         d_stressJinvT[eq + NQE*5] = weight * stress[0 + 1*DIM];
+      }
+      return;
+   }
    // Quadrature data for partial assembly of the force operator.
    kernels::MultABt(DIM, DIM, DIM, stress, Jinv, stressJiT);
    for (int k = 0; k < DIM2; k++) { stressJiT[k] *= weight * detJ; }
@@ -1085,7 +1470,7 @@ void QUpdateBody(const int NE, const int e,
    {
       for (int gd = 0; gd < DIM; gd++)
       {
-         const int offset = eq + NQ*NE*(gd + vd*DIM);
+         const I offset = eq + I(NQ)*NE*(gd + vd*DIM);
          d_stressJinvT[offset] = stressJiT[vd + gd*DIM];
       }
    }
@@ -1110,13 +1495,8 @@ static void Rho0DetJ0Vol(const int dim, const int NE,
    qi->Mult(rho0, QuadratureInterpolator::VALUES, rho0Q, j, detj);
    const auto W = ir.GetWeights().Read();
    const auto R = Reshape(rho0Q.Read(), NQ, NE);
-   const auto J = Reshape(geom->J.Read(), NQ, dim, dim, NE);
    const auto detJ = Reshape(geom->detJ.Read(), NQ, NE);
    auto V = Reshape(qdata.rho0DetJ0w.Write(), NQ, NE);
-   Memory<double> &Jinv_m = qdata.Jac0inv.GetMemory();
-   const MemoryClass mc = Device::GetMemoryClass();
-   const int Ji_total_size = qdata.Jac0inv.TotalSize();
-   auto invJ = Reshape(Jinv_m.Write(mc, Ji_total_size), dim, dim, NQ, NE);
    Vector vol(NE*NQ), one(NE*NQ);
    auto A = Reshape(vol.Write(), NQ, NE);
    auto O = Reshape(one.Write(), NQ, NE);
@@ -1130,17 +1510,8 @@ static void Rho0DetJ0Vol(const int dim, const int NE,
             MFEM_FOREACH_THREAD(qx,x,Q1D)
             {
                const int q = qx + qy * Q1D;
-               const double J11 = J(q,0,0,e);
-               const double J12 = J(q,1,0,e);
-               const double J21 = J(q,0,1,e);
-               const double J22 = J(q,1,1,e);
                const double det = detJ(q,e);
                V(q,e) =  W[q] * R(q,e) * det;
-               const double r_idetJ = 1.0 / det;
-               invJ(0,0,q,e) =  J22 * r_idetJ;
-               invJ(1,0,q,e) = -J12 * r_idetJ;
-               invJ(0,1,q,e) = -J21 * r_idetJ;
-               invJ(1,1,q,e) =  J11 * r_idetJ;
                A(q,e) = W[q] * det;
                O(q,e) = 1.0;
             }
@@ -1158,12 +1529,80 @@ static void Rho0DetJ0Vol(const int dim, const int NE,
                MFEM_FOREACH_THREAD(qx,x,Q1D)
                {
                   const int q = qx + (qy + qz * Q1D) * Q1D;
-                  const double J11 = J(q,0,0,e), J12 = J(q,0,1,e), J13 = J(q,0,2,e);
-                  const double J21 = J(q,1,0,e), J22 = J(q,1,1,e), J23 = J(q,1,2,e);
-                  const double J31 = J(q,2,0,e), J32 = J(q,2,1,e), J33 = J(q,2,2,e);
                   const double det = detJ(q,e);
                   V(q,e) = W[q] * R(q,e) * det;
-                  const double r_idetJ = 1.0 / det;
+                  A(q,e) = W[q] * det;
+                  O(q,e) = 1.0;
+               }
+            }
+         }
+      });
+   }
+   qdata.rho0DetJ0w.HostRead();
+   volume = vol * one;
+}
+
+// Sets the ne*NQ matrices of Jac0inv to the inverse initial Jacobians of the
+// zones e0, ..., e0 + ne - 1.
+static void Jac0invZones(const int dim, const int e0, const int ne,
+                         const IntegrationRule &ir,
+                         ParMesh *pmesh,
+                         DenseTensor &Jac0inv)
+{
+   const int NE = pmesh->GetNE();
+   const int NQ = ir.GetNPoints();
+   const int Q1D = IntRules.Get(Geometry::SEGMENT,ir.GetOrder()).GetNPoints();
+   const int flags = GeometricFactors::JACOBIANS|GeometricFactors::DETERMINANTS;
+   const GeometricFactors *geom = pmesh->GetGeometricFactors(ir, flags);
+   const auto J = Reshape(geom->J.Read(), NQ, dim, dim, NE);
+   const auto detJ = Reshape(geom->detJ.Read(), NQ, NE);
+   Memory<double> &Jinv_m = Jac0inv.GetMemory();
+   const MemoryClass mc = Device::GetMemoryClass();
+   const int Ji_total_size = Jac0inv.TotalSize();
+   auto invJ = Reshape(Jinv_m.Write(mc, Ji_total_size), dim, dim, NQ, ne);
+   MFEM_ASSERT(dim==2 || dim==3, "");
+   if (dim==2)
+   {
+      MFEM_FORALL_2D(e, ne, Q1D, Q1D, 1,
+      {
+         const int ez = e0 + e;
+         MFEM_FOREACH_THREAD(qy,y,Q1D)
+         {
+            MFEM_FOREACH_THREAD(qx,x,Q1D)
+            {
+               const int q = qx + qy * Q1D;
+               const double J11 = J(q,0,0,ez);
+               const double J12 = J(q,1,0,ez);
+               const double J21 = J(q,0,1,ez);
+               const double J22 = J(q,1,1,ez);
+               const double r_idetJ = 1.0 / detJ(q,ez);
+               invJ(0,0,q,e) =  J22 * r_idetJ;
+               invJ(1,0,q,e) = -J12 * r_idetJ;
+               invJ(0,1,q,e) = -J21 * r_idetJ;
+               invJ(1,1,q,e) =  J11 * r_idetJ;
+            }
+         }
+      });
+   }
+   else
+   {
+      MFEM_FORALL_3D(e, ne, Q1D, Q1D, Q1D,
+      {
+         const int ez = e0 + e;
+         MFEM_FOREACH_THREAD(qz,z,Q1D)
+         {
+            MFEM_FOREACH_THREAD(qy,y,Q1D)
+            {
+               MFEM_FOREACH_THREAD(qx,x,Q1D)
+               {
+                  const int q = qx + (qy + qz * Q1D) * Q1D;
+                  const double J11 = J(q,0,0,ez), J12 = J(q,0,1,ez),
+                               J13 = J(q,0,2,ez);
+                  const double J21 = J(q,1,0,ez), J22 = J(q,1,1,ez),
+                               J23 = J(q,1,2,ez);
+                  const double J31 = J(q,2,0,ez), J32 = J(q,2,1,ez),
+                               J33 = J(q,2,2,ez);
+                  const double r_idetJ = 1.0 / detJ(q,ez);
                   invJ(0,0,q,e) = r_idetJ * ((J22 * J33)-(J23 * J32));
                   invJ(1,0,q,e) = r_idetJ * ((J32 * J13)-(J33 * J12));
                   invJ(2,0,q,e) = r_idetJ * ((J12 * J23)-(J13 * J22));
@@ -1173,18 +1612,15 @@ static void Rho0DetJ0Vol(const int dim, const int NE,
                   invJ(0,2,q,e) = r_idetJ * ((J21 * J32)-(J22 * J31));
                   invJ(1,2,q,e) = r_idetJ * ((J31 * J12)-(J32 * J11));
                   invJ(2,2,q,e) = r_idetJ * ((J11 * J22)-(J12 * J21));
-                  A(q,e) = W[q] * det;
-                  O(q,e) = 1.0;
                }
             }
          }
       });
    }
-   qdata.rho0DetJ0w.HostRead();
-   volume = vol * one;
 }
 
-template<int DIM, int Q1D> static inline
+template<int DIM, int Q1D, typename I = int, bool CW = false,
+         bool CS = false> static inline
 void QKernel(const int NE, const int NQ,
              const bool use_viscosity,
              const bool use_vorticity,
@@ -1192,15 +1628,17 @@ void QKernel(const int NE, const int NQ,
              const double h1order,
              const double cfl,
              const double infinity,
-             const ParGridFunction &gamma_gf,
+             const Vector &gamma_gf,
              const Array<double> &weights,
              const Vector &Jacobians,
              const Vector &rho0DetJ0w,
              const Vector &e_quads,
              const Vector &grad_v_ext,
              const DenseTensor &Jac0inv,
+             const Array<int> &jac0_class,
              Vector &dt_est,
-             DenseTensor &stressJinvT)
+             DenseTensor &stressJinvT,
+             Vector &stress)
 {
    constexpr int DIM2 = DIM*DIM;
    const auto d_gamma = gamma_gf.Read();
@@ -1210,8 +1648,13 @@ void QKernel(const int NE, const int NQ,
    const auto d_e_quads = e_quads.Read();
    const auto d_grad_v_ext = grad_v_ext.Read();
    const auto d_Jac0inv = Read(Jac0inv.GetMemory(), Jac0inv.TotalSize());
+   // Zone stride of Jac0inv, 0 when the matrices are shared by all zones,
+   // unless the zones have classes.
+   const int J0z = (Jac0inv.SizeK() == NE*NQ) ? NQ : 0;
+   const int *d_J0c = jac0_class.Size() ? jac0_class.Read() : nullptr;
    auto d_dt_est = dt_est.ReadWrite();
-   auto d_stressJinvT = Write(stressJinvT.GetMemory(), stressJinvT.TotalSize());
+   auto d_stressJinvT = CS ? stress.Write() :
+                        Write(stressJinvT.GetMemory(), stressJinvT.TotalSize());
    if (DIM == 2)
    {
       MFEM_FORALL_2D(e, NE, Q1D, Q1D, 1,
@@ -1225,17 +1668,20 @@ void QKernel(const int NE, const int NQ,
          double Jpi[DIM2];
          double ph_dir[DIM];
          double stressJiT[DIM2];
+         // With CW, the compile-time weights replace the ones of the rule.
+         constexpr ConstWeights<DIM, Q1D> cw;
+         const double *W = CW ? cw.W : d_weights;
          MFEM_FOREACH_THREAD(qx,x,Q1D)
          {
             MFEM_FOREACH_THREAD(qy,y,Q1D)
             {
-               QUpdateBody<DIM>(NE, e, NQ, qx + qy * Q1D,
+               QUpdateBody<DIM,I,CS>(NE, e, NQ, qx + qy * Q1D,
                                 use_viscosity, use_vorticity, h0, h1order, cfl, infinity,
                                 Jinv, stress, sgrad_v, eig_val_data, eig_vec_data,
                                 compr_dir, Jpi, ph_dir, stressJiT,
-                                d_gamma, d_weights, d_Jacobians, d_rho0DetJ0w,
-                                d_e_quads, d_grad_v_ext, d_Jac0inv,
-                                d_dt_est, d_stressJinvT);
+                                d_gamma, W, d_Jacobians, d_rho0DetJ0w,
+                                d_e_quads, d_grad_v_ext, d_Jac0inv, J0z,
+                                d_J0c, d_dt_est, d_stressJinvT);
             }
          }
          MFEM_SYNC_THREAD;
@@ -1254,19 +1700,22 @@ void QKernel(const int NE, const int NQ,
          double Jpi[DIM2];
          double ph_dir[DIM];
          double stressJiT[DIM2];
+         // With CW, the compile-time weights replace the ones of the rule.
+         constexpr ConstWeights<DIM, Q1D> cw;
+         const double *W = CW ? cw.W : d_weights;
          MFEM_FOREACH_THREAD(qx,x,Q1D)
          {
             MFEM_FOREACH_THREAD(qy,y,Q1D)
             {
                MFEM_FOREACH_THREAD(qz,z,Q1D)
                {
-                  QUpdateBody<DIM>(NE, e, NQ, qx + Q1D * (qy + qz * Q1D),
+                  QUpdateBody<DIM,I,CS>(NE, e, NQ, qx + Q1D * (qy + qz * Q1D),
                                    use_viscosity, use_vorticity, h0, h1order, cfl, infinity,
                                    Jinv, stress, sgrad_v, eig_val_data, eig_vec_data,
                                    compr_dir, Jpi, ph_dir, stressJiT,
-                                   d_gamma, d_weights, d_Jacobians, d_rho0DetJ0w,
-                                   d_e_quads, d_grad_v_ext, d_Jac0inv,
-                                   d_dt_est, d_stressJinvT);
+                                   d_gamma, W, d_Jacobians, d_rho0DetJ0w,
+                                   d_e_quads, d_grad_v_ext, d_Jac0inv, J0z,
+                                   d_J0c, d_dt_est, d_stressJinvT);
                }
             }
          }
@@ -1275,51 +1724,117 @@ void QKernel(const int NE, const int NQ,
    }
 }
 
-void QUpdate::UpdateQuadratureData(const Vector &S, QuadratureData &qdata)
+static bool kernel_index64 = false;
+
+void SetKernelIndex64(bool enable) { kernel_index64 = enable; }
+
+bool KernelIndex64() { return kernel_index64; }
+
+void QUpdateKernel(const int dim, const int Q1D, const int NE, const int NQ,
+                   const bool use_viscosity, const bool use_vorticity,
+                   const double h0, const double h1order, const double cfl,
+                   const Vector &gamma, const Array<double> &weights,
+                   const Vector &Jacobians, const Vector &rho0DetJ0w,
+                   const Vector &e_quads, const Vector &grad_v_ext,
+                   const DenseTensor &Jac0inv,
+                   Vector &dt_est, DenseTensor &stressJinvT,
+                   Vector *stress, const Array<int> *jac0_class,
+                   const bool cw)
 {
-   timer->sw_qdata.Start();
-   Vector* S_p = const_cast<Vector*>(&S);
-   const int H1_size = H1.GetVSize();
-   const double h1order = (double) H1.GetOrder(0);
    const double infinity = std::numeric_limits<double>::infinity();
-   ParGridFunction x, v, e;
-   x.MakeRef(&H1,*S_p, 0);
-   H1R->Mult(x, e_vec);
-   q1->SetOutputLayout(QVectorLayout::byVDIM);
-   q1->Derivatives(e_vec, q_dx);
-   v.MakeRef(&H1,*S_p, H1_size);
-   H1R->Mult(v, e_vec);
-   q1->Derivatives(e_vec, q_dv);
-   e.MakeRef(&L2, *S_p, 2*H1_size);
-   q2->SetOutputLayout(QVectorLayout::byVDIM);
-   q2->Values(e, q_e);
-   q_dt_est = qdata.dt_est;
-   const int id = (dim << 4) | Q1D;
+   // The largest offset, NE*NQ*dim*dim, fits in int (see QuadratureData), so
+   // the 64-bit offsets are only used to measure their cost.
+   const bool i64 = kernel_index64;
+   const bool cs = stress != nullptr;
+   const int id = (cs << 10) | (cw << 9) | (i64 << 8) | (dim << 4) | Q1D;
    typedef void (*fQKernel)(const int NE, const int NQ,
                             const bool use_viscosity,
                             const bool use_vorticity,
                             const double h0, const double h1order,
                             const double cfl, const double infinity,
-                            const ParGridFunction &gamma_gf,
+                            const Vector &gamma,
                             const Array<double> &weights,
                             const Vector &Jacobians, const Vector &rho0DetJ0w,
                             const Vector &e_quads, const Vector &grad_v_ext,
                             const DenseTensor &Jac0inv,
-                            Vector &dt_est, DenseTensor &stressJinvT);
+                            const Array<int> &jac0_class,
+                            Vector &dt_est, DenseTensor &stressJinvT,
+                            Vector &stress);
    static std::unordered_map<int, fQKernel> qupdate =
    {
       {0x24,&QKernel<2,4>}, {0x26,&QKernel<2,6>}, {0x28,&QKernel<2,8>},
-      {0x34,&QKernel<3,4>}, {0x36,&QKernel<3,6>}, {0x38,&QKernel<3,8>}
+      {0x34,&QKernel<3,4>}, {0x36,&QKernel<3,6>}, {0x38,&QKernel<3,8>},
+      {0x124,&QKernel<2,4,long long>}, {0x126,&QKernel<2,6,long long>},
+      {0x128,&QKernel<2,8,long long>}, {0x134,&QKernel<3,4,long long>},
+      {0x136,&QKernel<3,6,long long>}, {0x138,&QKernel<3,8,long long>},
+      // Compile-time quadrature weights
+      {0x224,&QKernel<2,4,int,true>}, {0x226,&QKernel<2,6,int,true>},
+      {0x228,&QKernel<2,8,int,true>}, {0x234,&QKernel<3,4,int,true>},
+      {0x236,&QKernel<3,6,int,true>}, {0x238,&QKernel<3,8,int,true>},
+      {0x324,&QKernel<2,4,long long,true>},
+      {0x326,&QKernel<2,6,long long,true>},
+      {0x328,&QKernel<2,8,long long,true>},
+      {0x334,&QKernel<3,4,long long,true>},
+      {0x336,&QKernel<3,6,long long,true>},
+      {0x338,&QKernel<3,8,long long,true>},
+      // Compact stress (3D)
+      {0x434,&QKernel<3,4,int,false,true>},
+      {0x436,&QKernel<3,6,int,false,true>},
+      {0x534,&QKernel<3,4,long long,false,true>},
+      {0x536,&QKernel<3,6,long long,false,true>},
+      {0x634,&QKernel<3,4,int,true,true>},
+      {0x636,&QKernel<3,6,int,true,true>},
+      {0x734,&QKernel<3,4,long long,true,true>},
+      {0x736,&QKernel<3,6,long long,true,true>}
    };
    if (!qupdate[id])
    {
       mfem::out << "Unknown kernel 0x" << std::hex << id << std::endl;
       MFEM_ABORT("Unknown kernel");
    }
-   qupdate[id](NE, NQ, use_viscosity, use_vorticity, qdata.h0, h1order,
-               cfl, infinity, gamma_gf, ir.GetWeights(), q_dx,
-               qdata.rho0DetJ0w, q_e, q_dv,
-               qdata.Jac0inv, q_dt_est, qdata.stressJinvT);
+   Vector none;
+   const Array<int> all;
+   qupdate[id](NE, NQ, use_viscosity, use_vorticity, h0, h1order,
+               cfl, infinity, gamma, weights, Jacobians,
+               rho0DetJ0w, e_quads, grad_v_ext,
+               Jac0inv, jac0_class ? *jac0_class : all, dt_est,
+               stressJinvT, cs ? *stress : none);
+}
+
+void QUpdate::UpdateQuadratureData(const Vector &S, QuadratureData &qdata)
+{
+   timer->sw_qdata.Start();
+   Vector* S_p = const_cast<Vector*>(&S);
+   const int H1_size = H1.GetVSize();
+   const double h1order = (double) H1.GetOrder(0);
+   // Positions and velocities are gathered together.
+   H1G.MultXV(S, x_evec, v_evec);
+   v_src = S_p->GetData() + H1_size;
+   q1->SetOutputLayout(QVectorLayout::byVDIM);
+   q1->Derivatives(x_evec, q_dx);
+   q1->Derivatives(v_evec, q_dv);
+   ParGridFunction e;
+   e.MakeRef(&L2, *S_p, 2*H1_size);
+   q2->SetOutputLayout(QVectorLayout::byVDIM);
+   q2->Values(e, q_e);
+   const double dt_est = qdata.dt_est;
+   q_dt_est = dt_est;
+   QUpdateKernel(dim, Q1D, NE, NQ, use_viscosity, use_vorticity, qdata.h0,
+                 h1order, cfl, gamma_gf, ir.GetWeights(), q_dx,
+                 qdata.rho0DetJ0w, q_e, q_dv,
+                 qdata.Jac0inv, q_dt_est, qdata.stressJinvT,
+                 qdata.compact_stress ? &qdata.stress : nullptr,
+                 &qdata.jac0_class, const_weights);
+   // The force kernels interpolate the Jacobians of the compact stress.
+   qdata.positions = &x_evec;
+   if (capture)
+   {
+      capture->Record(KernelCapture::QUPDATE,
+                      {dim, Q1D, NE, NQ, use_viscosity, use_vorticity},
+                      {qdata.h0, h1order, cfl, dt_est},
+                      {gamma_gf, ir.GetWeights(), q_dx, qdata.rho0DetJ0w, q_e,
+                       q_dv, qdata.Jac0inv, q_dt_est, qdata.stressJinvT});
+   }
    qdata.dt_est = q_dt_est.Min();
    timer->sw_qdata.Stop();
    timer->quad_tstep += NE;
@@ -1330,7 +1845,52 @@ void LagrangianHydroOperator::AssembleForceMatrix() const
    if (forcemat_is_assembled || p_assembly) { return; }
    Force = 0.0;
    timer.sw_force.Start();
-   Force.Assemble();
+   // The threads compute the element matrices of a chunk of zones, which are
+   // then added to the sparse matrix in the zone order. This is the order of
+   // MixedBilinearForm::Assemble(), so the matrix does not depend on the
+   // number of threads.
+   BilinearFormIntegrator &fi = *(*Force.GetDBFI())[0];
+   SparseMatrix &F = Force.SpMat();
+   const int rows = h1dofs_cnt * dim, esize = rows * l2dofs_cnt;
+#ifdef MFEM_USE_OPENMP
+   const int chunk = 16 * omp_get_max_threads();
+#else
+   const int chunk = 16;
+#endif
+   Vector elmats(std::min(chunk, NE) * esize);
+   double *d_elmats = elmats.HostWrite();
+   Array<int> vdofs, dofs;
+   for (int z0 = 0; z0 < NE; z0 += chunk)
+   {
+      const int nz = std::min(chunk, NE - z0);
+#ifdef MFEM_USE_OPENMP
+      #pragma omp parallel
+#endif
+      {
+         IsoparametricTransformation T;
+         DenseMatrix elmat;
+#ifdef MFEM_USE_OPENMP
+         #pragma omp for schedule(dynamic)
+#endif
+         for (int z = 0; z < nz; z++)
+         {
+            pmesh->GetElementTransformation(z0 + z, &T);
+            fi.AssembleElementMatrix2(*L2.GetFE(z0 + z), *H1.GetFE(z0 + z), T,
+                                      elmat);
+            std::copy(elmat.Data(), elmat.Data() + esize,
+                      d_elmats + (size_t) z * esize);
+         }
+      }
+      for (int z = 0; z < nz; z++)
+      {
+         H1.GetElementVDofs(z0 + z, vdofs);
+         L2.GetElementDofs(z0 + z, dofs);
+         const DenseMatrix elmat(d_elmats + (size_t) z * esize, rows,
+                                 l2dofs_cnt);
+         F.AddSubMatrix(vdofs, dofs, elmat);
+      }
+   }
+   if (ForceSell) { ForceSell->UpdateValues(Force.SpMat()); }
    timer.sw_force.Stop();
    forcemat_is_assembled = true;
 }
@@ -1355,12 +1915,96 @@ void RK2AvgSolver::Init(TimeDependentOperator &tdop)
    S0.Update(block_offsets, mem_type);
 }
 
+// V = v0 + a * dv_dt and dx_dt = V, in one pass.
+static void FusedVelocityUpdate(const double a, const Vector &v0,
+                                const Vector &dv_dt, Vector &V, Vector &dx_dt)
+{
+   const int n = V.Size();
+   const auto d_v0 = v0.Read();
+   const auto d_dv = dv_dt.Read();
+   auto d_V = V.Write();
+   auto d_dx = dx_dt.Write();
+   MFEM_FORALL(i, n,
+   {
+      const double v = d_v0[i] + a * d_dv[i];
+      d_V[i] = v;
+      d_dx[i] = v;
+   });
+}
+
+// S0 = S and S = S + a * dS_dt, in one pass.
+static void FusedSaveAndUpdate(const double a, const Vector &dS_dt,
+                               Vector &S0, Vector &S)
+{
+   const int n = S.Size();
+   const auto d_dS = dS_dt.Read();
+   auto d_S0 = S0.Write();
+   auto d_S = S.ReadWrite();
+   MFEM_FORALL(i, n,
+   {
+      const double s = d_S[i];
+      d_S0[i] = s;
+      d_S[i] = s + a * d_dS[i];
+   });
+}
+
+// S = S0 + a * dS_dt, in one pass that also returns the local e.e, where e is
+// the part of S starting at e_offset.
+static double FusedFinalUpdate(const double a, const int e_offset,
+                               const Vector &S0, const Vector &dS_dt,
+                               Vector &S)
+{
+   const int n = S.Size();
+   if (Device::Allows(Backend::DEVICE_MASK))
+   {
+      // No fused reduction on devices, e.e is computed in a second pass.
+      add(S0, a, dS_dt, S);
+      Vector e(S, e_offset, n - e_offset);
+      return e * e;
+   }
+   const double *d_S0 = S0.HostRead();
+   const double *d_dS = dS_dt.HostRead();
+   double *d_S = S.HostWrite();
+   double e_norm2 = 0.0;
+#ifdef MFEM_USE_OPENMP
+   #pragma omp parallel for reduction(+:e_norm2)
+#endif
+   for (int i = 0; i < n; i++)
+   {
+      const double s = d_S0[i] + a * d_dS[i];
+      d_S[i] = s;
+      if (i >= e_offset) { e_norm2 += s * s; }
+   }
+   return e_norm2;
+}
+
+void RK2AvgSolver::SetInitialStateStorage(Vector &S_old)
+{
+   MFEM_VERIFY(hydro_oper, "RK2AvgSolver::Init must be called first.");
+   S0.Update(S_old, hydro_oper->GetBlockOffsets());
+}
+
+void RK2AvgSolver::VectorUpdateTraffic(double &unfused, double &fused) const
+{
+   const Array<int> &block_offsets = hydro_oper->GetBlockOffsets();
+   const double N = block_offsets[3];
+   const double Nv = block_offsets[2] - block_offsets[1];
+   const double Ne = block_offsets[3] - block_offsets[2];
+   // Separate passes: driver copy S_old = S and S0 = S (2 x 2N), two stages
+   // with V = v0 + a dv_dt (3Nv) and dx_dt = V (2Nv), two state updates
+   // S = S0 + a dS_dt (2 x 3N) and the driver's e.e (Ne).
+   unfused = sizeof(double) * (4*N + 2*(3*Nv + 2*Nv) + 2*3*N + Ne);
+   // Fused passes: S0 = S with S += a dS_dt (4N), two stages with V and
+   // dx_dt written together (4Nv), and S = S0 + a dS_dt with e.e (3N).
+   fused = sizeof(double) * (4*N + 2*4*Nv + 3*N);
+}
+
 void RK2AvgSolver::Step(Vector &S, double &t, double &dt)
 {
    // The monolithic BlockVector stores the unknown fields as follows:
    // (Position, Velocity, Specific Internal Energy).
-   S0.Vector::operator=(S);
-   Vector &v0 = S0.GetBlock(1);
+   const Array<int> &block_offsets = hydro_oper->GetBlockOffsets();
+   const int Vsize = block_offsets[2] - block_offsets[1];
    Vector &dx_dt = dS_dt.GetBlock(0);
    Vector &dv_dt = dS_dt.GetBlock(1);
 
@@ -1369,32 +2013,141 @@ void RK2AvgSolver::Step(Vector &S, double &t, double &dt)
    // - Compute dv_dt using S.
    // - Update V using dv_dt.
    // - Compute de_dt and dx_dt using S and V.
+   // The vector updates are fused, so that each one is a single pass.
 
    // -- 1.
-   // S is S0.
+   // S is S0, which is not stored yet.
    hydro_oper->UpdateMesh(S);
    hydro_oper->SolveVelocity(S, dS_dt);
-   // V = v0 + 0.5 * dt * dv_dt;
-   add(v0, 0.5 * dt, dv_dt, V);
+   {
+      // V = v0 + 0.5 * dt * dv_dt; dx_dt = V.
+      const Vector v0(S, block_offsets[1], Vsize);
+      FusedVelocityUpdate(0.5 * dt, v0, dv_dt, V, dx_dt);
+   }
    hydro_oper->SolveEnergy(S, V, dS_dt);
-   dx_dt = V;
 
    // -- 2.
-   // S = S0 + 0.5 * dt * dS_dt;
-   add(S0, 0.5 * dt, dS_dt, S);
+   // S0 = S; S = S0 + 0.5 * dt * dS_dt;
+   FusedSaveAndUpdate(0.5 * dt, dS_dt, S0, S);
    hydro_oper->ResetQuadratureData();
    hydro_oper->UpdateMesh(S);
    hydro_oper->SolveVelocity(S, dS_dt);
-   // V = v0 + 0.5 * dt * dv_dt;
-   add(v0, 0.5 * dt, dv_dt, V);
+   // V = v0 + 0.5 * dt * dv_dt; dx_dt = V.
+   FusedVelocityUpdate(0.5 * dt, S0.GetBlock(1), dv_dt, V, dx_dt);
    hydro_oper->SolveEnergy(S, V, dS_dt);
-   dx_dt = V;
 
    // -- 3.
-   // S = S0 + dt * dS_dt.
-   add(S0, dt, dS_dt, S);
+   // S = S0 + dt * dS_dt, with the local e.e of the new state.
+   e_norm2 = FusedFinalUpdate(dt, block_offsets[2], S0, dS_dt, S);
+   hydro_oper->ResetQuadratureData();
+   t += dt;
+}
+
+AdamsBashforthSolver::AdamsBashforthSolver(const int order,
+                                           const double shock_tol) :
+   order(order), shock_tol(shock_tol), nhist(0), t_next(0.0), rk_steps(0)
+{
+   MFEM_VERIFY(order == 2 || order == 3,
+               "Adams-Bashforth: only orders 2 and 3 are supported.");
+   h[0] = h[1] = 0.0;
+   idx[0] = 0; idx[1] = 1; idx[2] = 2;
+}
+
+void AdamsBashforthSolver::Init(TimeDependentOperator &tdop)
+{
+   HydroODESolver::Init(tdop);
+   const Array<int> &block_offsets = hydro_oper->GetBlockOffsets();
+   for (int i = 0; i < 3; i++)
+   {
+      dS[i].Update(block_offsets, mem_type);
+      dS[i] = 0.0;
+   }
+   Y.Update(block_offsets, mem_type);
+   K.Update(block_offsets, mem_type);
+   K_sum.Update(block_offsets, mem_type);
+   nhist = 0;
+}
+
+bool AdamsBashforthSolver::SlopeJump(const BlockVector &f0,
+                                     const BlockVector &f1) const
+{
+   // Relative change of the velocity slope between the last two evaluations.
+   // In smooth regions this is O(dt), while it is O(1) around shocks.
+   const Vector &dv0 = f0.GetBlock(1), &dv1 = f1.GetBlock(1);
+   Vector diff(dv0.Size());
+   diff.UseDevice(true);
+   subtract(dv0, dv1, diff);
+   const MPI_Comm comm = hydro_oper->GetComm();
+   const double diff2 = hydrodynamics::GlobalDot(comm, diff, diff);
+   const double dv02 = hydrodynamics::GlobalDot(comm, dv0, dv0);
+   return diff2 > shock_tol * shock_tol * dv02;
+}
+
+void AdamsBashforthSolver::RK4Step(Vector &S, const BlockVector &k1,
+                                   const double dt)
+{
+   // K_sum = k1 + 2 k2 + 2 k3 + k4.
+   K_sum = k1;
+   add(S, 0.5 * dt, k1, Y);
+   f->Mult(Y, K);
+   K_sum.Add(2.0, K);
+   add(S, 0.5 * dt, K, Y);
+   f->Mult(Y, K);
+   K_sum.Add(2.0, K);
+   add(S, dt, K, Y);
+   f->Mult(Y, K);
+   K_sum += K;
+   S.Add(dt / 6.0, K_sum);
+   rk_steps++;
+}
+
+void AdamsBashforthSolver::Step(Vector &S, double &t, double &dt)
+{
+   // The driver repeats a step by going back in time with a smaller dt. In that
+   // case, or when dt changed too much for the variable step formulas, the
+   // history is restarted.
+   if (nhist > 0 && (t != t_next || dt > 2.0 * h[0] || dt < 0.5 * h[0]))
+   {
+      nhist = 0;
+   }
+
+   // The oldest slot receives the slope at the current state.
+   const int oldest = idx[2];
+   idx[2] = idx[1]; idx[1] = idx[0]; idx[0] = oldest;
+   BlockVector &f0 = dS[idx[0]];
+   f->Mult(S, f0);
+   if (nhist > 0 && SlopeJump(f0, dS[idx[1]])) { nhist = 0; }
+
+   if (nhist < order - 1) { RK4Step(S, f0, dt); }
+   else
+   {
+      // Integrals over [0, dt] of the Lagrange polynomials through the slope
+      // times tau. The 2-point Gauss rule is exact for the cubic integrands.
+      const double tau[3] = { 0.0, -h[0], -h[0] - h[1] };
+      const double gp[2] = { 0.5 - 0.5 / sqrt(3.0), 0.5 + 0.5 / sqrt(3.0) };
+      for (int j = 0; j < order; j++)
+      {
+         double b = 0.0;
+         for (int g = 0; g < 2; g++)
+         {
+            const double s = gp[g] * dt;
+            double L = 1.0;
+            for (int m = 0; m < order; m++)
+            {
+               if (m != j) { L *= (s - tau[m]) / (tau[j] - tau[m]); }
+            }
+            b += 0.5 * dt * L;
+         }
+         S.Add(b, dS[idx[j]]);
+      }
+   }
    hydro_oper->ResetQuadratureData();
+
+   nhist = std::min(nhist + 1, order - 1);
+   h[1] = h[0];
+   h[0] = dt;
    t += dt;
+   t_next = t;
 }
 
 } // namespace mfem
@@ -19,6 +19,10 @@
 
 #include "mfem.hpp"
 #include "laghos_assembly.hpp"
+#include "laghos_commprof.hpp"
+#include "laghos_nodetable.hpp"
+#include "laghos_perfmodel.hpp"
+#include "laghos_reduce.hpp"
 
 #ifdef MFEM_USE_MPI
 
@@ -40,19 +44,29 @@ struct TimingData
 {
    // Total times for all major computations:
    // CG solves (H1 and L2) / force RHS assemblies / quadrature computations.
-   StopWatch sw_cgH1, sw_cgL2, sw_force, sw_qdata;
+   // The MPI calls made while they run are attributed to these phases.
+   PhaseWatch sw_cgH1, sw_cgL2, sw_force, sw_qdata;
 
    // Store the number of dofs of the corresponding local CG
-   const HYPRE_Int L2dof;
+   const long long L2dof;
 
    // These accumulate the total processed dofs or quad points:
    // #(CG iterations) for the L2 CG solve.
    // #quads * #(RK sub steps) for the quadrature data computations.
-   HYPRE_Int H1iter, L2iter;
-   HYPRE_Int quad_tstep;
+   // They are 64-bit, since long runs overflow 32-bit counters.
+   long long H1iter, L2iter;
+   long long quad_tstep;
+   // #(force evaluations), i.e., the number of velocity slope computations.
+   long long force_evals;
+   // Times of the operators replaced by this one after a rebalance, for the
+   // CG (H1), CG (L2), force and quadrature data computations.
+   double prev_rt[4];
 
-   TimingData(const HYPRE_Int l2d) :
-      L2dof(l2d), H1iter(0), L2iter(0), quad_tstep(0) { }
+   TimingData(const long long l2d) :
+      sw_cgH1(CommProfile::CG_H1), sw_cgL2(CommProfile::CG_L2),
+      sw_force(CommProfile::FORCE), sw_qdata(CommProfile::QDATA),
+      L2dof(l2d), H1iter(0), L2iter(0), quad_tstep(0), force_evals(0),
+      prev_rt() { }
 };
 
 class QUpdate
@@ -63,35 +77,77 @@ private:
    const double cfl;
    TimingData *timer;
    const IntegrationRule &ir;
+   // Whether the kernel uses the compile-time quadrature weights.
+   const bool const_weights;
    ParFiniteElementSpace &H1, &L2;
-   const Operator *H1R;
-   Vector q_dt_est, q_e, e_vec, q_dx, q_dv;
+   const H1Gather &H1G;
+   LargeArrays arrays;
+   Vector q_dt_est, q_e, x_evec, v_evec, q_dx, q_dv;
+   // Velocity L-vector gathered in v_evec by the last update.
+   const double *v_src;
    const QuadratureInterpolator *q1,*q2;
    const ParGridFunction &gamma_gf;
+   KernelCapture *capture;
 public:
    QUpdate(const int d, const int ne, const int q1d,
            const bool visc, const bool vort,
            const double cfl, TimingData *t,
            const ParGridFunction &gamma_gf,
            const IntegrationRule &ir,
-           ParFiniteElementSpace &h1, ParFiniteElementSpace &l2):
+           ParFiniteElementSpace &h1, ParFiniteElementSpace &l2,
+           const H1Gather &h1g):
       dim(d), vdim(h1.GetVDim()),
       NQ(ir.GetNPoints()), NE(ne), Q1D(q1d),
       use_viscosity(visc), use_vorticity(vort), cfl(cfl),
-      timer(t), ir(ir), H1(h1), L2(l2),
-      H1R(H1.GetElementRestriction(ElementDofOrdering::LEXICOGRAPHIC)),
-      q_dt_est(NE*NQ),
-      q_e(NE*NQ),
-      e_vec(NQ*NE*vdim),
-      q_dx(NQ*NE*vdim*vdim),
-      q_dv(NQ*NE*vdim*vdim),
+      timer(t), ir(ir),
+      const_weights(ConstBasisTables() &&
+                    ConstWeightsMatch(d, q1d, ir.GetWeights())),
+      H1(h1), L2(l2), H1G(h1g), v_src(nullptr),
       q1(H1.GetQuadratureInterpolator(ir)),
       q2(L2.GetQuadratureInterpolator(ir)),
-      gamma_gf(gamma_gf) { }
+      gamma_gf(gamma_gf), capture(nullptr)
+   {
+      const int ND = NE > 0 ? H1.GetFE(0)->GetDof() : 0;
+      arrays.Allocate(q_dt_est, NE*NQ);
+      arrays.Allocate(q_e, NE*NQ);
+      arrays.Allocate(x_evec, ND*NE*vdim);
+      arrays.Allocate(v_evec, ND*NE*vdim);
+      arrays.Allocate(q_dx, NQ*NE*vdim*vdim);
+      arrays.Allocate(q_dv, NQ*NE*vdim*vdim);
+   }
 
    void UpdateQuadratureData(const Vector &S, QuadratureData &qdata);
+   // E-vector of the velocity v, when v is the velocity block of the state
+   // vector of the last update; nullptr otherwise.
+   const Vector *GetVelocityE(const Vector &v) const
+   { return (v.GetData() == v_src) ? &v_evec : nullptr; }
+   void SetKernelCapture(KernelCapture *c) { capture = c; }
 };
 
+// Quadrature point kernel of QUpdate::UpdateQuadratureData, with all inputs
+// given as element (E-vector) data. Its offsets are 32-bit, since the largest
+// one (NE*NQ*dim*dim) fits in int, see QuadratureData. After
+// SetKernelIndex64(true), it uses the 64-bit variant of the kernel instead,
+// which is used to measure the cost of the 64-bit indexing. When stress is
+// given (3D), the compact quadrature data of QuadratureData::stress is
+// computed in it, instead of stressJinvT. With a non-empty jac0_class, the
+// matrices of zone z in Jac0inv are those of the class jac0_class[z]. With
+// cw, it uses the compile-time quadrature weights, which must match the given
+// ones (see ConstWeightsMatch()).
+void SetKernelIndex64(bool enable);
+bool KernelIndex64();
+void QUpdateKernel(const int dim, const int Q1D, const int NE, const int NQ,
+                   const bool use_viscosity, const bool use_vorticity,
+                   const double h0, const double h1order, const double cfl,
+                   const Vector &gamma, const Array<double> &weights,
+                   const Vector &Jacobians, const Vector &rho0DetJ0w,
+                   const Vector &e_quads, const Vector &grad_v_ext,
+                   const DenseTensor &Jac0inv,
+                   Vector &dt_est, DenseTensor &stressJinvT,
+                   Vector *stress = nullptr,
+                   const Array<int> *jac0_class = nullptr,
+                   const bool cw = false);
+
 // Given a solutions state (x, v, e), this class performs all necessary
 // computations to evaluate the new slopes (dx_dt, dv_dt, de_dt).
 class LagrangianHydroOperator : public TimeDependentOperator
@@ -116,6 +172,17 @@ protected:
    const bool use_viscosity, use_vorticity, p_assembly;
    const double cg_rel_tol;
    const int cg_max_iter;
+   // Adaptive (inexact) CG tolerances, see SetAdaptiveCGTolerance().
+   bool cg_adaptive;
+   int cg_order;
+   double cg_safety, cg_tol_max, cg_dt;
+   mutable double cg_extra_error;
+   // Right-hand side and solution of the previous solve of each slot (the
+   // velocity components, and 3 for the energy), the warm start flag and the
+   // relative right-hand side increment of the current solve.
+   mutable Vector cg_b_prev[4], cg_x_prev[4], cg_db;
+   mutable bool cg_warm;
+   mutable double cg_rho;
    const double ftz_tol;
    const ParGridFunction &gamma_gf;
    // Velocity mass matrix and local inverses of the energy mass matrices. These
@@ -129,11 +196,17 @@ protected:
    // These values are recomputed at each time step.
    const int Q1D;
    mutable QuadratureData qdata;
+   // Structured mode: the initial zones are translates of each other.
+   bool uniform_zones;
+   MassCoefficient mass_coeff;
    mutable bool qdata_is_current, forcemat_is_assembled;
    // Force matrix that combines the kinematic and thermodynamic spaces. It is
    // assembled in each time step and then it is used to compute the final
    // right-hand sides for momentum and specific internal energy.
    mutable MixedBilinearForm Force;
+   // Optional SELL-C-sigma copies of the full assembly force and velocity mass
+   // matrices, used for their mat-vecs instead of the CSR kernels.
+   SellMatrix *ForceSell, *MvSell;
    // Same as above, but done through partial assembly.
    ForcePAOperator *ForcePA;
    // Mass matrices done through partial assembly:
@@ -141,12 +214,18 @@ protected:
    MassPAOperator *VMassPA, *EMassPA;
    OperatorJacobiSmoother *VMassPA_Jprec;
    // Linear solver for energy.
-   CGSolver CG_VMass, CG_EMass;
+   mutable ReproducibleCGSolver CG_VMass, CG_EMass;
    mutable TimingData timer;
    mutable QUpdate *qupdate;
+   KernelCapture *capture;
+   // Node shared table of the Jac0inv matrices of the zone classes.
+   NodeSharedTable *jac0_table;
    mutable Vector X, B, one, rhs, e_rhs;
    mutable ParGridFunction rhs_c_gf, dvc_gf;
    mutable Array<int> c_tdofs[3];
+   // Measured time of each zone in UpdateQuadratureData (1D/FA mode), when
+   // the measurement is enabled.
+   mutable Vector zone_cost;
 
    virtual void ComputeMaterialProperties(int nvalues, const double gamma[],
                                           const double rho[], const double e[],
@@ -161,6 +240,17 @@ protected:
 
    void UpdateQuadratureData(const Vector &S) const;
    void AssembleForceMatrix() const;
+   // Local energy mass matrices and their inverses (full assembly).
+   void AssembleEnergyMass();
+
+   // CG tolerance for the solve of the slot s with right-hand side b in the
+   // current stage. In the adaptive mode, x is set to the previous solution
+   // of the slot, when it is a good initial guess (cg_warm).
+   double StageCGTolerance(const int s, const Vector &b, Vector &x) const;
+   // Keeps b and the solution x of the slot s for the next stage, and adds
+   // the extra solve error compared to a solve with the fixed tolerance.
+   void AddCGExtraError(const int s, const double tol, const Vector &b,
+                        const Vector &x) const;
 
 public:
    LagrangianHydroOperator(const int size,
@@ -174,7 +264,10 @@ public:
                            const double cfl,
                            const bool visc, const bool vort, const bool pa,
                            const double cgt, const int cgiter, double ftz_tol,
-                           const int order_q);
+                           const int order_q, const bool sell = false,
+                           const bool structured = false,
+                           const bool compact_stress = false,
+                           const bool node_geometry = false);
    ~LagrangianHydroOperator();
 
    // Solve for dx_dt, dv_dt and de_dt.
@@ -191,6 +284,28 @@ public:
    double GetTimeStepEstimate(const Vector &S) const;
    void ResetTimeStepEstimate() const;
    void ResetQuadratureData() const { qdata_is_current = false; }
+   QuadratureData &GetQuadratureData() const { return qdata; }
+   const IntegrationRule &GetIntRule() const { return ir; }
+   // Rebuilds the mass matrices from qdata.rho0DetJ0w on the current mesh,
+   // after both were changed by a remap.
+   void UpdateMassMatrices();
+   // Records the kernel calls until it is reset with nullptr.
+   void SetKernelCapture(KernelCapture *c);
+   // Starts (from zero) or stops the accumulation of the zone costs.
+   void MeasureZoneCosts(bool enable);
+   const Vector &GetZoneCosts() const { return zone_cost; }
+   // Structured mode: false if the initial zones of this rank are not all
+   // translates of each other, i.e., if sharing Jac0inv is wrong.
+   bool UniformZones() const { return uniform_zones; }
+   // Structured mode: true if the H1 gather of the partial assembly looks up
+   // the dofs in the node table of the box of the zones, see H1Gather.
+   bool BoxNodeGather() const
+   { return ForcePA && ForcePA->GetH1Gather().UsesBoxNodes(); }
+   // Node shared geometry: the table of the Jac0inv classes, else nullptr.
+   const NodeSharedTable *GetJac0invTable() const { return jac0_table; }
+   // Continues the timings, counters and CG error estimate of prev, which is
+   // replaced by this operator, e.g., after a rebalance.
+   void ContinueFrom(const LagrangianHydroOperator &prev);
 
    // The density values, which are stored only at some quadrature points,
    // are projected as a ParGridFunction.
@@ -199,9 +314,30 @@ public:
    double KineticEnergy(const ParGridFunction &v) const;
 
    int GetH1VSize() const { return H1.GetVSize(); }
+   MPI_Comm GetComm() const { return H1.GetComm(); }
+   long long GetForceEvaluations() const { return timer.force_evals; }
    const Array<int> &GetBlockOffsets() const { return block_offsets; }
 
-   void PrintTimingData(bool IamRoot, int steps, const bool fom) const;
+   void PrintTimingData(bool IamRoot, long long steps,
+                        const bool fom) const;
+   // Global sizes, kernel work and kernel times, with the given number of
+   // force evaluations (steps of PrintTimingData), on all ranks.
+   void GetPerfCounts(long long steps, PerfCounts &c) const;
+
+   // Inexact solve policy: each solve starts from the solution of the same
+   // solve in the previous stage, and its tolerance follows the relative
+   // stage increment rho of the right-hand side. The slope error is kept at
+   // max(cgt, safety * rho^order) times the slope, i.e., at the level of the
+   // fixed solves or of the local truncation error of a time integrator of
+   // the given order, so small increments need few iterations. The relative
+   // tolerance is bounded by cgt from below and by tol_max from above.
+   void SetAdaptiveCGTolerance(const int order, const double safety,
+                               const double tol_max);
+   // Step size used by the adaptive CG tolerances.
+   void SetTimeStep(const double dt) { cg_dt = dt; }
+   // Estimate of the accumulated extra error in the solution due to the solves
+   // that were looser than the fixed tolerance cgt.
+   double GetCGExtraError() const { return cg_extra_error; }
 };
 
 // TaylorCoefficient used in the 2D Taylor-Green problem.
@@ -248,10 +384,50 @@ class RK2AvgSolver : public HydroODESolver
 protected:
    Vector V;
    BlockVector dS_dt, S0;
+   // Local e.e of the last computed state, from the final fused update.
+   double e_norm2;
+public:
+   RK2AvgSolver() : e_norm2(0.0) { }
+   virtual void Init(TimeDependentOperator &_f);
+   virtual void Step(Vector &S, double &t, double &dt);
+   // Use S_old to store the state at the beginning of each step. The driver can
+   // then restore repeated steps from it without making its own copy.
+   void SetInitialStateStorage(Vector &S_old);
+   double GetLocalEnergyNorm2() const { return e_norm2; }
+   // Local memory traffic (bytes) of the vector updates in one step, with the
+   // separate passes (including the driver copy and e.e) and with the fused
+   // kernels.
+   void VectorUpdateTraffic(double &unfused, double &fused) const;
+};
+
+// Variable step Adams-Bashforth method of order 2 or 3. The slopes of the
+// previous steps are stored, so that each step needs only one evaluation of the
+// operator. The history is (re)started with RK4 steps at the beginning, after a
+// repeated step, when dt changes too much between steps, and when the velocity
+// slope changes abruptly, e.g., when a shock forms or passes through.
+class AdamsBashforthSolver : public HydroODESolver
+{
+protected:
+   const int order;
+   const double shock_tol;
+   // Number of stored previous slopes, their step sizes and the time at which
+   // the next step is expected to start.
+   int nhist;
+   double h[2], t_next;
+   // Current and previous slopes, dS[idx[0]] is the most recent one.
+   BlockVector dS[3];
+   int idx[3];
+   // RK4 stages, used to build the history.
+   BlockVector Y, K, K_sum;
+   int rk_steps;
+
+   bool SlopeJump(const BlockVector &f0, const BlockVector &f1) const;
+   void RK4Step(Vector &S, const BlockVector &k1, const double dt);
 public:
-   RK2AvgSolver() { }
+   AdamsBashforthSolver(const int order, const double shock_tol = 0.5);
    virtual void Init(TimeDependentOperator &_f);
    virtual void Step(Vector &S, double &t, double &dt);
+   int GetRKSteps() const { return rk_steps; }
 };
 
 } // namespace mfem
@@ -0,0 +1,296 @@
+// Copyright (c) 2017, Lawrence Livermore National Security, LLC. Produced at
+// the Lawrence Livermore National Laboratory. LLNL-CODE-734707. All Rights
+// reserved. See files LICENSE and NOTICE for details.
+//
+// This file is part of CEED, a collection of benchmarks, miniapps, software
+// libraries and APIs for efficient high-order finite element and spectral
+// element discretizations for exascale applications. For more information and
+// source code availability see http://github.com/ceed.
+//
+// The CEED research is supported by the Exascale Computing Project 17-SC-20-SC,
+// a collaborative effort of two U.S. Department of Energy organizations (Office
+// of Science and the National Nuclear Security Administration) responsible for
+// the planning and preparation of a capable exascale ecosystem, including
+// software, applications, hardware, advanced system engineering and early
+// testbed platforms, in support of the nation's exascale computing imperative.
+
+#include "laghos_vis.hpp"
+#include <chrono>
+#include <limits>
+#include <sstream>
+
+namespace mfem
+{
+
+namespace hydrodynamics
+{
+
+// Time given to the sender threads to send their last frame and stop.
+static const int sender_stop_seconds = 10;
+
+LowBandwidthVis::LowBandwidthVis(ParMesh &pm, int aggregators,
+                                 const char *vishost, int visport,
+                                 bool rho)
+   : pmesh(pm), host(vishost), port(visport), dim(pm.Dimension()),
+     nv(Geometry::NumVerts[pm.GetElementBaseGeometry(0)]),
+     geom(pm.GetElementBaseGeometry(0)), send_rho(rho),
+     frames(0), dropped(0), state_req(MPI_REQUEST_NULL), state(0),
+     glob_state(0), stopped(false)
+{
+   MFEM_VERIFY(aggregators > 0, "The number of aggregators must be positive!");
+   const MPI_Comm comm = pmesh.GetComm();
+   int nranks, rank;
+   MPI_Comm_size(comm, &nranks);
+   MPI_Comm_rank(comm, &rank);
+   const int group_size = (nranks + aggregators - 1) / aggregators;
+   groups = (nranks + group_size - 1) / group_size;
+   gid = rank / group_size;
+   MPI_Comm_split(comm, gid, rank, &group);
+   int group_rank, group_ranks;
+   MPI_Comm_rank(group, &group_rank);
+   MPI_Comm_size(group, &group_ranks);
+   aggregator = group_rank == 0;
+   if (aggregator)
+   {
+      counts.SetSize(group_ranks);
+      displs.SetSize(group_ranks);
+   }
+   UpdateLayout();
+   if (aggregator)
+   {
+      sender = std::make_shared<Sender>();
+      Sender &s = *sender;
+      s.host = host;
+      s.port = port;
+      s.dim = dim;
+      s.nv = nv;
+      s.groups = groups;
+      s.gid = gid;
+      s.geom = geom;
+      s.send_rho = send_rho;
+      thread = std::thread(&Sender::Run, sender);
+   }
+   StartStateReduction();
+}
+
+void LowBandwidthVis::StartStateReduction()
+{
+   state = !sender ? 0 : (sender->failed ? 2 : (sender->busy ? 1 : 0));
+   MPI_Iallreduce(&state, &glob_state, 1, MPI_INT, MPI_MAX, pmesh.GetComm(),
+                  &state_req);
+}
+
+void LowBandwidthVis::UpdateLayout()
+{
+   const int size = pmesh.GetNE() * RecordSize();
+   MPI_Gather(&size, 1, MPI_INT, counts.GetData(), 1, MPI_INT, 0, group);
+   if (!aggregator) { return; }
+   long long total = 0;
+   for (int i = 0; i < counts.Size(); i++)
+   {
+      displs[i] = (int) total;
+      total += counts[i];
+   }
+   MFEM_VERIFY(total <= std::numeric_limits<int>::max(),
+               "Too many zones per aggregator, use more aggregators!");
+}
+
+LowBandwidthVis::~LowBandwidthVis()
+{
+   MPI_Wait(&state_req, MPI_STATUS_IGNORE);
+   if (aggregator)
+   {
+      Sender &s = *sender;
+      std::unique_lock<std::mutex> lock(s.mutex);
+      s.stop = true;
+      s.ready.notify_one();
+      const bool exited =
+         s.taken.wait_for(lock, std::chrono::seconds(sender_stop_seconds),
+                          [&s] { return s.exited; });
+      lock.unlock();
+      if (exited) { thread.join(); }
+      else
+      {
+         // Blocked on GLVis: the thread keeps its reference to the state.
+         thread.detach();
+         mfem::out << "GLVis sender of group " << gid << " did not stop in "
+                   << sender_stop_seconds << " s, detached." << std::endl;
+      }
+   }
+   MPI_Comm_free(&group);
+}
+
+void LowBandwidthVis::Send(const ParGridFunction &v, const ParGridFunction &e,
+                           const QuadratureData &qdata,
+                           const IntegrationRule &ir)
+{
+   // Drop the frame everywhere if any aggregator was busy at the previous
+   // frame, before it was queued, so that the pieces received by GLVis always
+   // belong to the same frame. The reduction was started there, so it has
+   // completed by now.
+   if (stopped) { return; }
+   MPI_Wait(&state_req, MPI_STATUS_IGNORE);
+   if (glob_state == 2)
+   {
+      stopped = true;
+      if (pmesh.GetMyRank() == 0)
+      {
+         mfem::out << "GLVis streaming to " << host << ":" << port
+                   << " failed, stopped after " << frames << " frames."
+                   << std::endl;
+      }
+      return;
+   }
+   if (glob_state == 1) { dropped++; StartStateReduction(); return; }
+
+   // Zone records: vertex coordinates, density, velocity, energy.
+   const int NE = pmesh.GetNE(), NQ = ir.GetNPoints(), rs = RecordSize();
+   std::vector<double> local((size_t) NE * rs);
+   const double *rho0DetJ0w = qdata.rho0DetJ0w.HostRead();
+   v.HostRead();
+   e.HostRead();
+   const IntegrationRule &verts = *Geometries.GetVertices(geom);
+   Vector x(dim), vq(dim), vz(dim);
+   for (int z = 0; z < NE; z++)
+   {
+      double *r = &local[(size_t) z * rs];
+      ElementTransformation &T = *pmesh.GetElementTransformation(z);
+      for (int i = 0; i < nv; i++)
+      {
+         T.Transform(verts.IntPoint(i), x);
+         for (int d = 0; d < dim; d++) { r[i*dim + d] = x(d); }
+      }
+      double mass = 0.0, ez = 0.0;
+      vz = 0.0;
+      for (int q = 0; q < NQ; q++)
+      {
+         const IntegrationPoint &ip = ir.IntPoint(q);
+         const double m = rho0DetJ0w[z*NQ + q];
+         mass += m;
+         ez += m * e.GetValue(z, ip);
+         v.GetVectorValue(z, ip, vq);
+         vz.Add(m, vq);
+      }
+      r[nv*dim] = mass / pmesh.GetElementVolume(z);
+      for (int d = 0; d < dim; d++) { r[nv*dim + 1 + d] = vz(d) / mass; }
+      r[nv*dim + 1 + dim] = ez / mass;
+   }
+
+   std::vector<double> gathered;
+   if (aggregator) { gathered.resize(displs.Last() + counts.Last()); }
+   MPI_Gatherv(local.data(), NE * rs, MPI_DOUBLE, gathered.data(),
+               counts.GetData(), displs.GetData(), MPI_DOUBLE, 0, group);
+   frames++;
+   // Before the frame is queued: the next frame is only dropped if the
+   // previous one is still being sent now.
+   StartStateReduction();
+   if (aggregator)
+   {
+      Sender &s = *sender;
+      std::unique_lock<std::mutex> lock(s.mutex);
+      // The sender takes each frame as soon as it is free, the slot is only
+      // still full if it has not been scheduled yet.
+      s.taken.wait(lock, [&s] { return !s.pending || s.exited; });
+      if (s.exited) { return; }
+      s.frame.swap(gathered);
+      s.pending = true;
+      s.busy = true;
+      s.ready.notify_one();
+   }
+}
+
+void LowBandwidthVis::Sender::Run(std::shared_ptr<Sender> s)
+{
+   s->SendFrames();
+   std::lock_guard<std::mutex> lock(s->mutex);
+   s->exited = true;
+   s->taken.notify_one();
+}
+
+void LowBandwidthVis::Sender::SendFrames()
+{
+   const char *titles[3] = { "Density", "Velocity",
+                             "Specific Internal Energy"
+                           };
+   const char *keys = (dim == 2) ? "mAcRjl" : "mmaaAcl";
+   const int Ww = 350, Wh = 350; // window size
+   socketstream socks[3];
+   std::vector<double> data;
+   while (true)
+   {
+      {
+         std::unique_lock<std::mutex> lock(mutex);
+         ready.wait(lock, [this] { return pending || stop; });
+         if (!pending) { return; }
+         data.swap(frame);
+         pending = false;
+      }
+      taken.notify_one();
+
+      // Piece of the mesh of this aggregator, with separate zone vertices.
+      const int rs = nv * dim + dim + 2, nz = data.size() / rs;
+      std::ostringstream mesh;
+      mesh.precision(8);
+      mesh << "MFEM mesh v1.0\n\ndimension\n" << dim
+           << "\n\nelements\n" << nz << '\n';
+      for (int z = 0; z < nz; z++)
+      {
+         mesh << "1 " << geom;
+         for (int i = 0; i < nv; i++) { mesh << ' ' << z*nv + i; }
+         mesh << '\n';
+      }
+      mesh << "\nboundary\n0\n\nvertices\n" << nz * nv << '\n' << dim << '\n';
+      for (int z = 0; z < nz; z++)
+      {
+         for (int i = 0; i < nv; i++)
+         {
+            const double *x = &data[(size_t) z*rs + i*dim];
+            for (int d = 0; d < dim; d++) { mesh << (d ? " " : "") << x[d]; }
+            mesh << '\n';
+         }
+      }
+
+      for (int f = send_rho ? 0 : 1; f < 3; f++)
+      {
+         socketstream &sock = socks[f];
+         bool newly_opened = false;
+         if (!sock.is_open())
+         {
+            if (sock.open(host.c_str(), port) != 0) { failed = true; }
+            sock.precision(8);
+            newly_opened = true;
+         }
+         if (failed) { break; }
+         const int vdim = (f == 1) ? dim : 1;
+         const int offset = nv*dim + ((f == 2) ? 1 + dim : f);
+         sock << "parallel " << groups << ' ' << gid << "\nsolution\n"
+              << mesh.str()
+              << "\nFiniteElementSpace\nFiniteElementCollection: L2_" << dim
+              << "D_P0\nVDim: " << vdim << "\nOrdering: 0\n\n";
+         for (int d = 0; d < vdim; d++)
+         {
+            for (int z = 0; z < nz; z++)
+            {
+               sock << data[(size_t) z*rs + offset + d] << '\n';
+            }
+         }
+         if (newly_opened)
+         {
+            sock << "window_title '" << titles[f] << "'\n"
+                 << "window_geometry " << f * (Ww+10) << " 0 "
+                 << Ww << " " << Wh << "\n"
+                 << "keys " << keys << ((f == 1) ? "vvv" : "") << '\n';
+         }
+         sock << std::flush;
+         if (!sock) { failed = true; break; }
+      }
+      if (failed) { return; }
+      // Still busy if the next frame was queued meanwhile.
+      std::lock_guard<std::mutex> lock(mutex);
+      busy = pending;
+   }
+}
+
+} // namespace hydrodynamics
+
+} // namespace mfem
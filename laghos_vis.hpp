@@ -0,0 +1,120 @@
+// Copyright (c) 2017, Lawrence Livermore National Security, LLC. Produced at
+// the Lawrence Livermore National Laboratory. LLNL-CODE-734707. All Rights
+// reserved. See files LICENSE and NOTICE for details.
+//
+// This file is part of CEED, a collection of benchmarks, miniapps, software
+// libraries and APIs for efficient high-order finite element and spectral
+// element discretizations for exascale applications. For more information and
+// source code availability see http://github.com/ceed.
+//
+// The CEED research is supported by the Exascale Computing Project 17-SC-20-SC,
+// a collaborative effort of two U.S. Department of Energy organizations (Office
+// of Science and the National Nuclear Security Administration) responsible for
+// the planning and preparation of a capable exascale ecosystem, including
+// software, applications, hardware, advanced system engineering and early
+// testbed platforms, in support of the nation's exascale computing imperative.
+
+#ifndef MFEM_LAGHOS_VIS
+#define MFEM_LAGHOS_VIS
+
+#include "mfem.hpp"
+#include "laghos_assembly.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace mfem
+{
+
+namespace hydrodynamics
+{
+
+// Low-bandwidth GLVis streaming of the density, velocity and specific internal
+// energy. Each frame holds one value per zone: the zone mass over its volume
+// for the density, and the mass-weighted averages of v and e, on the
+// straight-sided zones through the current vertex positions. The frames are
+// gathered on a few aggregating ranks, which send them to GLVis as the pieces
+// of a parallel stream from a background thread. The simulation never waits
+// for GLVis: each frame is queued behind at most one frame being sent. The
+// states of the aggregators are sampled at each frame, before it is queued,
+// and reduced without blocking during the time step. When an aggregator was
+// busy at the previous frame, the new frame is dropped on all the ranks. When
+// a connection or a send fails, the failure is reported once and the streaming
+// stops on all the ranks. The sender threads make no MPI calls, which needs
+// MPI_THREAD_FUNNELED.
+class LowBandwidthVis
+{
+private:
+   ParMesh &pmesh;
+   const std::string host;
+   const int port, dim, nv;
+   const Geometry::Type geom;
+   const bool send_rho;
+   MPI_Comm group;
+   int groups, gid;
+   bool aggregator;
+   // Gather layout of the zone records on the aggregators.
+   Array<int> counts, displs;
+   int frames, dropped;
+
+   // State of the sender thread of an aggregator, with a single frame slot.
+   // The thread holds its own reference, so that it can be detached when it
+   // does not stop in time, e.g., when it is blocked on a stalled socket.
+   struct Sender
+   {
+      std::string host;
+      int port, dim, nv, groups, gid;
+      Geometry::Type geom;
+      bool send_rho;
+      std::mutex mutex;
+      // Signaled by the main thread when a frame is queued or at the stop,
+      // and by the sender when it takes a frame or exits.
+      std::condition_variable ready, taken;
+      std::vector<double> frame;
+      bool pending = false, stop = false, exited = false;
+      // A frame is queued or being sent.
+      std::atomic<bool> busy{false}, failed{false};
+
+      static void Run(std::shared_ptr<Sender> s);
+      void SendFrames();
+   };
+   std::shared_ptr<Sender> sender;
+   std::thread thread;
+
+   // Reduction of the states of all the ranks (0 ready, 1 busy, 2 failed),
+   // started at the previous frame, and the streaming stop flag.
+   MPI_Request state_req;
+   int state, glob_state;
+   bool stopped;
+   void StartStateReduction();
+
+   int RecordSize() const { return nv * dim + dim + 2; }
+
+public:
+   // Streams to host:port from the given number of aggregating ranks. Without
+   // send_rho, the density window is not opened.
+   LowBandwidthVis(ParMesh &pmesh, int aggregators, const char *host,
+                   int port, bool send_rho);
+   ~LowBandwidthVis();
+
+   // Gathers the new zone counts, after the mesh was rebalanced.
+   void UpdateLayout();
+
+   // Sends the current fields, or drops the frame if GLVis is behind. Does
+   // nothing after a failure.
+   void Send(const ParGridFunction &v, const ParGridFunction &e,
+             const QuadratureData &qdata, const IntegrationRule &ir);
+
+   int GetFrames() const { return frames; }
+   int GetDropped() const { return dropped; }
+};
+
+} // namespace hydrodynamics
+
+} // namespace mfem
+
+#endif // MFEM_LAGHOS_VIS